@@ -714,6 +714,21 @@ class NeumoGui(wx.App):
     def Jump(self, seconds):
         self.current_mpv_player.jump(seconds)
 
+    def TrickPlay(self, direction):
+        """
+        direction=1: start fast forward, or double its speed, up to 64x; direction=-1: same for rewind.
+        In the opposite direction, the speed is halved, until normal play resumes
+        """
+        speed = self.current_mpv_player.get_trick_play_speed()
+        if speed == 0:
+            speed = 2 * direction
+        elif (speed > 0) == (direction > 0):
+            speed = min(2 * abs(speed), 64) * direction
+        else:
+            speed = 0 if abs(speed) == 2 else speed // 2
+        dtdebug(f'TrickPlay speed={speed}')
+        self.current_mpv_player.set_trick_play(speed)
+
     def AudioLang(self, dark_mode):
         langs = self.current_mpv_player.audio_languages()
         from neumodvb.language_dialog import show_audio_language_dialog
@@ -2706,6 +2706,14 @@ class LivePanel(wx.Panel):
         dtdebug('CmdJumpBack')
         return wx.GetApp().Jump(-60)
 
+    def CmdFastForward(self, event=None):
+        dtdebug('CmdFastForward')
+        return wx.GetApp().TrickPlay(1)
+
+    def CmdRewind(self, event=None):
+        dtdebug('CmdRewind')
+        return wx.GetApp().TrickPlay(-1)
+
     def CmdVolumeUp(self, evt):
         dtdebug('CmdVolumeUp')
         self.mosaic_panel.ChangeVolume(+1)
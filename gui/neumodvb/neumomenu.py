@@ -73,6 +73,8 @@ play_menu = (
     MI("Stop",  _("&Stop\tCtrl-X"), ""),
     MI("JumpBack",  _("&Back\tLeft"), ""),
     MI("JumpForward",  _("&Forward\tRight"), ""),
+    MI("Rewind",  _("&Rewind\tShift-Left"), ""),
+    MI("FastForward",  _("&Fast forward\tShift-Right"), ""),
     SEP,
     MI("AudioLang",  _("&Audio language\tCtrl-Shift-3"), ""), #ctrl-#
     MI("SubtitleLang",  _("&Subtitle language\tCtrl-T"), ""),
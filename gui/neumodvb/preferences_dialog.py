@@ -45,6 +45,8 @@ class PreferencesDialog(PreferencesDialog_):
             elif type(w) == wx.TextCtrl:
                 w.SetValue(str(v))
             elif type(w) == DtIntCtrl:
+                if type(v) == datetime.timedelta: #durations in milliseconds
+                    v = v // datetime.timedelta(milliseconds=1)
                 w.SetValue(int(v))
             elif type(w) == wx.CheckBox:
                 w.SetValue(int(v))
@@ -70,6 +72,8 @@ class PreferencesDialog(PreferencesDialog_):
                 v = w.GetValue()
             elif type(w) == DtIntCtrl:
                 v = w.GetValue()
+                if type(getattr(self.opts, e, None)) == datetime.timedelta:
+                    v = datetime.timedelta(milliseconds=v)
             elif type(w) == wx.CheckBox:
                 v= w.GetValue()
             else:
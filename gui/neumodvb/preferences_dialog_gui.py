@@ -71,7 +71,7 @@ class PreferencesDialog_(wx.Dialog):
         self.softcam_panel = wx.Panel(self.preferences_notebook, wx.ID_ANY)
         self.preferences_notebook.AddPage(self.softcam_panel, _("Softcam"))
 
-        grid_sizer_2 = wx.FlexGridSizer(3, 2, 5, 5)
+        grid_sizer_2 = wx.FlexGridSizer(5, 2, 5, 5)
 
         softcam_server_label = wx.StaticText(self.softcam_panel, wx.ID_ANY, _("Server"))
         grid_sizer_2.Add(softcam_server_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
@@ -95,10 +95,26 @@ class PreferencesDialog_(wx.Dialog):
         self.softcam_enabled = wx.CheckBox(self.softcam_panel, wx.ID_ANY, "")
         grid_sizer_2.Add(self.softcam_enabled, 0, 0, 0)
 
+        descrambling_threads_label = wx.StaticText(self.softcam_panel, wx.ID_ANY, _("Descrambling threads"))
+        grid_sizer_2.Add(descrambling_threads_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.descrambling_threads = DtIntCtrl(self.softcam_panel, wx.ID_ANY, _("0"))
+        self.descrambling_threads.SetMinSize((250, -1))
+        self.descrambling_threads.SetToolTip(_("Number of threads shared by all services for descrambling; 0: descramble on each service's own thread"))
+        grid_sizer_2.Add(self.descrambling_threads, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        descrambling_latency_target_label = wx.StaticText(self.softcam_panel, wx.ID_ANY, _("Descrambling latency (ms)"))
+        grid_sizer_2.Add(descrambling_latency_target_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.descrambling_latency_target = DtIntCtrl(self.softcam_panel, wx.ID_ANY, _("100"))
+        self.descrambling_latency_target.SetMinSize((250, -1))
+        self.descrambling_latency_target.SetToolTip(_("Maximum time in milliseconds for which received data may wait before being descrambled; larger values descramble more efficiently"))
+        grid_sizer_2.Add(self.descrambling_latency_target, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
         self.record_pane = wx.Panel(self.preferences_notebook, wx.ID_ANY)
         self.preferences_notebook.AddPage(self.record_pane, _("Record"))
 
-        grid_sizer_3 = wx.FlexGridSizer(6, 2, 5, 5)
+        grid_sizer_3 = wx.FlexGridSizer(10, 2, 5, 5)
 
         label_9 = wx.StaticText(self.record_pane, wx.ID_ANY, _("Default record time"))
         grid_sizer_3.Add(label_9, 0, wx.ALIGN_CENTER_VERTICAL, 0)
@@ -148,6 +164,36 @@ class PreferencesDialog_(wx.Dialog):
         self.livebuffer_mpm_part_duration.SetToolTip(_("Timeshift resolution (use format 1h 3m 2s for 1 hours, 3 minutes and 1 second)"))
         grid_sizer_3.Add(self.livebuffer_mpm_part_duration, 0, wx.ALIGN_CENTER_VERTICAL, 0)
 
+        livebuffer_use_io_uring_label = wx.StaticText(self.record_pane, wx.ID_ANY, _("Write timeshift with io_uring"))
+        grid_sizer_3.Add(livebuffer_use_io_uring_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.livebuffer_use_io_uring = wx.CheckBox(self.record_pane, wx.ID_ANY, "")
+        self.livebuffer_use_io_uring.SetToolTip(_("Write timeshift buffers using io_uring instead of a memory map"))
+        grid_sizer_3.Add(self.livebuffer_use_io_uring, 0, 0, 0)
+
+        livebuffer_spare_parts_label = wx.StaticText(self.record_pane, wx.ID_ANY, _("Spare timeshift parts"))
+        grid_sizer_3.Add(livebuffer_spare_parts_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.livebuffer_spare_parts = DtIntCtrl(self.record_pane, wx.ID_ANY, _("2"))
+        self.livebuffer_spare_parts.SetMinSize((250, -1))
+        self.livebuffer_spare_parts.SetToolTip(_("Number of expired timeshift parts kept for reuse; 0: delete expired parts"))
+        grid_sizer_3.Add(self.livebuffer_spare_parts, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        livebuffer_index_commit_delay_label = wx.StaticText(self.record_pane, wx.ID_ANY, _("Timeshift index delay (ms)"))
+        grid_sizer_3.Add(livebuffer_index_commit_delay_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.livebuffer_index_commit_delay = DtIntCtrl(self.record_pane, wx.ID_ANY, _("250"))
+        self.livebuffer_index_commit_delay.SetMinSize((250, -1))
+        self.livebuffer_index_commit_delay.SetToolTip(_("Maximum time in milliseconds for which new timeshift index records may wait before being written to the database"))
+        grid_sizer_3.Add(self.livebuffer_index_commit_delay, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        livebuffer_mux_capture_label = wx.StaticText(self.record_pane, wx.ID_ANY, _("Shared mux capture"))
+        grid_sizer_3.Add(livebuffer_mux_capture_label, 0, wx.ALIGN_CENTER_VERTICAL, 0)
+
+        self.livebuffer_mux_capture = wx.CheckBox(self.record_pane, wx.ID_ANY, "")
+        self.livebuffer_mux_capture.SetToolTip(_("Let unscrambled services on the same mux share one demux and one set of timeshift files"))
+        grid_sizer_3.Add(self.livebuffer_mux_capture, 0, 0, 0)
+
         self.preferences_notebook_Tune = wx.Panel(self.preferences_notebook, wx.ID_ANY)
         self.preferences_notebook.AddPage(self.preferences_notebook_Tune, _("Tune"))
 
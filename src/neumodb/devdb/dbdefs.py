@@ -455,7 +455,13 @@ user_options = db_struct(name ='user_options',
                         (9, 'int32_t', 'livebuffer_mpm_part_duration', '10*60'),  #10 minutes
                         (19, 'ss::string<16>', 'softcam_server', '"192.168.2.254"'),
                         (20, 'int16_t', 'softcam_port', '9000'),
-                        (21, 'bool', 'softcam_enabled', 'true')
+                        (21, 'bool', 'softcam_enabled', 'true'),
+                        (22, 'int16_t', 'descrambling_threads', '0'),
+                        (23, 'int32_t', 'descrambling_latency_target', '100'), #milliseconds
+                        (24, 'bool', 'livebuffer_use_io_uring', 'false'),
+                        (25, 'int16_t', 'livebuffer_spare_parts', '2'),
+                        (26, 'int32_t', 'livebuffer_index_commit_delay', '250'), #milliseconds
+                        (27, 'bool', 'livebuffer_mux_capture', 'false')
                     ))
 
 
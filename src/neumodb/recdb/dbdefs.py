@@ -160,7 +160,8 @@ file = db_struct(name='file',
                           (5, 'time_t', 'real_time_end'), #in unix epoch
                           (6, 'int64_t', 'stream_packetno_start'),  #redundant
                           (7, 'int64_t', 'stream_packetno_end', 'std::numeric_limits<int64_t>::max()'),   #redundant
-                          (8, 'ss::string<128>', 'filename')
+                          (8, 'ss::string<128>', 'filename'),
+                          (9, 'bool', 'mux_capture', 'false') #part of a mux capture, also containing other services
                 ))
 
 
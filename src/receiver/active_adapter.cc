@@ -36,9 +36,11 @@
 #include "active_adapter.h"
 #include "active_service.h"
 #include "receiver.h"
+#include "muxcapture.h"
 #include "streamfilter.h"
 #include "util/neumovariant.h"
 #include "util/template_util.h"
+#include "fmt/chrono.h"
 #include <algorithm>
 #include <errno.h>
 #include <iomanip>
@@ -466,7 +468,7 @@ active_adapter_t::active_adapter_t(receiver_t& receiver_,
 	: receiver(receiver_)
 	, fe(fe_)
 	, tuner_thread(receiver_, *this)
-	,	si(receiver, std::make_unique<dvb_stream_reader_t>(*this, -1), false)
+	,	si(receiver, std::make_unique<dvb_stream_reader_t>(*this, -1, pid_stats), false)
 {}
 
 void active_adapter_t::destroy() {
@@ -634,7 +636,7 @@ void active_adapter_t::update_received_si_mux(const std::optional<chdb::any_mux_
 }
 
 std::shared_ptr<stream_reader_t> active_adapter_t::make_dvb_stream_reader(ssize_t dmx_buffer_size) {
-	return std::make_shared<dvb_stream_reader_t>(*this, dmx_buffer_size);
+	return std::make_shared<dvb_stream_reader_t>(*this, dmx_buffer_size, pid_stats);
 }
 
 std::shared_ptr<stream_reader_t> active_adapter_t::make_embedded_stream_reader(
@@ -652,6 +654,23 @@ std::shared_ptr<stream_reader_t> active_adapter_t::make_embedded_stream_reader(
 	return std::make_shared<embedded_stream_reader_t>(*this, substream);
 }
 
+/*
+	reader for a service which shares the mux capture of this adapter with other services;
+	the capture is created for the first such service and ends with the last one
+*/
+std::shared_ptr<stream_reader_t> active_adapter_t::make_mux_view_reader() {
+	auto capture = mux_capture.lock();
+	if (!capture) {
+		auto r = receiver.options.readAccess();
+		auto now = system_clock_t::to_time_t(system_clock_t::now());
+		ss::string<128> dirname;
+		dirname.format("{:s}/mux/A{:02d}_{:%Y%m%d_%T}", r->live_path.c_str(), get_adapter_no(), fmt::localtime(now));
+		capture = std::make_shared<mux_capture_t>(*this, dirname.c_str(), r->livebuffer_mpm_part_duration);
+		mux_capture = capture;
+	}
+	return std::make_shared<mux_view_reader_t>(*this, capture);
+}
+
 /*
 	start si processing for an embedded stream on a mux;
 	Note that the substream's si processing cannot be removed until the active_adapter
@@ -1075,8 +1094,13 @@ active_adapter_t::tune_service(const subscribe_ret_t& sret,
 	auto prefix =fmt::format("CH[{:d}:{}]", this->get_adapter_no(), service);
 	log4cxx::NDC::push(prefix.c_str());
 
-	auto reader = service.k.mux.t2mi_pid >= 0 ? this->make_embedded_stream_reader(mux)
-		: this->make_dvb_stream_reader();
+	std::shared_ptr<stream_reader_t> reader;
+	if (service.k.mux.t2mi_pid >= 0)
+		reader = this->make_embedded_stream_reader(mux);
+	else if (!service.encrypted && receiver.options.readAccess()->livebuffer_mux_capture)
+		reader = this->make_mux_view_reader(); //scrambled services are descrambled in their own live buffer
+	else
+		reader = this->make_dvb_stream_reader();
 	active_service_ptr = std::make_shared<active_service_t>(receiver, *this, service, std::move(reader));
 	log4cxx::NDC::pop();
 	// remember that this service is now in use (for future planning and for later unsubscription)
@@ -30,6 +30,7 @@ using namespace dtdemux;
 //class active_fe_state_t;
 class tuner_thread_t;
 class streamer_t;
+class mux_capture_t;
 /* DVB-S */
 /** lnb_slof: switch frequency of LNB */
 #define DEFAULT_SLOF (11700*1000UL)
@@ -128,10 +129,13 @@ class active_adapter_t final : public  std::enable_shared_from_this<active_adapt
 	friend class active_si_stream_t;
 	friend class stream_reader_t;
 	friend struct dvb_stream_reader_t;
+	friend class mux_view_reader_t;
 
 public:
 	receiver_t& receiver;
 	const std::shared_ptr<dvb_frontend_t> fe; //accessible by other threads (with some care?)
+	//per pid health counters of the tuned mux, updated by all dvb readers; accessible by other threads
+	const std::shared_ptr<dtdemux::pid_stats_t> pid_stats{std::make_shared<dtdemux::pid_stats_t>()};
 private:
 /*
 		for uncommitted switch closest to receiver, followed by committed switch.
@@ -145,6 +149,7 @@ private:
 	steady_time_t last_new_matype_time;
 
 	safe::Safe<std::map <uint16_t, std::shared_ptr<stream_filter_t>>> stream_filters; //indexed by stream_pid
+	std::weak_ptr<mux_capture_t> mux_capture; //shared by the services which use it; only accessed by the tuner thread
 	std::map <uint16_t, active_si_stream_t> embedded_si_streams; //indexed by stream_pid
 
 	tune_state_t tune_state{TUNE_INIT};
@@ -369,6 +374,7 @@ private:
 	std::shared_ptr<stream_reader_t> make_dvb_stream_reader(ssize_t dmx_buffer_size_ = -1);
 	std::shared_ptr<stream_reader_t> make_embedded_stream_reader(const chdb::any_mux_t& mux,
 																															 ssize_t dmx_buffer_size_ = -1);
+	std::shared_ptr<stream_reader_t> make_mux_view_reader();
 	bool add_embedded_si_stream(const chdb::any_mux_t& emdedded_mux, bool start=false);
 
 	bool read_and_process_data_for_fd(const epoll_event* evt);
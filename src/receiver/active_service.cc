@@ -342,6 +342,8 @@ void active_service_t::update_pmt_pid(int new_pmt_pid) {
 */
 void active_service_t::housekeeping(system_time_t now) {
 	auto parent_txn = mpm.db->mpm_rec.idxdb.wtxn();
+	// also bounds the delay of index markers when no data arrives
+	mpm.stream_parser.event_handler.flush_markers(parent_txn);
 	auto rec_txn = parent_txn.child_txn(mpm.db->mpm_rec.recdb);
 	// Update stream_time_end and real_time end periodically
 	mpm.update_recordings(rec_txn, now);
@@ -355,6 +357,7 @@ void active_service_t::housekeeping(system_time_t now) {
 	periodic.run([this, &parent_txn](system_time_t now) { mpm.delete_old_data(parent_txn, now); }, now);
 
 	parent_txn.commit();
+	mpm.stream_parser.event_handler.markers_committed();
 	/*@todo:
 		1) global recording database must also be kept up todate.
 		2) when recordings stop, receiver thread should know about this
@@ -399,8 +402,9 @@ int service_thread_t::run() {
 		dterrorf("Could not open channel");
 		return -1;
 	}
+	auto timeout = 2000ms;
 	for (;;) {
-		auto n = epoll_wait(2000);
+		auto n = epoll_wait(timeout.count());
 		if (n < 0) {
 			dterrorf("error in poll");
 			continue;
@@ -431,6 +435,8 @@ int service_thread_t::run() {
 				assert(0);
 			}
 		}
+		//descramble data which would otherwise wait for more data beyond the latency target
+		timeout = active_service.mpm.process_descrambling_deadline(2000ms);
 	}
 	assert(0);
 	return 0;
@@ -77,6 +77,11 @@ class active_service_t final : public std::enable_shared_from_this<active_servic
 	}
 
 	playback_info_t get_current_program_info() const;
+
+	//may be called from any thread
+	inline decrypt_stats_t get_decrypt_stats() const {
+		return mpm.decrypt_scheduler.stats();
+	}
 	service_thread_t service_thread;
 private:
 	int channel_status=0; //composed of bitflags channel_status_t
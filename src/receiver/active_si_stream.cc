@@ -2814,7 +2814,7 @@ reset_type_t active_si_stream_t::pmt_section_cb(const pmt_info_t& pmt, bool isne
 			/*
 				we discovered a t2mi stream and must ensure that its mux
 				exists in the database.*/
-			auto& aa = reader->active_adapter;
+			auto& aa = active_adapter();
 			chdb::any_mux_t mux = reader->stream_mux();
 			mux_key_ptr(mux)->t2mi_pid = desc.stream_pid;
 			assert(!chdb::is_template(mux));
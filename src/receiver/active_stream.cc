@@ -57,6 +57,7 @@
 #include "neumo.h"
 #include "filemapper.h"
 #include "streamparser/packetstream.h"
+#include "filestreamreader.h"
 
 using std::placeholders::_1;
 using std::placeholders::_2;
@@ -156,6 +157,8 @@ void dvb_stream_reader_t::close() {
 		dtdebugf("Closed demux_fd");
 	}
 	demux_fd = -1;
+	if(pid_stats)
+		pid_stats->release(this);
 }
 
 void active_stream_t::close() {
@@ -286,7 +289,8 @@ void dvb_stream_reader_t::set_current_tp(const chdb::any_mux_t& mux) const
 
 const subscription_options_t& stream_reader_t::tune_options() const
 {
-	auto& tune_options = active_adapter.fe->ts.readAccess()->tune_options;
+	assert(adapter);
+	auto& tune_options = adapter->fe->ts.readAccess()->tune_options;
 	return tune_options;
 }
 
@@ -305,7 +309,8 @@ void dvb_stream_reader_t::update_received_si_mux(const std::optional<chdb::any_m
 void  stream_reader_t::update_stream_mux_tune_confirmation(const tune_confirmation_t& tune_confirmation)
 {
 	//for active_adapter stream_mux == tuned_mux
-	active_adapter.update_tuned_mux_tune_confirmation(tune_confirmation);
+	assert(adapter);
+	adapter->update_tuned_mux_tune_confirmation(tune_confirmation);
 }
 
 
@@ -334,3 +339,34 @@ int dvb_stream_reader_t::remove_pid(int pid) {
 		dtdebugf("DMX_REMOVE_PID {}",  pid);
 	return 0;
 }
+
+int file_stream_reader_t::open(uint16_t initial_pid, epoll_t* epoll, int epoll_flags)
+{
+	this->epoll = epoll;
+	this->epoll_flags = epoll_flags;
+	// initial_pid not used because the file contains all pids anyway
+	return file.open(epoll, epoll_flags) < 0 ? -1 : 0;
+}
+
+void file_stream_reader_t::close() {
+	file.close();
+	epoll = nullptr;
+}
+
+std::tuple<uint8_t*, ssize_t> file_stream_reader_t::read(ssize_t size)
+{
+	auto [p, ret] = file.read(size);
+	if(ret > 0)
+		num_read += ret;
+	return {p, ret};
+}
+
+ssize_t file_stream_reader_t::read_into(uint8_t* p, ssize_t toread, const std::vector<pid_with_use_count_t>* pids)
+{
+	if(!pids)
+		return file.read_into(p, toread);
+	read_pids.clear();
+	for(const auto& pid: *pids)
+		read_pids.push_back(pid.pid);
+	return file.read_into(p, toread, &read_pids);
+}
@@ -29,6 +29,7 @@
 #include "stackstring.h"
 #include "util/logger.h"
 #include "util/util.h"
+#include "streamparser/pidstats.h"
 
 #ifndef null_pid
 #define null_pid (0x1fff)
@@ -72,7 +73,7 @@ class stream_reader_t : public std::enable_shared_from_this<stream_reader_t> {
 public:
 	ssize_t num_read{0};
 	uint16_t embedded_pid{0};
-	active_adapter_t& active_adapter;
+	active_adapter_t* const adapter{nullptr}; //null for readers which do not read from a tuner, e.g., files
 
 	epoll_t* epoll{nullptr};
 	int epoll_flags;
@@ -80,7 +81,11 @@ public:
 protected:
 	stream_reader_t(active_adapter_t& active_adapter)
 		: last_data_time(steady_clock_t::now())
-		, active_adapter(active_adapter)
+		, adapter(&active_adapter)
+		{}
+
+	stream_reader_t()
+		: last_data_time(steady_clock_t::now())
 		{}
 
 public:
@@ -160,10 +165,15 @@ struct dvb_stream_reader_t final : public stream_reader_t {
 
 	int read_pointer{0}; //location in buffer where client will read next
 	std::unique_ptr<uint8_t[]> bufferp{nullptr};
+	std::shared_ptr<dtdemux::pid_stats_t> pid_stats; //health counters of the tuned mux, shared with other readers
+	active_adapter_t& active_adapter;
 
-	dvb_stream_reader_t(active_adapter_t & active_adapter, ssize_t dmx_buffer_size_ = -1)
+	dvb_stream_reader_t(active_adapter_t & active_adapter, ssize_t dmx_buffer_size_ = -1,
+											const std::shared_ptr<dtdemux::pid_stats_t>& pid_stats = nullptr)
 		: stream_reader_t(active_adapter)
+		, active_adapter(active_adapter)
 		, dmx_buffer_size(dmx_buffer_size_ <0 ?  32*1024L*1024 : dmx_buffer_size_)
+		, pid_stats(pid_stats)
 		{}
 
 	virtual ~dvb_stream_reader_t() {
@@ -206,13 +216,20 @@ struct dvb_stream_reader_t final : public stream_reader_t {
 			ret += read_pointer;
 			read_pointer = ret;
 		}
-		if(ret>0)
+		if(ret>0) {
 			num_read+=ret;
+			/*a partial packet left over from the previous read starts the buffer,
+				so each packet is accounted for once, when it is complete*/
+			if(pid_stats)
+				pid_stats->update(p, ret, this);
+		}
 		return  {p, ret};
 	}
 
 	virtual inline ssize_t read_into(uint8_t* p, ssize_t toread, const std::vector<pid_with_use_count_t>* pids = nullptr) {
 		ssize_t ret = ::read(demux_fd, p, toread);
+		if(ret > 0 && pid_stats)
+			pid_stats->update(p, ret, this);
 		return ret;
 	}
 
@@ -227,11 +244,11 @@ struct dvb_stream_reader_t final : public stream_reader_t {
 	virtual int add_pid(int pid);
 
 
-	virtual inline int remove_pid(int pid);
+	virtual int remove_pid(int pid);
 
 	virtual std::shared_ptr<stream_reader_t> clone(ssize_t buffer_size = -1) const {
 		return std::make_shared<dvb_stream_reader_t>(active_adapter,
-																								 buffer_size < 0 ? dmx_buffer_size : buffer_size);
+																								 buffer_size < 0 ? dmx_buffer_size : buffer_size, pid_stats);
 	}
 
 };
@@ -255,6 +272,8 @@ class embedded_stream_reader_t final : public stream_reader_t {
 
 
 public:
+	active_adapter_t& active_adapter;
+
 	embedded_stream_reader_t(active_adapter_t& adapter,
 													 const std::shared_ptr<stream_filter_t>& stream_filter);
 
@@ -354,8 +373,8 @@ public:
 	}
 
 	inline active_adapter_t& active_adapter() const {
-		assert(reader);
-		return reader->active_adapter;
+		assert(reader && reader->adapter);
+		return *reader->adapter;
 	}
 
 	inline ssize_t dmx_buffer_size() const {
@@ -0,0 +1,268 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "aes128.h"
+#include <immintrin.h>
+#include <string.h>
+
+const uint8_t aes128_cissa_iv[16] = {'D', 'V', 'B', 'T', 'M', 'C', 'P', 'T', 'A', 'E', 'S', 'C', 'I', 'S', 'S', 'A'};
+
+static constexpr uint8_t gmul(uint8_t a, uint8_t b) {
+	uint8_t ret = 0;
+	for (int i = 0; i < 8; ++i) {
+		if (b & 1)
+			ret ^= a;
+		a = (a << 1) ^ ((a & 0x80) ? 0x1b : 0);
+		b >>= 1;
+	}
+	return ret;
+}
+
+static constexpr uint32_t ror32(uint32_t x, int n) {
+	return n == 0 ? x : (x >> n) | (x << (32 - n));
+}
+
+/*
+	sbox, inverse sbox and the tables for the equivalent inverse cipher (FIPS-197 section 5.3.5):
+	td[0][x] contains the column (0e, 09, 0d, 0b) * inv_sbox[x]; td[k] is td[0] rotated by k bytes
+*/
+struct aes_tables_t {
+	uint8_t sbox[256];
+	uint8_t inv_sbox[256];
+	uint32_t td[4][256];
+	constexpr aes_tables_t() : sbox{}, inv_sbox{}, td{} {
+		for (int x = 0; x < 256; ++x) {
+			//multiplicative inverse as x^254
+			uint8_t inv = 1, base = x;
+			for (int e = 254; e; e >>= 1) {
+				if (e & 1)
+					inv = gmul(inv, base);
+				base = gmul(base, base);
+			}
+			uint8_t s = inv;
+			for (int i = 1; i < 5; ++i)
+				s ^= (uint8_t)((inv << i) | (inv >> (8 - i)));
+			s ^= 0x63;
+			sbox[x] = s;
+			inv_sbox[s] = x;
+		}
+		for (int x = 0; x < 256; ++x) {
+			uint8_t s = inv_sbox[x];
+			uint32_t t = ((uint32_t)gmul(s, 0x0e) << 24) | ((uint32_t)gmul(s, 0x09) << 16) |
+				((uint32_t)gmul(s, 0x0d) << 8) | gmul(s, 0x0b);
+			for (int k = 0; k < 4; ++k)
+				td[k][x] = ror32(t, 8 * k);
+		}
+	}
+};
+
+static constexpr aes_tables_t aes_tables;
+
+static inline uint32_t load_be32(const uint8_t* p) {
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return __builtin_bswap32(x);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t x) {
+	x = __builtin_bswap32(x);
+	memcpy(p, &x, sizeof(x));
+}
+
+static inline uint32_t inv_mix_column(uint32_t w) {
+	auto& t = aes_tables;
+	return t.td[0][t.sbox[w >> 24]] ^ t.td[1][t.sbox[(w >> 16) & 0xff]] ^ t.td[2][t.sbox[(w >> 8) & 0xff]] ^
+		t.td[3][t.sbox[w & 0xff]];
+}
+
+aes_impl_t aes128_best_impl() {
+	static const aes_impl_t best = []() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2"))
+			return aes_impl_t::AESNI;
+		return aes_impl_t::PORTABLE;
+	}();
+	return best;
+}
+
+void aes128_set_key(aes128_key_t& key, const uint8_t* cw, const uint8_t* iv, aes_impl_t impl) {
+	auto& t = aes_tables;
+	uint32_t w[44];
+	for (int i = 0; i < 4; ++i)
+		w[i] = load_be32(cw + 4 * i);
+	uint8_t rcon = 1;
+	for (int i = 4; i < 44; ++i) {
+		uint32_t temp = w[i - 1];
+		if (i % 4 == 0) {
+			temp = ((uint32_t)t.sbox[(temp >> 16) & 0xff] << 24) | ((uint32_t)t.sbox[(temp >> 8) & 0xff] << 16) |
+				((uint32_t)t.sbox[temp & 0xff] << 8) | t.sbox[temp >> 24];
+			temp ^= (uint32_t)rcon << 24;
+			rcon = gmul(rcon, 2);
+		}
+		w[i] = w[i - 4] ^ temp;
+	}
+	for (int r = 0; r <= 10; ++r) {
+		for (int j = 0; j < 4; ++j) {
+			auto x = w[4 * (10 - r) + j];
+			store_be32(&key.dec_round_keys[r][4 * j], (r == 0 || r == 10) ? x : inv_mix_column(x));
+		}
+	}
+	memcpy(key.iv, iv ? iv : aes128_cissa_iv, sizeof(key.iv));
+	key.impl = impl == aes_impl_t::AUTO ? aes128_best_impl() : impl;
+}
+
+static inline void decrypt_block_portable(const aes128_key_t& key, const uint8_t* in, uint8_t* out) {
+	auto& t = aes_tables;
+	auto* rk = key.dec_round_keys;
+	uint32_t s0 = load_be32(in) ^ load_be32(rk[0]);
+	uint32_t s1 = load_be32(in + 4) ^ load_be32(rk[0] + 4);
+	uint32_t s2 = load_be32(in + 8) ^ load_be32(rk[0] + 8);
+	uint32_t s3 = load_be32(in + 12) ^ load_be32(rk[0] + 12);
+	for (int r = 1; r < 10; ++r) {
+		auto t0 = t.td[0][s0 >> 24] ^ t.td[1][(s3 >> 16) & 0xff] ^ t.td[2][(s2 >> 8) & 0xff] ^ t.td[3][s1 & 0xff] ^
+			load_be32(rk[r]);
+		auto t1 = t.td[0][s1 >> 24] ^ t.td[1][(s0 >> 16) & 0xff] ^ t.td[2][(s3 >> 8) & 0xff] ^ t.td[3][s2 & 0xff] ^
+			load_be32(rk[r] + 4);
+		auto t2 = t.td[0][s2 >> 24] ^ t.td[1][(s1 >> 16) & 0xff] ^ t.td[2][(s0 >> 8) & 0xff] ^ t.td[3][s3 & 0xff] ^
+			load_be32(rk[r] + 8);
+		auto t3 = t.td[0][s3 >> 24] ^ t.td[1][(s2 >> 16) & 0xff] ^ t.td[2][(s1 >> 8) & 0xff] ^ t.td[3][s0 & 0xff] ^
+			load_be32(rk[r] + 12);
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+	auto last = [&t](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+		return ((uint32_t)t.inv_sbox[a >> 24] << 24) | ((uint32_t)t.inv_sbox[(b >> 16) & 0xff] << 16) |
+			((uint32_t)t.inv_sbox[(c >> 8) & 0xff] << 8) | t.inv_sbox[d & 0xff];
+	};
+	store_be32(out, last(s0, s3, s2, s1) ^ load_be32(rk[10]));
+	store_be32(out + 4, last(s1, s0, s3, s2) ^ load_be32(rk[10] + 4));
+	store_be32(out + 8, last(s2, s1, s0, s3) ^ load_be32(rk[10] + 8));
+	store_be32(out + 12, last(s3, s2, s1, s0) ^ load_be32(rk[10] + 12));
+}
+
+static void decrypt_ecb_portable(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	for (int i = 0; i < num_blocks; ++i)
+		decrypt_block_portable(key, data + 16 * i, data + 16 * i);
+}
+
+static void decrypt_cbc_portable(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	uint8_t prev[16], cur[16];
+	memcpy(prev, key.iv, sizeof(prev));
+	for (int i = 0; i < num_blocks; ++i) {
+		auto* p = data + 16 * i;
+		memcpy(cur, p, sizeof(cur));
+		decrypt_block_portable(key, cur, p);
+		for (int j = 0; j < 16; ++j)
+			p[j] ^= prev[j];
+		memcpy(prev, cur, sizeof(prev));
+	}
+}
+
+/*
+	AES-NI: 4 blocks are decrypted at a time to hide the latency of aesdec
+*/
+#define AESNI_ROUNDS(apply)																							\
+	for (int r = 1; r < 10; ++r) {																				\
+		auto k = _mm_load_si128((const __m128i*)key.dec_round_keys[r]);		\
+		apply(_mm_aesdec_si128);																						\
+	}																																			\
+	{																																			\
+		auto k = _mm_load_si128((const __m128i*)key.dec_round_keys[10]);		\
+		apply(_mm_aesdeclast_si128);																				\
+	}
+
+__attribute__((target("aes,sse2")))
+static void decrypt_ecb_aesni(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	auto k0 = _mm_load_si128((const __m128i*)key.dec_round_keys[0]);
+	int i = 0;
+	for (; i + 4 <= num_blocks; i += 4) {
+		auto* p = (__m128i*)(data + 16 * i);
+		auto b0 = _mm_xor_si128(_mm_loadu_si128(p), k0);
+		auto b1 = _mm_xor_si128(_mm_loadu_si128(p + 1), k0);
+		auto b2 = _mm_xor_si128(_mm_loadu_si128(p + 2), k0);
+		auto b3 = _mm_xor_si128(_mm_loadu_si128(p + 3), k0);
+#define APPLY4(op) b0 = op(b0, k); b1 = op(b1, k); b2 = op(b2, k); b3 = op(b3, k);
+		AESNI_ROUNDS(APPLY4);
+#undef APPLY4
+		_mm_storeu_si128(p, b0);
+		_mm_storeu_si128(p + 1, b1);
+		_mm_storeu_si128(p + 2, b2);
+		_mm_storeu_si128(p + 3, b3);
+	}
+	for (; i < num_blocks; ++i) {
+		auto* p = (__m128i*)(data + 16 * i);
+		auto b0 = _mm_xor_si128(_mm_loadu_si128(p), k0);
+#define APPLY1(op) b0 = op(b0, k);
+		AESNI_ROUNDS(APPLY1);
+		_mm_storeu_si128(p, b0);
+	}
+}
+
+__attribute__((target("aes,sse2")))
+static void decrypt_cbc_aesni(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	auto k0 = _mm_load_si128((const __m128i*)key.dec_round_keys[0]);
+	auto prev = _mm_load_si128((const __m128i*)key.iv);
+	int i = 0;
+	for (; i + 4 <= num_blocks; i += 4) {
+		auto* p = (__m128i*)(data + 16 * i);
+		auto c0 = _mm_loadu_si128(p);
+		auto c1 = _mm_loadu_si128(p + 1);
+		auto c2 = _mm_loadu_si128(p + 2);
+		auto c3 = _mm_loadu_si128(p + 3);
+		auto b0 = _mm_xor_si128(c0, k0);
+		auto b1 = _mm_xor_si128(c1, k0);
+		auto b2 = _mm_xor_si128(c2, k0);
+		auto b3 = _mm_xor_si128(c3, k0);
+#define APPLY4(op) b0 = op(b0, k); b1 = op(b1, k); b2 = op(b2, k); b3 = op(b3, k);
+		AESNI_ROUNDS(APPLY4);
+#undef APPLY4
+		_mm_storeu_si128(p, _mm_xor_si128(b0, prev));
+		_mm_storeu_si128(p + 1, _mm_xor_si128(b1, c0));
+		_mm_storeu_si128(p + 2, _mm_xor_si128(b2, c1));
+		_mm_storeu_si128(p + 3, _mm_xor_si128(b3, c2));
+		prev = c3;
+	}
+	for (; i < num_blocks; ++i) {
+		auto* p = (__m128i*)(data + 16 * i);
+		auto c0 = _mm_loadu_si128(p);
+		auto b0 = _mm_xor_si128(c0, k0);
+		AESNI_ROUNDS(APPLY1);
+		_mm_storeu_si128(p, _mm_xor_si128(b0, prev));
+		prev = c0;
+	}
+}
+#undef APPLY1
+#undef AESNI_ROUNDS
+
+void aes128_decrypt_ecb(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	if (key.impl == aes_impl_t::AESNI)
+		decrypt_ecb_aesni(key, data, num_blocks);
+	else
+		decrypt_ecb_portable(key, data, num_blocks);
+}
+
+void aes128_decrypt_cbc(const aes128_key_t& key, uint8_t* data, int num_blocks) {
+	if (key.impl == aes_impl_t::AESNI)
+		decrypt_cbc_aesni(key, data, num_blocks);
+	else
+		decrypt_cbc_portable(key, data, num_blocks);
+}
@@ -0,0 +1,76 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+	AES-128 decryption of transport stream payloads.
+
+	Each payload is descrambled independently. Only whole 16 byte blocks are scrambled;
+	a residue of less than 16 bytes at the end of the payload is transmitted in the clear,
+	as in DVB-CISSA (ETSI TS 103 127) and the CI+ AES profile. In CBC mode the chain
+	restarts with the same iv for each payload.
+*/
+
+enum class aes_impl_t {
+	AUTO, //best one supported by the cpu
+	PORTABLE, //table based
+	AESNI
+};
+
+struct aes128_key_t {
+	/*round keys for the equivalent inverse cipher, in the order in which they are used:
+		dec_round_keys[0] is the last encryption round key*/
+	alignas(16) uint8_t dec_round_keys[11][16];
+	alignas(16) uint8_t iv[16];
+	aes_impl_t impl{aes_impl_t::PORTABLE};
+};
+
+//iv defined by DVB-CISSA: "DVBTMCPTAESCISSA"
+extern const uint8_t aes128_cissa_iv[16];
+
+/*!
+	Prepare key for decryption with control word cw (16 bytes) and,
+	for CBC mode, initialisation vector iv (16 bytes; nullptr means aes128_cissa_iv)
+*/
+void aes128_set_key(aes128_key_t& key, const uint8_t* cw, const uint8_t* iv = nullptr,
+										aes_impl_t impl = aes_impl_t::AUTO);
+
+/*!
+	Decrypt num_blocks 16 byte blocks in place
+*/
+void aes128_decrypt_ecb(const aes128_key_t& key, uint8_t* data, int num_blocks);
+void aes128_decrypt_cbc(const aes128_key_t& key, uint8_t* data, int num_blocks);
+
+/*!
+	Descramble a ts packet payload of len bytes in place; the residue is left untouched
+*/
+inline void aes128_descramble_payload(const aes128_key_t& key, bool cbc, uint8_t* data, int len) {
+	if (cbc)
+		aes128_decrypt_cbc(key, data, len / 16);
+	else
+		aes128_decrypt_ecb(key, data, len / 16);
+}
+
+/*!
+	Returns the implementation selected by aes_impl_t::AUTO
+*/
+aes_impl_t aes128_best_impl();
@@ -0,0 +1,90 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Descrambling throughput of ts packet payloads (184 bytes) with AES-128 in ECB and CBC mode,
+	for each implementation, compared with csa as used by decrypt_cache_t
+	benchaes128 [megabytes]
+*/
+
+extern "C" {
+#include <dvbcsa/dvbcsa.h>
+}
+#include "aes128.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static constexpr int packet_size = 188;
+
+template <typename fn_t> static void report(const char* name, std::vector<uint8_t>& data, fn_t fn) {
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%-14s %10.1f MB/s\n", name, data.size() / t / 1e6);
+}
+
+int main(int argc, char** argv) {
+	int64_t megabytes = argc > 1 ? atoi(argv[1]) : 256;
+	int64_t num_packets = megabytes * 1024 * 1024 / packet_size;
+	std::vector<uint8_t> data(num_packets * packet_size);
+	for (auto& x : data)
+		x = random();
+	uint8_t cw[16];
+	for (auto& x : cw)
+		x = random();
+
+	const aes_impl_t impls[] = {aes_impl_t::PORTABLE, aes_impl_t::AESNI};
+	const char* names[] = {"portable", "aesni"};
+	for (int i = 0; i < 2; ++i) {
+		if (impls[i] == aes_impl_t::AESNI && aes128_best_impl() != aes_impl_t::AESNI)
+			continue;
+		aes128_key_t key;
+		aes128_set_key(key, cw, nullptr, impls[i]);
+		for (bool cbc : {false, true}) {
+			char name[32];
+			snprintf(name, sizeof(name), "aes %s %s", names[i], cbc ? "cbc" : "ecb");
+			report(name, data, [&]() {
+				for (int64_t pos = 0; pos < (int64_t)data.size(); pos += packet_size)
+					aes128_descramble_payload(key, cbc, &data[pos + 4], packet_size - 4);
+			});
+		}
+	}
+
+	int batch_size = dvbcsa_bs_batch_size();
+	auto* key = dvbcsa_bs_key_alloc();
+	dvbcsa_bs_key_set(cw, key);
+	std::vector<dvbcsa_bs_batch_s> batch(batch_size + 1);
+	report("csa", data, [&]() {
+		int idx = 0;
+		for (int64_t pos = 0; pos < (int64_t)data.size(); pos += packet_size) {
+			batch[idx].data = &data[pos + 4];
+			batch[idx].len = packet_size - 4;
+			if (++idx == batch_size || pos + packet_size == (int64_t)data.size()) {
+				batch[idx].data = nullptr;
+				dvbcsa_bs_decrypt(key, batch.data(), 184);
+				idx = 0;
+			}
+		}
+	});
+	dvbcsa_bs_key_free(key);
+	return 0;
+}
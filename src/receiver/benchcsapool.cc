@@ -0,0 +1,158 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Throughput of csa descrambling on the calling thread versus csa_worker_pool_t
+	benchcsapool [megabytes] [max_threads] [crypto_period_in_packets]
+
+	A scrambled stream with alternating even/odd parity is descrambled in batches of
+	dvbcsa_bs_batch_size() packets, as decrypt_cache_t does, first synchronously and then
+	with worker pools of 1..max_threads threads. The output of the pools is compared
+	with the synchronous output.
+*/
+
+extern "C" {
+#include <dvbcsa/dvbcsa.h>
+}
+#include "csapool.h"
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static constexpr int packet_size = 188;
+
+static std::vector<uint8_t> make_stream(int64_t num_packets, int crypto_period) {
+	std::vector<uint8_t> data(num_packets * packet_size);
+	for (int64_t i = 0; i < num_packets; ++i) {
+		auto* p = &data[i * packet_size];
+		bool odd = (i / crypto_period) & 1;
+		p[0] = 0x47;
+		p[1] = 0x01;
+		p[2] = 0x00;
+		p[3] = (odd ? 0xc0 : 0x80) | 0x10 | (i & 0xf);
+		for (int j = 4; j < packet_size; ++j)
+			p[j] = random();
+	}
+	return data;
+}
+
+static void descramble_sync(std::vector<uint8_t>& data, const uint8_t cws[2][8], int batch_size) {
+	dvbcsa_bs_key_s* keys[2] = {dvbcsa_bs_key_alloc(), dvbcsa_bs_key_alloc()};
+	dvbcsa_bs_key_set(cws[0], keys[0]);
+	dvbcsa_bs_key_set(cws[1], keys[1]);
+	std::vector<dvbcsa_bs_batch_s> batches[2];
+	batches[0].resize(batch_size + 1);
+	batches[1].resize(batch_size + 1);
+	int idx[2] = {0, 0};
+	auto flush = [&](int odd) {
+		if (idx[odd] == 0)
+			return;
+		batches[odd][idx[odd]].data = nullptr;
+		dvbcsa_bs_decrypt(keys[odd], batches[odd].data(), 184);
+		for (int i = 0; i < idx[odd]; ++i)
+			batches[odd][i].data[-1] &= 0x3f;
+		idx[odd] = 0;
+	};
+	for (int64_t pos = 0; pos + packet_size <= (int64_t)data.size(); pos += packet_size) {
+		auto* p = &data[pos];
+		int odd = (p[3] & 0x40) != 0;
+		batches[odd][idx[odd]].data = p + 4;
+		batches[odd][idx[odd]].len = packet_size - 4;
+		if (++idx[odd] == batch_size)
+			flush(odd);
+	}
+	flush(0);
+	flush(1);
+	dvbcsa_bs_key_free(keys[0]);
+	dvbcsa_bs_key_free(keys[1]);
+}
+
+static void descramble_pool(std::vector<uint8_t>& data, const uint8_t cws[2][8], int batch_size,
+														csa_worker_pool_t& pool) {
+	std::vector<std::unique_ptr<csa_job_t>> jobs;
+	for (int i = 0; i < 2 * pool.size() + 2; ++i)
+		jobs.push_back(std::make_unique<csa_job_t>(batch_size));
+	int next_job = 0;
+	csa_job_t* filling[2] = {nullptr, nullptr};
+	auto submit = [&](int odd) {
+		auto* job = filling[odd];
+		memcpy(job->cw, cws[odd], sizeof(job->cw));
+		filling[odd] = nullptr;
+		pool.submit(job);
+	};
+	for (int64_t pos = 0; pos + packet_size <= (int64_t)data.size(); pos += packet_size) {
+		auto* p = &data[pos];
+		int odd = (p[3] & 0x40) != 0;
+		if (!filling[odd]) {
+			for (;;) {
+				auto* job = jobs[next_job].get();
+				next_job = (next_job + 1) % jobs.size();
+				if (job == filling[0] || job == filling[1])
+					continue;
+				job->wait();
+				filling[odd] = job;
+				break;
+			}
+		}
+		filling[odd]->add(p + 4, packet_size - 4, p + 3);
+		if (filling[odd]->num_packets == batch_size)
+			submit(odd);
+	}
+	for (int odd = 0; odd < 2; ++odd)
+		if (filling[odd])
+			submit(odd);
+	for (auto& job : jobs)
+		job->wait();
+}
+
+int main(int argc, char** argv) {
+	int64_t megabytes = argc > 1 ? atoi(argv[1]) : 256;
+	int max_threads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+	int crypto_period = argc > 3 ? atoi(argv[3]) : 10000;
+	int64_t num_packets = megabytes * 1024 * 1024 / packet_size;
+	int batch_size = dvbcsa_bs_batch_size();
+	const uint8_t cws[2][8] = {{0x11, 0x22, 0x33, 0x66, 0x44, 0x55, 0x66, 0xff},
+														 {0xa1, 0xb2, 0xc3, 0x16, 0xd4, 0xe5, 0xf6, 0xcf}};
+	srandom(1);
+	auto scrambled = make_stream(num_packets, crypto_period);
+	printf("%ld packets, batch_size=%d, crypto period %d packets\n", num_packets, batch_size, crypto_period);
+
+	auto reference = scrambled;
+	auto start = std::chrono::steady_clock::now();
+	descramble_sync(reference, cws, batch_size);
+	auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%-10s %10.1f MB/s\n", "sync", reference.size() / t / 1e6);
+
+	int num_errors{0};
+	for (int num_threads = 1; num_threads <= max_threads; ++num_threads) {
+		auto data = scrambled;
+		csa_worker_pool_t pool(num_threads);
+		start = std::chrono::steady_clock::now();
+		descramble_pool(data, cws, batch_size, pool);
+		t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		bool ok = data == reference;
+		num_errors += !ok;
+		printf("%2d threads %10.1f MB/s%s\n", num_threads, data.size() / t / 1e6, ok ? "" : " FAIL: output differs");
+	}
+	return num_errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,268 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Replay of a synthetic csa scrambled stream through dvbcsa_t, with scam emulated
+	benchdvbcsa [megabytes] [crypto_period] [key_delay] [bit_errors] [outage_every] [num_workers]
+
+	crypto_period: length of a crypto period in packets (default 20000)
+	key_delay: packets between sending an ecm to scam and receiving its key (default 1000). The ecm for
+	the next crypto period is sent 1/10 into the current period, so keys arrive after the parity change
+	if key_delay > 0.9 * crypto_period
+	bit_errors: number of packets per million in which the scrambling control is damaged (default 10)
+	outage_every: every so many crypto periods, scam stops returning keys for about 1.5 crypto periods
+	and then restarts. The crypto period for which no key ever arrives cannot be descrambled and should
+	be skipped (default 5; 0: no outages)
+	num_workers: number of threads in the csa worker pool (default 0: no pool)
+
+	The stream is fed in chunks of 1024 packets, as active_mpm_t does, and the output is compared with
+	the clear stream. Reported are the throughput of dvbcsa_t::decrypt_buffer and the number of packets
+	skipped by skip_non_decryptable. It is an error if any packet is descrambled with the wrong key,
+	or if a packet which could be descrambled is left scrambled.
+
+	dvbcsa_t knows stream positions only per chunk and remembers only the last ecm sent. Crypto periods
+	of only a few chunks, or key delays such that the ecm for the next key is sent before the previous
+	key arrives, therefore lead to failures that do not occur with real crypto periods of several seconds.
+	Damaged packets just before a parity change can cause a few packets to be descrambled with the new key.
+*/
+
+extern "C" {
+#include <dvbcsa/dvbcsa.h>
+}
+#include "dvbcsa.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static constexpr int packet_size = 188;
+static constexpr int chunk_size = 1024 * packet_size;
+
+static const uint16_t pids[] = {0x100, 0x101, 0x000}; //video, audio (scrambled), pat (clear)
+
+struct stream_t {
+	int crypto_period;
+	std::vector<uint8_t> clear;
+	std::vector<uint8_t> scrambled;
+	std::vector<bool> damaged; //per packet
+
+	int64_t num_packets() const {
+		return clear.size() / packet_size;
+	}
+
+	static void make_cw(int period, uint8_t* cw) {
+		for (int i = 0; i < 8; ++i)
+			cw[i] = period * 37 + i * 101 + (period >> 8);
+		//csa control words are usually sent with a checksum in every 4th byte
+		cw[3] = cw[0] + cw[1] + cw[2];
+		cw[7] = cw[4] + cw[5] + cw[6];
+	}
+
+	stream_t(int64_t num_packets_, int crypto_period_, int bit_errors);
+};
+
+stream_t::stream_t(int64_t num_packets_, int crypto_period_, int bit_errors)
+	: crypto_period(crypto_period_)
+	, clear(num_packets_ * packet_size)
+	, damaged(num_packets_) {
+	int cc[3]{};
+	for (int64_t i = 0; i < num_packets_; ++i) {
+		auto* p = &clear[i * packet_size];
+		auto r = random() % 100;
+		int s = r < 80 ? 0 : r < 95 ? 1 : 2;
+		p[0] = 0x47;
+		p[1] = pids[s] >> 8;
+		p[2] = pids[s] & 0xff;
+		p[3] = 0x10 | (cc[s]++ & 0xf);
+		for (int j = 4; j < packet_size; ++j)
+			p[j] = random();
+	}
+	scrambled = clear;
+
+	int batch_size = dvbcsa_bs_batch_size();
+	std::vector<dvbcsa_bs_batch_s> batch(batch_size + 1);
+	auto* key = dvbcsa_bs_key_alloc();
+	int n = 0;
+	auto flush = [&]() {
+		batch[n].data = nullptr;
+		dvbcsa_bs_encrypt(key, batch.data(), 184);
+		n = 0;
+	};
+	for (int64_t i = 0; i < num_packets_; ++i) {
+		if (i % crypto_period == 0) {
+			if (n > 0)
+				flush();
+			uint8_t cw[8];
+			make_cw(i / crypto_period, cw);
+			dvbcsa_bs_key_set(cw, key);
+		}
+		auto* p = &scrambled[i * packet_size];
+		if (p[1] == 0 && p[2] == 0)
+			continue;
+		bool odd = (i / crypto_period) & 1;
+		p[3] |= odd ? 0xc0 : 0x80;
+		batch[n].data = p + 4;
+		batch[n].len = packet_size - 4;
+		if (++n == batch_size)
+			flush();
+	}
+	if (n > 0)
+		flush();
+	dvbcsa_bs_key_free(key);
+
+	//damage the parity bit of some scrambled packets
+	for (int64_t i = 0; i < num_packets_; ++i) {
+		if (random() % 1000000 >= bit_errors)
+			continue;
+		auto* p = &scrambled[i * packet_size];
+		if ((p[3] & 0x80) == 0)
+			continue;
+		p[3] ^= 0x40;
+		damaged[i] = true;
+	}
+}
+
+struct scam_event_t {
+	enum type_t { RESTART, ECM_SENT, KEY };
+	int64_t bytepos;
+	type_t type;
+	int period;
+};
+
+/*
+	The ecm for crypto period p is sent 1/10 into period p - 1. During an outage starting with the ecm
+	for period p, no keys are returned. At the restart, 1.5 crypto periods later in period p + 1, scam
+	returns the keys for periods p + 1 and p + 2 which are in the ecms being broadcast at that time.
+	So only the key for period p is never returned
+*/
+static std::vector<scam_event_t> make_key_schedule(int num_periods, int crypto_period, int key_delay,
+																									 int outage_every, std::vector<bool>& lost) {
+	std::vector<scam_event_t> events;
+	int64_t period_bytes = crypto_period * (int64_t)packet_size;
+	auto ecm_bytepos = [&](int p) { return (p - 1) * period_bytes + period_bytes / 10; };
+	lost.assign(num_periods, false);
+	events.push_back({0, scam_event_t::RESTART, 0});
+	events.push_back({0, scam_event_t::ECM_SENT, 0});
+	events.push_back({key_delay * (int64_t)packet_size, scam_event_t::KEY, 0});
+	for (int p = 1; p < num_periods; ++p) {
+		if (outage_every > 0 && p % outage_every == 0 && p + 2 < num_periods) {
+			lost[p] = true;
+			auto restart = (p + 1) * period_bytes + period_bytes / 2;
+			events.push_back({restart, scam_event_t::RESTART, p + 1});
+			for (int q = p + 1; q <= p + 2; ++q) {
+				events.push_back({restart, scam_event_t::ECM_SENT, q});
+				events.push_back({restart + key_delay * (int64_t)packet_size, scam_event_t::KEY, q});
+			}
+			p += 2;
+			continue;
+		}
+		events.push_back({ecm_bytepos(p), scam_event_t::ECM_SENT, p});
+		events.push_back({ecm_bytepos(p) + key_delay * (int64_t)packet_size, scam_event_t::KEY, p});
+	}
+	std::stable_sort(events.begin(), events.end(),
+									 [](const scam_event_t& a, const scam_event_t& b) { return a.bytepos < b.bytepos; });
+	return events;
+}
+
+int main(int argc, char** argv) {
+	int64_t megabytes = argc > 1 ? atoi(argv[1]) : 64;
+	int crypto_period = argc > 2 ? atoi(argv[2]) : 20000;
+	int key_delay = argc > 3 ? atoi(argv[3]) : 1000;
+	int bit_errors = argc > 4 ? atoi(argv[4]) : 10;
+	int outage_every = argc > 5 ? atoi(argv[5]) : 5;
+	int num_workers = argc > 6 ? atoi(argv[6]) : 0;
+	int64_t num_packets = megabytes * 1024 * 1024 / packet_size;
+	int num_periods = (num_packets + crypto_period - 1) / crypto_period;
+	srandom(1);
+	stream_t stream(num_packets, crypto_period, bit_errors);
+	std::vector<bool> lost;
+	auto events = make_key_schedule(num_periods, crypto_period, key_delay, outage_every, lost);
+	printf("%ld packets, %d crypto periods of %d packets, key delay %d packets, %d lost keys, %d workers\n",
+				 num_packets, num_periods, crypto_period, key_delay, (int)std::count(lost.begin(), lost.end(), true),
+				 num_workers);
+
+	auto data = stream.scrambled;
+	dvbcsa_t dvbcsa;
+	dvbcsa.cache.set_num_workers(num_workers);
+	ca_slot_t slot;
+	int64_t write_pointer = 0;
+	int64_t decrypt_pointer = 0;
+	size_t next_event = 0;
+	std::chrono::duration<double> t{};
+	for (;;) {
+		write_pointer = std::min(write_pointer + chunk_size, (int64_t)data.size());
+		auto start = std::chrono::steady_clock::now();
+		auto ret = dvbcsa.decrypt_buffer(&data[decrypt_pointer], write_pointer - decrypt_pointer);
+		t += std::chrono::steady_clock::now() - start;
+		decrypt_pointer += ret;
+		if (write_pointer == (int64_t)data.size() && (ret == 0 || decrypt_pointer == write_pointer))
+			break; // end of stream, or waiting for data which will never come
+		//scam reacts on data which has been received
+		for (; next_event < events.size() && events[next_event].bytepos <= write_pointer; ++next_event) {
+			auto& e = events[next_event];
+			auto now = system_clock_t::now();
+			switch (e.type) {
+			case scam_event_t::RESTART:
+				dvbcsa.restart_decryption(now);
+				break;
+			case scam_event_t::ECM_SENT:
+				dvbcsa.mark_ecm_sent(e.period & 1, now);
+				break;
+			case scam_event_t::KEY:
+				slot.last_key.parity = e.period & 1;
+				slot.last_key.valid = true;
+				stream_t::make_cw(e.period, slot.last_key.cw);
+				slot.last_key.receive_time = now;
+				dvbcsa.add_key(slot, 0, now);
+				break;
+			}
+		}
+	}
+
+	int64_t num_wrong{0}, num_left_scrambled{0}, num_expected_scrambled{0}, num_damaged{0}, num_damaged_ok{0};
+	for (int64_t i = 0; i < num_packets; ++i) {
+		auto* out = &data[i * packet_size];
+		auto* in = &stream.clear[i * packet_size];
+		bool scrambled = stream.scrambled[i * packet_size + 3] & 0x80;
+		bool undecryptable = lost[i / crypto_period] || i * packet_size >= decrypt_pointer;
+		if (stream.damaged[i]) {
+			num_damaged++;
+			num_damaged_ok += memcmp(out, in, packet_size) == 0;
+			continue;
+		}
+		num_expected_scrambled += scrambled && undecryptable;
+		if (out[3] & 0x80) {
+			num_left_scrambled++;
+			if (!undecryptable && num_wrong++ < 10)
+				printf("FAIL: packet %ld (crypto period %ld) was not descrambled\n", i, i / crypto_period);
+		} else if (memcmp(out, in, packet_size) != 0 && num_wrong++ < 10)
+			printf("FAIL: packet %ld (crypto period %ld) descrambled incorrectly\n", i, i / crypto_period);
+	}
+	printf("%.1f MB/s; %ld packets skipped as undecryptable; %ld/%ld packets left scrambled as expected "
+				 "(%ld at end of stream); %ld/%ld damaged packets descrambled correctly\n",
+				 decrypt_pointer / t.count() / 1e6, dvbcsa.num_bytes_skipped / packet_size, num_left_scrambled,
+				 num_expected_scrambled, ((int64_t)data.size() - decrypt_pointer) / packet_size, num_damaged_ok,
+				 num_damaged);
+	if (num_wrong == 0)
+		printf("All tests passed\n");
+	return num_wrong == 0 ? 0 : -1;
+}
@@ -0,0 +1,115 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+extern "C" {
+#include <dvbcsa/dvbcsa.h>
+}
+#include "csapool.h"
+#include <assert.h>
+#include <string.h>
+
+csa_job_t::csa_job_t(int batch_size)
+	: batch(batch_size + 1)
+	, scnt_fields(batch_size + 1) {
+}
+
+void csa_job_t::add(uint8_t* payload, int len, uint8_t* scnt_field) {
+	assert(num_packets + 1 < (int)batch.size());
+	batch[num_packets].data = payload;
+	batch[num_packets].len = len;
+	scnt_fields[num_packets] = scnt_field;
+	++num_packets;
+}
+
+void csa_job_t::run(struct dvbcsa_bs_key_s* key) {
+	batch[num_packets].data = nullptr;
+	if (aes) {
+		for (int i = 0; i < num_packets; ++i)
+			aes128_descramble_payload(aes_key, cbc, batch[i].data, batch[i].len);
+	} else
+		dvbcsa_bs_decrypt(key, batch.data(), 184);
+	// We zero the scrambling control field to mark stream as unscrambled.
+	for (int i = 0; i < num_packets; ++i)
+		*scnt_fields[i] &= 0x3f;
+	num_packets = 0;
+}
+
+csa_worker_pool_t::csa_worker_pool_t(int num_threads) {
+	for (int i = 0; i < num_threads; ++i)
+		threads.emplace_back([this]() { run(); });
+}
+
+csa_worker_pool_t::~csa_worker_pool_t() {
+	{
+		std::unique_lock lck(mutex);
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+
+std::shared_ptr<csa_worker_pool_t> csa_worker_pool_t::get(int num_threads) {
+	static std::mutex m;
+	static std::weak_ptr<csa_worker_pool_t> instance;
+	std::unique_lock lck(m);
+	auto ret = instance.lock();
+	if (!ret) {
+		ret = std::make_shared<csa_worker_pool_t>(num_threads);
+		instance = ret;
+	}
+	return ret;
+}
+
+void csa_worker_pool_t::submit(csa_job_t* job) {
+	job->done.store(false, std::memory_order_relaxed);
+	{
+		std::unique_lock lck(mutex);
+		queue.push_back(job);
+	}
+	cv.notify_one();
+}
+
+void csa_worker_pool_t::run() {
+	auto* key = dvbcsa_bs_key_alloc();
+	uint8_t cw[8]{};
+	bool have_key{false};
+	for (;;) {
+		csa_job_t* job{nullptr};
+		{
+			std::unique_lock lck(mutex);
+			cv.wait(lck, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+				break; // stopping
+			job = queue.front();
+			queue.pop_front();
+		}
+		//consecutive jobs usually share the same control word
+		if (!job->aes && (!have_key || memcmp(cw, job->cw, sizeof(cw)) != 0)) {
+			memcpy(cw, job->cw, sizeof(cw));
+			dvbcsa_bs_key_set(cw, key);
+			have_key = true;
+		}
+		job->run(key);
+		job->done.store(true, std::memory_order_release);
+		job->done.notify_all();
+	}
+	dvbcsa_bs_key_free(key);
+}
@@ -0,0 +1,89 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include "aes128.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+struct dvbcsa_bs_batch_s;
+
+/*!
+	A batch of ts packet payloads of the same parity, to be descrambled with one control word
+*/
+struct csa_job_t {
+	uint8_t cw[8]{};
+	bool aes{false}; //use aes_key instead of cw
+	bool cbc{false};
+	aes128_key_t aes_key;
+	int num_packets{0};
+	std::vector<dvbcsa_bs_batch_s> batch; //null terminated, as required by dvbcsa_bs_decrypt
+	std::vector<uint8_t*> scnt_fields; //byte 3 of each packet, to mark it as descrambled afterwards
+	std::atomic<bool> done{true};
+
+	explicit csa_job_t(int batch_size);
+	csa_job_t(const csa_job_t& other) = delete;
+
+	void add(uint8_t* payload, int len, uint8_t* scnt_field);
+
+	//descramble using key, which must contain the key schedule for cw (unused for aes)
+	void run(struct dvbcsa_bs_key_s* key);
+
+	void wait() const {
+		done.wait(false, std::memory_order_acquire);
+	}
+};
+
+/*!
+	Threads descrambling csa_job_t's submitted by the service threads, shared by all services.
+	Jobs are executed in order of submission, but may complete out of order; submitters
+	wait for their own jobs.
+*/
+class csa_worker_pool_t {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<csa_job_t*> queue;
+	std::vector<std::thread> threads;
+	bool stopping{false};
+
+	void run();
+
+public:
+	explicit csa_worker_pool_t(int num_threads);
+	~csa_worker_pool_t();
+
+	/*!
+		The pool shared by all services. It is created with num_threads threads on first use
+		and destroyed when the last user releases it
+	*/
+	static std::shared_ptr<csa_worker_pool_t> get(int num_threads);
+
+	inline int size() const {
+		return threads.size();
+	}
+
+	void submit(csa_job_t* job);
+};
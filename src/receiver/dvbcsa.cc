@@ -21,9 +21,10 @@
 extern "C" {
 #include <dvbcsa/dvbcsa.h>
 }
-#include "mpm.h"
-#include "receiver.h"
-#include "scam.h"
+#include "dvbcsa.h"
+#include "streamparser/streamparser.h"
+
+using dtdemux::ts_packet_t;
 
 ss::string<32> ca_key_t::to_str() const {
 	ss::string<32> ret;
@@ -69,10 +70,78 @@ decrypt_cache_t::decrypt_cache_t() : batch_size(dvbcsa_bs_batch_size()) {
 }
 
 decrypt_cache_t::~decrypt_cache_t() {
+	for (auto& job : jobs)
+		job->wait();
 	dvbcsa_bs_key_free(active_keys[0]);
 	dvbcsa_bs_key_free(active_keys[1]);
 }
 
+void decrypt_cache_t::set_num_workers(int num_workers) {
+	assert(batch_idx[0] == 0 && batch_idx[1] == 0);
+	for (auto& job : jobs)
+		job->wait();
+	jobs.clear();
+	next_job = 0;
+	if (num_workers <= 0) {
+		pool.reset();
+		return;
+	}
+	pool = csa_worker_pool_t::get(num_workers);
+	//enough jobs to keep all workers busy, plus the ones being filled
+	int num_jobs = 2 * pool->size() + 2;
+	for (int i = 0; i < num_jobs; ++i)
+		jobs.push_back(std::make_unique<csa_job_t>(batch_size));
+	dtdebugf("Descrambling with {:d} workers", pool->size());
+}
+
+void decrypt_cache_t::set_key(bool odd, const ca_key_t& key) {
+	switch (key.algo) {
+	case ca_algo_t::CA_ALGO_AES:
+	case ca_algo_t::CA_ALGO_AES128:
+		//the iv is not passed by scam; cbc mode uses the DVB-CISSA iv
+		aes128_set_key(aes_keys[odd], key.cw);
+		aes_cbc[odd] = key.cipher_mode == ca_cipher_mode_t::CA_MODE_CBC;
+		use_aes[odd] = true;
+		return;
+	case ca_algo_t::CA_ALGO_DES:
+		dterrorf("DES descrambling is not supported; using csa");
+		break;
+	default:
+		break;
+	}
+	use_aes[odd] = false;
+	dvbcsa_bs_key_set(key.cw, active_keys[odd]);
+	memcpy(active_cws[odd].data(), key.cw, active_cws[odd].size());
+}
+
+/*
+	Returns the least recently used job which is not being filled, after waiting for
+	the workers to finish it
+*/
+csa_job_t* decrypt_cache_t::acquire_job() {
+	for (;;) {
+		auto* job = jobs[next_job].get();
+		next_job = (next_job + 1) % jobs.size();
+		if (job == filling_jobs[0] || job == filling_jobs[1])
+			continue;
+		job->wait();
+		return job;
+	}
+}
+
+void decrypt_cache_t::submit(bool odd) {
+	auto* job = filling_jobs[odd];
+	job->aes = use_aes[odd];
+	if (job->aes) {
+		job->aes_key = aes_keys[odd];
+		job->cbc = aes_cbc[odd];
+	} else
+		memcpy(job->cw, active_cws[odd].data(), sizeof(job->cw));
+	filling_jobs[odd] = nullptr;
+	batch_idx[odd] = 0;
+	pool->submit(job);
+}
+
 void decrypt_cache_t::add_packet(bool odd, uint8_t* packet) {
 	int offset = ts_packet_get_payload_offset(packet);
 	if (!offset)
@@ -83,9 +152,18 @@ void decrypt_cache_t::add_packet(bool odd, uint8_t* packet) {
 		return;
 	}
 
+	int& idx = batch_idx[odd];
+	if (pool) {
+		auto*& job = filling_jobs[odd];
+		if (!job)
+			job = acquire_job();
+		job->add(packet + offset, len, packet + 3);
+		if (++idx == batch_size)
+			submit(odd);
+		return;
+	}
 	auto& batch = batches[odd];
 	auto& scnt_field = scnt_fields[odd];
-	int& idx = batch_idx[odd];
 	batch[idx].data = packet + offset;
 	batch[idx].len = len;
 	scnt_field[idx] = packet + 3;
@@ -97,6 +175,17 @@ void decrypt_cache_t::add_packet(bool odd, uint8_t* packet) {
 }
 
 void decrypt_cache_t::decrypt_all_pending(const char* debug_msg) {
+	if (pool) {
+		for (int odd = 0; odd < 2; ++odd) {
+			if (batch_idx[odd] > 0) {
+				dtdebugf("Decrypting {:d} packets with parity={:d} {}", batch_idx[odd], odd, debug_msg);
+				submit(odd);
+			}
+		}
+		for (auto& job : jobs)
+			job->wait();
+		return;
+	}
 
 	for (int odd = 0; odd < 2; ++odd) {
 		auto& batch = batches[odd];
@@ -108,7 +197,11 @@ void decrypt_cache_t::decrypt_all_pending(const char* debug_msg) {
 #endif
 			assert(idx < batch_size + 1);
 			batch[idx].data = 0;
-			dvbcsa_bs_decrypt(active_keys[odd], batch.buffer(), 184);
+			if (use_aes[odd]) {
+				for (int i = 0; i < idx; ++i)
+					aes128_descramble_payload(aes_keys[odd], aes_cbc[odd], batch[i].data, batch[i].len);
+			} else
+				dvbcsa_bs_decrypt(active_keys[odd], batch.buffer(), 184);
 			// We zero the scrambling control field to mark stream as unscrambled.
 			for (int i = 0; i < idx; ++i) {
 				*scnt_field[i] &= 0x3f;
@@ -118,6 +211,56 @@ void decrypt_cache_t::decrypt_all_pending(const char* debug_msg) {
 	};
 }
 
+int decrypt_scheduler_t::schedule(int64_t num_bytes_read, int available, int csa_batch_size, bool low_data_rate,
+																	steady_time_t now) {
+	//bitrate, measured over periods of at least 500ms and smoothed
+	if (window_start == steady_time_t{})
+		window_start = now;
+	window_bytes += num_bytes_read;
+	auto dt = std::chrono::duration<double>(now - window_start).count();
+	if (dt >= 0.5) {
+		int32_t rate = window_bytes * 8 / dt;
+		auto old = bitrate.load(std::memory_order_relaxed);
+		bitrate.store(old == 0 ? rate : (3 * (int64_t)old + rate) / 4, std::memory_order_relaxed);
+		window_start = now;
+		window_bytes = 0;
+	}
+
+	auto rate = bitrate.load(std::memory_order_relaxed);
+	int packets = csa_batch_size; //until the bitrate is known
+	if (rate > 0)
+		packets = (int64_t)rate / 8 * latency_target.count() / 1000 / ts_packet_t::size;
+	packets = std::clamp(packets, 1, max_csa_batches * csa_batch_size);
+	if (packets >= csa_batch_size)
+		packets -= packets % csa_batch_size;
+	if (low_data_rate)
+		packets = std::min(packets, std::max(1, csa_batch_size / 32));
+	batch_packets.store(packets, std::memory_order_relaxed);
+
+	int unit = packets * ts_packet_t::size;
+	int ret = (available / unit) * unit;
+	int all = available - available % ts_packet_t::size;
+	if (ret == all) {
+		pending_since = {};
+	} else if (ret > 0 || pending_since == steady_time_t{}) {
+		pending_since = now; //the remainder is newer data
+	} else if (now - pending_since >= latency_target) {
+		num_deadline_flushes.fetch_add(1, std::memory_order_relaxed);
+		pending_since = {};
+		ret = all;
+	}
+	return ret;
+}
+
+decrypt_stats_t decrypt_scheduler_t::stats() const {
+	decrypt_stats_t ret;
+	ret.bitrate = bitrate.load(std::memory_order_relaxed);
+	ret.batch_packets = batch_packets.load(std::memory_order_relaxed);
+	ret.lag_bytes = lag_bytes.load(std::memory_order_relaxed);
+	ret.lag_ms = ret.bitrate > 0 ? ret.lag_bytes * 8 * 1000 / ret.bitrate : 0;
+	ret.num_deadline_flushes = num_deadline_flushes.load(std::memory_order_relaxed);
+	return ret;
+}
 
 /*!
 	Checks the first few packets for specific stream pid, starting at position 0 in buffer
@@ -153,11 +296,7 @@ int dvbcsa_t::confirm_parity_change(uint8_t* buffer, int buffer_size, int pid, i
 */
 int dvbcsa_t::skip_non_decryptable(uint8_t* buffer, int buffer_size) {
 	assert(waiting_for_keys);
-	int64_t pos;
-	{
-		std::unique_lock lck(key_mutex);
-		pos = last_restart_decryption_bytepos;
-	}
+	int64_t pos = last_restart_decryption_bytepos.load(std::memory_order_acquire);
 
 	if (pos <= num_bytes_decrypted) {
 		return 0; /*restart was in the past, so it is possible that it will arrive later
@@ -208,6 +347,7 @@ int dvbcsa_t::skip_non_decryptable(uint8_t* buffer, int buffer_size) {
 						dtdebugf("packets[0-{:d}] UNDECRYPTABLE pid={:d} scrambling_control_packet={:d}", packet_start, pid,
 										 scrambling_control_packet);
 						descrambling_contexts.clear();
+						first_key_idx = first_key_after_restart(); // older keys cannot be used anymore
 						waiting_for_keys = false; // needed
 						return packet_start;
 					}
@@ -220,6 +360,19 @@ int dvbcsa_t::skip_non_decryptable(uint8_t* buffer, int buffer_size) {
 	return 0;
 }
 
+/*!
+	Returns the index of the oldest received key which was received after the last scam restart,
+	or of the next key to be received if there is none yet
+*/
+int dvbcsa_t::first_key_after_restart() {
+	keys.receive();
+	auto count = restart_count.load(std::memory_order_relaxed);
+	auto idx = keys.last_received_key_idx();
+	for (int n = 0; idx >= 0 && n < num_keys && keys[idx].restart_count == count; ++n)
+		idx = (idx + num_keys - 1) % num_keys;
+	return (idx + 1) % num_keys;
+}
+
 /*!
 	@brief
 	Decrypt a batch of transportstream packets.
@@ -241,10 +394,8 @@ int dvbcsa_t::decrypt_buffer(uint8_t* buffer, int buffer_size) {
 	// bool late_key = false;
 	// unsigned int last_scrambling_control_packet = 0;
 
-	{
-		std::unique_lock lck(key_mutex);
-		num_bytes_received = num_bytes_decrypted + buffer_size; // used to mark keys
-	}
+	num_bytes_received.store(num_bytes_decrypted + buffer_size, std::memory_order_relaxed); // used to mark keys
+	keys.receive(); //also when no parity changes occur, so that the key queue cannot fill up
 	dtdebugf("buffer_size={:d}", buffer_size);
 	descrambling_context_t* context = nullptr;
 	// static descrambling_context_t * last_pid_context  = nullptr; //only for debugging
@@ -347,6 +498,7 @@ int dvbcsa_t::handle_parity_change(descrambling_context_t* context, int* idx, in
 						 context->scrambling_control_packet, scrambling_control_packet, packet_start / ts_packet_t::size,
 						 buffer_size / ts_packet_t::size);
 
+		parity_change_bytepos = num_bytes_decrypted + packet_start;
 		ret = next_key(*context, pid, odd);
 		if (ret >= 0)
 			dtdebugf("KEY pid={:d}: called next_key ret={:d} for parity transition to parity={:d}: {:d} => {:d}", pid, ret, odd,
@@ -367,6 +519,7 @@ int dvbcsa_t::handle_parity_change(descrambling_context_t* context, int* idx, in
 
 			auto non_decryptable = skip_non_decryptable(buffer + packet_start, buffer_size - packet_start);
 			packet_start += non_decryptable;
+			num_bytes_skipped += non_decryptable;
 		}
 		return -1; // we must wait for a key update or for data
 	} else if (ret == 1) {
@@ -413,48 +566,26 @@ int dvbcsa_t::handle_parity_change(descrambling_context_t* context, int* idx, in
 */
 int dvbcsa_t::get_key(int key_idx, int parity, bool allow_future_key) {
 	assert(parity == 0 || parity == 1);
-	std::unique_lock lck(key_mutex);
-	auto& last_installed_key_idx = last_installed_key_idxs[parity]; // info only
-	auto start = key_idx % num_keys;																// we may need to reuse the last key
-	auto end = (last_received_key_idx + 1) % num_keys;
-	/// loop over all keys, starting with the oldest (circular buffer)
-
-	if (start == end) {
-		dtdebugf("KEY LOAD {:s} key {:d}: no key yet. start={:d} end={:d}", parity ? "odd" : "even", key_idx, start, end);
+	keys.receive();
+	auto idx = keys.find_key(key_idx, parity, parity_change_bytepos, allow_future_key);
+	if (idx == -1) {
+		dtdebugf("KEY LOAD {:s} key {:d}: no key yet", parity ? "odd" : "even", key_idx);
 		waiting_for_keys = true;
 		return -1; // no key received yet
 	}
-
-	for (int idx = start; idx != end; idx = (idx + 1) % num_keys) {
-		auto& key = keys[idx];
-		if (!key.valid || parity != key.parity) {
-			if (key.request_bytepos > num_bytes_decrypted && !allow_future_key) {
-				// This can also happen at start, if keys are wrongly ordered
-				dtdebugf("KEY found for other parity which was requested in the future; cannot use yet (key "
-								 "we want will also be in the future)");
-				/*@todo we could skip some data (but this is handled elsewehere)
-				 */
-				break;
-			}
-			continue; // we expect that this happens once on each call
-		}
-		if (key.valid && parity == key.parity) {
-			if (key.request_bytepos > num_bytes_decrypted && !allow_future_key) {
-				// This can also happen at start, if keys are wrongly ordered
-				dtdebugf("KEY found for current parity which was requested in the future; cannot use it yet");
-				/*@todo we could skip some data (but this is handled elsewehere)
-				 */
-				break;
-			}
-			last_installed_key_idx = idx;
-			dtdebugf("Switch to {:s} key idx {:d} => {:d} start={:d} end={:d}", parity ? "odd" : "even", key_idx, idx, start, end);
-			waiting_for_keys = false;
-			return idx;
-		}
+	if (idx == -2) {
+		/*keys of the other parity only, or the next key was requested in the future;
+			@todo we could skip some data (but this is handled elsewehere)
+		*/
+		dtdebugf("KEY LOAD {:s} key {:d}: no usable key yet; last received={:d}", parity ? "odd" : "even", key_idx,
+						 keys.last_received_key_idx());
+		waiting_for_keys = true;
+		return -2;
 	}
-
-	waiting_for_keys = true;
-	return -2;
+	last_installed_key_idxs[parity] = idx; // info only
+	dtdebugf("Switch to {:s} key idx {:d} => {:d}", parity ? "odd" : "even", key_idx, idx);
+	waiting_for_keys = false;
+	return idx;
 }
 
 /*!
@@ -479,7 +610,7 @@ int dvbcsa_t::next_key(descrambling_context_t& context, uint16_t pid, bool odd)
 		/* First expire key for other parity (except in rare cases)
 		 */
 		auto& otherkey = keys[otheridx];
-		if (otherkey.request_bytepos < num_bytes_decrypted) {
+		if (otherkey.request_bytepos < parity_change_bytepos) {
 			/*usual case: otherkey has expired;
 				note that the other key may not yet have been installed
 			*/
@@ -521,7 +652,7 @@ int dvbcsa_t::next_key(descrambling_context_t& context, uint16_t pid, bool odd)
 				This state was entered after a restart; there has been no transition to the other parity yet (or the
 				state would be EXPIRED)
 			*/
-			if (key.request_bytepos < num_bytes_decrypted) {
+			if (key.request_bytepos < parity_change_bytepos) {
 				dtdebugf("KEY pid {:d}: desired key[{:d}] for parity {:d} was UNKNOWN; is now VALID", pid, idx, odd);
 				context.last_used_key_validity[odd] = descrambling_context_t::key_validy_t::VALID;
 				// assert(!waiting_for_keys);
@@ -534,7 +665,7 @@ int dvbcsa_t::next_key(descrambling_context_t& context, uint16_t pid, bool odd)
 			dtdebugf("KEY pid {:d}: UNEXPECTED desired key[{:d}] for parity {:d} in VALID state visited twice", pid, idx, odd);
 			break;
 		case descrambling_context_t::key_validy_t::EXPIRED:
-			assert(key.request_bytepos < num_bytes_decrypted);
+			assert(key.request_bytepos < parity_change_bytepos);
 			allow_future_key = true; // if the last key was expired some gap must have occurred
 			break;
 		}
@@ -545,7 +676,7 @@ int dvbcsa_t::next_key(descrambling_context_t& context, uint16_t pid, bool odd)
 		parity
 	*/
 
-	idx = (idx + 1) % num_keys;
+	idx = idx < 0 ? first_key_idx : (idx + 1) % num_keys;
 	if (idx == cache.active_key_indexes[odd]) {
 		dtdebugf("KEY pid {:d}: desired key[{:d}] for parity {:d} already installed", pid, idx, odd);
 		assert(!waiting_for_keys);
@@ -604,47 +735,47 @@ int dvbcsa_t::next_key(descrambling_context_t& context, uint16_t pid, bool odd)
 	service thread
 */
 void dvbcsa_t::add_key(const ca_slot_t& slot, int decryption_index, system_time_t t) {
-	std::unique_lock lck(key_mutex);
-	auto idx = (last_received_key_idx + 1) % num_keys;
 	if (this->decryption_index < 0)
 		this->decryption_index = decryption_index;
 	if (decryption_index != this->decryption_index) {
 		dterrorf("Unexpected: received keys from multiple slots: {:d} and {:d}", decryption_index, this->decryption_index);
 	};
-	auto k = slot.last_key.to_str();
-	ss::string<64> tt;
-	tt.format("{}", std::chrono::duration_cast<std::chrono::seconds>(t - start).count());
-	dtdebugf("ADD CW {:s} [{:d}] at bytepos={:d} t={:s}: {:s}", odd_even_str(slot.last_key.parity), idx, num_bytes_received,
-					 tt.c_str(), k.c_str());
-	auto& key = keys[idx];
-	key = slot.last_key;
+	auto bytepos = num_bytes_received.load(std::memory_order_relaxed);
+	ca_key_t key = slot.last_key;
 	key.receive_time = t;
-	key.receive_bytepos = num_bytes_received;
+	key.receive_bytepos = bytepos;
 	key.request_time = last_key_request_time;
 	key.request_bytepos = last_key_request_bytepos;
-	key.restart_count = restart_count;
+	key.restart_count = restart_count.load(std::memory_order_relaxed);
+	key.algo = slot.algo;
+	key.cipher_mode = slot.cipher_mode;
 	/*tag the key with the point in the byte stream where it was approximately received
 		Because multiple threads are involved, this position is approximate
 	*/
 	// key.valid_from_byte_pos = num_bytes_received;
-	last_received_key_idx = idx;
+	auto idx = keys.push(key);
+	auto k = slot.last_key.to_str();
+	ss::string<64> tt;
+	tt.format("{}", std::chrono::duration_cast<std::chrono::seconds>(t - start).count());
+	dtdebugf("ADD CW {:s} [{:d}] at bytepos={:d} t={:s}: {:s}", odd_even_str(slot.last_key.parity), idx, bytepos,
+					 tt.c_str(), k.c_str());
 }
 
 void dvbcsa_t::restart_decryption(system_time_t t) {
 	ss::string<64> tt;
 	tt.format("{}", std::chrono::duration_cast<std::chrono::seconds>(t - start).count());
-	dtdebugf("DECRYPTION restarted at bytepos {:d} t={:s}", num_bytes_received, tt.c_str());
-	std::unique_lock lck(key_mutex);
-	restart_count++;
-	last_restart_decryption_bytepos = num_bytes_received;
+	auto bytepos = num_bytes_received.load(std::memory_order_relaxed);
+	dtdebugf("DECRYPTION restarted at bytepos {:d} t={:s}", bytepos, tt.c_str());
+	restart_count.fetch_add(1, std::memory_order_relaxed);
+	last_restart_decryption_bytepos.store(bytepos, std::memory_order_release);
 }
 
 void dvbcsa_t::mark_ecm_sent(bool odd, system_time_t t) {
 	ss::string<64> tt;
 	tt.format("{}", std::chrono::duration_cast<std::chrono::seconds>(t - start).count());
-	dtdebugf("ECM {:s} sent to scam at bytepos={:d} t={:s}", odd_even_str(odd), num_bytes_received, tt.c_str());
-	std::unique_lock lck(key_mutex);
-	last_key_request_bytepos = num_bytes_received;
+	auto bytepos = num_bytes_received.load(std::memory_order_relaxed);
+	dtdebugf("ECM {:s} sent to scam at bytepos={:d} t={:s}", odd_even_str(odd), bytepos, tt.c_str());
+	last_key_request_bytepos = bytepos;
 	last_key_request_time = t;
 }
 
@@ -653,7 +784,7 @@ void dvbcsa_t::set_cw(const descrambling_context_t& context, bool odd) {
 	auto& key = keys[idx];
 	assert(key.parity == odd);
 	assert(key.parity == 0 || key.parity == 1);
-	dvbcsa_bs_key_set(key.cw, cache.active_keys[key.parity]);
+	cache.set_key(key.parity, key);
 	auto k = key.to_str();
 	cache.active_key_indexes[key.parity] = idx;
 	dtdebugf("SET CW {:s}[{:d}]: {:s}", key.parity ? "odd" : "even", idx, k.c_str());
@@ -20,10 +20,17 @@
 
 #pragma once
 
+#include "active_stream.h"
 #include "linux/dvb/ca.h"
 #include "dvbapi.h"
 #include <linux/dvb/dmx.h>
-#include "active_stream.h"
+#include "csapool.h"
+#include "aes128.h"
+#include "keyring.h"
+#include "streamparser/substream.h"
+#include <algorithm>
+#include <array>
+#include <map>
 
 inline const char* odd_even_str(bool odd)
 {
@@ -54,6 +61,8 @@ struct ca_key_t {
 	system_time_t request_time{};
 	system_time_t receive_time{};
 	int restart_count = 0 ; //number of times scam was restarted before receving this key
+	ca_algo_t algo{ca_algo_t::CA_ALGO_DVBCSA};
+	ca_cipher_mode_t cipher_mode{ca_cipher_mode_t::CA_MODE_ECB};
 	ss::string<32> to_str() const;
 };
 
@@ -90,8 +99,8 @@ struct descrambling_context_t {
 struct ca_slot_t {
 	static constexpr int MAX_PIDS=16;
 	ss::vector<uint16_t, MAX_PIDS> pids; //service pids
-	ca_algo_t algo;
-	ca_cipher_mode_t cipher_mode;
+	ca_algo_t algo{ca_algo_t::CA_ALGO_DVBCSA};
+	ca_cipher_mode_t cipher_mode{ca_cipher_mode_t::CA_MODE_ECB};
 	ca_key_t last_key;
 	ca_slot_t() {
 		for(auto & pid: pids)
@@ -110,22 +119,113 @@ struct decrypt_cache_t {
 	int batch_idx[2]={0,0};
 	std::array<struct dvbcsa_bs_key_s*, 2> active_keys{{nullptr, nullptr}};
 	std::array<int, 2> active_key_indexes{-1, -1};
+	//aes keys are used instead of active_keys for a parity if use_aes is set
+	std::array<bool, 2> use_aes{{false, false}};
+	std::array<bool, 2> aes_cbc{{false, false}};
+	std::array<aes128_key_t, 2> aes_keys;
+
+	/*
+		worker pool mode: full batches are handed to the workers, while the service thread continues
+		collecting packets, so the batches of one decrypt_buffer call are descrambled in parallel.
+		decrypt_all_pending blocks until all of them are done, and decrypt_buffer therefore still only
+		returns when all data it reports as decrypted has been descrambled. Jobs cannot remain in
+		progress after decrypt_buffer returns, because the jobs point into the live buffer's map,
+		which can be moved by mremap when it grows, or replaced when a new part file is started
+	*/
+	std::shared_ptr<csa_worker_pool_t> pool;
+	std::vector<std::unique_ptr<csa_job_t>> jobs; //reused round robin
+	int next_job{0};
+	std::array<csa_job_t*, 2> filling_jobs{{nullptr, nullptr}}; //jobs collecting packets, per parity
+	std::array<std::array<uint8_t, 8>, 2> active_cws{};
 
 	decrypt_cache_t();
 	~decrypt_cache_t();
 
+	/*!
+		0: descramble on the service thread; otherwise use the shared pool,
+		which is created with num_workers threads if it does not exist yet.
+		Should only be called when no packets are pending
+	*/
+	void set_num_workers(int num_workers);
+	void set_key(bool odd, const ca_key_t& key);
 	void decrypt_all_pending(const char*debug_msg);
 	void add_packet(bool odd, uint8_t* packet);
+
+private:
+	csa_job_t* acquire_job();
+	void submit(bool odd);
 };
 
 
+struct decrypt_stats_t {
+	int32_t bitrate{0}; //bits/s of the service, as measured by the scheduler
+	int32_t batch_packets{0}; //number of packets currently descrambled at once
+	int64_t lag_bytes{0}; //bytes received but not yet descrambled
+	int32_t lag_ms{0}; //time needed to receive lag_bytes at the current bitrate
+	int64_t num_deadline_flushes{0}; //incomplete batches descrambled because the latency target expired
+};
+
+/*!
+	Decides how much data active_mpm_t::decrypt_channel_data descrambles at once.
+
+	Large amounts are descrambled more efficiently, but at low bitrates waiting for them delays
+	the data (e.g., the start of playback of a radio service). The amount is chosen to fill up
+	in about latency_target at the measured bitrate of the service, rounded down to whole csa batches
+	if larger than one batch. Data which has waited longer than latency_target is descrambled
+	even if the amount is not reached.
+
+	Called by the service thread; the metrics can be read from any thread
+*/
+class decrypt_scheduler_t {
+	steady_time_t window_start{};
+	int64_t window_bytes{0};
+	steady_time_t pending_since{}; //since when a partial batch is waiting; {} if none
+	std::atomic<int32_t> bitrate{0};
+	std::atomic<int32_t> batch_packets{0};
+	std::atomic<int64_t> lag_bytes{0};
+	std::atomic<int64_t> num_deadline_flushes{0};
+
+public:
+	static constexpr int max_csa_batches = 32;
+	std::chrono::milliseconds latency_target{100ms};
+
+	/*!
+		Returns how many of the available bytes should be descrambled now.
+		num_bytes_read: number of bytes received since the last call.
+		low_data_rate: limit the amount to 1/32 of a csa batch, e.g., while waiting for an encrypted pmt
+	*/
+	int schedule(int64_t num_bytes_read, int available, int csa_batch_size, bool low_data_rate,
+							 steady_time_t now);
+
+	/*!
+		Returns how long data which is waiting for descrambling may still wait, or max_wait if no data is waiting.
+		Used by the service thread to call schedule in time when no more data arrives
+	*/
+	std::chrono::milliseconds time_to_deadline(steady_time_t now, std::chrono::milliseconds max_wait) const {
+		if (pending_since == steady_time_t{})
+			return max_wait;
+		auto ret = std::chrono::ceil<std::chrono::milliseconds>(pending_since + latency_target - now);
+		return std::clamp(ret, 0ms, max_wait);
+	}
+
+	//no data is waiting for descrambling
+	inline void clear_deadline() {
+		pending_since = {};
+	}
+
+	//record the number of bytes still waiting after descrambling
+	inline void set_lag(int64_t bytes) {
+		lag_bytes.store(bytes, std::memory_order_relaxed);
+	}
+
+	decrypt_stats_t stats() const;
+};
 
 /*
 	owned by service streaming thread
  */
 struct dvbcsa_t {
 	system_time_t start;
-	std::mutex key_mutex;
 	/*This dvbcsa is specific per actice_service
 	here we need either a key queue per pid
 	or a key_seqno per pid
@@ -145,22 +245,26 @@ struct dvbcsa_t {
 	The first time it can skp the first key if it is the wrong parity, from then on not.
 	*/
 	int last_installed_key_idxs[2] = {0, 0}; //last installed key (per parity)
-	int last_received_key_idx = -1; //last received key
 	constexpr static int num_keys = 256; //2 should be enough
-	ca_key_t keys[num_keys];
+	key_ring_t<ca_key_t, num_keys> keys; //pushed by scam thread, received by service thread
 	int64_t  num_bytes_decrypted{}; //total number of bytes decrypted from service start
-	int64_t  num_bytes_received{}; //total number of bytes read from service start
+	std::atomic<int64_t>  num_bytes_received{}; //total number of bytes read from service start
 	int64_t skip_non_decryptable_last_scanned_bytepos{}; /*when no keys arrive the code
 																												 starts scanning for parity changes
 																												 in the data; this variable
 																												 remebers the progress
 																											 */
+	int64_t num_bytes_skipped{}; //total number of bytes skipped because they could not be decrypted
+	int64_t parity_change_bytepos{}; //position of the parity change for which a key is being searched
 
-	int restart_count{0}; //number of times scam has restarted
+	//only accessed by scam thread
 	int64_t last_key_request_bytepos{-1};
-	int64_t last_restart_decryption_bytepos{-1};
 	system_time_t last_key_request_time{};
 
+	std::atomic<int> restart_count{0}; //number of times scam has restarted
+	std::atomic<int64_t> last_restart_decryption_bytepos{-1};
+	int first_key_idx{0}; //pids without a descrambling context search for keys starting at this index
+
 	int decryption_index = -1;
 
 	decrypt_cache_t cache;
@@ -189,6 +293,7 @@ struct dvbcsa_t {
 private:
 	int get_key(int key_idx, int parity, bool allow_future_key);
 	int skip_non_decryptable(uint8_t* buffer, int buffer_size);
+	int first_key_after_restart();
 	int confirm_parity_change(uint8_t* buffer, int buffer_size, int pid, int scrambling_control_packet,
 														int threshold=3);
 	int handle_parity_change(descrambling_context_t* context, int* idx,
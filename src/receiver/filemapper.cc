@@ -22,15 +22,90 @@
 #include "util/logger.h"
 #include "util/util.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <list>
+#include <mutex>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 const int mmap_t::pagesize = sysconf(_SC_PAGESIZE);
 
+struct mmap_chunk_t {
+	dev_t dev;
+	ino_t ino;
+	off_t offset; //in the file
+	uint8_t* mem{nullptr};
+
+	~mmap_chunk_t() {
+		if (mem && munmap(mem, mmap_t::chunk_size) < 0)
+			dterrorf("Error while unmapping: {}", strerror(errno));
+	}
+};
+
+/*
+	Least recently used chunks are unmapped when more than max_chunks are mapped, but only after
+	the last reader has moved away from them. When a reader closes a file, the chunks of that file
+	which no other reader uses are unmapped immediately, so that no mappings are kept for files
+	which are no longer being read (and which may since have been deleted)
+*/
+class mmap_chunk_cache_t {
+	static constexpr int max_chunks = 32;
+	std::mutex mutex;
+	std::list<std::shared_ptr<mmap_chunk_t>> chunks; //most recently used first
+
+public:
+	std::shared_ptr<mmap_chunk_t> get(int fd, dev_t dev, ino_t ino, off_t offset);
+	void release(dev_t dev, ino_t ino);
+};
+
+static mmap_chunk_cache_t chunk_cache;
+
+std::shared_ptr<mmap_chunk_t> mmap_chunk_cache_t::get(int fd, dev_t dev, ino_t ino, off_t offset) {
+	std::scoped_lock lck(mutex);
+	for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+		auto& c = **it;
+		if (c.dev == dev && c.ino == ino && c.offset == offset) {
+			chunks.splice(chunks.begin(), chunks, it);
+			return chunks.front();
+		}
+	}
+	/*The chunk may extend beyond the end of the file, which is fine as long as only bytes
+		which have been written are accessed*/
+	auto* mem = (uint8_t*)mmap(NULL, mmap_t::chunk_size, PROT_READ, MAP_SHARED, fd, offset);
+	if (mem == (uint8_t*)-1) {
+		dterrorf("Error in mmap: {}", strerror(errno));
+		return nullptr;
+	}
+	dtdebugf("MMAP chunk {:d}", offset);
+	madvise(mem, mmap_t::chunk_size, MADV_SEQUENTIAL);
+	auto ret = std::make_shared<mmap_chunk_t>();
+	ret->dev = dev;
+	ret->ino = ino;
+	ret->offset = offset;
+	ret->mem = mem;
+	chunks.push_front(ret);
+	if ((int)chunks.size() > max_chunks)
+		chunks.pop_back();
+	return ret;
+}
+
+void mmap_chunk_cache_t::release(dev_t dev, ino_t ino) {
+	std::scoped_lock lck(mutex);
+	for (auto it = chunks.begin(); it != chunks.end();) {
+		auto& c = **it;
+		if (c.dev == dev && c.ino == ino && it->use_count() == 1) {
+			dtdebugf("MUNMAP chunk {:d}", c.offset);
+			it = chunks.erase(it);
+		} else
+			++it;
+	}
+}
+
 /*!
 	use other as a template, to create a non-mapped version
 */
@@ -50,6 +125,8 @@ mmap_t& mmap_t::operator=(const mmap_t& other) {
 	read_pointer = 0;
 	write_pointer = 0;
 	decrypt_pointer = 0;
+	chunk.reset();
+	end_read_offset = -1;
 	return *this;
 }
 
@@ -84,6 +161,12 @@ mmap_t& mmap_t::operator=(mmap_t&& other) {
 	decrypt_pointer = other.decrypt_pointer;
 	other.decrypt_pointer = 0;
 
+	chunk = std::move(other.chunk);
+	end_read_offset = other.end_read_offset;
+	other.end_read_offset = -1;
+	dev = other.dev;
+	ino = other.ino;
+
 	return *this;
 }
 
@@ -164,6 +247,14 @@ int mmap_t::move_map(off_t start) {
 
 */
 int mmap_t::grow_map(off_t end_read_offset) {
+	if (readonly) {
+		/*chunks are never remapped; get_read_buffer moves to the next chunk when needed*/
+		if (end_read_offset <= this->end_read_offset)
+			return -1;
+		this->end_read_offset = end_read_offset;
+		safe_read_len = std::min((off_t)map_len, end_read_offset - offset);
+		return 0;
+	}
 	/*
 		compute offset in currently mapped part of the file
 		in case beginning of file is no longer mapped, this will be different from end_read_offset
@@ -226,6 +317,27 @@ bool mmap_t::init(int fd_, off_t start_offset, off_t end_read_offset) {
 		close();
 		fd = fd_;
 	}
+	if (readonly) {
+		assert(end_read_offset >= 0);
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			dterrorf("fstat failed fd={:d}: {}", fd, strerror(errno));
+			return false;
+		}
+		dev = st.st_dev;
+		ino = st.st_ino;
+		this->end_read_offset = end_read_offset;
+		if (!map_chunk(start_offset - start_offset % chunk_size))
+			return false;
+		read_pointer = start_offset - offset;
+		assert(read_pointer <= safe_read_len);
+		write_pointer = 0;
+		decrypt_pointer = 0;
+		// after a seek, start reading the data we will need first
+		auto start_page = read_pointer - read_pointer % pagesize;
+		madvise(buffer + start_page, map_len - start_page, MADV_WILLNEED);
+		return true;
+	}
 	auto page_offset = (start_offset / pagesize) * pagesize;
 
 	safe_read_len = -1;
@@ -250,9 +362,40 @@ bool mmap_t::init(int fd_, off_t start_offset, off_t end_read_offset) {
 	return ret;
 }
 
+bool mmap_t::map_chunk(off_t chunk_offset) {
+	assert(chunk_offset % chunk_size == 0);
+	auto c = chunk_cache.get(fd, dev, ino, chunk_offset);
+	if (!c)
+		return false;
+	chunk = std::move(c);
+	buffer = chunk->mem;
+	offset = chunk_offset;
+	map_len = chunk_size;
+	safe_read_len = std::max((off_t)0, std::min((off_t)map_len, end_read_offset - offset));
+	// let the kernel read the next chunk while this one is being played
+	posix_fadvise(fd, offset + map_len, chunk_size, POSIX_FADV_WILLNEED);
+	return true;
+}
+
+bool mmap_t::next_chunk() {
+	assert(readonly);
+	if (end_read_offset <= offset + map_len)
+		return false;
+	if (!map_chunk(offset + map_len))
+		return false;
+	read_pointer = 0;
+	return true;
+}
+
 void mmap_t::unmap() {
 	if (!buffer)
 		return;
+	if (chunk) {
+		chunk.reset(); // unmapped by the cache
+		offset = -1;
+		buffer = nullptr;
+		return;
+	}
 	dtdebugf("UNMAP: {:p} {:d}", fmt::ptr(buffer), map_len);
 	if (buffer && munmap(buffer, map_len) < 0) {
 		dterrorf("Error while unmapping: {}", strerror(errno));
@@ -262,6 +405,10 @@ void mmap_t::unmap() {
 }
 
 void mmap_t::close() {
+	if (readonly && fd >= 0) {
+		unmap();
+		chunk_cache.release(dev, ino);
+	}
 	while (fd >= 0 && ::close(fd) < 0) {
 		if (errno != EINTR) {
 			dterrorf("Error closing file: {:s}", strerror(errno));
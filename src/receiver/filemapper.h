@@ -19,14 +19,28 @@
  */
 
 #pragma once
+#include <memory>
 #include <stdint.h>
+#include <sys/types.h>
 #include <unistd.h>
 #include "util/dtassert.h"
 
+#ifndef EXPORT
+#define EXPORT __attribute__((visibility("default")))
+#endif
 
+struct mmap_chunk_t;
+
+/*
+	Readers (readonly) do not map the file as a whole, but one chunk of chunk_size bytes at a time.
+	Chunks are kept in a process wide cache shared by all readers, so seeking back and forth and
+	multiple readers of the same file do not need to remap data. Chunks have a fixed size, independent
+	of the file size, so a growing file never needs to be remapped either.
+ */
 struct mmap_t {
 	bool readonly = false;
 	static const int pagesize;
+	static constexpr int chunk_size = 188 * 3 * 16384; //multiple of 188 and of 64kB pages; approx 9 MByte
 	int fd{-1}; //file descriptor of currently mapped file
 
 	/*
@@ -59,6 +73,12 @@ struct mmap_t {
 														valid range for decrypt_pointer: [0, write_pointer]
 													*/
 
+	//readonly only
+	std::shared_ptr<mmap_chunk_t> chunk; //currently mapped chunk; buffer points into it
+	off_t end_read_offset{-1}; //number of bytes which are safe to read in the file
+	dev_t dev{0}; //identifies the file in the chunk cache
+	ino_t ino{0};
+
 	void init();
 
 	/*!
@@ -80,6 +100,8 @@ struct mmap_t {
 	int get_read_buffer(uint8_t*& buffer_ret) {
 		if(!buffer)
 			return -1;
+		if (readonly && read_pointer == map_len)
+			next_chunk();
 		buffer_ret = buffer + read_pointer;
 		assert (read_pointer>= 0);
 		assert (read_pointer<= safe_read_len);
@@ -141,6 +163,12 @@ mmap_t(int map_len_, bool readonly_)
 
 	int grow_map(off_t end_read_offset);
 
+	/*readonly: map the chunk starting at chunk_offset*/
+	bool map_chunk(off_t chunk_offset);
+
+	/*readonly: move to the next chunk, if data is safe to read there*/
+	bool next_chunk();
+
 	EXPORT void close();
 
 	mmap_t& operator=(const mmap_t& other);
@@ -0,0 +1,103 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include "active_stream.h"
+#include "tsfilereader.h"
+#include "neumodb/chdb/chdb_extra.h"
+
+/*
+	Stream reader which replays a recorded transport stream instead of reading a demux device,
+	so that code which consumes a stream_reader_t can be driven from a file.
+
+	The reader has no active_adapter_t: stream_mux() returns the mux passed by the caller, and
+	changes reported by si processing are stored, but not propagated to a tuner. Code which needs
+	the adapter itself (tune_options(), tuning state, the tuner thread) cannot use this reader
+ */
+class file_stream_reader_t final : public stream_reader_t {
+	ts_file_reader_t file;
+	chdb::any_mux_t mux;
+	std::vector<uint16_t> read_pids; //scratch space for read_into
+
+public:
+	file_stream_reader_t(const char* filename, const chdb::any_mux_t& mux, bool paced = false,
+											 double speed = 1., ssize_t buffer_size = -1)
+		: file(filename, paced, speed, buffer_size)
+		, mux(mux)
+		{}
+
+	virtual ~file_stream_reader_t() {
+		close();
+	}
+
+	virtual bool is_open() const {
+		return file.is_open();
+	}
+
+	inline bool at_end() const {
+		return file.at_end();
+	}
+
+	virtual int open(uint16_t initial_pid, epoll_t* epoll,
+									 int epoll_flags = EPOLLIN|EPOLLERR|EPOLLHUP|EPOLLET);
+	virtual void close();
+
+	virtual bool on_epoll_event(const epoll_event* evt) {
+		return file.on_epoll_event(evt);
+	}
+
+	virtual std::tuple<uint8_t*, ssize_t> read(ssize_t size=-1);
+	virtual ssize_t read_into(uint8_t* p, ssize_t toread, const std::vector<pid_with_use_count_t>* pids = nullptr);
+
+	virtual inline void discard(ssize_t num_bytes) {
+		file.discard(num_bytes);
+	}
+
+	virtual inline int add_pid(int pid) {
+		return 0; //all pids in the file are returned anyway
+	}
+
+	virtual inline int remove_pid(int pid) {
+		return 0;
+	}
+
+	virtual std::shared_ptr<stream_reader_t> clone(ssize_t buffer_size=-1) const {
+		return std::make_shared<file_stream_reader_t>(file.filename.c_str(), mux, file.paced, file.speed,
+																									buffer_size < 0 ? file.buffer_size : buffer_size);
+	}
+
+	virtual chdb::any_mux_t stream_mux() const {
+		return mux;
+	}
+
+	virtual void set_current_tp(const chdb::any_mux_t& stream_mux) const {
+	}
+
+	virtual void on_stream_mux_change(const chdb::any_mux_t& stream_mux) {
+		mux = stream_mux;
+	}
+
+	virtual void update_received_si_mux(const std::optional<chdb::any_mux_t>& mux, bool is_bad) {
+	}
+
+	virtual void update_stream_mux_nit(const chdb::any_mux_t& stream_mux) {
+		mux = stream_mux;
+	}
+};
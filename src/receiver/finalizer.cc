@@ -0,0 +1,244 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "finalizer.h"
+#include "mpm.h"
+#include "util/logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <set>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/*
+	Pinned parts are identified by device and inode, so that the same file is recognised whatever path
+	is used to refer to it
+*/
+static std::mutex pinned_mutex;
+static std::multiset<std::pair<dev_t, ino_t>> pinned_inodes;
+
+pinned_parts_t::pinned_parts_t(const std::vector<fs::path>& filenames) {
+	std::scoped_lock lck(pinned_mutex);
+	for (auto& filename : filenames) {
+		int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			dterrorf("Cannot open {}: {}", filename.c_str(), strerror(errno));
+			if (fd >= 0)
+				::close(fd);
+			fd = -1;
+		} else
+			pinned_inodes.insert({st.st_dev, st.st_ino});
+		fds.push_back(fd);
+	}
+}
+
+pinned_parts_t::~pinned_parts_t() {
+	std::scoped_lock lck(pinned_mutex);
+	for (auto fd : fds) {
+		struct stat st;
+		if (fd < 0)
+			continue;
+		if (fstat(fd, &st) == 0) {
+			auto it = pinned_inodes.find({st.st_dev, st.st_ino});
+			if (it != pinned_inodes.end())
+				pinned_inodes.erase(it);
+		}
+		::close(fd);
+	}
+}
+
+bool part_is_pinned(const char* filename) {
+	struct stat st;
+	if (stat(filename, &st) < 0)
+		return false;
+	std::scoped_lock lck(pinned_mutex);
+	return pinned_inodes.count({st.st_dev, st.st_ino}) > 0;
+}
+
+/*
+	copy in the kernel, in large chunks, to report progress and to avoid holding up other i/o for too long.
+	copy_file_range fails with EXDEV across filesystems on older kernels, and on some filesystems
+	(e.g., some network filesystems); sendfile then does the same from the page cache
+*/
+static int copy_data(int src_fd, int dst_fd, int64_t size, std::atomic<int64_t>* num_bytes_done) {
+	constexpr size_t chunk_size = 64 * 1024 * 1024;
+	bool use_sendfile{false};
+	off_t in_offset{0};
+	while (in_offset < size) {
+		auto len = std::min((int64_t)chunk_size, size - in_offset);
+		ssize_t ret;
+		if (!use_sendfile) {
+			off_t out_offset = in_offset;
+			ret = copy_file_range(src_fd, &in_offset, dst_fd, &out_offset, len, 0);
+			if (ret < 0 && in_offset == 0 &&
+					(errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+				dtdebugf("copy_file_range not possible ({}); using sendfile", strerror(errno));
+				use_sendfile = true;
+				continue;
+			}
+		} else
+			ret = sendfile(dst_fd, src_fd, &in_offset, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			dterrorf("Error while copying: {}", strerror(errno));
+			return -1;
+		}
+		if (ret == 0) {
+			dterrorf("File shrunk while copying: {:d} bytes of {:d} copied", in_offset, size);
+			return -1;
+		}
+		if (num_bytes_done)
+			*num_bytes_done += ret;
+	}
+	return 0;
+}
+
+int copy_part(int src_fd, const fs::path& src, const fs::path& dst, std::atomic<int64_t>* num_bytes_done) {
+	struct stat st;
+	if (src_fd < 0 || fstat(src_fd, &st) < 0) {
+		dterrorf("Cannot access {}", src.c_str());
+		return -1;
+	}
+	struct stat src_st;
+	//src may have been removed along with the live buffer; then only the pinned data remains
+	if (stat(src.c_str(), &src_st) == 0 && src_st.st_dev == st.st_dev && src_st.st_ino == st.st_ino) {
+		if (link(src.c_str(), dst.c_str()) == 0) {
+			if (num_bytes_done)
+				*num_bytes_done += st.st_size;
+			return (int)copy_method_t::HARDLINK;
+		}
+		if (errno == EEXIST) {
+			dterrorf("Error hardlinking {} to {}: {}", src.c_str(), dst.c_str(), strerror(errno));
+			return -1;
+		}
+		dtdebugf("Cannot hardlink {} to {}: {}", src.c_str(), dst.c_str(), strerror(errno));
+	}
+	auto tmp = dst;
+	tmp += ".part";
+	int dst_fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (dst_fd < 0) {
+		dterrorf("Cannot create {}: {}", tmp.c_str(), strerror(errno));
+		return -1;
+	}
+	auto method = copy_method_t::REFLINK;
+	int ret = 0;
+	if (ioctl(dst_fd, FICLONE, src_fd) == 0) {
+		if (num_bytes_done)
+			*num_bytes_done += st.st_size;
+	} else {
+		method = copy_method_t::COPY;
+		ret = copy_data(src_fd, dst_fd, st.st_size, num_bytes_done);
+	}
+	if (::close(dst_fd) < 0 && ret == 0) {
+		dterrorf("Error closing {}: {}", tmp.c_str(), strerror(errno));
+		ret = -1;
+	}
+	if (ret == 0 && rename(tmp.c_str(), dst.c_str()) < 0) {
+		dterrorf("Cannot rename {} to {}: {}", tmp.c_str(), dst.c_str(), strerror(errno));
+		ret = -1;
+	}
+	if (ret < 0) {
+		unlink(tmp.c_str());
+		return -1;
+	}
+	dtdebugf("{} {} to {}", method == copy_method_t::REFLINK ? "Reflinked" : "Copied", src.c_str(), dst.c_str());
+	return (int)method;
+}
+
+recording_finalizer_t::recording_finalizer_t()
+	: thread([this]() { run(); }) {}
+
+recording_finalizer_t::~recording_finalizer_t() {
+	stop();
+}
+
+void recording_finalizer_t::stop() {
+	{
+		std::unique_lock lck(mutex);
+		if (stopping)
+			return;
+		stopping = true;
+	}
+	cv.notify_all();
+	thread.join();
+}
+
+void recording_finalizer_t::submit(const mpm_copylist_t& copy_list) {
+	auto job = std::make_shared<job_t>();
+	job->copy_list = std::make_shared<mpm_copylist_t>(copy_list);
+	job->copy_list->pin();
+	job->recording = copy_list.dst_dir.string();
+	job->num_files = copy_list.parts.size();
+	for (auto fd : job->copy_list->pins->fds) {
+		struct stat st;
+		if (fd >= 0 && fstat(fd, &st) == 0)
+			job->num_bytes += st.st_size;
+	}
+	{
+		std::unique_lock lck(mutex);
+		jobs.push_back(job);
+	}
+	cv.notify_one();
+}
+
+std::vector<finalizer_progress_t> recording_finalizer_t::get_progress() {
+	std::vector<finalizer_progress_t> ret;
+	std::unique_lock lck(mutex);
+	for (auto& job : jobs)
+		ret.push_back(finalizer_progress_t{job->recording, job->num_files, job->num_files_done, job->num_bytes,
+				job->num_bytes_done, job->num_errors, job->done});
+	return ret;
+}
+
+void recording_finalizer_t::run() {
+	pthread_setname_np(pthread_self(), "finalizer");
+	for (;;) {
+		std::shared_ptr<job_t> job;
+		{
+			std::unique_lock lck(mutex);
+			//jobs are only abandoned at exit once all of them are finished
+			cv.wait(lck, [this]() { return stopping || num_finished_jobs < (int)jobs.size(); });
+			if (num_finished_jobs == (int)jobs.size())
+				break; // stopping
+			job = jobs[num_finished_jobs];
+		}
+		dtdebugf("Finalizing {}: {:d} parts, {:d} bytes", job->recording, job->num_files, job->num_bytes);
+		job->num_errors = job->copy_list->run(&job->num_files_done, &job->num_bytes_done);
+		if (job->num_errors > 0)
+			dterrorf("Finalizing {}: {:d} of {:d} parts could not be copied", job->recording,
+							 (int)job->num_errors, job->num_files);
+		job->copy_list.reset(); // releases the pinned parts
+		job->done = true;
+		std::unique_lock lck(mutex);
+		if (++num_finished_jobs > max_finished_jobs) {
+			jobs.pop_front();
+			--num_finished_jobs;
+		}
+	}
+}
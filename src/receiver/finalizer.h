@@ -0,0 +1,110 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct mpm_copylist_t;
+
+/*!
+	Source parts of a recording which are being linked or copied into the recording's directory.
+	The parts are kept open, so that their data remains available even when the live buffer is removed.
+	As long as they are pinned, active_mpm_t::delete_old_data neither removes nor reuses them.
+*/
+struct pinned_parts_t {
+	std::vector<int> fds; //-1 for parts which could not be opened
+
+	pinned_parts_t(const std::vector<std::filesystem::path>& filenames);
+	pinned_parts_t(const pinned_parts_t& other) = delete;
+	~pinned_parts_t();
+};
+
+bool part_is_pinned(const char* filename);
+
+enum class copy_method_t { HARDLINK, REFLINK, COPY };
+
+/*!
+	Make dst a copy of src, which is also open as src_fd, using the fastest method which works:
+	a hard link, a reflink (FICLONE; only on filesystems sharing extents, such as btrfs or xfs)
+	or a copy in the kernel (copy_file_range, or sendfile across filesystems where that fails).
+	Copies are made under a temporary name and renamed when complete.
+	num_bytes_done is increased while copying. Returns -1 on error
+*/
+int copy_part(int src_fd, const std::filesystem::path& src, const std::filesystem::path& dst,
+							std::atomic<int64_t>* num_bytes_done = nullptr);
+
+struct finalizer_progress_t {
+	std::string recording; //directory of the recording
+	int num_files{0};
+	int num_files_done{0};
+	int64_t num_bytes{0};
+	int64_t num_bytes_done{0};
+	int num_errors{0};
+	bool done{false};
+};
+
+/*!
+	Links or copies the parts of finished recordings from the live buffer into the recordings directory
+	in a background thread, so that a slow copy (e.g., when recordings are on another filesystem than the
+	live buffer) does not hold up the recmgr or tuner threads. Jobs are executed in order of submission.
+*/
+class recording_finalizer_t {
+	struct job_t {
+		std::shared_ptr<mpm_copylist_t> copy_list;
+		std::string recording;
+		int num_files{0};
+		int64_t num_bytes{0};
+		std::atomic<int> num_files_done{0};
+		std::atomic<int64_t> num_bytes_done{0};
+		std::atomic<int> num_errors{0};
+		std::atomic<bool> done{false};
+	};
+	static constexpr int max_finished_jobs = 8; //finished jobs kept for reporting
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::shared_ptr<job_t>> jobs; //finished, running and queued, in this order
+	int num_finished_jobs{0};
+	bool stopping{false};
+	std::thread thread;
+
+	void run();
+
+public:
+	recording_finalizer_t();
+	~recording_finalizer_t();
+
+	void submit(const mpm_copylist_t& copy_list);
+
+	//queued, running and recently finished jobs
+	std::vector<finalizer_progress_t> get_progress();
+
+	//finishes all submitted jobs before returning
+	void stop();
+};
@@ -0,0 +1,495 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "indexrebuild.h"
+#include "mpm.h"
+#include "streamparser/psi.h"
+#include "streamparser/tsprescan.h"
+#include "util/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <errno.h>
+#include <fcntl.h>
+#include <optional>
+#include <pthread.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static constexpr int read_size = 32 * 1024 * 188; //approx. 6 MByte
+static constexpr int max_clear_gap = 1000; //clear packets allowed inside an undecrypted region
+static constexpr int64_t max_part_gap_ms = 1000; //larger pcr jumps between parts are discontinuities
+
+/*
+	Continuity counter check of one part. The first and last counter of each pid are kept, so that
+	continuity between consecutive parts can be checked after all parts have been scanned
+*/
+struct cc_check_t {
+	std::vector<int8_t> first_cc = std::vector<int8_t>(8192, -1);
+	std::vector<int8_t> last_cc = std::vector<int8_t>(8192, -1);
+	std::vector<bool> last_was_duplicate = std::vector<bool>(8192, false);
+	int64_t num_errors{0};
+
+	void update(const dtdemux::ts_prescan_t& s, const uint8_t* buffer);
+};
+
+void cc_check_t::update(const dtdemux::ts_prescan_t& s, const uint8_t* buffer) {
+	for (int i = 0; i < s.size(); ++i) {
+		auto pid = s.pids[i];
+		//the counter only increases in packets with payload
+		if (pid == null_pid || !s.has_payload(i) || s.has_transport_error(i))
+			continue;
+		auto cc = s.ccs[i];
+		auto* p = buffer + s.offsets[i];
+		bool discontinuity = s.has_adaptation(i) && p[4] > 0 && (p[5] & 0x80);
+		auto& last = last_cc[pid];
+		if (first_cc[pid] < 0)
+			first_cc[pid] = cc;
+		else if (discontinuity)
+			;
+		else if (cc == last) {
+			//one duplicate packet is allowed
+			if (last_was_duplicate[pid])
+				++num_errors;
+			last_was_duplicate[pid] = !last_was_duplicate[pid];
+			continue;
+		} else if (cc != ((last + 1) & 0xf))
+			++num_errors;
+		last_was_duplicate[pid] = false;
+		last = cc;
+	}
+}
+
+struct pmt_change_t {
+	int64_t packetno; //last packet of the pmt, relative to the start of the part
+	milliseconds_t stream_time; //relative to the first pcr in the part
+	dtdemux::pmt_info_t pmt;
+	ss::bytebuffer<256> sec_data;
+};
+
+struct part_scan_t {
+	fs::path path;
+	int fileno{-1};
+	time_t real_time_start{0};
+	int64_t num_packets{0};
+	int64_t num_bytes_skipped{0};
+
+	//packetnos and times relative to the start of the part
+	std::vector<recdb::marker_t> markers;
+	std::vector<pmt_change_t> pmts;
+	std::vector<std::pair<int64_t, int64_t>> scrambled_regions;
+	int64_t num_scrambled_packets{0};
+	cc_check_t cc_check;
+
+	dtdemux::pcr_t first_pcr;
+	dtdemux::pcr_t last_pcr;
+	milliseconds_t end_time{0}; //play time of last_pcr
+	bool mux_capture{false}; //part also contains pids of other services
+	std::string error;
+
+	void scan(int service_id);
+	void scan_(int service_id);
+};
+
+/*
+	Extract fileno and start time from a part's name, as created by relfilename in live_mpm.cc
+*/
+static bool parse_part_name(const std::string& name, int& fileno, time_t& real_time_start) {
+	int n{0};
+	if (sscanf(name.c_str(), "%d_%n", &fileno, &n) != 1 || n == 0)
+		return false;
+	struct tm tm {};
+	auto* end = strptime(name.c_str() + n, "%Y%m%d_%T", &tm);
+	if (!end || strcmp(end, ".ts") != 0)
+		return false;
+	tm.tm_isdst = -1;
+	real_time_start = mktime(&tm);
+	return true;
+}
+
+void part_scan_t::scan(int service_id) {
+	try {
+		scan_(service_id);
+	} catch (const std::exception& e) {
+		error = e.what();
+	}
+	if (!error.empty())
+		dterrorf("Error scanning {}: {}", path.c_str(), error);
+}
+
+/*
+	Parse one part in the same way as active_mpm_t does while recording: PAT, then the service's PMT, and
+	then the pcr pid, which produces the markers. service_id < 0 selects the service of the first PMT found
+*/
+void part_scan_t::scan_(int service_id) {
+	using namespace dtdemux;
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		error = fmt::format("Cannot open: {}", strerror(errno));
+		return;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	//declared before stream_parser, which holds callbacks referring to them
+	std::vector<uint16_t> pmt_pids;
+	ts_prescan_t prescan;
+	std::vector<uint8_t> buffer(read_size);
+
+	ts_stream_t stream_parser;
+	stream_parser.event_handler.collected_markers = &markers;
+	stream_parser.set_batch_dispatch(true);
+	stream_parser.header_only_indexing = true;
+
+	auto on_pmt = [this, &stream_parser, &service_id](pmt_parser_t* parser, const pmt_info_t& pmt, bool isnext,
+																										 const ss::bytebuffer_& sec_data) {
+		using namespace stream_type;
+		if (isnext)
+			return reset_type_t::NO_RESET;
+		if (service_id < 0)
+			service_id = pmt.service_id;
+		if (pmt.service_id != service_id) //several services can share a pmt pid
+			return reset_type_t::NO_RESET;
+		for (const auto& pidinfo : pmt.pid_descriptors) {
+			if (pmt.pcr_pid != pidinfo.stream_pid)
+				continue;
+			if (is_video(pidinfo.stream_type))
+				stream_parser.register_video_pids(pmt.service_id, pidinfo.stream_pid, pmt.pcr_pid, pidinfo.stream_type);
+			else if (is_audio(pidinfo))
+				stream_parser.register_audio_pids(pmt.service_id, pidinfo.stream_pid, pmt.pcr_pid, pidinfo.stream_type);
+		}
+		if (pmts.empty() || pmts.back().sec_data != sec_data) {
+			pmt_change_t c{(int64_t)pmt.stream_packetno_end, stream_parser.event_handler.last_saved_marker.k.time, pmt};
+			c.sec_data = sec_data;
+			pmts.push_back(c);
+		}
+		return reset_type_t::NO_RESET;
+	};
+
+	auto pat_parser = stream_parser.register_pat_pid();
+	pat_parser->section_cb = [&](const pat_services_t& pat_services, const subtable_info_t& i) {
+		for (const auto& e : pat_services.entries) {
+			if (e.service_id == 0 || (service_id >= 0 && e.service_id != service_id) ||
+					std::find(pmt_pids.begin(), pmt_pids.end(), e.pmt_pid) != pmt_pids.end())
+				continue;
+			pmt_pids.push_back(e.pmt_pid);
+			auto pmt_parser = stream_parser.register_pmt_pid(e.pmt_pid, e.service_id);
+			pmt_parser->section_cb = on_pmt;
+		}
+		return reset_type_t::NO_RESET;
+	};
+
+	int64_t pos = 0;
+	for (;;) {
+		int len = 0;
+		while (len < read_size) {
+			auto ret = pread(fd, buffer.data() + len, read_size - len, pos + len);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0) {
+				error = fmt::format("Read error at {:d}: {}", pos + len, strerror(errno));
+				break;
+			}
+			if (ret == 0)
+				break;
+			len += ret;
+		}
+		auto num_bytes = len - len % ts_packet_t::size;
+		if (num_bytes == 0) {
+			num_bytes_skipped += len;
+			break;
+		}
+		prescan.clear();
+		prescan_ts_packets(buffer.data(), num_bytes, prescan);
+		num_bytes_skipped += prescan.num_bytes_skipped;
+		cc_check.update(prescan, buffer.data());
+		for (int i = 0; i < prescan.size(); ++i) {
+			if (!prescan.is_encrypted(i))
+				continue;
+			auto packetno = (pos + prescan.offsets[i]) / ts_packet_t::size;
+			++num_scrambled_packets;
+			if (!scrambled_regions.empty() && packetno - scrambled_regions.back().second <= max_clear_gap)
+				scrambled_regions.back().second = packetno + 1;
+			else
+				scrambled_regions.push_back({packetno, packetno + 1});
+		}
+
+		stream_parser.set_buffer(buffer.data(), num_bytes);
+		stream_parser.parse();
+		pos += num_bytes;
+		if (len < read_size || !error.empty()) {
+			num_bytes_skipped += len - num_bytes;
+			break;
+		}
+	}
+	::close(fd);
+
+	num_packets = pos / ts_packet_t::size;
+	auto& event_handler = stream_parser.event_handler;
+	first_pcr = event_handler.first_pcr;
+	last_pcr = event_handler.get_last_pcr();
+	if (event_handler.ref_pcr_inited)
+		end_time = event_handler.pcr_play_time_();
+
+	/*a live buffer of a single service only receives the pat, the pmt, the pcr pid and the pids of the
+		service's streams; any other pid (with payload) means that the part was written by a mux capture*/
+	if (!pmts.empty()) {
+		std::vector<bool> service_pids(8192, false);
+		service_pids[ts_stream_t::PAT_PID] = true;
+		service_pids[null_pid] = true;
+		for (const auto& c : pmts) {
+			service_pids[c.pmt.pmt_pid] = true;
+			service_pids[c.pmt.pcr_pid] = true;
+			for (const auto& pidinfo : c.pmt.pid_descriptors)
+				service_pids[pidinfo.stream_pid] = true;
+		}
+		for (int pid = 0; pid < 8192 && !mux_capture; ++pid)
+			mux_capture = cc_check.first_cc[pid] >= 0 && !service_pids[pid];
+	}
+}
+
+/*
+	Time of the last marker at or before packetno
+*/
+static milliseconds_t time_for_packetno(const std::vector<recdb::marker_t>& markers, int64_t packetno) {
+	auto it = std::upper_bound(markers.begin(), markers.end(), packetno,
+														 [](int64_t p, const recdb::marker_t& m) { return p < (int64_t)m.packetno_start; });
+	return it == markers.begin() ? milliseconds_t(0) : std::prev(it)->k.time;
+}
+
+index_rebuild_report_t rebuild_recording_index(const fs::path& recording_dir, int num_threads, bool write_index) {
+	using namespace recdb;
+	auto start = std::chrono::steady_clock::now();
+	index_rebuild_report_t report;
+	report.recording = recording_dir.string();
+
+	std::vector<part_scan_t> parts;
+	{
+		std::error_code ec;
+		for (const auto& entry : fs::directory_iterator(recording_dir, ec)) {
+			part_scan_t part;
+			if (!entry.is_regular_file() ||
+					!parse_part_name(entry.path().filename().string(), part.fileno, part.real_time_start))
+				continue;
+			part.path = entry.path();
+			report.num_bytes += entry.file_size();
+			parts.push_back(std::move(part));
+		}
+		if (ec) {
+			report.error = fmt::format("Cannot list {}: {}", report.recording, ec.message());
+			return report;
+		}
+	}
+	std::sort(parts.begin(), parts.end(), [](const part_scan_t& a, const part_scan_t& b) { return a.fileno < b.fileno; });
+	report.num_parts = parts.size();
+	if (parts.empty()) {
+		report.error = fmt::format("No parts found in {}", report.recording);
+		return report;
+	}
+
+	auto dbdir = recording_dir / "index.mdb";
+	std::optional<rec_t> old_rec;
+	std::map<int, bool> old_mux_capture; //fileno -> mux_capture of the parts in the old index
+	try {
+		mpm_index_t old_index(dbdir.c_str());
+		if (fs::exists(dbdir)) {
+			old_index.open_index();
+			auto txn = old_index.mpm_rec.recdb.rtxn();
+			auto c = find_first<rec_t>(txn);
+			if (c.is_valid())
+				old_rec = c.current();
+			auto idx_txn = old_index.mpm_rec.idxdb.rtxn();
+			auto cf = find_first<file_t>(idx_txn);
+			for (const auto& f : cf.range())
+				old_mux_capture[f.fileno] = f.mux_capture;
+			idx_txn.abort();
+			txn.abort();
+		}
+	} catch (...) {
+		dterrorf("Cannot read old index of {}", report.recording);
+	}
+	int service_id = old_rec ? old_rec->service.k.service_id : -1;
+
+	if (num_threads <= 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	report.num_threads = std::min(num_threads, (int)parts.size());
+	{
+		std::atomic<int> next_part{0};
+		std::vector<std::thread> threads;
+		for (int i = 0; i < report.num_threads; ++i)
+			threads.emplace_back([&]() {
+				pthread_setname_np(pthread_self(), "indexrebuild");
+				for (int k; (k = next_part++) < (int)parts.size();)
+					parts[k].scan(service_id);
+			});
+		for (auto& t : threads)
+			t.join();
+	}
+
+	/*join the parts: packet numbers continue where the previous part ended; play time continues after the last
+		pcr of the previous part, with the pcr difference between that pcr and the first pcr of the next part added,
+		unless they are too far apart*/
+	std::vector<file_t> files;
+	std::vector<marker_t> markers;
+	std::vector<stream_descriptor_t> stream_descriptors;
+	std::vector<std::pair<int64_t, int64_t>> scrambled_regions;
+	const ss::bytebuffer<256>* last_sec_data{nullptr};
+	milliseconds_t time_offset{0};
+	int64_t packetno_offset{0};
+	for (int k = 0; k < (int)parts.size(); ++k) {
+		auto& part = parts[k];
+		if (!part.error.empty()) {
+			report.error = fmt::format("{}: {}", part.path.filename().string(), part.error);
+			break;
+		}
+		if (k > 0) {
+			auto& prev = parts[k - 1];
+			time_offset += prev.end_time;
+			if (prev.last_pcr.is_valid() && part.first_pcr.is_valid()) {
+				auto gap = (part.first_pcr - prev.last_pcr).milliseconds();
+				if (gap >= milliseconds_t(0) && gap <= milliseconds_t(max_part_gap_ms))
+					time_offset += gap;
+			}
+			for (int pid = 0; pid < 8192; ++pid) {
+				auto last = prev.cc_check.last_cc[pid];
+				auto first = part.cc_check.first_cc[pid];
+				if (last >= 0 && first >= 0 && first != last && first != ((last + 1) & 0xf))
+					++report.num_cc_errors;
+			}
+		}
+		report.num_cc_errors += part.cc_check.num_errors;
+		report.num_packets += part.num_packets;
+		report.num_bytes_skipped += part.num_bytes_skipped;
+		report.num_scrambled_packets += part.num_scrambled_packets;
+
+		file_t f;
+		f.k.stream_time_start = time_offset;
+		f.fileno = part.fileno;
+		f.stream_time_end = time_offset + part.end_time;
+		f.real_time_start = part.real_time_start;
+		f.real_time_end = k + 1 < (int)parts.size() ? parts[k + 1].real_time_start
+			: part.real_time_start + int64_t(part.end_time) / 1000;
+		f.stream_packetno_start = packetno_offset;
+		f.stream_packetno_end = packetno_offset + part.num_packets;
+		f.filename = part.path.filename().c_str();
+		auto it = old_mux_capture.find(part.fileno);
+		f.mux_capture = it == old_mux_capture.end() ? part.mux_capture : it->second;
+		files.push_back(f);
+
+		for (auto m : part.markers) {
+			m.k.time += time_offset;
+			//markers are keyed on time, and a later marker must not overwrite an earlier one
+			if (!markers.empty() && m.k.time <= markers.back().k.time)
+				m.k.time = markers.back().k.time + milliseconds_t(1);
+			m.packetno_start += packetno_offset;
+			m.packetno_end += packetno_offset;
+			markers.push_back(m);
+		}
+
+		for (auto& c : part.pmts) {
+			if (last_sec_data && *last_sec_data == c.sec_data)
+				continue;
+			last_sec_data = &c.sec_data;
+			auto stream_time = c.stream_time + time_offset;
+			stream_descriptors.push_back(stream_descriptor_t(
+																		 c.packetno + packetno_offset,
+																		 part.real_time_start + int64_t(c.stream_time) / 1000, stream_time, c.pmt.pmt_pid,
+																		 c.pmt.audio_languages(), c.pmt.subtitle_languages(), c.sec_data));
+		}
+
+		for (auto [s, e] : part.scrambled_regions) {
+			if (!scrambled_regions.empty() && s + packetno_offset - scrambled_regions.back().second <= max_clear_gap)
+				scrambled_regions.back().second = e + packetno_offset;
+			else
+				scrambled_regions.push_back({s + packetno_offset, e + packetno_offset});
+		}
+		packetno_offset += part.num_packets;
+	}
+	if (!report.error.empty()) {
+		report.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return report;
+	}
+	report.num_markers = markers.size();
+	report.num_stream_descriptors = stream_descriptors.size();
+	report.duration = int64_t(files.back().stream_time_end);
+	for (auto [s, e] : scrambled_regions)
+		report.undecrypted_regions.push_back({s, e, int64_t(time_for_packetno(markers, s)),
+				int64_t(time_for_packetno(markers, e))});
+
+	if (write_index) {
+		rec_t rec;
+		if (old_rec)
+			rec = *old_rec;
+		else {
+			dterrorf("No recording found in old index of {}; creating one", report.recording);
+			rec.real_time_start = files.front().real_time_start;
+			rec.real_time_end = files.back().real_time_end;
+			rec.filename = recording_dir.filename().c_str();
+		}
+		rec.stream_time_start = markers.empty() ? milliseconds_t(0) : markers.front().k.time;
+		rec.stream_time_end = markers.empty() ? milliseconds_t(0) : markers.back().k.time;
+
+		auto newdir = recording_dir / "index.mdb.new";
+		auto olddir = recording_dir / "index.mdb.old";
+		std::error_code ec;
+		fs::remove_all(newdir, ec);
+		if (!mkpath(newdir.c_str())) {
+			report.error = fmt::format("Could not create dir {}", newdir.c_str());
+			return report;
+		}
+		try {
+			mpm_index_t recidx(newdir.c_str());
+			recidx.open_index();
+			auto rec_txn = recidx.mpm_rec.recdb.wtxn();
+			put_record(rec_txn, rec);
+			auto idx_txn = rec_txn.child_txn(recidx.mpm_rec.idxdb);
+			for (const auto& f : files)
+				put_record(idx_txn, f);
+			for (const auto& m : markers)
+				put_record(idx_txn, m);
+			for (const auto& sd : stream_descriptors)
+				put_record(idx_txn, sd);
+			idx_txn.commit();
+			rec_txn.commit();
+		} catch (const std::exception& e) {
+			report.error = fmt::format("Could not write index: {}", e.what());
+			return report;
+		}
+		fs::remove_all(olddir, ec);
+		if (fs::exists(dbdir))
+			fs::rename(dbdir, olddir, ec);
+		if (!ec)
+			fs::rename(newdir, dbdir, ec);
+		if (ec) {
+			report.error = fmt::format("Could not replace index: {}", ec.message());
+			return report;
+		}
+		report.index_written = true;
+	}
+	report.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	dtinfof("Rebuilt index of {}: {:d} parts, {:d} markers, {:d} cc errors, {:d} undecrypted regions in {:.1f}s",
+					report.recording, report.num_parts, report.num_markers, report.num_cc_errors,
+					report.undecrypted_regions.size(), report.elapsed);
+	return report;
+}
@@ -0,0 +1,72 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <filesystem>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "util/util.h"
+
+/*!
+	Range of packets in a recording, e.g., a region which could not be descrambled
+*/
+struct index_rebuild_region_t {
+	int64_t packetno_start{0};
+	int64_t packetno_end{0}; //one past the last packet
+	int64_t stream_time_start{0}; //in milliseconds; time of the nearest marker at or before the region
+	int64_t stream_time_end{0};
+};
+
+struct index_rebuild_report_t {
+	std::string recording; //directory of the recording
+	std::string error; //empty on success
+	bool index_written{false};
+	int num_threads{0};
+	int num_parts{0};
+	int64_t num_packets{0};
+	int64_t num_bytes{0};
+	int64_t num_bytes_skipped{0}; //bytes not part of a packet: sync loss, or a part not ending on a packet boundary
+	int num_markers{0};
+	int num_stream_descriptors{0};
+	int64_t num_cc_errors{0}; //including discontinuities between consecutive parts
+	int64_t num_scrambled_packets{0};
+	std::vector<index_rebuild_region_t> undecrypted_regions;
+	int64_t duration{0}; //play time of the recording in milliseconds
+	double elapsed{0}; //seconds taken by the scan
+};
+
+/*!
+	Regenerate the index (index.mdb) of a recording from its parts (NN_YYYYmmdd_HH:MM:SS.ts), e.g., when it
+	has been lost or is corrupt.
+
+	The parts are scanned in parallel, one part per thread, with num_threads threads (0: one per core).
+	Each part is parsed by its own indexer, which starts from the first PAT/PMT in that part; the play times
+	of the parts are then joined using the PCRs at the end of each part and the start of the next one.
+	The rec_t of the old index is kept if it can still be read; otherwise a minimal one is created.
+
+	The new index is written in a single transaction to index.mdb.new, which then replaces index.mdb; the
+	old index is kept as index.mdb.old. If write_index is false, the recording is only checked.
+
+	Packet numbers in the new index start at 0. As the indexers of the parts cannot see a frame which is
+	split over two parts, the first frame of each part usually gets no marker.
+*/
+EXPORT index_rebuild_report_t rebuild_recording_index(const std::filesystem::path& recording_dir,
+																											int num_threads = 0, bool write_index = true);
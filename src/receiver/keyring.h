@@ -0,0 +1,147 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+/*!
+	Control words handed from the scam thread (the only producer) to a service thread
+	(the only consumer), normally without locking.
+
+	The producer pushes keys into a small queue and never waits for the consumer. The consumer
+	moves them into a history of num_keys keys, in which the n-th key ever pushed has index
+	n % num_keys. Descrambling contexts refer to keys by that index, so a key stays valid
+	until num_keys more keys have been received.
+
+	If the consumer falls behind and the queue is full, keys are appended to an overflow list
+	protected by a mutex, until the consumer has received them all. No key is ever dropped.
+
+	key_t must have the fields parity, valid and request_bytepos
+*/
+template <typename key_t, int num_keys_ = 256, int queue_size = 32> class key_ring_t {
+	static_assert((num_keys_ & (num_keys_ - 1)) == 0 && (queue_size & (queue_size - 1)) == 0,
+								"sizes must be powers of 2");
+	static_assert(queue_size < num_keys_, "keys would be overwritten before they are seen");
+
+	key_t queue[queue_size];
+	alignas(64) std::atomic<uint32_t> head{0}; //number of keys pushed; written by the producer only
+	alignas(64) std::atomic<uint32_t> tail{0}; //number of keys popped; written by the consumer only
+
+	//owned by the producer
+	uint32_t num_pushed{0};
+
+	//keys which did not fit in the queue, and the keys pushed after them
+	std::mutex overflow_mutex;
+	std::vector<key_t> overflow;
+	std::atomic<bool> overflowing{false};
+
+	//owned by the consumer
+	key_t keys[num_keys_];
+	uint32_t num_received{0};
+	int last_received_idx{-1};
+
+	void receive_queued() {
+		auto t = tail.load(std::memory_order_relaxed);
+		auto h = head.load(std::memory_order_acquire);
+		for (auto i = t; i != h; ++i)
+			receive_one(queue[i % queue_size]);
+		tail.store(h, std::memory_order_release);
+	}
+
+	inline void receive_one(const key_t& key) {
+		last_received_idx = num_received++ % num_keys;
+		keys[last_received_idx] = key;
+	}
+
+public:
+	static constexpr int num_keys = num_keys_;
+
+	/*!
+		Called by the producer. Returns the index the key will have in the history
+	*/
+	int push(const key_t& key) {
+		auto h = head.load(std::memory_order_relaxed);
+		if (!overflowing.load(std::memory_order_acquire) && h - tail.load(std::memory_order_acquire) != queue_size) {
+			queue[h % queue_size] = key;
+			head.store(h + 1, std::memory_order_release);
+		} else {
+			/*once a key has overflowed, later keys must overflow as well, until the consumer has received
+				them, or they would be received out of order*/
+			std::scoped_lock lck(overflow_mutex);
+			overflow.push_back(key);
+			overflowing.store(true, std::memory_order_release);
+		}
+		return num_pushed++ % num_keys;
+	}
+
+	/*!
+		Called by the consumer: move all pushed keys into the history.
+		Returns the number of new keys
+	*/
+	int receive() {
+		auto n = num_received;
+		receive_queued();
+		if (overflowing.load(std::memory_order_acquire)) {
+			std::scoped_lock lck(overflow_mutex);
+			receive_queued(); //keys queued before the first overflowing key
+			for (const auto& key : overflow)
+				receive_one(key);
+			overflow.clear();
+			overflowing.store(false, std::memory_order_release);
+		}
+		return num_received - n;
+	}
+
+	inline const key_t& operator[](int idx) const {
+		return keys[idx];
+	}
+
+	inline int last_received_key_idx() const {
+		return last_received_idx;
+	}
+
+	/*!
+		Called by the consumer: search the received keys, starting at key_idx, for the first key
+		with the given parity. A key requested after bytepos (i.e., meant for a later parity period)
+		stops the search, unless allow_future_key is set.
+
+		Returns the index of the key,
+		or -1 if no key starting at key_idx has been received yet,
+		or -2 if the next keys have the wrong parity or are meant for the future
+	*/
+	int find_key(int key_idx, int parity, int64_t bytepos, bool allow_future_key) const {
+		auto start = key_idx % num_keys; // we may need to reuse the last key
+		auto end = (last_received_idx + 1) % num_keys;
+		if (start == end)
+			return -1;
+		/// loop over all keys, starting with the oldest (circular buffer)
+		for (int idx = start; idx != end; idx = (idx + 1) % num_keys) {
+			auto& key = keys[idx];
+			if (key.request_bytepos > bytepos && !allow_future_key)
+				break; // this can also happen at start, if keys are wrongly ordered
+			if (key.valid && parity == key.parity)
+				return idx;
+		}
+		return -2;
+	}
+};
@@ -19,18 +19,21 @@
  */
 #include "active_service.h"
 #include "mpm.h"
+#include "muxcapture.h"
 #include "receiver.h"
 #include "util/dtassert.h"
 #include "util/logger.h"
 #include "util/util.h"
 #include <atomic>
 #include <errno.h>
+#include <fcntl.h>
 #include <filesystem>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "fmt/chrono.h"
 using namespace std::chrono;
@@ -222,6 +225,27 @@ active_mpm_t::active_mpm_t(active_service_t* parent_, system_time_t now)
 	using namespace dtdemux;
 	dirname = make_dirname(parent_, now);
 	file_time_limit = active_service->receiver.options.readAccess()->livebuffer_mpm_part_duration;
+	mux_view = std::dynamic_pointer_cast<mux_view_reader_t>(active_service->reader);
+	{
+		auto r = active_service->receiver.options.readAccess();
+		dvbcsa.cache.set_num_workers(r->descrambling_threads);
+		decrypt_scheduler.latency_target = r->descrambling_latency_target;
+		//parts of a mux capture are shared with other live buffers and cannot be reused
+		max_spare_files = mux_view ? 0 : r->livebuffer_spare_parts;
+		stream_parser.event_handler.max_marker_delay = r->livebuffer_index_commit_delay;
+		if (r->livebuffer_use_io_uring && !mux_view) {
+			uring_writer = std::make_unique<uring_writer_t>();
+			if (!uring_writer->is_valid()) {
+				dterrorf("io_uring not available; writing live buffer through mmap");
+				uring_writer.reset();
+			}
+		}
+	}
+	/*resume each parser once per buffer instead of once per packet; the event handler then combines the
+		markers with the pat and pmt positions in stream order at the end of each buffer*/
+	stream_parser.set_batch_dispatch(true);
+	//only the frame type of each pes packet is needed for indexing
+	stream_parser.header_only_indexing = true;
 	active_service->pat_parser = stream_parser.register_pat_pid();
 	active_service->pat_parser->section_cb = [this](const pat_services_t& pat_services, const subtable_info_t& i) {
 		assert(!i.timedout);
@@ -281,7 +305,8 @@ void active_mpm_t::create() {
 		throw std::runtime_error("Failed to create live buffer");
 	}
 	db->open_index();
-	if (next_data_file(creation_time, 0) < 0)
+	//with a mux capture, the first file is linked when the capture has started
+	if (!mux_view && next_data_file(creation_time, 0) < 0)
 		throw std::runtime_error("Failed to create live buffer");
 }
 
@@ -299,6 +324,12 @@ void active_mpm_t::destroy() {
 */
 
 void active_mpm_t::transfer_filemap(int fd, int64_t new_num_bytes_safe_to_read) {
+	if (uring_writer) {
+		auto num_bytes_processed = new_num_bytes_safe_to_read -
+			current_file_stream_packetno_start * (int64_t)ts_packet_t::size - uring_writer->offset;
+		uring_writer->transfer(fd, num_bytes_processed);
+		return;
+	}
 	mmap_t newfilemap(filemap.map_len, false);
 	// fd will be owned by filemap
 	newfilemap.init(fd, 0);
@@ -376,39 +407,26 @@ static inline int overlap_duration(int a1, int a2, int b1, int b2) {
 	return right - left;
 }
 
-void mpm_copylist_t::run() {
-	auto mpm_db = dst_dir / "index.mdb";
-	mpm_index_t mpmidx(mpm_db.c_str());
-	mpmidx.open_index();
-	auto txn = mpmidx.mpm_rec.idxdb.rtxn();
-	run(txn);
-	txn.abort();
+void mpm_copylist_t::pin() {
+	if (pins)
+		return;
+	std::vector<fs::path> filenames;
+	for (auto& part : parts)
+		filenames.push_back(part.src);
+	pins = std::make_shared<pinned_parts_t>(filenames);
 }
 
-void mpm_copylist_t::run(db_txn& txn) {
-	std::error_code ec;
-	auto dbdir = dst_dir / "index.mdb"; // location of the recording's database
-	// open the recording database in the mpm
-	using namespace recdb;
-	auto c = find_first<recdb::file_t>(txn);
-	for (auto file : c.range()) {
-		if (file.fileno < fileno_offset)
-			continue;
-		auto& dstfname = file.filename;
-		auto f = file;
-		f.fileno -= fileno_offset;
-		auto srcfname = ::relfilename(f);
-		auto src = src_dir / srcfname.c_str();
-		auto dst = dst_dir / dstfname.c_str();
-		fs::create_hard_link(src, dst, ec); /*
-																					TODO: tis part could be too slow in some cases (especially if link is replaced
-																					by copy) In that case, the linking can be done in another thread provided the
-																					rec_t record is not deleted in the livebuffer yet. This prevents the
-																					recording's data from being deleted before it is linked/copied*/
-		if (ec) {
-			dterrorf("Error hardlinking {} to {}: {}", src.c_str(), dst.c_str(), ec.message());
-		}
+int mpm_copylist_t::run(std::atomic<int>* num_files_done, std::atomic<int64_t>* num_bytes_done) {
+	pin();
+	int num_errors{0};
+	for (int i = 0; i < (int)parts.size(); ++i) {
+		auto& part = parts[i];
+		if (copy_part(pins->fds[i], part.src, part.dst, num_bytes_done) < 0)
+			++num_errors;
+		if (num_files_done)
+			++*num_files_done;
 	}
+	return num_errors;
 }
 
 /*
@@ -476,6 +494,7 @@ int finalize_recording(db_txn& livebuffer_idxdb_rtxn, mpm_copylist_t& copy_comma
 			stream_time_end = f.stream_time_end;
 			auto real_time_end = f.real_time_end;
 			if (overlap_duration(start, end, f.real_time_start, real_time_end) > 0) {
+				auto src = copy_command.src_dir / f.filename.c_str();
 				if (int64_t(stream_time_start) < 0) {
 					stream_time_start = f.k.stream_time_start;
 				}
@@ -505,7 +524,7 @@ int finalize_recording(db_txn& livebuffer_idxdb_rtxn, mpm_copylist_t& copy_comma
 #endif
 				put_record(idx_txn, f);
 				// put the file in the recording's filesystem directory
-				// copy_command.filenames.push_back(f.filename.c_str());
+				copy_command.parts.push_back({src, destdir / f.filename.c_str()});
 			}
 		}
 	}
@@ -571,7 +590,9 @@ int active_mpm_t::stop_recording(const recdb::rec_t& rec_in, mpm_copylist_t& cop
 	}
 	rec1_txn.abort();
 	{
-		auto ret = next_data_file(now, -1);
+		/*with a mux capture, the next part of the capture may not exist yet; the current part then
+			remains in use, and only its record is finalised for the recording*/
+		auto ret = mux_view ? finalise_current_file_record(now) : next_data_file(now, -1);
 		dtdebugf("Closed last mpm part as part of ending recording ret={:d}", ret);
 	}
 	assert(num_recordings_in_progress > 0);
@@ -596,6 +617,11 @@ int active_mpm_t::stop_recording(const recdb::rec_t& rec_in, mpm_copylist_t& cop
 	auto livebuffer_idxdb_rtxn = db->mpm_rec.idxdb.rtxn(); // for accessing the livebuffer's database
 	::finalize_recording(	livebuffer_idxdb_rtxn, copy_command, db.get());
 	livebuffer_idxdb_rtxn.abort();
+	if (mux_view)
+		reopen_current_file_record();
+	/*the parts are copied in the background, after the recording has been removed from the live buffer,
+		so protect them from delete_old_data*/
+	copy_command.pin();
 	return 0;
 }
 
@@ -647,7 +673,7 @@ void active_mpm_t::update_recordings(db_txn& parent_txn, system_time_t now) {
 }
 
 void active_mpm_t::self_check(meta_marker_t& m) {
-	assert(m.num_bytes_safe_to_read >= stream_parser.event_handler.last_saved_marker.packetno_end * ts_packet_t::size);
+	assert(m.num_bytes_safe_to_read >= m.current_marker.packetno_end * ts_packet_t::size);
 }
 
 /*
@@ -698,6 +724,11 @@ int close_last_mpm_part(db_txn& idx_txn, const ss::string_& dirname) {
 	auto fname = ::relfilename(last_file);
 	filename.format("{:s}/{:s}", dirname.c_str(), fname.c_str());
 
+	/*a part of a mux capture is shared with other live buffers and may contain data beyond our last
+		marker; readers never read beyond stream_packetno_end anyway*/
+	if (last_file.mux_capture)
+		return ret;
+
 	auto* fp_out = fopen64(filename.c_str(), "a");
 	if (!fp_out) {
 		dterror_nicef("Could not create output file {}", filename);
@@ -718,82 +749,205 @@ int close_last_mpm_part(db_txn& idx_txn, const ss::string_& dirname) {
 	return ret;
 }
 
+/*!
+	Open a file for a new part, reusing a spare part file if there is one, and make sure
+	that at least initial_file_size bytes are allocated on disk.
+	A reused file keeps its old contents and size, but the new contents will be written over them and
+	the file is truncated to the actual data size when the part is finalised.
+	Returns the file descriptor or -1 on error
+*/
+int active_mpm_t::open_part_file(const char* filename) {
+	int fd = -1;
+	while (fd < 0 && !spare_files.empty()) {
+		auto spare = spare_files.back();
+		spare_files.pop_back();
+		if (::rename(spare.c_str(), filename) < 0) {
+			dterrorf("Could not rename {} to {}: {}", spare, filename, strerror(errno));
+			::unlink(spare.c_str());
+			continue;
+		}
+		fd = ::open(filename, O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			dterrorf("Could not open {}: {}", filename, strerror(errno));
+		else
+			dtdebugf("Reusing {} as {}", spare, filename);
+	}
+	if (fd < 0) {
+		fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (fd < 0) {
+			dterror_nicef("Could not create output file {}: {}", filename, strerror(errno));
+			return -1;
+		}
+	}
+	//fallocate reserves contiguous space where possible and never shrinks the file
+	if (fallocate(fd, 0, 0, initial_file_size) < 0) {
+		if (errno != EOPNOTSUPP || (filesize_fd(fd) < (off_t)initial_file_size && ftruncate(fd, initial_file_size) < 0)) {
+			dterrorf("Error while allocating {}: {}", filename, strerror(errno));
+			::close(fd);
+			return -1;
+		}
+	}
+	return fd;
+}
+
+/*!
+	Remove a part file which is no longer needed, or keep it as a spare part to be reused by
+	open_part_file. Files which are also linked from a recording are never reused
+*/
+void active_mpm_t::remove_part_file(const char* filename) {
+	struct stat st;
+	if ((int)spare_files.size() < max_spare_files && ::stat(filename, &st) == 0 && st.st_nlink == 1) {
+		ss::string<128> spare;
+		spare.format("{:s}/spare{:d}.ts", dirname.c_str(), num_spare_files_created++);
+		if (::rename(filename, spare.c_str()) == 0) {
+			spare_files.push_back(spare);
+			return;
+		}
+		dterrorf("Could not rename {} to {}: {}", filename, spare, strerror(errno));
+	}
+	std::filesystem::remove(std::filesystem::path(filename));
+}
+
+/*!
+	mux capture only: link the next part of the capture into the live buffer as filename, and open it.
+	The first part is the one which the capture was writing when the service joined it; data in it from
+	before that time is indexed as well.
+	Returns the file descriptor or -1 on error
+*/
+int active_mpm_t::link_mux_part(const char* filename) {
+	auto fileno = mux_part_fileno < 0 ? mux_view->start_fileno : mux_part_fileno + 1;
+	auto part = mux_view->capture().get_part(fileno);
+	if (!part) {
+		dterrorf("Part {:d} of mux capture is not available", fileno);
+		return -1;
+	}
+	if (::link(part->filename.c_str(), filename) < 0) {
+		dterrorf("Could not link {} to {}: {}", part->filename, filename, strerror(errno));
+		return -1;
+	}
+	int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		dterrorf("Could not open {}: {}", filename, strerror(errno));
+		return -1;
+	}
+	mux_part_fileno = fileno;
+	mux_view->capture().set_linked_part(mux_view.get(), fileno);
+	return fd;
+}
+
+/*!
+	copy of the current file record, with its end set to the data indexed so far
+*/
+recdb::file_t active_mpm_t::finalised_file_record(const meta_marker_t& mm, system_time_t now,
+																									 int64_t num_bytes_safe_to_read) const {
+	auto ret = mm.current_file_record;
+	// stream_time_end may be slightly off because bytes may have been received after last pcr
+	ret.stream_time_end = stream_parser.event_handler.last_saved_marker.k.time; // could be 0
+	ret.real_time_end = system_clock_t::to_time_t(now);
+	ret.stream_packetno_end = num_bytes_safe_to_read / ts_packet_t::size;
+	return ret;
+}
+
+/*!
+	mux capture only: finalise the record of the current file at the data indexed so far, without
+	moving to the next part of the capture, which may not exist yet. Indexing continues in the current
+	file, whose record is reopened by reopen_current_file_record once the finalised one is no longer needed.
+	Returns -1 on error
+*/
+int active_mpm_t::finalise_current_file_record(system_time_t now) {
+	if (current_fileno < 0)
+		return -1;
+	auto idx_txn = db->mpm_rec.idxdb.wtxn();
+	stream_parser.event_handler.flush_markers(idx_txn);
+	{
+		auto mm = meta_marker.readAccess();
+		auto tmp = finalised_file_record(*mm, now, mm->num_bytes_safe_to_read);
+#ifndef NDEBUG
+		testf(idx_txn, tmp);
+#endif
+		put_record(idx_txn, tmp);
+	}
+	idx_txn.commit();
+	stream_parser.event_handler.markers_committed();
+	return 1;
+}
+
+/*!
+	mux capture only: undo finalise_current_file_record
+*/
+void active_mpm_t::reopen_current_file_record() {
+	if (current_fileno < 0)
+		return;
+	auto idx_txn = db->mpm_rec.idxdb.wtxn();
+	put_record(idx_txn, meta_marker.readAccess()->current_file_record);
+	idx_txn.commit();
+}
+
 /*!
 	create a new empty data file, open it and map it to memory
-	if old file and map exist, then it is closed and unmapped
+	if old file and map exist, then it is closed and unmapped.
+	Returns -1 on error, in which case the old file remains the current one
 */
 int active_mpm_t::next_data_file(system_time_t now, int64_t new_num_bytes_safe_to_read) {
 	auto idx_txn = db->mpm_rec.idxdb.wtxn();
 	using namespace recdb;
 	auto cfile = db->mpm_rec.idxdb.tcursor<file_t>(idx_txn);
-	current_file_time_start = now;
+	stream_parser.event_handler.flush_markers(idx_txn); // markers of the old file must be saved with it
 	auto mm = meta_marker.writeAccess();
+	if (uring_writer)
+		publish_written_data(*mm, true); // the old file must be complete before it is finalised
 	if (new_num_bytes_safe_to_read < 0)
 		new_num_bytes_safe_to_read = mm->num_bytes_safe_to_read;
-	mm->current_marker = stream_parser.event_handler.last_saved_marker;
-	auto stream_time_end = mm->current_marker.k.time; // could be 0
-	assert(mm->current_marker.packetno_end * ts_packet_t::size <= new_num_bytes_safe_to_read);
+	const auto& last_saved_marker = stream_parser.event_handler.last_saved_marker;
+	assert(last_saved_marker.packetno_end * ts_packet_t::size <= new_num_bytes_safe_to_read);
 	assert(new_num_bytes_safe_to_read >= mm->num_bytes_safe_to_read);
 	assert(new_num_bytes_safe_to_read % ts_packet_t::size == 0);
-	auto end_packet = new_num_bytes_safe_to_read / ts_packet_t::size;
 	if (current_fileno != -1) {
 		// first finalise last file record if there is one
-		// stream_time_end may be slightly off because bytes may have been received after last pcr
-		auto tmp = mm->current_file_record; // make a copy because of possible concurrent access
-		tmp.stream_time_end = stream_time_end;
-		tmp.real_time_end = system_clock_t::to_time_t(now);
-
-		tmp.stream_packetno_end = end_packet;
+		auto tmp = finalised_file_record(*mm, now, new_num_bytes_safe_to_read);
 #ifndef NDEBUG
 		testf(idx_txn, tmp);
 #endif
 		put_record(cfile, tmp);
 	}
-	current_fileno++;
 
-	auto new_file_stream_time_start = stream_time_end;
-	auto new_file_stream_packetno_start = end_packet;
-	mm->current_file_record.real_time_start = system_clock_t::to_time_t(now);
-	mm->current_file_record.fileno = current_fileno;
+	/*nothing is changed before the new file has been opened, so that on error the old file remains
+		current and the flushed markers remain pending*/
+	auto new_file_record = mm->current_file_record;
+	new_file_record.fileno = current_fileno + 1;
+	new_file_record.real_time_start = system_clock_t::to_time_t(now);
 
-	auto relfilename  = ::relfilename(mm->current_file_record);
+	auto relfilename  = ::relfilename(new_file_record);
 
-	current_filename.clear();
-	current_filename.format("{:s}/{:s}", dirname.c_str(), relfilename.c_str());
+	ss::string<128> filename;
+	filename.format("{:s}/{:s}", dirname.c_str(), relfilename.c_str());
 
-	auto* fp_out = fopen64(current_filename.c_str(), "w+");
-	if (!fp_out) {
-		dterror_nicef("Could not create output file {}", current_filename);
+	int fd = mux_view ? link_mux_part(filename.c_str()) : open_part_file(filename.c_str());
+	if (fd < 0) {
 		idx_txn.abort();
 		return -1;
 	}
-	int fd = fileno(fp_out);
-	if (ftruncate(fd, initial_file_size) < 0) {
-		dterrorf("Error while truncating {}", strerror(errno));
-		idx_txn.abort();
-		fclose(fp_out);
-		return -1;
-	}
+	current_filename = filename;
 	dtdebugf("Start streaming to {}", current_filename);
 
-	if (setvbuf(fp_out, NULL, _IONBF, 0)) // TODO: is this needed?
-		dterrorf("setvbuf failed: {}", strerror(errno));
-	transfer_filemap(fd, new_num_bytes_safe_to_read);
+	if (mux_view)
+		mux_part_map.init(fd, 0, 0);
+	else
+		transfer_filemap(fd, new_num_bytes_safe_to_read);
+	current_fileno = new_file_record.fileno;
+	current_file_time_start = now;
+	mm->current_marker = last_saved_marker;
 	mm->num_bytes_safe_to_read = new_num_bytes_safe_to_read;
-	// mm->current_marker = 	stream_parser.event_handler.last_saved_marker;
-	mm->current_file_record.k.stream_time_start = new_file_stream_time_start;
+	auto new_file_stream_packetno_start = new_num_bytes_safe_to_read / ts_packet_t::size;
+	mm->current_file_record = new_file_record;
+	mm->current_file_record.k.stream_time_start = last_saved_marker.k.time;
 	mm->current_file_record.stream_time_end = std::numeric_limits<milliseconds_t>::max(); // signifies infinite
 	mm->current_file_record.real_time_end = std::numeric_limits<time_t>::max(); // signifies infinite
 	mm->current_file_record.stream_packetno_start = new_file_stream_packetno_start;
 	mm->current_file_record.stream_packetno_end = std::numeric_limits<int64_t>::max(); // signifies infinite
 	mm->current_file_record.filename = relfilename;
+	mm->current_file_record.mux_capture = !!mux_view;
 
-	self_check(*mm);
-#if 0
-	//the following is incorrect; the old value should be preserved
-	mm->num_bytes_safe_to_read =  mm->current_file_record.stream_packetno_start*
-		ts_packet_t::size;
-#endif
 	self_check(*mm);
 #ifndef NDEBUG
 				testf(idx_txn, mm->current_file_record);
@@ -801,6 +955,7 @@ int active_mpm_t::next_data_file(system_time_t now, int64_t new_num_bytes_safe_t
 
 	put_record(cfile, mm->current_file_record);
 	idx_txn.commit();
+	stream_parser.event_handler.markers_committed();
 
 	mm->cv.notify_all();
 
@@ -809,40 +964,110 @@ int active_mpm_t::next_data_file(system_time_t now, int64_t new_num_bytes_safe_t
 }
 
 void active_mpm_t::close() {
+	stream_parser.event_handler.flush_markers();
 	current_fileno = -1;
+	if (uring_writer)
+		uring_writer->close();
 	filemap.unmap();
 	filemap.close();
+	mux_part_map.unmap();
+	mux_part_map.close();
+	mux_part_fileno = -1;
 	// TODO: check that parser is complete destroyed
 	dtdebugf("mpm close");
 }
 
 /*
 	Returns the number of bytes successfully decrypted (may be zero)
+	num_bytes_read_now: number of bytes received since the last call
 	low_data_rate: force decryption to use smaller buffers for a faster response
 */
-int active_mpm_t::decrypt_channel_data(bool low_data_rate) {
+template <typename writer_t>
+int active_mpm_t::decrypt_channel_data(writer_t& writer, int num_bytes_read_now, bool low_data_rate) {
 	uint8_t* buffer = nullptr;
-	int batch_size = (ts_packet_t::size * (dvbcsa.cache.batch_size)); // process at least 128 packets at a time);
-	if (low_data_rate)
-		batch_size /= 32;
-	int numbatches = (filemap.bytes_to_decrypt(buffer) / batch_size);
-	const int num_bytes_to_decrypt = numbatches * batch_size;
-	assert(filemap.decrypt_pointer + num_bytes_to_decrypt <= filemap.write_pointer);
+	auto available = writer.bytes_to_decrypt(buffer);
+	const int num_bytes_to_decrypt = decrypt_scheduler.schedule(num_bytes_read_now, available, dvbcsa.cache.batch_size,
+																															low_data_rate, steady_clock_t::now());
+	assert(writer.decrypt_pointer + num_bytes_to_decrypt <= writer.write_pointer);
 	int num_bytes_decrypted = 0;
-	if (num_bytes_to_decrypt == 0)
+	if (num_bytes_to_decrypt == 0) {
+		decrypt_scheduler.set_lag(available);
 		return num_bytes_to_decrypt;
+	}
 
 	assert(num_bytes_to_decrypt > num_bytes_decrypted);
 	auto newly_decrypted =
 		dvbcsa.decrypt_buffer(buffer + num_bytes_decrypted, num_bytes_to_decrypt - num_bytes_decrypted);
 	num_bytes_decrypted += newly_decrypted;
 	assert(num_bytes_decrypted <= num_bytes_to_decrypt);
+	decrypt_scheduler.set_lag(available - num_bytes_decrypted);
 	return num_bytes_decrypted;
 }
 
+/*
+	Make readers aware of new data
+*/
+void active_mpm_t::update_meta_marker(meta_marker_t& mm, const recdb::marker_t& marker,
+																			int64_t num_bytes_safe_to_read) {
+	mm.livebuffer_end_time = now;
+	mm.current_marker = marker;
+	assert(mm.num_bytes_safe_to_read <= num_bytes_safe_to_read); // KNOWN PROBLEM: we may not go back!!
+	mm.num_bytes_safe_to_read = num_bytes_safe_to_read;
+	if (!mm.started && mm.num_bytes_safe_to_read > 0) {
+		mm.started = true;
+		dtdebugf("notifying metamarker: safe_to_read={:d}", mm.num_bytes_safe_to_read);
+	}
+	self_check(mm);
+	//		TODO: add num_bytes_decrypted??? How to save time at start? e.g., first minute alway safe to read?
+	mm.cv.notify_all();
+}
+
+/*
+	io_uring only: make readers aware of the parsed data which has been written to the file.
+	flush: first wait until all parsed data has been written
+*/
+void active_mpm_t::publish_written_data(meta_marker_t& mm, bool flush) {
+	if (flush)
+		uring_writer->flush();
+	else
+		uring_writer->submit();
+	auto num_bytes_written =
+		current_file_stream_packetno_start * (int64_t)ts_packet_t::size + uring_writer->num_bytes_written;
+	auto it = unpublished_markers.begin();
+	for (; it != unpublished_markers.end() && it->num_bytes_decrypted <= num_bytes_written; ++it)
+		;
+	if (it == unpublished_markers.begin())
+		return;
+	auto& last = *std::prev(it);
+	update_meta_marker(mm, last.marker, last.num_bytes_decrypted);
+	unpublished_markers.erase(unpublished_markers.begin(), it);
+}
+
 void active_mpm_t::process_channel_data() {
+	if (mux_view)
+		process_mux_view_data();
+	else if (uring_writer) {
+		process_channel_data(*uring_writer);
+		// pick up writes which completed during processing
+		if (!unpublished_markers.empty())
+			publish_written_data(*meta_marker.writeAccess(), false);
+	} else
+		process_channel_data(filemap);
+	stream_parser.event_handler.flush_markers_if_due(steady_clock_t::now());
+}
+
+std::chrono::milliseconds active_mpm_t::process_descrambling_deadline(std::chrono::milliseconds max_wait) {
+	if (mux_view || error)
+		return max_wait;
+	if (decrypt_scheduler.time_to_deadline(steady_clock_t::now(), max_wait) == 0ms)
+		process_channel_data(); //descrambles the waiting data, even if nothing can be read
+	return decrypt_scheduler.time_to_deadline(steady_clock_t::now(), max_wait);
+}
+
+template <typename writer_t> void active_mpm_t::process_channel_data(writer_t& writer) {
 	now = system_clock_t::now();
 	auto start = steady_clock_t::now();
+	bool deadline_flushed = false;
 	for (;;) {
 		auto s = steady_clock_t::now();
 		auto delta = s - start;
@@ -852,8 +1077,9 @@ void active_mpm_t::process_channel_data() {
 		}
 
 		bool may_start_new_file = false;
+		bool deadline_expired = false; //set when no data was read
 		uint8_t* buffer = NULL;
-		ssize_t remaining_space = filemap.get_write_buffer(buffer);
+		ssize_t remaining_space = writer.get_write_buffer(buffer);
 		// TODO: ensure parser can cope with changing mmap region
 
 		if (remaining_space < 1024) {
@@ -865,8 +1091,8 @@ void active_mpm_t::process_channel_data() {
 				moving an mmapped region is not optimal. The readv function call can help to
 				read data into multiple chunks
 			*/
-			filemap.advance();
-			remaining_space = filemap.get_write_buffer(buffer);
+			writer.advance();
+			remaining_space = writer.get_write_buffer(buffer);
 		}
 		/*
 			read as much data as possible.
@@ -887,14 +1113,18 @@ void active_mpm_t::process_channel_data() {
 				continue;
 			}
 			if (errno == EAGAIN) {
-				break; // no more data
+				if (deadline_flushed || decrypt_scheduler.time_to_deadline(steady_clock_t::now(), 1ms) > 0ms)
+					break; // no more data
+				deadline_flushed = true;
+				ret = 0; // no more data, but waiting data must be descrambled now
+				deadline_expired = true;
 			} else {
 				dterrorf("error while reading: {}", strerror(errno));
 				break;
 			}
 		}
 		assert(ret >= 0);
-		if (ret == 0)
+		if (ret == 0 && !deadline_expired)
 			return;
 
 		if (ret % ts_packet_t::size != 0) {
@@ -910,18 +1140,20 @@ void active_mpm_t::process_channel_data() {
 			Decryption could then proceed at some later time. This also allows nonlive decryption.
 		*/
 		assert(ret >= 0);
-		filemap.advance_write_pointer(ret);
+		writer.advance_write_pointer(ret);
 		auto* pmt_parser = active_service->pmt_parser.get();
 		active_service->pmt_is_encrypted = (pmt_parser && pmt_parser->num_encrypted_packets > 0);
 		bool is_encrypted = active_service->need_decryption();
+		if (!is_encrypted)
+			decrypt_scheduler.clear_deadline();
 		assert(!is_encrypted || num_bytes_decrypted == dvbcsa.num_bytes_decrypted);
 		bool low_data_rate = active_service->pmt_is_encrypted;
 		auto num_bytes_decrypted_now =
-			(is_encrypted) ? decrypt_channel_data(low_data_rate) : filemap.bytes_to_decrypt(buffer);
+			(is_encrypted) ? decrypt_channel_data(writer, ret, low_data_rate) : writer.bytes_to_decrypt(buffer);
 		if (!is_encrypted)
 			dvbcsa.num_bytes_decrypted += num_bytes_decrypted_now;
 
-		assert(num_bytes_decrypted_now + filemap.decrypt_pointer <= filemap.write_pointer);
+		assert(num_bytes_decrypted_now + writer.decrypt_pointer <= writer.write_pointer);
 		/*TODO: returned ret may not be a multiple of ts_packet_t::size (188)
 			We need a parse_pointer to remember where parsing should continue
 		*/
@@ -933,13 +1165,13 @@ void active_mpm_t::process_channel_data() {
 				@todo: we could make discarding data more clever by only skipping encrypted packets
 			*/
 			assert(num_bytes_decrypted_now % ts_packet_t::size == 0);
-			stream_parser.set_buffer(filemap.buffer + filemap.decrypt_pointer, num_bytes_decrypted_now);
+			stream_parser.set_buffer(writer.buffer + writer.decrypt_pointer, num_bytes_decrypted_now);
 			auto old_packetno_start = stream_parser.event_handler.last_saved_marker.packetno_start;
 			dttime_init();
 			stream_parser.parse();
 			dttime(500);
 
-			filemap.advance_decrypt_pointer(num_bytes_decrypted_now);
+			writer.advance_decrypt_pointer(num_bytes_decrypted_now);
 
 			if (stream_parser.event_handler.last_saved_marker.packetno_start != old_packetno_start) {
 				may_start_new_file = true;
@@ -992,18 +1224,12 @@ void active_mpm_t::process_channel_data() {
 			*/
 			next_data_file(now, num_bytes_decrypted);
 		} else if (num_bytes_decrypted_now) {
-			auto mm = meta_marker.writeAccess();
-			mm->livebuffer_end_time = now;
-			mm->current_marker = stream_parser.event_handler.last_saved_marker;
-			assert(mm->num_bytes_safe_to_read <= num_bytes_decrypted); // KNOWN PROBLEM: we may not go back!!
-			mm->num_bytes_safe_to_read = num_bytes_decrypted;
-			if (!mm->started && mm->num_bytes_safe_to_read > 0) {
-				mm->started = true;
-				dtdebugf("notifying metamarker: safe_to_read={:d}", mm->num_bytes_safe_to_read);
-			}
-			self_check(*mm);
-			//		TODO: add num_bytes_decrypted??? How to save time at start? e.g., first minute alway safe to read?
-			mm->cv.notify_all();
+			if constexpr (std::is_same_v<writer_t, uring_writer_t>) {
+				unpublished_markers.push_back({stream_parser.event_handler.last_saved_marker, num_bytes_decrypted});
+				publish_written_data(*meta_marker.writeAccess(), false);
+			} else
+				update_meta_marker(*meta_marker.writeAccess(), stream_parser.event_handler.last_saved_marker,
+													 num_bytes_decrypted);
 		}
 		if (num_bytes_read % dtdemux::ts_packet_t::size != 0) {
 			dtdebugf("Read partial packet: num_bytes_read={:d} num_bytes_read%%188={:d}", num_bytes_read,
@@ -1012,6 +1238,59 @@ void active_mpm_t::process_channel_data() {
 	}
 }
 
+/*
+	mux capture only: index the data which the capture has added to the current part, and continue with
+	the next part when the current one is complete. The parts also contain the pids of other services;
+	the parser skips those. Data is never descrambled
+*/
+void active_mpm_t::process_mux_view_data() {
+	if (error)
+		return;
+	now = system_clock_t::now();
+	if (current_fileno < 0 && next_data_file(now, 0) < 0) {
+		error = true;
+		return;
+	}
+	auto start = steady_clock_t::now();
+	while (steady_clock_t::now() - start <= 500ms) {
+		auto part = mux_view->capture().get_part(mux_part_fileno);
+		if (!part) {
+			dterrorf("Part {:d} of mux capture is not available", mux_part_fileno);
+			error = true;
+			break;
+		}
+		if (mux_part_map.offset + mux_part_map.read_pointer >= part->num_bytes) {
+			if (!part->complete)
+				break; // wait for more data
+			if (next_data_file(now, num_bytes_decrypted) < 0) {
+				error = true;
+				break;
+			}
+			continue;
+		}
+		mux_part_map.grow_map(part->num_bytes);
+		uint8_t* buffer{nullptr};
+		int len = mux_part_map.get_read_buffer(buffer);
+		if (len <= 0)
+			break;
+		//parse in the same amounts as process_channel_data reads, so that readers are notified as often
+		len = std::min(len, ts_packet_t::size * 1024);
+		stream_parser.set_buffer(buffer, len);
+		stream_parser.parse();
+		mux_part_map.advance_read_pointer(len);
+		num_bytes_read += len;
+		num_bytes_decrypted += len;
+		dvbcsa.num_bytes_decrypted += len;
+		update_meta_marker(*meta_marker.writeAccess(), stream_parser.event_handler.last_saved_marker,
+											 num_bytes_decrypted);
+	}
+	auto* pmt_parser = active_service->pmt_parser.get();
+	bool was_encrypted = active_service->pmt_is_encrypted;
+	active_service->pmt_is_encrypted = (pmt_parser && pmt_parser->num_encrypted_packets > 0);
+	if (active_service->pmt_is_encrypted && !was_encrypted)
+		dterrorf("Service is scrambled; services in a mux capture cannot be descrambled");
+}
+
 bool active_mpm_t::file_used_by_recording(const recdb::file_t& file) const {
 	auto txn = db->mpm_rec.idxdb.rtxn();
 	using namespace recdb;
@@ -1034,7 +1313,7 @@ void active_mpm_t::delete_old_data(db_txn& parent_txn, system_time_t now) {
 		by live viewing should be removed. Otherwise we may be viewing an old part of the live buffer and
 		when a newer part is then reached, it may no longer exist and we have a gap in playback
 		2. we do not delete old data when recordings are in progress. These
-
+		3. parts of a finished recording which are still being copied into the recording (pinned parts)
 	*/
 	using namespace recdb;
 	auto cfile = find_first<recdb::file_t>(parent_txn);
@@ -1050,10 +1329,10 @@ void active_mpm_t::delete_old_data(db_txn& parent_txn, system_time_t now) {
 			filename.format("{:s}/{:s}", dirname.c_str(), file.filename.c_str());
 			auto playing_fileno = meta_marker.readAccess()->playback_clients_newest_fileno();
 			if ((int)file.fileno < playing_fileno) {
-				if (!file_used_by_recording(file)) {
+				if (!file_used_by_recording(file) && !part_is_pinned(filename.c_str())) {
 					dtdebugf("REMOVE TIMESHIFT FILE {:d}: {:s} age={:d}", file.fileno, filename.c_str(),
 									 std::chrono::duration_cast<std::chrono::seconds>(delta).count());
-					std::filesystem::remove(std::filesystem::path(filename.c_str()));
+					remove_part_file(filename.c_str());
 					new_data_stream_time_start = std::max(new_data_stream_time_start, file.stream_time_end);
 					delete_record_at_cursor(cfile); //@todo: does this cfile cursor point to the current "file"?
 				}
@@ -19,8 +19,11 @@
  */
 
 #pragma once
+#include <bitset>
 #include <filesystem>
 #include "filemapper.h"
+#include "uringwriter.h"
+#include "finalizer.h"
 #include "streamparser/packetstream.h"
 #include "neumodb/chdb/chdb_extra.h"
 #include "neumodb/epgdb/epgdb_extra.h"
@@ -34,6 +37,7 @@ namespace fs = std::filesystem;
 
 class active_service_t;
 class active_mpm_t;
+class mux_view_reader_t;
 
 struct playback_info_t {
 	chdb::service_t service;
@@ -60,9 +64,14 @@ namespace epgdb
 
 */
 struct mpm_copylist_t {
+	struct part_t {
+		fs::path src; //in the live buffer
+		fs::path dst; //in the recording
+	};
 	fs::path src_dir;
 	fs::path dst_dir;
-	//ss::vector<ss::string<128>, 32> filenames;
+	std::vector<part_t> parts;
+	std::shared_ptr<pinned_parts_t> pins; //shared by all copies of this list
 	recdb::rec_t rec;
 	int fileno_offset{0};
 	mpm_copylist_t() = default;
@@ -72,8 +81,16 @@ struct mpm_copylist_t {
 		, rec(rec_)
 		{}
 
-	void run(db_txn& txn);
-	void run();
+	/*!
+		open all source parts, protecting them from being deleted or reused before they have been
+		copied. Must be called before the recording is removed from the live buffer's database
+	*/
+	void pin();
+
+	/*!
+		link or copy all parts into the recording; returns the number of parts which failed
+	*/
+	int run(std::atomic<int>* num_files_done = nullptr, std::atomic<int64_t>* num_bytes_done = nullptr);
 };
 
 
@@ -95,6 +112,61 @@ public:
 
 };
 
+/*!
+	In-memory index of the markers of a recording or live buffer, to find the position for a play time,
+	and the play time for a position, without database lookups, e.g., while scrubbing.
+	The markers of each part are loaded when the part is first needed. For a live buffer, newer parts
+	and markers are loaded when a lookup goes beyond what has been loaded.
+	Markers are sorted on time, and therefore also on packetno.
+*/
+class seek_index_t {
+	struct part_t {
+		int fileno{-1};
+		milliseconds_t stream_time_start{};
+		int64_t stream_packetno_start{0};
+		bool growing{false}; //last part of a live buffer
+		bool loaded{false};
+		bool complete{false}; //all markers loaded
+		std::vector<int64_t> times;
+		std::vector<uint32_t> packetnos_start;
+		std::vector<uint32_t> packetnos_end;
+
+		recdb::marker_t marker(int idx) const {
+			return recdb::marker_t(recdb::marker_key_t(milliseconds_t(times[idx])), packetnos_start[idx],
+														 packetnos_end[idx]);
+		}
+	};
+
+	mutable std::mutex mutex;
+	std::vector<part_t> parts; //in order of time
+	std::optional<db_txn> txn; //only open while loading
+
+	db_txn& get_txn(recdb::recdb_t& idxdb);
+	void load_parts(recdb::recdb_t& idxdb);
+	void load_markers(recdb::recdb_t& idxdb, int part_idx);
+	bool refresh(recdb::recdb_t& idxdb);
+	int part_for_time(milliseconds_t play_time) const;
+	int part_for_packetno(int64_t packetno) const;
+
+public:
+	void clear();
+
+	/*!
+		first marker at or after play_time. Returns -1 if there is none
+	*/
+	int marker_for_time(recdb::recdb_t& idxdb, recdb::marker_t& marker, milliseconds_t play_time);
+
+	/*!
+		the last marker. Returns -1 if there is none
+	*/
+	int end_marker(recdb::recdb_t& idxdb, recdb::marker_t& marker);
+
+	/*!
+		play time of the last marker starting at or before packetno; 0 if there is none
+	*/
+	milliseconds_t time_for_packetno(recdb::recdb_t& idxdb, int64_t packetno);
+};
+
 class playback_mpm_t;
 
 /*!Records the current state of playback or livebuffer recording
@@ -222,12 +294,34 @@ class playback_mpm_t : public mpm_t {
 																		-1 means: need initialisation
 																 */
 	meta_marker_t last_seen_live_meta_marker; //only used when playing a live buffer
+	mutable seek_index_t seek_index;
+
+	/*
+		Trick play (fast forward/rewind): the stream is replaced by the I-frames referenced by the markers,
+		of which only the video packets are read from disk, and sent one per frame interval with new timestamps
+	*/
+	static constexpr auto trick_play_frame_interval = 200ms; //time between frames sent to mpv
+	static constexpr int max_trick_play_frame_size = 4 * 1024 * 1024;
+	std::atomic<int> trick_play_speed{0}; //0: normal play; otherwise speed factor, negative for rewind
+	std::atomic<bool> trick_play_ended{false}; //trick play reached the start or end of the data by itself
+	milliseconds_t trick_play_time{}; //play time of the frame being sent
+	recdb::marker_t trick_play_marker{}; //marker of the frame being sent
+	recdb::file_t trick_play_file{}; //file part from which frames are being read
+	int trick_play_fd{-1};
+	std::vector<uint8_t> trick_play_input; //packets in the marker's range
+	std::vector<uint8_t> trick_play_frame; //video packets of the frame being sent
+	int trick_play_frame_pos{0}; //number of bytes of trick_play_frame already sent
+	int64_t trick_play_pts{0}; //output timestamp of the frame being sent (90kHz)
+	uint8_t trick_play_cc{0}; //continuity counter of the output video pid
 
 	bool is_timeshifted{false};
 	recdb::rec_t currently_playing_recording{};
 	ss_t stream_state;
 	dtdemux::pmt_info_t current_pmt;
 	ss::bytebuffer<128> preferred_streams_pmt_ts;
+	/*streams of current_pmt; when playing a part made by a mux capture, which also contains the packets
+		of other services, other pids are not passed to mpv*/
+	std::bitset<8192> service_pids;
 	int64_t next_stream_change_{-1}; //cache
 	int next_stream_change(); //byte at which new pmt becomes active (coincides with end of old pmt)
 	inline void clear_stream_state() {
@@ -243,7 +337,6 @@ public:
 private:
 	void find_current_pmts(int64_t bytepos);
 	int get_end_marker_from_db(db_txn& txn, recdb::marker_t& end_marker);
-	int get_marker_for_time_from_db(db_txn& idxdb_txn, recdb::marker_t& current_marker, milliseconds_t start_play_time);
 
 	//int refresh_markers_(db_txn& txn);
 	//int refresh_markers_(db_txn& txn, milliseconds_t milliseconds);
@@ -256,6 +349,14 @@ private:
 	int64_t copy_filtered_packets(char* outbuffer, uint8_t* inbuffer, int64_t numbytes);
 	std::tuple<int,int> copy_filtered_packets(char* outbuffer, uint8_t* inbuffer, int outbytes, int inbytes);
 	int64_t read_pmt_data(char* outbuffer, uint64_t numbytes);
+	int open_trick_play_file(db_txn& idxdb_txn, const recdb::marker_t& marker);
+	void close_trick_play_file();
+	int read_trick_play_frame(const recdb::marker_t& marker);
+	void restamp_trick_play_frame();
+	int next_trick_play_frame();
+	void start_trick_play(milliseconds_t play_time);
+	void end_trick_play(milliseconds_t play_time, bool at_end);
+	int64_t read_trick_play_data(char* outbuffer, uint64_t numbytes);
 	int64_t read_data_from_current_file(uint8_t*& buffer);
 	std::tuple<int, int> read_data_(char* outbuffer, int outbytes, int inbytes);
 	std::tuple<bool, int64_t> currently_playing_file_status();
@@ -285,6 +386,22 @@ public:
 	//int open(int fileno=0); //find and open file
 	EXPORT void close();
 	EXPORT milliseconds_t get_current_play_time() const;
+	/*!
+		speed=2...64: fast forward; speed=-2...-64: rewind; speed=0: back to normal play.
+		The caller must make mpv reopen the stream (as when jumping)
+	*/
+	EXPORT int set_trick_play(int speed);
+	int get_trick_play_speed() const {
+		return trick_play_speed;
+	}
+	/*!
+		returns true (once) after trick play has ended by itself; mpv must then reopen the stream
+		and call resume_after_trick_play
+	*/
+	bool trick_play_has_ended() {
+		return trick_play_ended.exchange(false);
+	}
+	EXPORT int resume_after_trick_play();
 	EXPORT void force_abort();
 	int current_fileno() const {
 		return currently_playing_file.readAccess()->fileno;
@@ -319,6 +436,9 @@ public:
 	size_t initial_file_size = default_file_size;
 	size_t mmap_size = default_file_size;
 	std::chrono::seconds file_time_limit{300s};//30; //if >0, then a new file will be started after approx. this many seconds
+	int max_spare_files{2}; //number of expired part files kept for reuse, to avoid allocating new disk space
+	std::vector<ss::string<128>> spare_files; //full paths of part files which can be reused
+	int num_spare_files_created{0}; //used to create unique names for spare files
 
 
 	int64_t num_bytes_read{0};  //since start of receiving this channel
@@ -336,6 +456,22 @@ public:
 	uint32_t current_file_stream_packetno_start{0};
 
 	dvbcsa_t dvbcsa;
+	decrypt_scheduler_t decrypt_scheduler;
+
+	/*if set, data is written with io_uring instead of through filemap. Data is then only announced
+		to readers (num_bytes_safe_to_read) after it has been written*/
+	std::unique_ptr<uring_writer_t> uring_writer;
+	struct unpublished_marker_t {
+		recdb::marker_t marker;
+		int64_t num_bytes_decrypted;
+	};
+	std::deque<unpublished_marker_t> unpublished_markers; //parsed, but possibly not yet written
+
+	/*if set, the data is written by a mux capture which is shared with other services; the parts of the
+		capture are linked into the live buffer and indexed from there*/
+	std::shared_ptr<mux_view_reader_t> mux_view;
+	int mux_part_fileno{-1}; //part of the capture which is the current file
+	mmap_t mux_part_map{mmap_t::chunk_size, true}; //reads the current file for indexing
 
 	dtdemux::ts_stream_t stream_parser;
 
@@ -343,9 +479,21 @@ public:
 
 private:
 	bool  file_used_by_recording(const recdb::file_t& file) const;
+	int open_part_file(const char* filename);
+	int link_mux_part(const char* filename);
+	recdb::file_t finalised_file_record(const meta_marker_t& mm, system_time_t now,
+																			int64_t num_bytes_safe_to_read) const;
+	int finalise_current_file_record(system_time_t now);
+	void reopen_current_file_record();
+	void remove_part_file(const char* filename);
 	static ss::string<128> make_dirname(active_service_t*parent, system_time_t start_time);
 	bool next_key(int parity);
 	void transfer_filemap(int fd, int64_t new_num_bytes_safe_to_read); //helper
+	template <typename writer_t> void process_channel_data(writer_t& writer);
+	void process_mux_view_data();
+	template <typename writer_t> int decrypt_channel_data(writer_t& writer, int num_bytes_read_now, bool low_data_rate);
+	void update_meta_marker(meta_marker_t& mm, const recdb::marker_t& marker, int64_t num_bytes_safe_to_read);
+	void publish_written_data(meta_marker_t& mm, bool flush);
 
   /*!
 		create the directory structure, including the database
@@ -369,9 +517,11 @@ private:
 	int next_data_file(system_time_t now, int64_t new_num_bytes_safe_to_read);
 
 	void process_channel_data();
-
-//low_data_rate: force decryption to use smaller buffers for a faster response
-	int decrypt_channel_data(bool low_data_rate);
+	/*!
+		service thread: descramble data which has waited longer than the descrambling latency target,
+		also when no new data arrives. Returns the time until this must be checked again (at most max_wait)
+	*/
+	std::chrono::milliseconds process_descrambling_deadline(std::chrono::milliseconds max_wait);
 
 	void close();
 
@@ -0,0 +1,390 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "muxcapture.h"
+#include "active_adapter.h"
+#include "streamparser/packetstream.h"
+#include "util/logger.h"
+#include "util/util.h"
+#include "fmt/chrono.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using namespace dtdemux;
+
+mux_capture_t::mux_capture_t(active_adapter_t& active_adapter, const char* dirname,
+														 std::chrono::seconds part_time_limit)
+	: active_adapter(active_adapter)
+	, dirname(dirname)
+	, part_time_limit(part_time_limit)
+	, dvb_reader(active_adapter, -1, active_adapter.pid_stats)
+	, filemap(default_file_size, false) {
+}
+
+mux_capture_t::~mux_capture_t() {
+	std::scoped_lock lck(m);
+	assert(views.size() == 0);
+	close();
+}
+
+/*
+	Create the directory and the first part, and start the demux.
+	Directories of earlier captures on the same adapter are left over after a crash; they are removed.
+	Their parts remain available in the live buffers which linked them.
+	m must be locked
+*/
+int mux_capture_t::open() {
+	error = false;
+	auto dir = fs::path(dirname.c_str());
+	ss::string<16> prefix;
+	prefix.format("A{:02d}_", active_adapter.get_adapter_no());
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(dir.parent_path(), ec)) {
+		if (entry.path() != dir && entry.path().filename().string().starts_with(prefix.c_str())) {
+			dtdebugf("Removing old mux capture {}", entry.path().string());
+			fs::remove_all(entry.path(), ec);
+		}
+	}
+	if (!mkpath(dirname.c_str())) {
+		dterrorf("Could not create dir {}", dirname);
+		error = true;
+		return -1;
+	}
+	if (dvb_reader.open(ts_stream_t::PAT_PID, &idle_epoll) < 0) {
+		error = true;
+		return -1;
+	}
+	open_pids.push_back(pid_with_use_count_t(ts_stream_t::PAT_PID));
+	if (next_part(system_clock_t::now()) < 0) {
+		error = true;
+		return -1;
+	}
+	dtdebugf("Started mux capture in {}", dirname);
+	return 0;
+}
+
+/*
+	Stop the demux and remove the directory; parts which have been linked remain available in the
+	live buffers.
+	m must be locked
+*/
+void mux_capture_t::close() {
+	dvb_reader.close();
+	open_pids.clear();
+	if (filemap.fd >= 0 && !parts.empty()) {
+		if (ftruncate(filemap.fd, parts.back().num_bytes) < 0)
+			dterrorf("Error while truncating {}: {}", parts.back().filename, strerror(errno));
+		parts.back().complete = true;
+	}
+	filemap.unmap();
+	filemap.close();
+	parts.clear();
+	std::error_code ec;
+	fs::remove_all(dirname.c_str(), ec);
+	if (ec)
+		dterrorf("Error deleting {}: {}", dirname, ec.message());
+}
+
+mux_capture_t::view_t* mux_capture_t::find_view(mux_view_reader_t* reader) {
+	for (auto& v : views)
+		if (v.reader == reader)
+			return &v;
+	return nullptr;
+}
+
+int mux_capture_t::register_view(mux_view_reader_t* reader) {
+	std::scoped_lock lck(m);
+	if (find_view(reader)) {
+		dterrorf("View already registered");
+		return -1;
+	}
+	if (views.size() == 0 && open() < 0) {
+		close();
+		return -1;
+	}
+	if (error || parts.empty())
+		return -1;
+	auto fileno = parts.back().fileno;
+	views.push_back(view_t{reader, fileno - 1, {}});
+	return fileno;
+}
+
+void mux_capture_t::unregister_view(mux_view_reader_t* reader) {
+	std::scoped_lock lck(m);
+	auto* v = find_view(reader);
+	if (!v) {
+		dterrorf("Attempting to unregister view which is not registered");
+		return;
+	}
+	for (auto pid : v->pids)
+		remove_pid_(pid);
+	views.erase(v - &views[0]);
+	if (views.size() == 0)
+		close();
+	else
+		remove_linked_parts();
+}
+
+/*
+	m must be locked
+*/
+int mux_capture_t::remove_pid_(int pid) {
+	for (int i = 0; i < (int)open_pids.size(); ++i) {
+		auto& x = open_pids[i];
+		if (x.pid != pid)
+			continue;
+		assert(x.use_count > 0);
+		if (--x.use_count > 0)
+			return 0;
+		open_pids.erase(open_pids.begin() + i);
+		return dvb_reader.remove_pid(pid);
+	}
+	dterrorf("pid {} was not added", pid);
+	return -1;
+}
+
+int mux_capture_t::add_pid(mux_view_reader_t* reader, int pid) {
+	std::scoped_lock lck(m);
+	auto* v = find_view(reader);
+	if (!v || !dvb_reader.is_open())
+		return -1;
+	v->pids.push_back(pid);
+	for (auto& x : open_pids) {
+		if (x.pid == pid) {
+			x.use_count++;
+			return 0;
+		}
+	}
+	open_pids.push_back(pid_with_use_count_t(pid));
+	return dvb_reader.add_pid(pid);
+}
+
+int mux_capture_t::remove_pid(mux_view_reader_t* reader, int pid) {
+	std::scoped_lock lck(m);
+	auto* v = find_view(reader);
+	if (!v)
+		return -1;
+	auto it = std::find(v->pids.begin(), v->pids.end(), pid);
+	if (it == v->pids.end()) {
+		dterrorf("pid {} was not added", pid);
+		return -1;
+	}
+	v->pids.erase(it);
+	return remove_pid_(pid);
+}
+
+std::optional<mux_capture_t::part_t> mux_capture_t::get_part(int fileno) const {
+	std::scoped_lock lck(m);
+	for (const auto& part : parts)
+		if (part.fileno == fileno)
+			return part;
+	return {};
+}
+
+void mux_capture_t::set_linked_part(mux_view_reader_t* reader, int fileno) {
+	std::scoped_lock lck(m);
+	auto* v = find_view(reader);
+	if (!v)
+		return;
+	v->fileno = fileno;
+	remove_linked_parts();
+}
+
+/*
+	Remove parts which all services have finished: they have all linked a later part, which means that
+	they have indexed all data in this one.
+	m must be locked
+*/
+void mux_capture_t::remove_linked_parts() {
+	while (!parts.empty() && parts.front().complete) {
+		auto fileno = parts.front().fileno;
+		for (const auto& v : views)
+			if (v.fileno <= fileno)
+				return;
+		dtdebugf("Removing mux capture part {}", parts.front().filename);
+		if (::unlink(parts.front().filename.c_str()) < 0)
+			dterrorf("Could not remove {}: {}", parts.front().filename, strerror(errno));
+		parts.pop_front();
+	}
+}
+
+/*
+	Start a new part and complete the current one (if any), such that the services find the new part
+	when they have indexed all data in the old one.
+	m must be locked
+*/
+int mux_capture_t::next_part(system_time_t now) {
+	ss::string<128> filename;
+	filename.format("{:s}/{:02d}_{:%Y%m%d_%T}.ts", dirname, next_fileno,
+									fmt::localtime(system_clock_t::to_time_t(now)));
+	int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd < 0) {
+		dterror_nicef("Could not create output file {}: {}", filename, strerror(errno));
+		return -1;
+	}
+	//as in active_mpm_t::open_part_file; the map grows the file if this fails
+	if (fallocate(fd, 0, 0, default_file_size) < 0 && errno != EOPNOTSUPP)
+		dterrorf("Error while allocating {}: {}", filename, strerror(errno));
+	mmap_t newfilemap(filemap.map_len, false);
+	// fd will be owned by newfilemap
+	newfilemap.init(fd, 0);
+	if (!parts.empty()) {
+		//the old part ends with the last complete packet; move a partial packet to the new part
+		auto& last = parts.back();
+		auto num_bytes_to_move = filemap.write_pointer - filemap.decrypt_pointer;
+		assert(num_bytes_to_move < ts_packet_t::size);
+		memcpy(newfilemap.buffer, filemap.buffer + filemap.decrypt_pointer, num_bytes_to_move);
+		newfilemap.advance_write_pointer(num_bytes_to_move);
+		if (ftruncate(filemap.fd, last.num_bytes) < 0)
+			dterrorf("Error while truncating {}: {}", last.filename, strerror(errno));
+		filemap.unmap();
+		filemap.close();
+		last.complete = true;
+	}
+	filemap = std::move(newfilemap);
+	parts.push_back(part_t{next_fileno++, filename, 0, false});
+	current_part_time_start = now;
+	dtdebugf("Start capturing to {}", filename);
+	remove_linked_parts();
+	return 0;
+}
+
+/*
+	Append all data available on the demux to the current part.
+	Returns the number of bytes of complete packets added
+*/
+int mux_capture_t::read_data(system_time_t now) {
+	std::scoped_lock lck(m);
+	if (error || parts.empty())
+		return 0;
+	int num_bytes_added{0};
+	for (;;) {
+		uint8_t* buffer{nullptr};
+		auto remaining_space = filemap.get_write_buffer(buffer);
+		if (remaining_space < 1024) {
+			if (filemap.advance() < 0) {
+				dterrorf("Could not grow {}", parts.back().filename);
+				error = true;
+				break;
+			}
+			remaining_space = filemap.get_write_buffer(buffer);
+		}
+		int toread = std::min(remaining_space, ts_packet_t::size * 1024);
+		auto ret = dvb_reader.read_into(buffer, toread - toread % ts_packet_t::size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EOVERFLOW) {
+				dtdebug_nicef("OVERFLOW");
+				continue;
+			}
+			if (errno != EAGAIN)
+				dterrorf("error while reading: {}", strerror(errno));
+			break;
+		}
+		if (ret == 0)
+			break;
+		filemap.advance_write_pointer(ret);
+		//decrypt_pointer marks the end of the complete packets, which are available to the services
+		auto num_bytes = filemap.bytes_to_decrypt(buffer);
+		filemap.advance_decrypt_pointer(num_bytes);
+		parts.back().num_bytes += num_bytes;
+		num_bytes_added += num_bytes;
+	}
+	if (now - current_part_time_start > part_time_limit && next_part(now) < 0)
+		error = true;
+	return num_bytes_added;
+}
+
+void mux_capture_t::notify_other_views(mux_view_reader_t* reader) {
+	std::scoped_lock lck(m);
+	for (auto& v : views)
+		if (v.reader != reader)
+			v.reader->notifier.unblock();
+}
+
+int mux_view_reader_t::open(uint16_t initial_pid, epoll_t* epoll, int epoll_flags) {
+	start_fileno = mux_capture->register_view(this);
+	if (start_fileno < 0) {
+		dterrorf("Could not join mux capture");
+		return -1;
+	}
+	this->epoll = epoll;
+	this->epoll_flags = epoll_flags;
+	// ensure that exactly one thread receives a wakeup call for the demux
+	epoll->add_fd(mux_capture->dvb_reader.demux_fd, epoll_flags | EPOLLEXCLUSIVE);
+	epoll->add_fd((int)notifier, epoll_flags);
+	return add_pid(initial_pid);
+}
+
+void mux_view_reader_t::close() {
+	if (!is_open())
+		return;
+	epoll->remove_fd((int)notifier);
+	if (mux_capture->dvb_reader.demux_fd >= 0)
+		epoll->remove_fd(mux_capture->dvb_reader.demux_fd);
+	mux_capture->unregister_view(this);
+	epoll = nullptr;
+}
+
+bool mux_view_reader_t::on_epoll_event(const epoll_event* evt) {
+	if (!epoll)
+		return false;
+	if (epoll->matches(evt, mux_capture->dvb_reader.demux_fd)) {
+		if (mux_capture->read_data(system_clock_t::now()) > 0)
+			mux_capture->notify_other_views(this);
+		return true;
+	}
+	if (epoll->matches(evt, (int)notifier)) {
+		notifier.reset();
+		return true;
+	}
+	return false;
+}
+
+std::shared_ptr<stream_reader_t> mux_view_reader_t::clone(ssize_t buffer_size) const {
+	return std::make_shared<dvb_stream_reader_t>(active_adapter, buffer_size, active_adapter.pid_stats);
+}
+
+chdb::any_mux_t mux_view_reader_t::stream_mux() const {
+	return active_adapter.current_tp();
+}
+
+void mux_view_reader_t::set_current_tp(const chdb::any_mux_t& mux) const {
+	active_adapter.set_current_tp(mux);
+}
+
+void mux_view_reader_t::on_stream_mux_change(const chdb::any_mux_t& stream_mux) {
+	active_adapter.on_tuned_mux_change(stream_mux);
+}
+
+void mux_view_reader_t::update_received_si_mux(const std::optional<chdb::any_mux_t>& mux, bool is_bad) {
+	active_adapter.update_received_si_mux(mux, is_bad);
+}
+
+void mux_view_reader_t::update_stream_mux_nit(const chdb::any_mux_t& stream_mux) {
+	active_adapter.update_tuned_mux_nit(stream_mux);
+}
@@ -0,0 +1,171 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <deque>
+#include <mutex>
+#include <optional>
+#include "active_stream.h"
+#include "filemapper.h"
+#include "stackstring.h"
+
+class mux_view_reader_t;
+
+/*
+	Captures the pids of several services on the same mux into a single partial transport stream,
+	which is written to disk only once, as a series of parts in the capture's own directory.
+
+	Each service reads the capture through a mux_view_reader_t: its live buffer hard links the parts
+	of the capture instead of writing its own, and indexes only its own pids (see
+	active_mpm_t::process_mux_view_data). A part is removed from the capture's directory as soon as
+	all services have linked it; the live buffers then own the data.
+
+	Like stream_filter_t, the capture has no thread of its own: the demux fd is added to the epoll set
+	of the thread of each service with EPOLLEXCLUSIVE. The thread which is woken up writes the data and
+	then notifies the other services.
+
+	Scrambled services cannot be captured this way, as they are descrambled in their live buffer
+ */
+class mux_capture_t {
+	friend class mux_view_reader_t;
+public:
+	struct part_t {
+		int fileno{-1};
+		ss::string<128> filename; //in the directory of the capture
+		int64_t num_bytes{0}; //number of bytes of complete packets written so far
+		bool complete{false}; //no data will be added anymore
+	};
+private:
+	static constexpr size_t default_file_size = 127827968; //multiple of 4096 and 188; approx 121 MByte
+	mutable std::mutex m;
+	active_adapter_t& active_adapter;
+	const ss::string<128> dirname;
+	const std::chrono::seconds part_time_limit;
+	epoll_t idle_epoll; //never waited on; services wait on the demux fd in their own epoll set
+	dvb_stream_reader_t dvb_reader; //demux for the union of the pids of all services
+	std::vector<pid_with_use_count_t> open_pids;
+
+	struct view_t {
+		mux_view_reader_t* reader{nullptr};
+		int fileno{-1}; //part which the service has linked most recently
+		std::vector<uint16_t> pids; //pids added by the service
+	};
+	ss::vector<view_t, 8> views;
+
+	mmap_t filemap; //current part
+	std::deque<part_t> parts; //parts which are still in the directory of the capture
+	int next_fileno{0};
+	system_time_t current_part_time_start{};
+	bool error{false};
+
+	int open();
+	void close();
+	view_t* find_view(mux_view_reader_t* reader);
+	int remove_pid_(int pid);
+	int next_part(system_time_t now);
+	void remove_linked_parts();
+	int read_data(system_time_t now);
+	void notify_other_views(mux_view_reader_t* reader);
+
+public:
+	mux_capture_t(active_adapter_t& active_adapter, const char* dirname, std::chrono::seconds part_time_limit);
+	~mux_capture_t();
+
+	/*!
+		returns the part at which the service must start, or -1 on error
+	*/
+	int register_view(mux_view_reader_t* reader);
+	void unregister_view(mux_view_reader_t* reader);
+
+	int add_pid(mux_view_reader_t* reader, int pid);
+	int remove_pid(mux_view_reader_t* reader, int pid);
+
+	std::optional<part_t> get_part(int fileno) const;
+
+	/*!
+		Called after a service has linked part fileno into its live buffer; earlier parts are then no longer
+		needed by the capture
+	*/
+	void set_linked_part(mux_view_reader_t* reader, int fileno);
+};
+
+/*
+	Stream reader of a service which is part of a mux capture. The reader does not return data;
+	the live buffer reads it from the parts of the capture.
+ */
+class mux_view_reader_t final : public stream_reader_t {
+	friend class mux_capture_t;
+	std::shared_ptr<mux_capture_t> mux_capture;
+	event_handle_t notifier;
+
+public:
+	int start_fileno{-1}; //first part of the capture to link into the live buffer
+	active_adapter_t& active_adapter;
+
+	mux_view_reader_t(active_adapter_t& active_adapter, const std::shared_ptr<mux_capture_t>& mux_capture)
+		: stream_reader_t(active_adapter)
+		, mux_capture(mux_capture)
+		, active_adapter(active_adapter)
+		{}
+
+	virtual ~mux_view_reader_t() {
+		close();
+	}
+
+	inline mux_capture_t& capture() const {
+		return *mux_capture;
+	}
+
+	virtual int open(uint16_t initial_pid, epoll_t* epoll,
+									 int epoll_flags = EPOLLIN|EPOLLERR|EPOLLHUP|EPOLLET);
+	virtual void close();
+
+	virtual bool on_epoll_event(const epoll_event* evt);
+
+	virtual inline int add_pid(int pid) {
+		return mux_capture->add_pid(this, pid);
+	}
+
+	virtual inline int remove_pid(int pid) {
+		return mux_capture->remove_pid(this, pid);
+	}
+
+	//used for reading ecms; returns a reader with its own demux
+	virtual std::shared_ptr<stream_reader_t> clone(ssize_t buffer_size = -1) const;
+
+	virtual inline std::tuple<uint8_t*, ssize_t> read(ssize_t size = -1) {
+		errno = EAGAIN;
+		return {nullptr, -1};
+	}
+
+	virtual inline void discard(ssize_t num_bytes) {
+	}
+
+	virtual inline ssize_t read_into(uint8_t* p, ssize_t toread, const std::vector<pid_with_use_count_t>* pids = nullptr) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	virtual chdb::any_mux_t stream_mux() const;
+	virtual void set_current_tp(const chdb::any_mux_t& mux) const;
+	virtual void on_stream_mux_change(const chdb::any_mux_t& mux);
+	virtual void update_received_si_mux(const std::optional<chdb::any_mux_t>& mux, bool is_bad);
+	virtual void update_stream_mux_nit(const chdb::any_mux_t& stream_mux);
+};
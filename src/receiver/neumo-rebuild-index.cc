@@ -0,0 +1,71 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Rebuild the index of one or more recordings from their parts, or only check them (--check)
+	neumo-rebuild-index [-j threads] [--check] [--logconfig file] recording_dir...
+*/
+
+#include "CLI/CLI.hpp"
+#include "indexrebuild.h"
+#include "util/logger.h"
+#include <algorithm>
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+	CLI::App app{"Rebuild the index of recordings"};
+	std::vector<std::string> recordings;
+	int num_threads{0};
+	bool check_only{false};
+	std::string logconfig;
+	app.add_option("recordings", recordings, "Recording directories")->required();
+	app.add_option("-j,--threads", num_threads, "Number of threads (0: one per core)", true);
+	app.add_flag("--check", check_only, "Only check the recordings; do not write a new index");
+	app.add_option("--logconfig", logconfig, "log4cxx configuration file");
+	try {
+		app.parse(argc, argv);
+	} catch (const CLI::ParseError& e) {
+		return app.exit(e);
+	}
+	if (!logconfig.empty())
+		set_logconfig(logconfig.c_str());
+
+	int num_failed = 0;
+	for (const auto& recording : recordings) {
+		auto r = rebuild_recording_index(recording, num_threads, !check_only);
+		printf("%s:\n", r.recording.c_str());
+		if (!r.error.empty()) {
+			printf("  ERROR: %s\n", r.error.c_str());
+			++num_failed;
+			continue;
+		}
+		printf("  %d parts, %ld packets, %.1f MB/s with %d threads\n", r.num_parts, r.num_packets,
+					 r.num_bytes / std::max(r.elapsed, 1e-3) / 1e6, r.num_threads);
+		printf("  duration %ld.%03lds, %d markers, %d stream descriptors%s\n", r.duration / 1000, r.duration % 1000,
+					 r.num_markers, r.num_stream_descriptors, r.index_written ? "; index written" : "");
+		printf("  %ld cc errors, %ld bytes skipped, %ld scrambled packets\n", r.num_cc_errors, r.num_bytes_skipped,
+					 r.num_scrambled_packets);
+		for (const auto& u : r.undecrypted_regions)
+			printf("  undecrypted: packets [%ld, %ld) time [%ld.%03lds, %ld.%03lds)\n", u.packetno_start, u.packetno_end,
+						 u.stream_time_start / 1000, u.stream_time_start % 1000, u.stream_time_end / 1000,
+						 u.stream_time_end % 1000);
+	}
+	return num_failed == 0 ? 0 : -1;
+}
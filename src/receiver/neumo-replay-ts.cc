@@ -0,0 +1,145 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Replay a recorded transport stream through the si parsers and the live buffer indexer, without a tuner
+	neumo-replay-ts [--paced] [--speed x] [--logconfig file] file.ts
+
+	Data is read with ts_file_reader_t from an epoll loop, as the service thread reads a demux device.
+	The pat, nit, sdt and eit are parsed, and all services in the pat are indexed as in a live buffer:
+	pmt, and the video or audio stream carrying the pcr
+*/
+
+#include "CLI/CLI.hpp"
+#include "tsfilereader.h"
+#include "streamparser/packetstream.h"
+#include "streamparser/psi.h"
+#include "util/logger.h"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace dtdemux;
+
+struct replay_state_t {
+	std::vector<uint16_t> pmt_pids;
+	std::vector<uint16_t> pcr_pids; //pids being indexed
+	std::vector<recdb::marker_t> markers;
+};
+
+static void register_parsers(ts_stream_t& stream, replay_state_t& state) {
+	auto pat_parser = stream.register_pat_pid();
+	pat_parser->section_cb = [&stream, &state](const pat_services_t& pat_services, const subtable_info_t& i) {
+		auto& pmt_pids = state.pmt_pids;
+		for (const auto& e : pat_services.entries) {
+			if (e.service_id == 0 || std::find(pmt_pids.begin(), pmt_pids.end(), e.pmt_pid) != pmt_pids.end())
+				continue; //nit or already registered
+			pmt_pids.push_back(e.pmt_pid);
+			auto pmt_parser = stream.register_pmt_pid(e.pmt_pid, e.service_id);
+			pmt_parser->section_cb = [&stream, &state](pmt_parser_t* parser, const pmt_info_t& pmt, bool isnext,
+																								 const ss::bytebuffer_& sec_data) {
+				using namespace stream_type;
+				auto& pcr_pids = state.pcr_pids;
+				if (isnext || pmt.pcr_pid == null_pid ||
+						std::find(pcr_pids.begin(), pcr_pids.end(), pmt.pcr_pid) != pcr_pids.end())
+					return reset_type_t::NO_RESET; //already indexed, also when services share a pcr pid
+				for (const auto& pidinfo : pmt.pid_descriptors) {
+					if (pmt.pcr_pid != pidinfo.stream_pid)
+						continue;
+					if (is_video(pidinfo.stream_type))
+						stream.register_video_pids(pmt.service_id, pidinfo.stream_pid, pmt.pcr_pid, pidinfo.stream_type);
+					else if (is_audio(pidinfo))
+						stream.register_audio_pids(pmt.service_id, pidinfo.stream_pid, pmt.pcr_pid, pidinfo.stream_type);
+					else
+						continue;
+					pcr_pids.push_back(pmt.pcr_pid);
+				}
+				return reset_type_t::NO_RESET;
+			};
+		}
+		return reset_type_t::NO_RESET;
+	};
+	stream.register_pid<nit_parser_t>(ts_stream_t::NIT_PID, "NIT");
+	stream.register_pid<sdt_bat_parser_t>(ts_stream_t::SDT_PID, "SDT");
+	stream.register_pid<eit_parser_t>(ts_stream_t::EIT_PID, "EIT", chdb::epg_type_t::DVB);
+}
+
+int main(int argc, char** argv) {
+	CLI::App app{"Replay a transport stream through the si parsers and the indexer"};
+	std::string filename;
+	bool paced{false};
+	double speed{1.};
+	std::string logconfig;
+	app.add_option("file", filename, "Transport stream file")->required();
+	app.add_flag("--paced", paced, "Deliver data according to the pcr in the file, as a tuner would");
+	app.add_option("--speed", speed, "Speed factor for paced replay", true);
+	app.add_option("--logconfig", logconfig, "log4cxx configuration file");
+	try {
+		app.parse(argc, argv);
+	} catch (const CLI::ParseError& e) {
+		return app.exit(e);
+	}
+	if (!logconfig.empty())
+		set_logconfig(logconfig.c_str());
+
+	epoll_t epoll;
+	ts_file_reader_t reader(filename.c_str(), paced, speed);
+	if (reader.open(&epoll) < 0)
+		return -1;
+
+	replay_state_t state; //declared before stream, whose parsers refer to it
+	ts_stream_t stream;
+	stream.event_handler.collected_markers = &state.markers;
+	stream.set_batch_dispatch(true);
+	register_parsers(stream, state);
+
+	auto start = steady_clock_t::now();
+	struct epoll_event events[8];
+	while (!reader.at_end()) {
+		int n = epoll.wait(events, sizeof(events) / sizeof(events[0]), 1000);
+		for (int i = 0; i < n; ++i) {
+			if (!reader.on_epoll_event(&events[i]))
+				continue;
+			for (;;) {
+				auto [p, len] = reader.read();
+				if (len <= 0)
+					break;
+				auto num_bytes = len - len % ts_packet_t::size;
+				if (num_bytes == 0) {
+					reader.discard(len); //partial packet at the end of the file
+					break;
+				}
+				stream.set_buffer(p, num_bytes);
+				stream.parse();
+				reader.discard(num_bytes);
+			}
+		}
+	}
+	auto elapsed = std::chrono::duration<double>(steady_clock_t::now() - start).count();
+	reader.close();
+
+	printf("%s:\n", filename.c_str());
+	printf("  %ld bytes in %.3fs: %.1f MB/s, %.0f packets/s\n", reader.num_read, elapsed,
+				 reader.num_read / std::max(elapsed, 1e-6) / 1e6,
+				 reader.num_read / ts_packet_t::size / std::max(elapsed, 1e-6));
+	printf("  %ld sections (%ld repeated sections skipped), %d pmts, %d pcr pids indexed, %ld markers\n",
+				 stream.num_sections, stream.num_duplicate_sections_skipped, (int)state.pmt_pids.size(),
+				 (int)state.pcr_pids.size(), (int64_t)state.markers.size());
+	return 0;
+}
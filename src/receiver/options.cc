@@ -28,6 +28,8 @@ void neumo_options_t::load_from_db(db_txn& devdb_wtxn, int32_t user_id)
 		this->softcam_server = u.softcam_server;
 		this->softcam_port = u.softcam_port;
 		this->softcam_enabled = u.softcam_enabled;
+		this->descrambling_threads = u.descrambling_threads;
+		this->descrambling_latency_target = std::chrono::milliseconds(u.descrambling_latency_target);
 
 		this->usals_location = u.usals_location;
 
@@ -51,6 +53,10 @@ void neumo_options_t::load_from_db(db_txn& devdb_wtxn, int32_t user_id)
 		this->timeshift_duration = std::chrono::seconds(u.timeshift_duration);
 		this->livebuffer_retention_time = std::chrono::seconds(u.livebuffer_retention_time);
 		this->livebuffer_mpm_part_duration = std::chrono::seconds(u.livebuffer_mpm_part_duration);
+		this->livebuffer_use_io_uring = u.livebuffer_use_io_uring;
+		this->livebuffer_spare_parts = u.livebuffer_spare_parts;
+		this->livebuffer_index_commit_delay = std::chrono::milliseconds(u.livebuffer_index_commit_delay);
+		this->livebuffer_mux_capture = u.livebuffer_mux_capture;
 
 	} else {
 		save_to_db(devdb_wtxn, user_id);
@@ -68,6 +74,8 @@ void neumo_options_t::save_to_db(db_txn& devdb_wtxn, int32_t user_id)
 	u.softcam_server = this->softcam_server.c_str();
 	u.softcam_port = this->softcam_port;
 	u.softcam_enabled =	this->softcam_enabled;
+	u.descrambling_threads = this->descrambling_threads;
+	u.descrambling_latency_target = this->descrambling_latency_target.count();
 
 	u.usals_location = this->usals_location;
 
@@ -91,6 +99,10 @@ void neumo_options_t::save_to_db(db_txn& devdb_wtxn, int32_t user_id)
 	u.timeshift_duration = this->timeshift_duration.count();
 	u.livebuffer_retention_time = this->livebuffer_retention_time.count();
 	u.livebuffer_mpm_part_duration = this->livebuffer_mpm_part_duration.count();
+	u.livebuffer_use_io_uring = this->livebuffer_use_io_uring;
+	u.livebuffer_spare_parts = this->livebuffer_spare_parts;
+	u.livebuffer_index_commit_delay = this->livebuffer_index_commit_delay.count();
+	u.livebuffer_mux_capture = this->livebuffer_mux_capture;
 
 	put_record(devdb_wtxn, u);
 }
@@ -53,6 +53,12 @@ struct neumo_options_t {
 	std::string softcam_server{"192.168.2.254"};
 	int softcam_port{9000};
 	bool softcam_enabled{true};
+	int descrambling_threads{0}; //threads shared by all services for descrambling; 0: use each service's own thread
+	std::chrono::milliseconds descrambling_latency_target{100ms}; //how long received data may wait before descrambling
+	bool livebuffer_use_io_uring{false}; //write live buffers with io_uring instead of through a memory map
+	int livebuffer_spare_parts{2}; //number of expired parts a live buffer keeps for reuse
+	std::chrono::milliseconds livebuffer_index_commit_delay{250ms}; //how long new index records may remain uncommitted
+	bool livebuffer_mux_capture{false}; //unscrambled services on one mux share a demux and part files
 	devdb::usals_location_t usals_location;
 	bool tune_use_blind_tune{false};
 	bool positioner_dialog_use_blind_tune{false};
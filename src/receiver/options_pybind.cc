@@ -64,6 +64,22 @@ void export_options(py::module& m) {
 									 "how soon is an inactive timehsift buffer removed")
 		.def_readwrite("livebuffer_mpm_part_duration", &neumo_options_t::livebuffer_mpm_part_duration,
 									 "how quickly live buffers are deleted after they become inactive")
+		.def_readwrite("descrambling_threads", &neumo_options_t::descrambling_threads,
+									 "number of threads used for descrambling services; 0: use each service's own thread")
+		.def_readwrite("descrambling_latency_target", &neumo_options_t::descrambling_latency_target,
+									 "how long received data may wait before being descrambled; larger values descramble more "
+									 "efficiently")
+		.def_readwrite("livebuffer_use_io_uring", &neumo_options_t::livebuffer_use_io_uring,
+									 "write live buffers using io_uring instead of a memory map; reduces stalls when many services "
+									 "are recorded to slow disks")
+		.def_readwrite("livebuffer_spare_parts", &neumo_options_t::livebuffer_spare_parts,
+									 "number of expired live buffer parts kept for reuse; 0: delete expired parts")
+		.def_readwrite("livebuffer_index_commit_delay", &neumo_options_t::livebuffer_index_commit_delay,
+									 "how long new index records may wait before being written to the live buffer's database; "
+									 "larger values mean fewer database commits")
+		.def_readwrite("livebuffer_mux_capture", &neumo_options_t::livebuffer_mux_capture,
+									 "let unscrambled services on the same mux share one demux and one set of live buffer parts; "
+									 "reduces disk writes when several services of a mux are recorded")
 		.def_readwrite("tune_use_blind_tune", &neumo_options_t::tune_use_blind_tune)
 		.def_readwrite("tune_may_move_dish", &neumo_options_t::tune_may_move_dish)
 		.def_readwrite("dish_move_penalty", &neumo_options_t::dish_move_penalty)
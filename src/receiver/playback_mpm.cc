@@ -23,7 +23,10 @@
 #include "receiver.h"
 #include "util/logger.h"
 #include "util/util.h"
+#include "streamparser/tsprescan.h"
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <errno.h>
 #include <filesystem>
 #include <pthread.h>
@@ -91,6 +94,10 @@ void playback_mpm_t::find_current_pmts(int64_t bytepos)
 
 void playback_mpm_t::open_recording(const char* dirname_) {
 	db.reset();
+	seek_index.clear();
+	trick_play_speed = 0;
+	trick_play_ended = false;
+	close_trick_play_file();
 	filemap.init();
 	/*@todo: replace this by removing the init calls altogether
 		init is only called when playing a recording
@@ -146,6 +153,10 @@ void playback_mpm_t::close() {
 		filemap.unmap();
 		filemap.close();
 	}
+	trick_play_speed = 0;
+	trick_play_ended = false;
+	close_trick_play_file();
+	seek_index.clear();
 	db.reset();
 }
 
@@ -216,6 +227,14 @@ void playback_mpm_t::update_pmt(stream_state_t& ss) {
 	std::tie(ss.current_audio_language, ss.current_subtitle_language ) =
 		current_pmt.make_preferred_pmt_ts(preferred_streams_pmt_ts, ss.audio_pref, ss.subtitle_pref);
 	assert(current_pmt.pmt_pid ==  ss.current_streams.pmt_pid);
+	service_pids.reset();
+	for (const auto& pidinfo : current_pmt.pid_descriptors)
+		service_pids.set(pidinfo.stream_pid & 0x1fff);
+	if (current_pmt.pcr_pid != null_pid)
+		service_pids.set(current_pmt.pcr_pid & 0x1fff);
+	//the pat is not sent; the pmt is sent from preferred_streams_pmt_ts
+	service_pids.reset(0);
+	service_pids.reset(current_pmt.pmt_pid & 0x1fff);
 
 	//activate the pmt for ouput
 	num_pmt_bytes_to_send = preferred_streams_pmt_ts.size();
@@ -338,6 +357,11 @@ int playback_mpm_t::move_to_time(milliseconds_t start_play_time) {
 	clear_stream_state();
 	if (start_play_time < milliseconds_t(0))
 		start_play_time = milliseconds_t(0);
+	if (trick_play_speed != 0) {
+		//normal play will be resumed from the time trick play ends
+		start_trick_play(start_play_time);
+		return 0;
+	}
 	dtdebugf("Starting move_to_time");
 	auto idxdb_txn = db->mpm_rec.idxdb.rtxn();
 	auto ret = open_(idxdb_txn, start_play_time);
@@ -397,8 +421,9 @@ int playback_mpm_t::open_(db_txn& idxdb_txn, milliseconds_t start_time) {
 		In case the opened file is still live, end_marker
 	*/
 	recdb::marker_t current_marker;
-	get_end_marker_from_db(idxdb_txn, end_marker);
-	if (start_time >= end_marker.k.time || get_marker_for_time_from_db(idxdb_txn, current_marker, start_time) < 0) {
+	auto& idxdb = db->mpm_rec.idxdb;
+	seek_index.end_marker(idxdb, end_marker);
+	if (start_time >= end_marker.k.time || seek_index.marker_for_time(idxdb, current_marker, start_time) < 0) {
 		dtdebugf("Requested start_play_time is beyond last logged packet");
 		if (live_mpm) {
 			auto mm = live_mpm->meta_marker.readAccess();
@@ -697,6 +722,8 @@ std::tuple<int, int> playback_mpm_t::read_data_(char* outbuffer, int outbytes, i
 int64_t playback_mpm_t::read_data(char* outbuffer, uint64_t num_bytes) {
 	if (error || num_bytes == 0)
 		return 0;
+	if (trick_play_speed != 0)
+		return read_trick_play_data(outbuffer, num_bytes);
 	int num_bytes_read{0};
 	while(num_bytes_read == 0 && !must_exit && !error) {
     /*below, read_data_live_ and read_data_nonlive_ can read 0 bytes
@@ -831,14 +858,7 @@ int64_t playback_mpm_t::read_data_from_current_file(uint8_t*& buffer) {
 
 
 milliseconds_t playback_mpm_t::get_current_play_time() const {
-	auto txn = db->mpm_rec.idxdb.rtxn();
-	{
-		auto c = recdb::marker_t::find_by_packetno(txn, current_byte_pos / ts_packet_t::size, find_leq);
-		if (!c.is_valid())
-			return milliseconds_t(0);
-		auto m = c.current();
-		return m.k.time;
-	}
+	return seek_index.time_for_packetno(db->mpm_rec.idxdb, current_byte_pos / ts_packet_t::size);
 }
 
 
@@ -916,19 +936,490 @@ int playback_mpm_t::get_end_marker_from_db(db_txn& txn, recdb::marker_t& end_mar
 	return 0;
 }
 
-int playback_mpm_t::get_marker_for_time_from_db(db_txn& idxdb_txn, recdb::marker_t& current_marker,
-																								milliseconds_t start_play_time) {
+void seek_index_t::clear() {
+	std::scoped_lock lck(mutex);
+	parts.clear();
+}
+
+db_txn& seek_index_t::get_txn(recdb::recdb_t& idxdb) {
+	if (!txn)
+		txn.emplace(idxdb.rtxn());
+	return *txn;
+}
+
+/*
+	(re)read the list of parts, keeping the markers already loaded
+*/
+void seek_index_t::load_parts(recdb::recdb_t& idxdb) {
+	using namespace recdb;
+	auto& txn = get_txn(idxdb);
+	std::vector<part_t> new_parts;
+	size_t j = 0;
+	auto c = find_first<recdb::file_t>(txn);
+	for (const auto& f : c.range()) {
+		while (j < parts.size() && parts[j].fileno < (int)f.fileno)
+			++j; // part has been deleted
+		part_t p;
+		if (j < parts.size() && parts[j].fileno == (int)f.fileno)
+			p = std::move(parts[j]);
+		p.fileno = f.fileno;
+		p.stream_time_start = f.k.stream_time_start;
+		p.stream_packetno_start = f.stream_packetno_start;
+		p.growing = f.stream_time_end == std::numeric_limits<milliseconds_t>::max();
+		new_parts.push_back(std::move(p));
+	}
+	parts = std::move(new_parts);
+	/*a part loaded while it was the last one, may contain the first markers of the next part, which
+		start at the same time the part ends*/
+	for (int i = 0; i + 1 < (int)parts.size(); ++i) {
+		auto& p = parts[i];
+		if (p.complete)
+			continue;
+		auto n = std::lower_bound(p.times.begin(), p.times.end(), (int64_t)parts[i + 1].stream_time_start) -
+			p.times.begin();
+		p.times.resize(n);
+		p.packetnos_start.resize(n);
+		p.packetnos_end.resize(n);
+	}
+}
+
+/*
+	load the markers of a part, or the markers not yet loaded of a part which was still growing
+*/
+void seek_index_t::load_markers(recdb::recdb_t& idxdb, int part_idx) {
+	using namespace recdb;
+	auto& txn = get_txn(idxdb);
+	auto& p = parts[part_idx];
+	bool has_next = part_idx + 1 < (int)parts.size();
+	// markers before the start of the first part are included in the first part
+	auto from = !p.times.empty() ? milliseconds_t(p.times.back()) : part_idx > 0 ? p.stream_time_start : milliseconds_t(0);
+	auto c = marker_t::find_by_key(txn, marker_key_t(from), find_geq);
+	for (const auto& m : c.range()) {
+		if (has_next && m.k.time >= parts[part_idx + 1].stream_time_start)
+			break;
+		if (!p.times.empty() && (int64_t)m.k.time <= p.times.back())
+			continue;
+		p.times.push_back((int64_t)m.k.time);
+		p.packetnos_start.push_back(m.packetno_start);
+		p.packetnos_end.push_back(m.packetno_end);
+	}
+	p.loaded = true;
+	p.complete = !p.growing;
+}
+
+/*
+	load newer parts and markers of a live buffer; returns false if nothing can have changed
+*/
+bool seek_index_t::refresh(recdb::recdb_t& idxdb) {
+	if (!parts.empty() && !parts.back().growing)
+		return false;
+	load_parts(idxdb);
+	for (int i = 0; i < (int)parts.size(); ++i) {
+		if (parts[i].loaded && !parts[i].complete)
+			load_markers(idxdb, i);
+	}
+	return true;
+}
+
+int seek_index_t::part_for_time(milliseconds_t play_time) const {
+	auto it = std::upper_bound(parts.begin(), parts.end(), play_time,
+														 [](milliseconds_t t, const part_t& p) { return t < p.stream_time_start; });
+	return std::max(0, int(it - parts.begin()) - 1);
+}
+
+int seek_index_t::part_for_packetno(int64_t packetno) const {
+	auto it = std::upper_bound(parts.begin(), parts.end(), packetno,
+														 [](int64_t packetno, const part_t& p) { return packetno < p.stream_packetno_start; });
+	return std::max(0, int(it - parts.begin()) - 1);
+}
+
+int seek_index_t::marker_for_time(recdb::recdb_t& idxdb, recdb::marker_t& marker, milliseconds_t play_time) {
+	std::scoped_lock lck(mutex);
+	if (parts.empty())
+		load_parts(idxdb);
+	int ret = -1;
+	bool refreshed = false;
+	for (int i = part_for_time(play_time); i < (int)parts.size(); ++i) {
+		auto& p = parts[i];
+		if (!p.loaded)
+			load_markers(idxdb, i);
+		auto it = std::lower_bound(p.times.begin(), p.times.end(), (int64_t)play_time);
+		if (it != p.times.end()) {
+			marker = p.marker(it - p.times.begin());
+			ret = 0;
+			break;
+		}
+		if (i + 1 == (int)parts.size() && !refreshed) {
+			refreshed = true;
+			if (refresh(idxdb))
+				i = std::max(-1, part_for_time(play_time) - 1); // retry with the new data
+		}
+	}
+	txn.reset();
+	if (ret < 0)
+		dtdebugf("Could not obtain marker for time {}", play_time);
+	return ret;
+}
+
+int seek_index_t::end_marker(recdb::recdb_t& idxdb, recdb::marker_t& marker) {
+	std::scoped_lock lck(mutex);
+	if (parts.empty())
+		load_parts(idxdb);
+	else
+		refresh(idxdb);
+	int ret = -1;
+	for (int i = parts.size() - 1; i >= 0; --i) {
+		auto& p = parts[i];
+		if (!p.loaded)
+			load_markers(idxdb, i);
+		if (!p.times.empty()) {
+			marker = p.marker(p.times.size() - 1);
+			ret = 0;
+			break;
+		}
+	}
+	txn.reset();
+	if (ret < 0)
+		dterrorf("Could not obtain last marker");
+	return ret;
+}
+
+milliseconds_t seek_index_t::time_for_packetno(recdb::recdb_t& idxdb, int64_t packetno) {
+	std::scoped_lock lck(mutex);
+	if (parts.empty())
+		load_parts(idxdb);
+	milliseconds_t ret{0};
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		//the first marker of the next part may start in this part
+		int i = std::min(part_for_packetno(packetno) + 1, (int)parts.size() - 1);
+		int idx = -1;
+		for (; i >= 0; --i) {
+			auto& p = parts[i];
+			if (!p.loaded)
+				load_markers(idxdb, i);
+			idx = std::upper_bound(p.packetnos_start.begin(), p.packetnos_start.end(), packetno) -
+				p.packetnos_start.begin() - 1;
+			if (idx >= 0)
+				break;
+		}
+		if (i < 0)
+			break;
+		auto& p = parts[i];
+		ret = milliseconds_t(p.times[idx]);
+		//a newer marker may start before packetno, if it has not been loaded yet
+		bool may_have_newer = i + 1 == (int)parts.size() && idx + 1 == (int)p.times.size();
+		if (!may_have_newer || attempt > 0 || !refresh(idxdb))
+			break;
+	}
+	txn.reset();
+	return ret;
+}
+
+/*
+	Trick play.
+	Each frame sent to mpv is the I-frame of the first marker at or after trick_play_time, which moves by
+	trick_play_speed * trick_play_frame_interval per frame. Only the packets in the marker's range are read
+	from disk, and of those only the video packets of the first picture are kept. Each frame is preceded by
+	a synthesized pcr packet, and pcr, pts, dts and continuity counters are rewritten, so that mpv sees
+	a regular stream of I-frames, one per trick_play_frame_interval, with increasing timestamps also when
+	rewinding. If the marker does not change (low speed, long gop), the previous frame is sent again.
+*/
+
+static void write_pes_timestamp(uint8_t* p, int64_t ts) {
+	ts &= (int64_t(1) << 33) - 1;
+	p[0] = (p[0] & 0xf0) | ((ts >> 29) & 0x0e) | 0x01;
+	p[1] = ts >> 22;
+	p[2] = ((ts >> 14) & 0xfe) | 0x01;
+	p[3] = ts >> 7;
+	p[4] = ((ts << 1) & 0xfe) | 0x01;
+}
+
+static void write_pcr(uint8_t* p, int64_t pcr) {
+	pcr &= (int64_t(1) << 33) - 1;
+	p[0] = pcr >> 25;
+	p[1] = pcr >> 17;
+	p[2] = pcr >> 9;
+	p[3] = pcr >> 1;
+	p[4] = ((pcr & 1) << 7) | 0x7e; //extension = 0
+	p[5] = 0;
+}
+
+int playback_mpm_t::set_trick_play(int speed) {
+	if (speed != 0 && (std::abs(speed) < 2 || std::abs(speed) > 64)) {
+		dterrorf("Unsupported trick play speed {:d}", speed);
+		return -1;
+	}
+	if (speed != 0 && current_pmt.video_pid == null_pid) {
+		dterrorf("Trick play needs a video stream");
+		return -1;
+	}
+	trick_play_ended = false;
+	if (speed == 0) {
+		if (trick_play_speed == 0)
+			return 0;
+		trick_play_speed = 0;
+		close_trick_play_file();
+		return move_to_time(trick_play_time);
+	}
+	dtdebugf("Trick play speed={:d}", speed);
+	auto play_time = trick_play_speed == 0 ? get_current_play_time() : trick_play_time;
+	if (live_mpm)
+		is_timeshifted = true;
+	trick_play_speed = speed;
+	start_trick_play(play_time);
+	return 0;
+}
+
+/*
+	(re)start sending frames at play_time; mpv has reopened the stream, so a new pmt
+	and a new time line are needed
+*/
+void playback_mpm_t::start_trick_play(milliseconds_t play_time) {
+	//next_trick_play_frame advances the time before selecting a frame
+	trick_play_time = play_time - milliseconds_t(trick_play_speed * (int64_t)trick_play_frame_interval.count());
+	trick_play_frame.clear();
+	trick_play_frame_pos = 0;
+	trick_play_pts = 90000;
+	trick_play_cc = 0;
+	num_pmt_bytes_to_send = preferred_streams_pmt_ts.size();
+}
 
-	auto c = recdb::marker_t::find_by_key(idxdb_txn, recdb::marker_key_t(start_play_time), find_geq);
+/*
+	Resume normal play when trick play has reached the start or the end of the available data
+*/
+void playback_mpm_t::end_trick_play(milliseconds_t play_time, bool at_end) {
+	dtdebugf("Trick play ends at {}", play_time);
+	trick_play_speed = 0;
+	close_trick_play_file();
+	if (at_end && live_mpm)
+		move_to_live();
+	else
+		move_to_time(play_time);
+	//the data sent so far has trick play timestamps
+	trick_play_ended = true;
+}
+
+/*
+	Called after mpv has reopened the stream because trick play ended by itself: restart normal play,
+	with a new pmt, where trick play ended
+*/
+int playback_mpm_t::resume_after_trick_play() {
+	if (trick_play_speed != 0)
+		return 0; //trick play was restarted in the mean time
+	if (live_mpm && !is_timeshifted)
+		return move_to_live();
+	return move_to_time(get_current_play_time());
+}
+
+void playback_mpm_t::close_trick_play_file() {
+	if (trick_play_fd >= 0)
+		::close(trick_play_fd);
+	trick_play_fd = -1;
+	trick_play_file = {};
+}
+
+/*
+	make trick_play_fd refer to the file part containing the start of marker
+*/
+int playback_mpm_t::open_trick_play_file(db_txn& idxdb_txn, const recdb::marker_t& marker) {
+	int64_t packetno = marker.packetno_start;
+	//the end of a growing part is not known yet, so its record is reread
+	if (trick_play_fd >= 0 && packetno >= trick_play_file.stream_packetno_start &&
+			packetno < trick_play_file.stream_packetno_end &&
+			trick_play_file.stream_packetno_end != std::numeric_limits<int64_t>::max())
+		return 0;
+	using namespace recdb;
+	auto c = file_t::find_by_key(idxdb_txn, file_key_t(marker.k.time), find_leq);
+	if (!c.is_valid())
+		c = find_first<recdb::file_t>(idxdb_txn);
+	//the first marker of a part can start in the previous part
+	while (c.is_valid() && packetno < c.current().stream_packetno_start)
+		c.prev();
 	if (!c.is_valid()) {
-		dtdebugf("Could not obtain marker for time {}", start_play_time);
+		dtdebugf("Could not find file containing packet {:d}", packetno);
 		return -1;
 	}
-	current_marker = c.current();
+	auto f = c.current();
+	if (trick_play_fd >= 0 && f.fileno == trick_play_file.fileno) {
+		trick_play_file = f;
+		return 0;
+	}
+	close_trick_play_file();
+	ss::string<128> filename;
+	filename.format("{:s}/{:s}", dirname, f.filename);
+	for (;;) {
+		trick_play_fd = ::open(filename.c_str(), O_RDONLY);
+		if (trick_play_fd < 0 && errno == EINTR)
+			continue;
+		break;
+	}
+	if (trick_play_fd < 0) {
+		dtdebugf("Could not open data file {}: {}", filename, strerror(errno));
+		return -1;
+	}
+	trick_play_file = f;
+	return 0;
+}
 
+/*
+	Read the packets in the range of marker and replace trick_play_frame by the video packets
+	of the first picture in that range. Returns -1 if no picture was found, keeping the old frame
+*/
+int playback_mpm_t::read_trick_play_frame(const recdb::marker_t& marker) {
+	auto idxdb_txn = db->mpm_rec.idxdb.rtxn();
+	auto ret = open_trick_play_file(idxdb_txn, marker);
+	idxdb_txn.abort();
+	if (ret < 0)
+		return -1;
+	int64_t len = ((int64_t)marker.packetno_end - (int64_t)marker.packetno_start) * ts_packet_t::size;
+	if (len <= 0 || len > max_trick_play_frame_size) {
+		dtdebugf("Skipping marker at {} of {:d} bytes", marker.k.time, len);
+		return -1;
+	}
+	trick_play_input.resize(len);
+	off_t offset = (marker.packetno_start - trick_play_file.stream_packetno_start) * ts_packet_t::size;
+	int64_t n = 0;
+	while (n < len) {
+		auto r = ::pread(trick_play_fd, trick_play_input.data() + n, len - n, offset + n);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break; // error, or the range continues in the next part; use what we have
+		n += r;
+	}
+
+	//keep the video packets of the first picture, moving them to the start of trick_play_input
+	uint16_t video_pid = current_pmt.video_pid;
+	int64_t num_kept = 0;
+	bool in_picture = false;
+	for (int64_t pos = 0; pos + ts_packet_t::size <= n; pos += ts_packet_t::size) {
+		auto* p = &trick_play_input[pos];
+		uint16_t pid = ((p[1] & 0x1f) << 8) | p[2];
+		if (p[0] != 0x47 || pid != video_pid || (p[1] & 0x80) /*transport error*/ || (p[3] & 0xc0) /*scrambled*/)
+			continue;
+		if (p[1] & 0x40) { //payload unit start: start of a pes packet, i.e., of a picture
+			if (in_picture)
+				break;
+			in_picture = true;
+		}
+		if (!in_picture)
+			continue; //end of the previous picture
+		if (pos != num_kept)
+			memcpy(&trick_play_input[num_kept], p, ts_packet_t::size);
+		num_kept += ts_packet_t::size;
+	}
+	if (num_kept == 0) {
+		dtdebugf("No picture found in marker at {}", marker.k.time);
+		return -1;
+	}
+
+	//pcr packet, followed by the picture
+	uint16_t pcr_pid = current_pmt.pcr_pid == null_pid ? video_pid : current_pmt.pcr_pid;
+	trick_play_frame.resize(ts_packet_t::size + num_kept);
+	auto* p = trick_play_frame.data();
+	p[0] = 0x47;
+	p[1] = (pcr_pid >> 8) & 0x1f;
+	p[2] = pcr_pid & 0xff;
+	p[3] = 0x20; //adaptation field only
+	p[4] = ts_packet_t::size - 5; //adaptation field length
+	p[5] = 0x10; //pcr present
+	memset(p + 6, 0, 6);
+	memset(p + 12, 0xff, ts_packet_t::size - 12); //stuffing
+	memcpy(p + ts_packet_t::size, trick_play_input.data(), num_kept);
+	return 0;
+}
+
+/*
+	Give trick_play_frame the timestamps of the next frame interval
+*/
+void playback_mpm_t::restamp_trick_play_frame() {
+	trick_play_pts += (int64_t)trick_play_frame_interval.count() * 90;
+	//give mpv time to decode the frame before it must be shown
+	auto pcr = trick_play_pts - 2 * (int64_t)trick_play_frame_interval.count() * 90;
+	uint16_t video_pid = current_pmt.video_pid;
+	for (size_t pos = 0; pos < trick_play_frame.size(); pos += ts_packet_t::size) {
+		auto* p = &trick_play_frame[pos];
+		uint16_t pid = ((p[1] & 0x1f) << 8) | p[2];
+		bool has_payload = p[3] & 0x10;
+		if (pid == video_pid) {
+			if (has_payload)
+				trick_play_cc = (trick_play_cc + 1) & 0xf;
+			p[3] = (p[3] & 0xf0) | trick_play_cc;
+		}
+		int payload_offset = 4;
+		if (p[3] & 0x20) {
+			if (p[4] > 0 && (p[5] & 0x10))
+				write_pcr(p + 6, pcr);
+			payload_offset += 1 + p[4];
+		}
+		auto* pes = p + payload_offset;
+		if (!has_payload || !(p[1] & 0x40) || payload_offset + 14 > ts_packet_t::size ||
+				pes[0] != 0 || pes[1] != 0 || pes[2] != 1)
+			continue;
+		auto pts_dts_flags = pes[7] & 0xc0;
+		//an I-frame on its own is decoded when it is shown, so dts = pts
+		if (pts_dts_flags & 0x80)
+			write_pes_timestamp(pes + 9, trick_play_pts);
+		if (pts_dts_flags == 0xc0 && payload_offset + 19 <= ts_packet_t::size)
+			write_pes_timestamp(pes + 14, trick_play_pts);
+	}
+}
+
+/*
+	Move to the next frame interval, and prepare the frame to send in it.
+	Returns -1 when the start or end of the available data has been reached, after resuming normal play
+*/
+int playback_mpm_t::next_trick_play_frame() {
+	auto& idxdb = db->mpm_rec.idxdb;
+	trick_play_time += milliseconds_t(trick_play_speed * (int64_t)trick_play_frame_interval.count());
+	recdb::marker_t start_marker;
+	recdb::marker_t end_marker;
+	if (seek_index.marker_for_time(idxdb, start_marker, milliseconds_t(0)) < 0 ||
+			seek_index.end_marker(idxdb, end_marker) < 0) {
+		end_trick_play(trick_play_time, true);
+		return -1;
+	}
+	if (trick_play_time < start_marker.k.time) {
+		end_trick_play(start_marker.k.time, false);
+		return -1;
+	}
+	recdb::marker_t marker;
+	if (trick_play_time >= end_marker.k.time || seek_index.marker_for_time(idxdb, marker, trick_play_time) < 0) {
+		end_trick_play(end_marker.k.time, true);
+		return -1;
+	}
+	if ((trick_play_frame.empty() || marker.packetno_start != trick_play_marker.packetno_start) &&
+			read_trick_play_frame(marker) >= 0) {
+		trick_play_marker = marker;
+		current_byte_pos = marker.packetno_start * (int64_t)ts_packet_t::size;
+	}
+	trick_play_frame_pos = 0;
+	if (!trick_play_frame.empty())
+		restamp_trick_play_frame();
 	return 0;
 }
 
+/*
+	read_data while in trick play
+ */
+int64_t playback_mpm_t::read_trick_play_data(char* outbuffer, uint64_t num_bytes) {
+	if (num_bytes < ts_packet_t::size && num_pmt_bytes_to_send <= 0)
+		num_pmt_bytes_to_send = preferred_streams_pmt_ts.size(); //see read_data
+	if (num_pmt_bytes_to_send > 0)
+		return read_pmt_data(outbuffer, num_bytes);
+	while (trick_play_frame_pos == (int)trick_play_frame.size()) {
+		if (must_exit || error)
+			return -1;
+		if (next_trick_play_frame() < 0)
+			return read_data(outbuffer, num_bytes);
+	}
+	int64_t n = std::min((int64_t)num_bytes, (int64_t)trick_play_frame.size() - trick_play_frame_pos);
+	n -= n % ts_packet_t::size;
+	memcpy(outbuffer, trick_play_frame.data() + trick_play_frame_pos, n);
+	trick_play_frame_pos += n;
+	return n;
+}
+
 int64_t  playback_mpm_t::read_pmt_data(char* outbuffer, uint64_t num_bytes) {
 	auto ls = stream_state.readAccess();
 	if(num_pmt_bytes_to_send < 0 ) {
@@ -949,37 +1440,63 @@ int64_t  playback_mpm_t::read_pmt_data(char* outbuffer, uint64_t num_bytes) {
 }
 
 /*
-	copy full packets to the mpv buffer, discarding pmt packets
+	Returns a mask with bit i set if packet i of the num_packets (at most 64) packets at buffer
+	does not have one of the given pids
+*/
+static inline uint64_t match_other_pids(const uint8_t* buffer, int num_packets, const std::bitset<8192>& pids) {
+	uint64_t ret{0};
+	for (int i = 0; i < num_packets; ++i, buffer += dtdemux::ts_packet_t::size) {
+		uint16_t pid = ((buffer[1] & 0x1f) << 8) | buffer[2];
+		ret |= uint64_t(!pids.test(pid)) << i;
+	}
+	return ret;
+}
+
+/*
+	copy full packets to the mpv buffer, discarding pat and pmt packets, and, for a part made by a mux capture,
+	packets of pids which are not in the pmt
 	inbytes = number of bytes that are available and allowed to read in inbuffer
 	outbytes = number of bytes available in outbuffer
 	Returns number of bytes placed in outbuffer,  and number of bytes read from inbuffer
 	Both can be smaller than min(inbytes, outbytes) if last input packet
 	is not yet complete and/or because some input packets are discarded
 	The number of packets read/written can also equal zero
+
+	Packets to discard are found 64 at a time; the runs of packets in between
+	are copied with a single memcpy each. mpv reads through a callback which fills its own buffer,
+	so this copy out of the mapped file is the only one
  */
 std::tuple<int,int> playback_mpm_t::copy_filtered_packets(char* outbuffer, uint8_t* inbuffer, int outbytes, int inbytes)
 {
-	inbytes -= inbytes % ts_packet_t::size;
-	outbytes -= outbytes % ts_packet_t::size;
 	auto ls = stream_state.readAccess();
+	//only parts of a mux capture contain other services; without a pmt, only pat and pmt can be recognised
+	bool filter_service_pids = currently_playing_file.readAccess()->mux_capture && service_pids.any();
 
-	if(inbytes<=0)
+	int num_in = inbytes / ts_packet_t::size;
+	int num_out = outbytes / ts_packet_t::size;
+	if(num_in <= 0)
 		return {0, 0};
-	auto *inptr = inbuffer;
-	auto *inptr_end = inptr + inbytes;
-	auto *outptr = outbuffer;
-	auto *outptr_end = outptr + outbytes;
-	int num_read{0};
-
-	for (; inptr < inptr_end && outptr < outptr_end; inptr +=  dtdemux::ts_packet_t::size) {
-		int pid = (((uint16_t)(inptr[1] & 0x1f)) << 8) | inptr[2];
-		if (pid == current_pmt.pmt_pid || pid == 0 /*pat*/)
-			continue;
-		memcpy(outptr, inptr, dtdemux::ts_packet_t::size);
-		outptr += dtdemux::ts_packet_t::size;
-		num_read += dtdemux::ts_packet_t::size;
+	int i{0}; //packets read
+	int o{0}; //packets written
+	while (i < num_in && o < num_out) {
+		int n = std::min(64, num_in - i);
+		auto* p = inbuffer + i * ts_packet_t::size;
+		auto drop = filter_service_pids ? match_other_pids(p, n, service_pids)
+			: dtdemux::match_pids(p, n, current_pmt.pmt_pid, 0 /*pat*/);
+		int j = 0;
+		while (j < n && o < num_out) {
+			if ((drop >> j) & 1) {
+				j += std::countr_zero(~(drop >> j)); // skip a run of discarded packets
+				continue;
+			}
+			int run = std::min({std::countr_zero(drop >> j), n - j, num_out - o});
+			memcpy(outbuffer + o * ts_packet_t::size, inbuffer + (i + j) * ts_packet_t::size, run * ts_packet_t::size);
+			o += run;
+			j += run;
+		}
+		i += j;
 	}
-	return {num_read, inptr - inbuffer};
+	return {o * ts_packet_t::size, i * ts_packet_t::size};
 }
 
 
@@ -407,6 +407,9 @@ int receiver_thread_t::exit() {
 	dtdebugf("Receiver thread exiting -stopping recmgr");
 	receiver.rec_manager.recmgr_thread.stop_running(true);
 
+	dtdebugf("Receiver thread exiting -waiting for recordings to be copied");
+	receiver.rec_manager.finalizer.stop();
+
 	dtdebugf("Receiver thread exiting -stopping tuner threads");
 	{
 		auto w = active_adapters.writeAccess();
@@ -2063,6 +2066,10 @@ neumo_options_t receiver_t::get_options() {
 	return *r;
 }
 
+std::vector<finalizer_progress_t> receiver_t::get_finalizer_progress() {
+	return rec_manager.finalizer.get_progress();
+}
+
 time_t receiver_thread_t::scan_start_time() const {
 	auto scanner = get_scanner();
 	return scanner.get() ? scanner->scan_start_time : -1;
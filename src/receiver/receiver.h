@@ -606,6 +606,11 @@ public:
 
 	EXPORT neumo_options_t get_options();
 
+	/*
+		progress of copying finished recordings from the live buffers into the recordings directory
+	*/
+	EXPORT std::vector<finalizer_progress_t> get_finalizer_progress();
+
 	inline time_t scan_start_time() const {
 		return receiver_thread.scan_start_time();
 	}
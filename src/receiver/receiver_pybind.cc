@@ -26,6 +26,7 @@
 #include "viewer/wxpy_api.h"
 #include "receiver/receiver.h"
 #include "receiver/scan.h"
+#include "receiver/indexrebuild.h"
 #include "neumodb/chdb/chdb_extra.h"
 #include "subscriber_pybind.h"
 #include "util/identification.h"
@@ -114,6 +115,46 @@ static void export_receiver(py::module& m) {
 		.def("set_process_name", &set_process_name, "Set process name",
 				 py::arg("name"))
 		;
+	py::class_<finalizer_progress_t>(m, "finalizer_progress_t")
+		.def(py::init())
+		.def_readonly("recording", &finalizer_progress_t::recording, "directory of the recording")
+		.def_readonly("num_files", &finalizer_progress_t::num_files)
+		.def_readonly("num_files_done", &finalizer_progress_t::num_files_done)
+		.def_readonly("num_bytes", &finalizer_progress_t::num_bytes)
+		.def_readonly("num_bytes_done", &finalizer_progress_t::num_bytes_done)
+		.def_readonly("num_errors", &finalizer_progress_t::num_errors, "number of parts which could not be copied")
+		.def_readonly("done", &finalizer_progress_t::done)
+		;
+	py::class_<index_rebuild_region_t>(m, "index_rebuild_region_t")
+		.def_readonly("packetno_start", &index_rebuild_region_t::packetno_start)
+		.def_readonly("packetno_end", &index_rebuild_region_t::packetno_end)
+		.def_readonly("stream_time_start", &index_rebuild_region_t::stream_time_start, "in milliseconds")
+		.def_readonly("stream_time_end", &index_rebuild_region_t::stream_time_end, "in milliseconds")
+		;
+	py::class_<index_rebuild_report_t>(m, "index_rebuild_report_t")
+		.def_readonly("recording", &index_rebuild_report_t::recording)
+		.def_readonly("error", &index_rebuild_report_t::error, "empty on success")
+		.def_readonly("index_written", &index_rebuild_report_t::index_written)
+		.def_readonly("num_threads", &index_rebuild_report_t::num_threads)
+		.def_readonly("num_parts", &index_rebuild_report_t::num_parts)
+		.def_readonly("num_packets", &index_rebuild_report_t::num_packets)
+		.def_readonly("num_bytes", &index_rebuild_report_t::num_bytes)
+		.def_readonly("num_bytes_skipped", &index_rebuild_report_t::num_bytes_skipped)
+		.def_readonly("num_markers", &index_rebuild_report_t::num_markers)
+		.def_readonly("num_stream_descriptors", &index_rebuild_report_t::num_stream_descriptors)
+		.def_readonly("num_cc_errors", &index_rebuild_report_t::num_cc_errors)
+		.def_readonly("num_scrambled_packets", &index_rebuild_report_t::num_scrambled_packets)
+		.def_readonly("undecrypted_regions", &index_rebuild_report_t::undecrypted_regions)
+		.def_readonly("duration", &index_rebuild_report_t::duration, "play time in milliseconds")
+		.def_readonly("elapsed", &index_rebuild_report_t::elapsed, "duration of the scan in seconds")
+		;
+	m.def("rebuild_recording_index",
+				[](const std::string& recording_dir, int num_threads, bool write_index) {
+					return rebuild_recording_index(recording_dir, num_threads, write_index);
+				},
+				"Rebuild the index of a recording from its parts, or only check it if write_index is False",
+				py::arg("recording_dir"), py::arg("num_threads") = 0, py::arg("write_index") = true,
+				py::call_guard<py::gil_scoped_release>());
 	py::class_<receiver_t>(m, "receiver_t")
 		.def(py::init<neumo_options_t*>(), py::arg("neumo_options"), "Start a NeumoDVB receiver")
 		//unsubscribe is needed to abort mux scan in progress
@@ -145,6 +186,8 @@ static void export_receiver(py::module& m) {
 				 py::arg("subscription_type"))
 		.def("get_api_type", &receiver_t::get_api_type)
 		.def("get_options", &receiver_t::get_options)
+		.def("get_finalizer_progress", &receiver_t::get_finalizer_progress,
+				 "Progress of copying finished recordings into the recordings directory")
 		.def("set_options", &receiver_t::set_options, py::arg("options"))
 		.def(
 			"get_spectrum_path",
@@ -177,6 +220,8 @@ PYBIND11_MODULE(pyreceiver, m) {
 	export_position_motion_report(m);
 	export_sdt_data(m);
 	export_scan_report(m);
+	export_pid_stats(m);
+	export_decrypt_stats(m);
 	export_logger(m);
 	export_live_history(m);
 	export_recording_history(m);
@@ -768,7 +768,7 @@ void recmgr_thread_t::stop_recording(const recdb::rec_t& rec) // important that
 	}).wait();
 	if (ret >= 0) {
 		assert(copy_list.rec.epg.rec_status == epgdb::rec_status_t::FINISHED);
-		copy_list.run();
+		recmgr.finalizer.submit(copy_list);
 	}
 	copy_list.rec.subscription_id = -1;
 	copy_list.rec.owner = -1;
@@ -24,6 +24,7 @@
 #include "neumodb/epgdb/epgdb_extra.h"
 #include "neumodb/recdb/recdb_extra.h"
 #include "txnmgr.h"
+#include "finalizer.h"
 
 class receiver_t;
 class active_service_t;
@@ -125,6 +126,7 @@ class rec_manager_t {
 	txnmgr_t<recdb::recdb_t> recdbmgr;
 public:
 	recmgr_thread_t recmgr_thread;
+	recording_finalizer_t finalizer; //copies finished recordings out of the live buffers
 	receiver_t& receiver;
 private:
 public:
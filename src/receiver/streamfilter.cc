@@ -381,7 +381,7 @@ inline bool embedded_stream_reader_t::on_epoll_event(const epoll_event* evt) {
 
 embedded_stream_reader_t::embedded_stream_reader_t(active_adapter_t& active_adapter,
 																									 const std::shared_ptr<stream_filter_t>& stream_filter)
-	: stream_reader_t(active_adapter), stream_filter(stream_filter) {}
+	: stream_reader_t(active_adapter), stream_filter(stream_filter), active_adapter(active_adapter) {}
 
 int embedded_stream_reader_t::embedded_stream_pid() const {
 	return mux_key_ptr(stream_filter->embedded_mux)->t2mi_pid; }
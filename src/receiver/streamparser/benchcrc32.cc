@@ -0,0 +1,66 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Benchmark of the crc32 implementations for typical section sizes
+	benchcrc32 [total_megabytes]
+*/
+
+#include "crc32.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace dtdemux;
+
+int main(int argc, char** argv) {
+	int64_t total = (argc > 1 ? atoi(argv[1]) : 256) * (int64_t)1024 * 1024;
+	std::vector<uint8_t> data(4096);
+	for (auto& x : data)
+		x = random();
+
+	const crc_impl_t impls[] = {crc_impl_t::TABLE, crc_impl_t::SLICE8, crc_impl_t::SLICE16, crc_impl_t::PCLMUL};
+	const char* names[] = {"table", "slice8", "slice16", "pclmul"};
+	printf("%8s", "size");
+	for (auto* name : names)
+		printf(" %10s", name);
+	printf("   (MB/s)\n");
+	for (int size : {32, 184, 1024, 4093}) {
+		printf("%8d", size);
+		int64_t num = total / size;
+		for (auto impl : impls) {
+			if (impl == crc_impl_t::PCLMUL && crc32_best_impl() != crc_impl_t::PCLMUL) {
+				printf(" %10s", "-");
+				continue;
+			}
+			uint32_t sum{0};
+			auto start = std::chrono::steady_clock::now();
+			for (int64_t i = 0; i < num; ++i)
+				sum += crc32_update(0xffffffff, data.data(), size, impl);
+			auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf(" %10.0f", num * size / t / 1e6);
+			if (sum == 1)
+				printf("!"); //prevent optimising away
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Microbenchmark for find_start_code_prefix: compares the scalar, sse2 and avx2 implementations
+	and checks that they return the same results, at all alignments.
+	benchstartcode [file.ts [pid]] [repeats]
+
+	Without a file, random data is used with start codes inserted at typical nal unit distances.
+	With a file, the payload of the given pid (default: the pid with the most packets) is used, with
+	the payload of each packet searched separately, as ts_substream_t::next_start_code does.
+*/
+
+#include "startcode.h"
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace dtdemux;
+
+static const startcode_impl_t impls[] = {startcode_impl_t::SCALAR, startcode_impl_t::SSE2, startcode_impl_t::AVX2};
+static const char* names[] = {"scalar", "sse2", "avx2"};
+
+static int64_t find_reference(const uint8_t* p, int64_t len) {
+	for (int64_t i = 0; i + 2 < len; ++i)
+		if (p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1)
+			return i;
+	return -1;
+}
+
+static std::vector<uint8_t> make_random(int64_t size) {
+	std::vector<uint8_t> data(size);
+	for (auto& x : data) {
+		x = random();
+		if (random() % 8 == 0)
+			x = 0; //many zero bytes, as in real streams
+	}
+	for (int64_t pos = 0; pos + 4 < size; pos += 500 + random() % 20000) {
+		data[pos] = 0;
+		data[pos + 1] = 0;
+		data[pos + 2] = 1;
+	}
+	return data;
+}
+
+/*
+	Concatenated payloads of all packets of pid. sizes receives the payload size of each packet
+*/
+static std::vector<uint8_t> read_payload(const char* filename, int pid, std::vector<int>& sizes) {
+	std::vector<uint8_t> ret;
+	FILE* fp = fopen(filename, "rb");
+	if (!fp) {
+		perror(filename);
+		return ret;
+	}
+	std::vector<uint8_t> ts;
+	uint8_t buffer[188 * 1024];
+	for (;;) {
+		auto n = fread(buffer, 1, sizeof(buffer), fp);
+		if (n == 0)
+			break;
+		ts.insert(ts.end(), buffer, buffer + n);
+	}
+	fclose(fp);
+	if (pid < 0) {
+		std::map<int, int> counts;
+		for (size_t pos = 0; pos + 188 <= ts.size(); pos += 188)
+			counts[((ts[pos + 1] & 0x1f) << 8) | ts[pos + 2]]++;
+		counts.erase(0x1fff);
+		int best = 0;
+		for (auto [p, count] : counts)
+			if (count > best) {
+				best = count;
+				pid = p;
+			}
+	}
+	printf("Using payload of pid %d\n", pid);
+	for (size_t pos = 0; pos + 188 <= ts.size(); pos += 188) {
+		auto* p = &ts[pos];
+		if (p[0] != 0x47 || (((p[1] & 0x1f) << 8) | p[2]) != pid || !(p[3] & 0x10))
+			continue;
+		int start = (p[3] & 0x20) ? 5 + p[4] : 4;
+		if (start >= 188)
+			continue;
+		ret.insert(ret.end(), p + start, p + 188);
+		sizes.push_back(188 - start);
+	}
+	return ret;
+}
+
+//count all prefixes, searching each chunk separately
+static int64_t count_all(const uint8_t* p, const std::vector<int>& sizes, startcode_impl_t impl) {
+	int64_t count = 0;
+	for (auto size : sizes) {
+		int64_t pos = 0;
+		for (;;) {
+			auto ret = find_start_code_prefix(p + pos, size - pos, impl);
+			if (ret < 0)
+				break;
+			count++;
+			pos += ret + 3;
+		}
+		p += size;
+	}
+	return count;
+}
+
+int main(int argc, char** argv) {
+	const char* filename = (argc > 1 && atoi(argv[1]) == 0) ? argv[1] : nullptr;
+	int arg = filename ? 2 : 1;
+	int pid = (filename && argc > 2) ? atoi(argv[arg++]) : -1;
+	int repeats = argc > arg ? atoi(argv[arg]) : 20;
+	auto best = startcode_best_impl();
+
+	//correctness: all offsets and lengths in a small buffer
+	auto data = make_random(1 << 16);
+	for (int align = 0; align < 64; ++align) {
+		for (int len = 0; len < 300; ++len) {
+			auto* p = &data[align * 997 % (data.size() - 400) + align];
+			auto ref = find_reference(p, len);
+			for (int i = 0; i < 3; ++i) {
+				if ((int)impls[i] > (int)best)
+					continue;
+				auto ret = find_start_code_prefix(p, len, impls[i]);
+				if (ret != ref) {
+					printf("FAIL: %s returned %ld instead of %ld (len=%d)\n", names[i], ret, ref, len);
+					return -1;
+				}
+			}
+		}
+	}
+
+	std::vector<int> sizes;
+	if (filename) {
+		data = read_payload(filename, pid, sizes);
+		if (data.empty()) {
+			fprintf(stderr, "No payload found\n");
+			return -1;
+		}
+	} else {
+		data = make_random(64 * 1024 * 1024);
+		sizes.assign(data.size() / 184, 184);
+	}
+
+	int64_t ref_count{-1};
+	printf("%ld bytes\n", data.size());
+	for (int i = 0; i < 3; ++i) {
+		if ((int)impls[i] > (int)best)
+			continue;
+		double t_best = 0;
+		int64_t count = 0;
+		for (int r = 0; r < repeats; ++r) {
+			auto start = std::chrono::steady_clock::now();
+			count = count_all(data.data(), sizes, impls[i]);
+			auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			t_best = (r == 0) ? t : std::min(t_best, t);
+		}
+		if (ref_count < 0)
+			ref_count = count;
+		else if (count != ref_count) {
+			printf("FAIL: %s found %ld start codes instead of %ld\n", names[i], count, ref_count);
+			return -1;
+		}
+		printf("%-8s: %10.0f MB/s (%ld start codes)\n", names[i], data.size() / t_best / 1e6, count);
+	}
+	return 0;
+}
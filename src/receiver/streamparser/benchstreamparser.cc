@@ -0,0 +1,235 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+/*
+	Benchmark for the stream parser:
+	benchstreamparser [file.ts|-] [chunk_size_in_packets] [repeats] [synthetic_seconds]
+
+	The parser is run over a generated multiplex and, if a file is given, over a recorded transport stream.
+	The generated multiplex contains pat, pmt, sdt, nit, eit present/following and eit schedule sections
+	(the latter spanning multiple packets), and h264, hevc, mpeg2 and audio pes streams. Section versions
+	never change, so it also exercises the skipping of repeated sections.
+
+	All services in the pat are indexed, i.e., pmt parsers are registered for all of them and
+	a pes parser for each video and audio pid. sdt, nit and eit parsers are registered as well.
+	Each stream is parsed with per packet dispatch, with batch dispatch and with batch dispatch in
+	header only indexing mode, reporting packets/s, sections/s, heap allocations per packet and the
+	fraction of packets skipped without header processing. Finally the cpu time spent in each parser is reported, as measured
+	in batch dispatch mode.
+
+	hevc streams are parsed by the h264 parser, as hevc_parser_t is not enabled.
+*/
+
+#include "packetstream.h"
+#include "muxgenerator.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace dtdemux;
+
+static std::atomic<int64_t> num_allocations{0};
+static std::atomic<int64_t> num_bytes_allocated{0};
+
+void* operator new(size_t size) {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	num_bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+	if (auto* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t size) noexcept {
+	free(p);
+}
+
+static std::vector<uint8_t> read_file(const char* filename) {
+	std::vector<uint8_t> ret;
+	FILE* fp = fopen(filename, "rb");
+	if (!fp) {
+		perror(filename);
+		return ret;
+	}
+	uint8_t buffer[ts_packet_t::size * 1024];
+	for (;;) {
+		auto n = fread(buffer, 1, sizeof(buffer), fp);
+		if (n == 0)
+			break;
+		ret.insert(ret.end(), buffer, buffer + n);
+	}
+	fclose(fp);
+	ret.resize(ret.size() - ret.size() % ts_packet_t::size);
+	return ret;
+}
+
+/*
+	labels: description of the parser registered on each pid
+*/
+static void register_parsers(ts_stream_t& stream, std::set<int>& pids, std::map<int, std::string>& labels) {
+	auto pat_parser = stream.register_pat_pid();
+	labels[0] = "pat";
+	pat_parser->section_cb = [&stream, &pids, &labels](const pat_services_t& pat_services,
+																										 const subtable_info_t& i) {
+		for (const auto& e : pat_services.entries) {
+			if (e.service_id == 0 || !pids.insert(e.pmt_pid).second)
+				continue; //nit or already registered
+			auto pmt_parser = stream.register_pmt_pid(e.pmt_pid, e.service_id);
+			labels[e.pmt_pid] = "pmt";
+			pmt_parser->section_cb = [&stream, &pids, &labels](pmt_parser_t* parser, const pmt_info_t& pmt,
+																												 bool isnext, const ss::bytebuffer_& sec_data) {
+				for (const auto& pidinfo : pmt.pid_descriptors) {
+					auto pid = pidinfo.stream_pid;
+					auto st = pidinfo.stream_type;
+					if (!stream_type::is_pes(st) || stream_type::is_private(st) || !pids.insert(pid).second)
+						continue;
+					if (stream_type::is_mpeg2(st)) {
+						auto parser = std::make_shared<mpeg2_parser_t>(stream, pmt.service_id, pid);
+						stream.register_parser(pid, [parser](ts_packet_t* p) { parser->parse(p); });
+						labels[pid] = "mpeg2";
+					} else if (stream_type::is_video(st)) {
+						auto parser = std::make_shared<h264_parser_t>(stream, pmt.service_id, pid);
+						stream.register_parser(pid, [parser](ts_packet_t* p) { parser->parse(p); });
+						labels[pid] = (st == stream_type::stream_type_t::HEVC_VIDEO) ? "hevc" : "h264";
+					} else {
+						auto parser = std::make_shared<audio_parser_t>(stream, pmt.service_id, pid);
+						stream.register_parser(pid, [parser](ts_packet_t* p) { parser->parse(p); });
+						labels[pid] = "audio";
+					}
+				}
+				return reset_type_t::NO_RESET;
+			};
+		}
+		return reset_type_t::NO_RESET;
+	};
+	stream.register_pid<nit_parser_t>(ts_stream_t::NIT_PID, "NIT");
+	labels[ts_stream_t::NIT_PID] = "nit";
+	stream.register_pid<sdt_bat_parser_t>(ts_stream_t::SDT_PID, "SDT");
+	labels[ts_stream_t::SDT_PID] = "sdt/bat";
+	stream.register_pid<eit_parser_t>(ts_stream_t::EIT_PID, "EIT", chdb::epg_type_t::DVB);
+	labels[ts_stream_t::EIT_PID] = "eit";
+}
+
+struct result_t {
+	double seconds{0};
+	int64_t num_sections{0};
+	int64_t num_duplicate_sections_skipped{0};
+	int64_t num_allocations{0};
+	int64_t num_bytes_allocated{0};
+	int64_t num_payload_packets_skipped{0};
+};
+
+static result_t run(std::vector<uint8_t>& data, int chunk_size, bool batch_dispatch, bool header_only,
+										bool report_cpu_time = false) {
+	result_t ret;
+	ts_stream_t stream;
+	std::set<int> pids;
+	std::map<int, std::string> labels;
+	stream.set_batch_dispatch(batch_dispatch);
+	stream.header_only_indexing = header_only;
+	stream.set_cpu_time_accounting(report_cpu_time);
+	register_parsers(stream, pids, labels);
+	auto allocations = num_allocations.load();
+	auto bytes_allocated = num_bytes_allocated.load();
+	auto start = std::chrono::steady_clock::now();
+	int64_t chunk_bytes = chunk_size * (int64_t)ts_packet_t::size;
+	for (int64_t pos = 0; pos < (int64_t)data.size(); pos += chunk_bytes) {
+		auto len = std::min(chunk_bytes, (int64_t)data.size() - pos);
+		stream.set_buffer(data.data() + pos, len);
+		stream.parse();
+	}
+	auto end = std::chrono::steady_clock::now();
+	ret.seconds = std::chrono::duration<double>(end - start).count();
+	ret.num_allocations = num_allocations - allocations;
+	ret.num_bytes_allocated = num_bytes_allocated - bytes_allocated;
+	ret.num_sections = stream.num_sections;
+	ret.num_duplicate_sections_skipped = stream.num_duplicate_sections_skipped;
+	ret.num_payload_packets_skipped = stream.num_payload_packets_skipped;
+	if (report_cpu_time) {
+		int64_t total{0};
+		for (auto& [pid, label] : labels)
+			total += stream.cpu_time_ns(pid);
+		printf("%8s %-10s %10s %8s\n", "pid", "parser", "cpu ms", "share");
+		for (auto& [pid, label] : labels) {
+			auto t = stream.cpu_time_ns(pid);
+			printf("  0x%04x %-10s %10.3f %7.1f%%\n", pid, label.c_str(), t / 1e6, total ? 100. * t / total : 0.);
+		}
+	}
+	stream.exit();
+	return ret;
+}
+
+static void bench(const char* title, std::vector<uint8_t>& data, int chunk_size, int repeats) {
+	auto num_packets = data.size() / ts_packet_t::size;
+	printf("%s: %ld packets; chunk_size=%d packets\n", title, num_packets, chunk_size);
+	const char* mode_names[] = {"per packet", "batch", "headers"};
+	for (int mode = 0; mode < 3; ++mode) {
+		result_t best;
+		for (int i = 0; i < repeats; ++i) {
+			auto r = run(data, chunk_size, mode > 0, mode == 2);
+			if (i == 0 || r.seconds < best.seconds)
+				best = r;
+		}
+		printf("%-10s: %8.3fs %12.0f packets/s %10.0f sections/s (%.1f%% repeated) %8.3f allocations/packet"
+					 " (%ld bytes) %.1f%% packets skipped\n",
+					 mode_names[mode], best.seconds, num_packets / best.seconds,
+					 best.num_sections / best.seconds,
+					 best.num_sections ? 100. * best.num_duplicate_sections_skipped / best.num_sections : 0.,
+					 best.num_allocations / (double)num_packets, best.num_bytes_allocated,
+					 100. * best.num_payload_packets_skipped / num_packets);
+	}
+	run(data, chunk_size, true, true, true);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && argv[1][0] == '-' && argv[1][1] != 0) {
+		fprintf(stderr, "Usage: %s [file.ts|-] [chunk_size_in_packets] [repeats] [synthetic_seconds]\n", argv[0]);
+		return -1;
+	}
+	int chunk_size = argc > 2 ? atoi(argv[2]) : 1024;
+	int repeats = argc > 3 ? atoi(argv[3]) : 3;
+	int seconds = argc > 4 ? atoi(argv[4]) : 60;
+	if (chunk_size <= 0 || repeats <= 0 || seconds <= 0) {
+		fprintf(stderr, "Nothing to do\n");
+		return -1;
+	}
+
+	std::vector<uint8_t> data;
+	mux_generator_t(data).generate(seconds);
+	bench("synthetic", data, chunk_size, repeats);
+
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		data = read_file(argv[1]);
+		if (data.size() == 0) {
+			fprintf(stderr, "No packets in %s\n", argv[1]);
+			return -1;
+		}
+		bench(argv[1], data, chunk_size, repeats);
+	}
+	return 0;
+}
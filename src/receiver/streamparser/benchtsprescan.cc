@@ -0,0 +1,145 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Microbenchmark for prescan_ts_packets: compares the scalar, sse4.2 and avx2 implementations with
+	each other and with constructing a ts_packet_t for each packet. Also checks that all implementations
+	return the same result, including on misaligned input.
+	The same is done for match_pids, which is used to drop pat and pmt packets during playback.
+	benchtsprescan [num_packets] [repeats]
+*/
+
+#include "streamparser.h"
+#include <bit>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace dtdemux;
+
+static void make_packets(std::vector<uint8_t>& data, int num_packets, int misalign) {
+	data.resize(misalign + num_packets * ts_packet_t::size);
+	for (auto& x : data)
+		x = (random() & 0xff) | 1; //never a sync byte
+	for (int i = 0; i < num_packets; ++i) {
+		auto* p = &data[misalign + i * ts_packet_t::size];
+		auto pid = random() % 0x2000;
+		p[0] = 0x47;
+		p[1] = (random() & 0x60) | (pid >> 8);
+		p[2] = pid & 0xff;
+		p[3] = (random() & 0xcf) | 0x10; //payload, no adaptation field
+	}
+}
+
+static bool same(const ts_prescan_t& a, const ts_prescan_t& b) {
+	return a.offsets == b.offsets && a.pids == b.pids && a.flags == b.flags && a.ccs == b.ccs &&
+		a.num_bytes_skipped == b.num_bytes_skipped && a.end_offset == b.end_offset;
+}
+
+template <typename fn_t> static double time_it(int repeats, fn_t fn) {
+	double best = 0;
+	for (int i = 0; i < repeats; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = (i == 0) ? t : std::min(best, t);
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	int num_packets = argc > 1 ? atoi(argv[1]) : 100000;
+	int repeats = argc > 2 ? atoi(argv[2]) : 20;
+	std::vector<uint8_t> data;
+
+	const prescan_impl_t impls[] = {prescan_impl_t::SCALAR, prescan_impl_t::SSE42, prescan_impl_t::AVX2};
+	const char* names[] = {"scalar", "sse4.2", "avx2"};
+	auto best = prescan_best_impl();
+
+	for (int misalign : {0, 17}) {
+		make_packets(data, num_packets, misalign);
+		ts_prescan_t ref;
+		prescan_ts_packets(data.data(), data.size(), ref, prescan_impl_t::SCALAR);
+		if (ref.size() != num_packets || ref.num_bytes_skipped != misalign) {
+			printf("FAIL: found %d packets, skipped %ld bytes\n", ref.size(), ref.num_bytes_skipped);
+			return -1;
+		}
+		for (int i = 0; i < 3; ++i) {
+			if ((int)impls[i] > (int)best)
+				continue; //not supported on this cpu
+			ts_prescan_t out;
+			prescan_ts_packets(data.data(), data.size(), out, impls[i]);
+			if (!same(out, ref)) {
+				printf("FAIL: %s differs from scalar implementation (misalign=%d)\n", names[i], misalign);
+				return -1;
+			}
+		}
+	}
+
+	make_packets(data, num_packets, 0);
+	printf("%d packets\n", num_packets);
+	for (int i = 0; i < 3; ++i) {
+		if ((int)impls[i] > (int)best)
+			continue;
+		ts_prescan_t out;
+		auto t = time_it(repeats, [&]() { prescan_ts_packets(data.data(), data.size(), out, impls[i]); });
+		printf("%-12s: %12.0f packets/s\n", names[i], num_packets / t);
+	}
+
+	//one packet in 16 is dropped, as pat/pmt packets are in a typical stream
+	for (int i = 0; i < num_packets; i += 16) {
+		auto* p = &data[i * ts_packet_t::size];
+		p[1] = (p[1] & 0xe0) | (i % 32 ? 0x00 : 0x01);
+		p[2] = i % 32 ? 0x00 : 0x23;
+	}
+	for (int i = 0; i < 3; ++i) {
+		if ((int)impls[i] > (int)best)
+			continue;
+		for (int start = 0; start < num_packets; start += 64) {
+			int n = std::min(64, num_packets - start);
+			auto* p = &data[start * ts_packet_t::size];
+			if (match_pids(p, n, 0x123, 0, impls[i]) != match_pids(p, n, 0x123, 0, prescan_impl_t::SCALAR)) {
+				printf("FAIL: match_pids %s differs from scalar implementation\n", names[i]);
+				return -1;
+			}
+		}
+		uint64_t num_matched{0};
+		auto t = time_it(repeats, [&]() {
+			num_matched = 0;
+			for (int start = 0; start < num_packets; start += 64)
+				num_matched += std::popcount(match_pids(&data[start * ts_packet_t::size],
+																								std::min(64, num_packets - start), 0x123, 0, impls[i]));
+		});
+		printf("%-12s: %12.0f packets/s (match_pids: %ld)\n", names[i], num_packets / t, num_matched);
+	}
+
+	int64_t sum{0};
+	auto t = time_it(repeats, [&]() {
+		data_range_t range(data.data(), data.size());
+		for (int i = 0; i < num_packets; ++i) {
+			auto r = range.sub_range(i * (int64_t)ts_packet_t::size, ts_packet_t::size);
+			ts_packet_t p(r);
+			sum += p.get_pid() + p.get_continuity_counter();
+		}
+	});
+	printf("%-12s: %12.0f packets/s (%ld)\n", "ts_packet_t", num_packets / t, sum);
+	return 0;
+}
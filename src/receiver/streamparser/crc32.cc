@@ -0,0 +1,198 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "crc32.h"
+#include <string.h>
+#include <immintrin.h>
+
+using namespace dtdemux;
+
+static constexpr uint32_t poly = 0x04c11db7;
+
+/*
+	crc_tables[0] is the classic byte at a time table (originally taken from libdtv, (c) Rolf Hakenes).
+	crc_tables[k][b] is the crc contribution of byte b followed by k zero bytes, used for slicing
+*/
+struct crc_tables_t {
+	uint32_t t[16][256];
+	constexpr crc_tables_t() : t{} {
+		for (uint32_t b = 0; b < 256; ++b) {
+			uint32_t crc = b << 24;
+			for (int i = 0; i < 8; ++i)
+				crc = (crc & 0x80000000) ? (crc << 1) ^ poly : (crc << 1);
+			t[0][b] = crc;
+		}
+		for (int k = 1; k < 16; ++k)
+			for (int b = 0; b < 256; ++b)
+				t[k][b] = (t[k - 1][b] << 8) ^ t[0][t[k - 1][b] >> 24];
+	}
+};
+
+static constexpr crc_tables_t crc_tables;
+
+static inline uint32_t load_be32(const uint8_t* p) {
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return __builtin_bswap32(x);
+}
+
+static uint32_t crc32_table(uint32_t crc, const uint8_t* data, int64_t size) {
+	auto& t = crc_tables.t[0];
+	for (int64_t i = 0; i < size; i++)
+		crc = (crc << 8) ^ t[(crc >> 24) ^ data[i]];
+	return crc;
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t* data, int64_t size) {
+	auto& t = crc_tables.t;
+	for (; size >= 8; size -= 8, data += 8) {
+		crc ^= load_be32(data);
+		crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff] ^ t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff] ^
+			t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+	}
+	return crc32_table(crc, data, size);
+}
+
+static uint32_t crc32_slice16(uint32_t crc, const uint8_t* data, int64_t size) {
+	auto& t = crc_tables.t;
+	for (; size >= 16; size -= 16, data += 16) {
+		crc ^= load_be32(data);
+		crc = t[15][crc >> 24] ^ t[14][(crc >> 16) & 0xff] ^ t[13][(crc >> 8) & 0xff] ^ t[12][crc & 0xff] ^
+			t[11][data[4]] ^ t[10][data[5]] ^ t[9][data[6]] ^ t[8][data[7]] ^
+			t[7][data[8]] ^ t[6][data[9]] ^ t[5][data[10]] ^ t[4][data[11]] ^
+			t[3][data[12]] ^ t[2][data[13]] ^ t[1][data[14]] ^ t[0][data[15]];
+	}
+	return crc32_slice8(crc, data, size);
+}
+
+/*
+	x^n mod poly, as a polynomial of degree < 32
+*/
+static constexpr uint64_t xpow_mod(int n) {
+	uint64_t r = 1;
+	for (int i = 0; i < n; ++i)
+		r = (r & 0x80000000) ? ((r << 1) ^ poly ^ 0x100000000) : (r << 1);
+	return r;
+}
+
+/*
+	Folding with carry-less multiplication, after "Fast CRC Computation for Generic Polynomials
+	Using PCLMULQDQ Instruction" (Intel, 2009).
+
+	16 byte blocks are byte reversed, so that the first byte ends up in the most significant bits and
+	bit i of the 128 bit value is the coefficient of x^i. Multiplying a 128 bit block X = H x^64 + L by x^n
+	modulo poly is then computed as H (x^(n+64) mod poly) + L (x^n mod poly), which fits in 128 bits again.
+
+	The crc register is included by xoring it into the first 4 bytes. The result is folded down
+	to a 64 bit value T congruent to the data seen so far, after which the byte at a time algorithm started
+	with crc=0 on the 8 bytes of T produces T x^32 mod poly, which is the crc register for the data seen so far.
+*/
+static constexpr int pclmul_min_size = 64;
+static constexpr uint64_t k64_lo = xpow_mod(64);
+static constexpr uint64_t k128_lo = xpow_mod(128), k128_hi = xpow_mod(128 + 64);
+static constexpr uint64_t k256_lo = xpow_mod(256), k256_hi = xpow_mod(256 + 64);
+static constexpr uint64_t k384_lo = xpow_mod(384), k384_hi = xpow_mod(384 + 64);
+static constexpr uint64_t k512_lo = xpow_mod(512), k512_hi = xpow_mod(512 + 64);
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i fold(__m128i x, __m128i k) {
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i load_reversed(const uint8_t* p) {
+	const auto bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), bswap);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t* data, int64_t size) {
+	if (size < pclmul_min_size)
+		return crc32_slice8(crc, data, size);
+	//low qword multiplies the low half, high qword the high half of a block
+	const auto k128 = _mm_set_epi64x(k128_hi, k128_lo);
+	const auto k256 = _mm_set_epi64x(k256_hi, k256_lo);
+	const auto k384 = _mm_set_epi64x(k384_hi, k384_lo);
+	const auto k512 = _mm_set_epi64x(k512_hi, k512_lo);
+	const auto k64 = _mm_set_epi64x(0, k64_lo);
+
+	//four interleaved accumulators, each covering every fourth block
+	auto x0 = _mm_xor_si128(load_reversed(data), _mm_set_epi32(crc, 0, 0, 0));
+	auto x1 = load_reversed(data + 16);
+	auto x2 = load_reversed(data + 32);
+	auto x3 = load_reversed(data + 48);
+	data += 64;
+	size -= 64;
+	for (; size >= 64; size -= 64, data += 64) {
+		x0 = _mm_xor_si128(fold(x0, k512), load_reversed(data));
+		x1 = _mm_xor_si128(fold(x1, k512), load_reversed(data + 16));
+		x2 = _mm_xor_si128(fold(x2, k512), load_reversed(data + 32));
+		x3 = _mm_xor_si128(fold(x3, k512), load_reversed(data + 48));
+	}
+	auto x = _mm_xor_si128(_mm_xor_si128(fold(x0, k384), fold(x1, k256)), _mm_xor_si128(fold(x2, k128), x3));
+	for (; size >= 16; size -= 16, data += 16)
+		x = _mm_xor_si128(fold(x, k128), load_reversed(data));
+
+	//reduce x = H x^64 + L to 64 bits
+	auto y = _mm_clmulepi64_si128(x, k64, 0x01); //H (x^64 mod poly); at most 95 bits
+	auto z = _mm_clmulepi64_si128(y, k64, 0x01); //high part of y times (x^64 mod poly); at most 62 bits
+	uint64_t t = _mm_cvtsi128_si64(_mm_xor_si128(_mm_xor_si128(x, y), z));
+	uint8_t tbytes[8];
+	t = __builtin_bswap64(t);
+	memcpy(tbytes, &t, sizeof(t));
+	crc = crc32_slice8(0, tbytes, sizeof(tbytes));
+	return crc32_slice8(crc, data, size);
+}
+
+crc_impl_t dtdemux::crc32_best_impl() {
+	static const crc_impl_t best = []() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"))
+			return crc_impl_t::PCLMUL;
+		return crc_impl_t::SLICE16;
+	}();
+	return best;
+}
+
+uint32_t dtdemux::crc32_update(uint32_t crc, const uint8_t* data, int64_t size, crc_impl_t impl) {
+	switch (impl == crc_impl_t::AUTO ? crc32_best_impl() : impl) {
+	case crc_impl_t::TABLE:
+		return crc32_table(crc, data, size);
+	case crc_impl_t::SLICE8:
+		return crc32_slice8(crc, data, size);
+	case crc_impl_t::PCLMUL:
+		return crc32_pclmul(crc, data, size);
+	case crc_impl_t::SLICE16:
+	default:
+		return crc32_slice16(crc, data, size);
+	}
+}
+
+int dtdemux::crc32_verify_batch(const uint8_t* const* sections, const int* sizes, int num, bool* ok) {
+	auto impl = crc32_best_impl();
+	int num_ok{0};
+	for (int i = 0; i < num; ++i) {
+		if (i + 1 < num)
+			__builtin_prefetch(sections[i + 1]);
+		ok[i] = sizes[i] < 4 || crc32_update(0xffffffff, sections[i], sizes[i], impl) == 0;
+		num_ok += ok[i];
+	}
+	return num_ok;
+}
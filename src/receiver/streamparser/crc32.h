@@ -0,0 +1,64 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+	CRC32/MPEG-2 (polynomial 0x04c11db7, msb first, initial value 0xffffffff, no final xor)
+	as used by psi/si sections.
+*/
+namespace dtdemux {
+
+	enum class crc_impl_t {
+		AUTO, //best one supported by the cpu
+		TABLE, //byte at a time
+		SLICE8,
+		SLICE16,
+		PCLMUL //carry-less multiplication folding, for long inputs; short ones use SLICE8
+	};
+
+	/*!
+		Continue a crc computation: crc is the value returned by the previous call,
+		or 0xffffffff at the start
+	*/
+	uint32_t crc32_update(uint32_t crc, const uint8_t* data, int64_t size, crc_impl_t impl = crc_impl_t::AUTO);
+
+	/*!
+		crc of a section; returns 0 for sections including a correct crc.
+		Sections shorter than 4 bytes also return 0
+	*/
+	inline uint32_t crc32(const uint8_t* data, int size) {
+		if (size < 4)
+			return false;
+		return crc32_update(0xffffffff, data, size);
+	}
+
+	/*!
+		Verify the crc of num sections at once: ok[i] is set to true if sections[i] (of size sizes[i])
+		is correct. Returns the number of correct sections
+	*/
+	int crc32_verify_batch(const uint8_t* const* sections, const int* sizes, int num, bool* ok);
+
+	/*!
+		Returns the implementation selected by crc_impl_t::AUTO
+	*/
+	crc_impl_t crc32_best_impl();
+};
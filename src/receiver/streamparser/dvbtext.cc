@@ -88,7 +88,7 @@ static const char* CharacterTables2[] = {
 	returns character table string, and bool which is true if single byte system
 */
 static std::tuple<const char*, bool>
-get_char_table_and_size(uint8_t*& buffer, int& length) {
+get_char_table_and_size(const uint8_t*& buffer, int& length) {
 	const char* cs = "ISO6937";
 	// Workaround for broadcaster stupidity: according to
 	// "ETSI EN 300 468" the default character set is ISO6937. But unfortunately some
@@ -186,6 +186,27 @@ static 	int translate_dvb_control_characters(uint8_t* to, int size_, bool single
 	return newlen;
 }
 
+/*
+	true if translate_dvb_control_characters would change the text. Multi byte text is always rewritten
+*/
+static inline bool needs_translation(const uint8_t* from, int len, bool single_byte_char) {
+	if(!single_byte_char)
+		return true;
+	for(auto* end = from + len; from < end; ++from) {
+		switch (*from) {
+		case 0x8A:
+		case 0xA0:
+		case 0x86:
+		case 0x87:
+		case '_':
+			return true;
+		default:
+			break;
+		}
+	}
+	return false;
+}
+
 //#define PRINTTIME
 #ifdef PRINTTIME
 static int64_t processing_count;
@@ -200,8 +221,10 @@ using namespace std::chrono;
 /* @brief decodes an SI string into a ss::string dataStructure
 	 Returns the c-length of the number of characters written
 	 String may still contain the emphasis on/off codes 0x86, 0x87
+	 from may point into packet data, which must not be modified; it is converted directly,
+	 unless control characters need to be translated, which is done in a copy
 */
-int decode_text(ss::string_& out, uint8_t* from, int len) {
+int decode_text(ss::string_& out, const uint8_t* from, int len) {
 	if (len <= 0) {
 		return 0;
 	}
@@ -233,7 +256,11 @@ int decode_text(ss::string_& out, uint8_t* from, int len) {
 	}
 
 	auto [cs, single_byte_char]  = get_char_table_and_size(from, len);
-	auto new_len = translate_dvb_control_characters(from, len, single_byte_char, true /*clean*/);
-	int ret = out.append_as_utf8((char*)from, new_len, cs);
+	if(!needs_translation(from, len, single_byte_char))
+		return out.append_as_utf8((const char*)from, len, cs);
+	ss::bytebuffer<256> text;
+	text.append_raw(from, len);
+	auto new_len = translate_dvb_control_characters(text.buffer(), len, single_byte_char, true /*clean*/);
+	int ret = out.append_as_utf8((const char*)text.buffer(), new_len, cs);
 	return ret;
 }
@@ -19,6 +19,8 @@
  */
 
 #include "events.h"
+#include <algorithm>
+#include <limits>
 #include "neumotime.h"
 #include "substream.h"
 
@@ -91,6 +93,8 @@ void event_handler_t::pcr_update(int pid, const pcr_t& pcr, bool discontinuity_p
 	if (discontinuity_pending)
 		return pcr_discontinuity_(pid, pcr);
 	const char* label = "PCR_UPDATE: ";
+	if (!first_pcr.is_valid())
+		first_pcr = pcr;
 	if (ref_pcr_update_enabled) {
 		if (!ref_pcr_inited) {
 			ref_pcr = pcr;
@@ -171,8 +175,8 @@ pts_dts_t event_handler_t::check_pes_discontinuity(pts_dts_t clock_period, const
 void event_handler_t::index_event(stream_type::marker_t unit_type,
 																	/*uint16_t pid, uint16_t stream_type,*/
 																	const milliseconds_t& play_time_ms, pts_dts_t pts, pts_dts_t dts, uint64_t first_byte,
-																	uint64_t last_byte, const char* name) {
-	if (!idxdb)
+																	uint64_t last_byte, uint64_t completed_bytepos, const char* name) {
+	if (!idxdb && !collected_markers)
 		return;
 	auto first_packetno = first_byte / ts_packet_t::size;
 	auto last_packetno = last_byte / ts_packet_t::size;
@@ -187,22 +191,109 @@ void event_handler_t::index_event(stream_type::marker_t unit_type,
 							 play_time_ms, pts, dts);
 		}
 		if (unit_type == stream_type::marker_t::i_frame || unit_type == stream_type::marker_t::pes_other) {
-			auto start = std::min(last_pat_start_bytepos, last_pmt_start_bytepos) / ts_packet_t::size;
-			auto end = std::max(last_pat_end_bytepos, last_pmt_end_bytepos) / ts_packet_t::size;
-			start = std::min(start, first_packetno);
-			end = std::max(end, last_packetno);
-			// start and end point to a byte region containing a pat a pmt and an i-frame (and perhaps some other
-			// data
-			dtdebugf("WRITE pos=[{}, {}] time={}", start, end, play_time_ms);
-			using namespace recdb;
-			auto txn = idxdb->wtxn();
-			{
-				auto c = idxdb->tcursor<marker_t>(txn);
-				last_saved_marker = marker_t(marker_key_t(play_time_ms), start, end);
-				put_record(c, last_saved_marker);
-			}
-			txn.commit();
-			///@todo create fewer transactions?
+			if (defer_markers)
+				deferred_markers.push_back({completed_bytepos, play_time_ms, first_packetno, last_packetno});
+			else
+				add_marker(play_time_ms, first_packetno, last_packetno);
 		}
 	}
 }
+
+void event_handler_t::add_marker(const milliseconds_t& play_time_ms, uint64_t first_packetno,
+																 uint64_t last_packetno) {
+	auto start = std::min(last_pat_start_bytepos, last_pmt_start_bytepos) / ts_packet_t::size;
+	auto end = std::max(last_pat_end_bytepos, last_pmt_end_bytepos) / ts_packet_t::size;
+	start = std::min(start, first_packetno);
+	end = std::max(end, last_packetno);
+	// start and end point to a byte region containing a pat a pmt and an i-frame (and perhaps some other
+	// data
+	dtdebugf("WRITE pos=[{}, {}] time={}", start, end, play_time_ms);
+	using namespace recdb;
+	//last_saved_marker is published to playback immediately; the database is updated in batches
+	last_saved_marker = marker_t(marker_key_t(play_time_ms), start, end);
+	if (collected_markers) {
+		collected_markers->push_back(last_saved_marker);
+		return;
+	}
+	auto now = steady_clock_t::now();
+	if (pending_markers.empty())
+		first_pending_marker_time = now;
+	pending_markers.push_back(last_saved_marker);
+	if ((int)pending_markers.size() >= max_pending_markers)
+		flush_markers();
+	else
+		flush_markers_if_due(now);
+}
+
+void event_handler_t::pat_completed(uint64_t start_bytepos, uint64_t end_bytepos, uint64_t completed_bytepos) {
+	if (defer_markers) {
+		batch_pats.push_back({completed_bytepos, start_bytepos, end_bytepos});
+		return;
+	}
+	last_pat_start_bytepos = start_bytepos;
+	last_pat_end_bytepos = end_bytepos;
+}
+
+void event_handler_t::pmt_completed(uint64_t start_bytepos, uint64_t end_bytepos, uint64_t completed_bytepos) {
+	if (defer_markers) {
+		batch_pmts.push_back({completed_bytepos, start_bytepos, end_bytepos});
+		return;
+	}
+	last_pmt_start_bytepos = start_bytepos;
+	last_pmt_end_bytepos = end_bytepos;
+}
+
+uint64_t event_handler_t::pmt_end_bytepos_before(uint64_t bytepos) const {
+	const psi_unit_t* last{nullptr};
+	for (const auto& u : batch_pmts) {
+		if (u.completed_bytepos <= bytepos && (!last || u.completed_bytepos > last->completed_bytepos))
+			last = &u;
+	}
+	return last ? last->end_bytepos : last_pmt_end_bytepos;
+}
+
+void event_handler_t::batch_completed() {
+	auto by_position = [](const auto& a, const auto& b) { return a.completed_bytepos < b.completed_bytepos; };
+	//each vector is ordered per pid, but several pmt pids (or marker pids) may be interleaved
+	std::stable_sort(batch_pats.begin(), batch_pats.end(), by_position);
+	std::stable_sort(batch_pmts.begin(), batch_pmts.end(), by_position);
+	std::stable_sort(deferred_markers.begin(), deferred_markers.end(), by_position);
+	auto pat = batch_pats.begin();
+	auto pmt = batch_pmts.begin();
+	auto apply_until = [&](uint64_t bytepos) {
+		for (; pat != batch_pats.end() && pat->completed_bytepos < bytepos; ++pat) {
+			last_pat_start_bytepos = pat->start_bytepos;
+			last_pat_end_bytepos = pat->end_bytepos;
+		}
+		for (; pmt != batch_pmts.end() && pmt->completed_bytepos < bytepos; ++pmt) {
+			last_pmt_start_bytepos = pmt->start_bytepos;
+			last_pmt_end_bytepos = pmt->end_bytepos;
+		}
+	};
+	for (const auto& m : deferred_markers) {
+		apply_until(m.completed_bytepos);
+		add_marker(m.play_time_ms, m.first_packetno, m.last_packetno);
+	}
+	apply_until(std::numeric_limits<uint64_t>::max());
+	batch_pats.clear();
+	batch_pmts.clear();
+	deferred_markers.clear();
+}
+
+void event_handler_t::flush_markers(db_txn& idxdb_wtxn) {
+	if (pending_markers.empty())
+		return;
+	using namespace recdb;
+	auto c = idxdb->tcursor<marker_t>(idxdb_wtxn);
+	for (const auto& marker : pending_markers)
+		put_record(c, marker);
+}
+
+void event_handler_t::flush_markers() {
+	if (pending_markers.empty() || !idxdb)
+		return;
+	auto txn = idxdb->wtxn();
+	flush_markers(txn);
+	txn.commit();
+	markers_committed();
+}
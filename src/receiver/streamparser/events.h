@@ -21,6 +21,7 @@
 #pragma once
 #include "util/dtutil.h"
 #include <functional>
+#include <vector>
 #include "mpeg.h"
 #include "streamtime.h"
 #include "streamparser.h"
@@ -41,12 +42,47 @@ namespace dtdemux {
 		milliseconds_t last_pcr_play_time{}; //defaults to invalid - only for debugging
 		time_t start_time; //time at which stream starts
 
+		/*markers are written to the database in batches, because each write transaction syncs the database.
+			pending_markers are the markers not yet written; the oldest one was found at first_pending_marker_time*/
+		std::vector<recdb::marker_t> pending_markers;
+		steady_time_t first_pending_marker_time;
+
+		/*
+			With batch dispatch, packets of different pids are not parsed in stream order, so a marker cannot use
+			the pat and pmt which were completed last when its event is reported. Instead, markers and pat/pmt
+			sections are collected per batch, together with the byte position of the packet which completed them,
+			and batch_completed() combines them in stream order, with the same result as per packet dispatch
+		*/
+		struct psi_unit_t {
+			uint64_t completed_bytepos;
+			uint64_t start_bytepos;
+			uint64_t end_bytepos;
+		};
+		struct deferred_marker_t {
+			uint64_t completed_bytepos;
+			milliseconds_t play_time_ms;
+			uint64_t first_packetno;
+			uint64_t last_packetno;
+		};
+		std::vector<psi_unit_t> batch_pats;
+		std::vector<psi_unit_t> batch_pmts;
+		std::vector<deferred_marker_t> deferred_markers;
+
+		void add_marker(const milliseconds_t& play_time_ms, uint64_t first_packetno, uint64_t last_packetno);
+
 	public:
 		uint64_t last_pat_start_bytepos = 0;
 		uint64_t last_pmt_start_bytepos = 0;
 		uint64_t last_pat_end_bytepos = 0;
 		uint64_t last_pmt_end_bytepos = 0;
-		recdb::marker_t last_saved_marker;
+		bool defer_markers{false}; //set by ts_stream_t in batch dispatch mode
+		recdb::marker_t last_saved_marker; //newest marker, which may not have been written to the database yet
+		/*when set, markers are appended here instead of being written to idxdb (e.g., when rebuilding
+			the index of a recording)*/
+		std::vector<recdb::marker_t>* collected_markers{nullptr};
+		pcr_t first_pcr; //first pcr in the stream; unlike ref_pcr not changed by discontinuities
+		int max_pending_markers{32};
+		std::chrono::milliseconds max_marker_delay{250ms}; //how long a marker may wait before being written
 
 		bool ref_pcr_inited = false;
 		bool ref_pcr_update_enabled = true; //set to false, when timing is read from database instead of from stream
@@ -57,6 +93,10 @@ namespace dtdemux {
 			24 hours. //ref_pcr:
 		*/
 
+		const pcr_t& get_last_pcr() const {
+			return last_pcr;
+		}
+
 		milliseconds_t pcr_play_time_() {
 			auto temp =  last_pcr - ref_pcr;
 			auto ret=  temp.milliseconds();
@@ -124,12 +164,43 @@ namespace dtdemux {
 
 		}
 
+		/*!
+			completed_bytepos: byte position of the packet whose arrival completed the unit
+		*/
 		void index_event(stream_type::marker_t unit_type,
 										 /*uint16_t pid, uint16_t stream_type,*/
 										 const milliseconds_t& play_time_ms, pts_dts_t pts,
 										 pts_dts_t dts, uint64_t first_byte,
-										 uint64_t last_byte, const char* name);
+										 uint64_t last_byte, uint64_t completed_bytepos, const char* name);
+
+		void pat_completed(uint64_t start_bytepos, uint64_t end_bytepos, uint64_t completed_bytepos);
+		void pmt_completed(uint64_t start_bytepos, uint64_t end_bytepos, uint64_t completed_bytepos);
 
+		//end position of the last pmt section completed before or by the packet at bytepos
+		uint64_t pmt_end_bytepos_before(uint64_t bytepos) const;
+
+		/*!
+			batch dispatch: create the markers of the batch which has just been dispatched
+		*/
+		void batch_completed();
+
+
+		/*!
+			write all pending markers to the database, in the caller's transaction or in a new one.
+			When the caller's transaction is used, the markers remain pending until the caller reports
+			that it committed with markers_committed(), so that they are not lost if it aborts instead
+		*/
+		void flush_markers(db_txn& idxdb_wtxn);
+		void flush_markers();
+		void markers_committed() {
+			pending_markers.clear();
+		}
+
+		//write pending markers if the oldest one has waited long enough
+		void flush_markers_if_due(steady_time_t now) {
+			if (!pending_markers.empty() && now - first_pending_marker_time >= max_marker_delay)
+				flush_markers();
+		}
 
 		void pts_update(bool isvideo, int pos, const pts_dts_t& pts) {
 
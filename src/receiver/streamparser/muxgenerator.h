@@ -0,0 +1,327 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#pragma once
+/*
+	Synthetic multiplex for the stream parser benchmark and tests
+*/
+#include "crc32.h"
+#include "packetstream.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace dtdemux {
+
+/*
+	Generator for a synthetic multiplex
+*/
+class mux_generator_t {
+	std::vector<uint8_t>& out;
+	uint8_t cc[8192]{};
+	uint32_t seed{1};
+
+	static constexpr int ts_id = 1000;
+	static constexpr int network_id = 1;
+	static constexpr int nit_pid = 0x10;
+
+	struct service_t {
+		int service_id;
+		int pmt_pid;
+		int video_pid;
+		int video_stream_type;
+		int audio_pid;
+		int audio_stream_type;
+	};
+
+	const service_t services[3] = {
+		{1, 0x100, 0x101, 0x1b /*h264*/, 0x102, 0x03 /*mpeg1 audio*/},
+		{2, 0x200, 0x201, 0x02 /*mpeg2*/, 0x202, 0x04 /*mpeg2 audio*/},
+		{3, 0x300, 0x301, 0x24 /*hevc*/, 0x302, 0x03 /*mpeg1 audio*/},
+	};
+
+	uint8_t random_byte() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 16;
+	}
+
+	/*
+		Split data into ts packets. The first packet has payload_unit_start set and optionally a pcr.
+		If pad_with_ff is true (sections) the last packet is padded with 0xff, otherwise (pes)
+		adaptation field stuffing is used
+	*/
+	void put_payload(int pid, const uint8_t* data, int len, bool pad_with_ff, int64_t pcr = -1) {
+		bool first = true;
+		while (len > 0 || first) {
+			uint8_t p[ts_packet_t::size];
+			p[0] = 0x47;
+			p[1] = (first ? 0x40 : 0) | (pid >> 8);
+			p[2] = pid & 0xff;
+			int pos = 4;
+			int af_len = -1; //no adaptation field
+			if (first && pcr >= 0)
+				af_len = 7;
+			int room = ts_packet_t::size - 4 - (af_len >= 0 ? af_len + 1 : 0);
+			if (!pad_with_ff && len < room) {
+				//stuffing: grow the adaptation field
+				af_len = (af_len >= 0 ? af_len : -1) + (room - len);
+				room = len;
+			}
+			p[3] = (af_len >= 0 ? 0x30 : 0x10) | (cc[pid] & 0xf);
+			cc[pid]++;
+			if (af_len >= 0) {
+				p[pos++] = af_len;
+				if (af_len > 0) {
+					int flags_pos = pos;
+					p[pos++] = 0;
+					if (first && pcr >= 0) {
+						p[flags_pos] = 0x10;
+						int64_t base = pcr / 300;
+						int ext = pcr % 300;
+						p[pos++] = base >> 25;
+						p[pos++] = base >> 17;
+						p[pos++] = base >> 9;
+						p[pos++] = base >> 1;
+						p[pos++] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+						p[pos++] = ext & 0xff;
+					}
+					while (pos < 4 + 1 + af_len)
+						p[pos++] = 0xff;
+				}
+			}
+			int n = std::min(room, len);
+			memcpy(p + pos, data, n);
+			pos += n;
+			data += n;
+			len -= n;
+			while (pos < ts_packet_t::size)
+				p[pos++] = 0xff;
+			out.insert(out.end(), p, p + ts_packet_t::size);
+			first = false;
+		}
+	}
+
+	static void start_section(std::vector<uint8_t>& s, int table_id, int ext, int section_number,
+														int last_section_number) {
+		s = {(uint8_t)table_id, 0xb0, 0, (uint8_t)(ext >> 8), (uint8_t)ext, 0xc1 /*version 0, current*/,
+			(uint8_t)section_number, (uint8_t)last_section_number};
+	}
+
+	static void put16(std::vector<uint8_t>& s, int v) {
+		s.push_back(v >> 8);
+		s.push_back(v & 0xff);
+	}
+
+	//fill in section_length, append the crc and output the section with pointer_field 0
+	void put_section(int pid, std::vector<uint8_t>& s) {
+		int section_length = s.size() - 3 + 4;
+		s[1] = (s[1] & 0xf0) | (section_length >> 8);
+		s[2] = section_length & 0xff;
+		auto crc = crc32_update(0xffffffff, s.data(), s.size());
+		for (int i = 0; i < 4; ++i)
+			s.push_back(crc >> (24 - 8 * i));
+		s.insert(s.begin(), 0); //pointer_field
+		put_payload(pid, s.data(), s.size(), true);
+	}
+
+	void put_pat() {
+		std::vector<uint8_t> s;
+		start_section(s, 0x00, ts_id, 0, 0);
+		put16(s, 0);
+		put16(s, 0xe000 | nit_pid);
+		for (auto& srv : services) {
+			put16(s, srv.service_id);
+			put16(s, 0xe000 | srv.pmt_pid);
+		}
+		put_section(0x0, s);
+	}
+
+	void put_pmt(const service_t& srv) {
+		std::vector<uint8_t> s;
+		start_section(s, 0x02, srv.service_id, 0, 0);
+		put16(s, 0xe000 | srv.video_pid); //pcr pid
+		put16(s, 0xf000);									//program_info_length
+		s.push_back(srv.video_stream_type);
+		put16(s, 0xe000 | srv.video_pid);
+		put16(s, 0xf000);
+		s.push_back(srv.audio_stream_type);
+		put16(s, 0xe000 | srv.audio_pid);
+		put16(s, 0xf000);
+		put_section(srv.pmt_pid, s);
+	}
+
+	void put_sdt() {
+		std::vector<uint8_t> s;
+		start_section(s, 0x42, ts_id, 0, 0);
+		s[1] = 0xf0;
+		put16(s, network_id);
+		s.push_back(0xff);
+		for (auto& srv : services) {
+			char name[32];
+			int name_len = snprintf(name, sizeof(name), "Service %d", srv.service_id);
+			put16(s, srv.service_id);
+			s.push_back(0xfc); //no eit schedule/present following flags
+			put16(s, 0x8000 | (5 + name_len)); //running
+			s.push_back(0x48);									//service_descriptor
+			s.push_back(3 + name_len);
+			s.push_back(0x01);
+			s.push_back(0); //provider name
+			s.push_back(name_len);
+			s.insert(s.end(), name, name + name_len);
+		}
+		put_section(0x11, s);
+	}
+
+	void put_nit() {
+		std::vector<uint8_t> s;
+		start_section(s, 0x40, network_id, 0, 0);
+		s[1] = 0xf0;
+		put16(s, 0xf000); //network_descriptors_length
+		put16(s, 0xf000 | 6);
+		put16(s, ts_id);
+		put16(s, network_id);
+		put16(s, 0xf000);
+		put_section(nit_pid, s);
+	}
+
+	//eit section with num_events events with a short event descriptor of about text_len bytes
+	void put_eit(int table_id, const service_t& srv, int section_number, int last_section_number, int num_events,
+							 int text_len) {
+		std::vector<uint8_t> s;
+		start_section(s, table_id, srv.service_id, section_number, last_section_number);
+		s[1] = 0xf0;
+		put16(s, ts_id);
+		put16(s, network_id);
+		s.push_back(std::min(last_section_number, section_number | 7)); //segment_last_section_number
+		s.push_back(table_id);
+		for (int i = 0; i < num_events; ++i) {
+			int event_id = section_number * num_events + i;
+			int hour = (event_id * 30 / 60) % 24;
+			int minute = (event_id * 30) % 60;
+			put16(s, event_id);
+			put16(s, 60000); //mjd
+			s.push_back(((hour / 10) << 4) | (hour % 10));
+			s.push_back(((minute / 10) << 4) | (minute % 10));
+			s.push_back(0);
+			s.push_back(0x00); //duration 00:30:00
+			s.push_back(0x30);
+			s.push_back(0x00);
+			char name[32];
+			int name_len = snprintf(name, sizeof(name), "Event %d", event_id);
+			int desc_len = 3 + 1 + name_len + 1 + text_len;
+			put16(s, 0x8000 | (2 + desc_len));
+			s.push_back(0x4d); //short_event_descriptor
+			s.push_back(desc_len);
+			s.push_back('e');
+			s.push_back('n');
+			s.push_back('g');
+			s.push_back(name_len);
+			s.insert(s.end(), name, name + name_len);
+			s.push_back(text_len);
+			for (int j = 0; j < text_len; ++j)
+				s.push_back('a' + j % 26);
+		}
+		put_section(0x12, s);
+	}
+
+	void put_pes(int pid, int stream_id, const std::vector<uint8_t>& es, int64_t pts, bool with_length,
+							 int64_t pcr = -1) {
+		std::vector<uint8_t> pes = {0, 0, 1, (uint8_t)stream_id, 0, 0, 0x80, 0x80 /*pts only*/, 5};
+		pes.push_back(0x21 | ((pts >> 29) & 0x0e));
+		pes.push_back(pts >> 22);
+		pes.push_back(0x01 | ((pts >> 14) & 0xfe));
+		pes.push_back(pts >> 7);
+		pes.push_back(0x01 | ((pts << 1) & 0xfe));
+		pes.insert(pes.end(), es.begin(), es.end());
+		if (with_length) {
+			int len = pes.size() - 6;
+			pes[4] = len >> 8;
+			pes[5] = len & 0xff;
+		}
+		put_payload(pid, pes.data(), pes.size(), false, pcr);
+	}
+
+	//es payload which does not contain start codes
+	void filler(std::vector<uint8_t>& es, int len) {
+		for (int i = 0; i < len; ++i)
+			es.push_back(0x80 | random_byte());
+	}
+
+public:
+	mux_generator_t(std::vector<uint8_t>& out) : out(out) {}
+
+	/*
+		25 frames per second; pat and pmt every 100ms; sdt, nit and eit present/following every 2s;
+		one eit schedule section per frame
+	*/
+	void generate(int seconds) {
+		const int gop_size = 12;
+		for (int frame = 0; frame < seconds * 25; ++frame) {
+			int64_t pts = 90000 + frame * 3600;
+			if (frame % 3 == 0) {
+				put_pat();
+				for (auto& srv : services)
+					put_pmt(srv);
+			}
+			if (frame % 50 == 0) {
+				put_sdt();
+				put_nit();
+				for (auto& srv : services) {
+					put_eit(0x4e, srv, 0, 1, 1, 100);
+					put_eit(0x4e, srv, 1, 1, 1, 100);
+				}
+			}
+			{
+				//eit schedule: 16 sections per service, each spanning several packets
+				auto& srv = services[(frame / 16) % 3];
+				put_eit(0x50, srv, frame % 16, 15, 4, 200);
+			}
+			int gop_pos = frame % gop_size;
+			for (auto& srv : services) {
+				std::vector<uint8_t> es;
+				int frame_size = gop_pos == 0 ? 40 * 184 : 12 * 184;
+				if (srv.video_stream_type == 0x02) {
+					//picture start code; temporal reference, picture_coding_type (1=I, 2=P, 3=B)
+					int type = gop_pos == 0 ? 1 : (gop_pos % 3 == 0 ? 2 : 3);
+					es = {0, 0, 1, 0, (uint8_t)(gop_pos >> 2), (uint8_t)(((gop_pos & 3) << 6) | (type << 3)), 0xff,
+						0xf8};
+				} else if (srv.video_stream_type == 0x1b) {
+					//access unit delimiter; primary_pic_type (0=I, 1=I/P, 2=I/P/B) followed by rbsp trailing bits
+					int type = gop_pos == 0 ? 0 : (gop_pos % 3 == 0 ? 1 : 2);
+					es = {0, 0, 0, 1, 0x09, (uint8_t)((type << 5) | 0x10), 0, 0, 1, 0x01};
+				} else {
+					//hevc access unit delimiter
+					int type = gop_pos == 0 ? 0 : (gop_pos % 3 == 0 ? 1 : 2);
+					es = {0, 0, 0, 1, 0x46, 0x01, (uint8_t)((type << 5) | 0x10), 0, 0, 1, 0x02, 0x01};
+				}
+				filler(es, frame_size);
+				put_pes(srv.video_pid, 0xe0, es, pts, false, pts * 300);
+				//two audio frames per video frame
+				for (int i = 0; i < 2; ++i) {
+					es = {0xff, 0xfd};
+					filler(es, 3 * 184);
+					put_pes(srv.audio_pid, 0xc0, es, pts + i * 1800, true);
+				}
+			}
+		}
+	}
+};
+
+} //namespace dtdemux
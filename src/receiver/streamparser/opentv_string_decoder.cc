@@ -74,11 +74,11 @@ INLINE multi_huff_entry_t* tstxxx(uint32_t code, int num_bits)
 #endif
 
 //__attribute__((optnone)) //12 us /call
-bool opentv_decode_string(ss::string_& ret, unsigned char* data, unsigned int n, opentv_table_type_t t) {
+bool opentv_decode_string(ss::string_& ret, const unsigned char* data, unsigned int n, opentv_table_type_t t) {
 	//tst();
-	unsigned char* p = data; // current input byte
+	const unsigned char* p = data; // current input byte
 	int pbits = 8;					 // number of bits still present in p[0]
-	unsigned char* pend = p + n;
+	const unsigned char* pend = p + n;
 #if 0
 	uint32_t end_of_string_code{0xe36f0000};
 #endif
@@ -28,4 +28,4 @@ namespace ss {
 	class string_;
 }
 
-bool opentv_decode_string(ss::string_&ret, unsigned char*data, unsigned int n, opentv_table_type_t t);
+bool opentv_decode_string(ss::string_&ret, const unsigned char*data, unsigned int n, opentv_table_type_t t);
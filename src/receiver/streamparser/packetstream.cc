@@ -27,6 +27,7 @@
 #include <iostream>
 
 #include "packetstream.h"
+#include "startcode.h"
 using namespace dtdemux;
 
 using namespace boost;
@@ -168,26 +169,41 @@ uint8_t ts_substream_t::get_start_code() {
 
 /*
 	Scan forward until start_code is reached
+
+	The payload of each packet is searched with find_start_code_prefix. Prefixes which straddle a packet
+	boundary are found by checking the first two bytes of each packet against the last bytes of the previous one.
+	The byte following the prefix is read with get, as it may be in the next packet
 */
 uint8_t ts_substream_t::next_start_code() {
-	uint32_t code = get<uint32_t>();
+	uint32_t window = 0xffffffff; //last bytes consumed, most recent in the low byte
 	for (;;) {
-		if ((code & 0xffffff00) == 0x00000100) { /*00 00 01 XX*/
-			return code & 0xff;
-		} else if ((code & 0x00ffffff) == 0x00000001) { /*YY 00 00 01 */
-			auto temp = get<uint8_t>();
-			code = (code << 8) | temp;
-		} else if ((code & 0xffff) == 0) { /*YY YY 00 00 */
-			auto temp = get<uint16_t>();
-			code = (code << 16) | temp;
-		} else if ((code & 0xff) == 0) { /*YY YY YY 00 */
-			auto temp = get<uint16_t>();
-			code = (code << 16) | temp;
-			auto temp1 = get<uint8_t>();
-			code = (code << 8) | temp1;
-		} else {
-			code = get<uint32_t>();
+		auto& range = current_ts_packet->range;
+		auto avail = range.available();
+		auto* p = range.current_pointer(0);
+		int64_t found = -1;
+		int64_t i = 0;
+		for (; i < std::min(avail, int64_t(2)); ++i) {
+			window = (window << 8) | p[i];
+			if ((window & 0xffffff) == 0x000001) {
+				found = i + 1;
+				break;
+			}
+		}
+		if (found < 0) {
+			auto pos = find_start_code_prefix(p, avail);
+			if (pos >= 0)
+				found = pos + 3;
 		}
+		if (found >= 0) {
+			range.skip(found);
+			bytes_read += found;
+			return get<uint8_t>();
+		}
+		if (avail >= 2)
+			window = 0xffff0000 | (p[avail - 2] << 8) | p[avail - 1];
+		range.skip(avail);
+		bytes_read += avail;
+		get_next_packet();
 		if (has_error())
 			return 0xff;
 	}
@@ -260,6 +276,25 @@ void ts_substream_t::skip_to_unit_start() {
 	bytes_read = 0;
 }
 
+/*
+	In header only indexing mode, called when parse_payload_unit has found all it needs in a pes packet:
+	skip the remaining packets of the pes packet without processing their headers one by one.
+	Afterwards the state is the same as after calling get_next_packet for each of them; packets
+	with an adaptation field, duplicates and continuity errors are left to get_next_packet
+*/
+void ts_substream_t::skip_rest_of_unit() {
+	if (!parent.header_only_indexing || continuity_counter == 0xff || has_error() || has_encrypted())
+		return;
+	bool scrambled{false};
+	auto* p = parent.skip_payload_packets(continuity_counter, scrambled);
+	if (!p)
+		return;
+	current_ts_packet = p;
+	continuity_counter = p->get_continuity_counter();
+	if (scrambled)
+		throw_encrypted_data();
+}
+
 /*
 	provides the next packet for the CURRENT stream. If the next packet is for another
 	stream, this function will yield (suspend it self).
@@ -291,8 +326,10 @@ bool ts_substream_t::process_packet_header(ts_packet_t* p) {
 		if (has_encrypted()) {
 			parent.num_encrypted_packets++;
 			num_encrypted_packets++;
-		} else
+		} else {
+			unit_completed_bytepos = p->range.start_bytepos();
 			unit_completed_cb();
+		}
 	}
 	current_unit_end_bytepos = current_ts_packet->range.start_bytepos(); // not an error
 
@@ -375,7 +412,7 @@ void ts_stream_t::register_audio_pids(int service_id, int audio_pid, int pcr_pid
 		/*If there is already a video parser, then remove it
 		 */
 
-		fibers.erase(dvb_pid_t(this->pcr_pid));
+		erase_fiber(this->pcr_pid);
 		return;
 	}
 
@@ -407,7 +444,7 @@ void ts_stream_t::register_video_pids(int service_id, int video_pid, int pcr_pid
 		/*If there is already a video parser, then remove it
 		 */
 
-		fibers.erase(dvb_pid_t(this->pcr_pid));
+		erase_fiber(this->pcr_pid);
 		// return;
 	}
 
@@ -70,6 +70,12 @@ namespace dtdemux {
 		std::function<void(uint16_t, const ss::bytebuffer_&)>  psi_cb =
 			[](uint16_t pid, const ss::bytebuffer_& payload) {};
 		uint32_t num_encrypted_packets{0};
+		int64_t num_sections{0}; //number of psi/si sections seen, including repeated ones
+		int64_t num_duplicate_sections_skipped{0}; //repeated sections dropped before copying and crc checking
+		int64_t num_duplicate_bytes_skipped{0};
+		/*only parse pes headers up to the point where the frame type is known and skip the remainder
+			of each pes packet at packet level (only effective with batch dispatch)*/
+		bool header_only_indexing{false};
 
 		void set_eof() {
 			eof = true;
@@ -80,7 +86,7 @@ namespace dtdemux {
 		}
 
 		bool need_data() const {
-			return (current_range.available() < av_pkt_size);
+			return (current_range.available() < av_pkt_size) && !batch_pending();
 		}
 
 
@@ -104,6 +110,25 @@ namespace dtdemux {
 			}
 		}
 
+		void set_batch_dispatch(bool on) {
+			stream_parser_base_t<ts_stream_t>::set_batch_dispatch(on);
+			event_handler.defer_markers = on;
+		}
+
+		void batch_dispatched() {
+			event_handler.batch_completed();
+		}
+
+		data_range_t read_batch() {
+			auto len = current_range.available();
+			len -= len % av_pkt_size;
+			if(len <= 0)
+				return {};
+			auto range = current_range.sub_range(current_range.processed(), len);
+			current_range.skip(len);
+			return range;
+		}
+
 		/*
 			Undo  the last read operation. Only possible directly after a read!
 		 */
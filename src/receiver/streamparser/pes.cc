@@ -479,7 +479,8 @@ void pes_parser_t::unit_completed_cb() {
 #endif
 	if (current_unit_type != stream_type::marker_t::illegal)
 		parent.event_handler.index_event(current_unit_type, this->last_play_time, this->last_pts, this->last_dts,
-																		 this->current_unit_start_bytepos, this->current_unit_end_bytepos, this->name);
+																		 this->current_unit_start_bytepos, this->current_unit_end_bytepos,
+																		 this->unit_completed_bytepos, this->name);
 	current_unit_start_bytepos = current_ts_packet->range.start_bytepos();
 }
 
@@ -498,6 +499,8 @@ void dtdemux::audio_parser_t::parse_payload_unit() {
 		dterrorf("unexpected: pes_packet_len=0 in audio stream");
 	}
 	this->current_unit_type = stream_type::marker_t::pes_other;
+	if (parent.header_only_indexing)
+		return; //the remainder of the pes packet is skipped by skip_rest_of_unit
 	this->skip(pes_packet_len - pes_header_data_len - 2 /*flags*/ - 1 /*pes_header_data_len*/);
 
 	return;
@@ -0,0 +1,188 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "pidstats.h"
+#include <algorithm>
+#include <limits.h>
+#include <time.h>
+
+using namespace dtdemux;
+
+static constexpr int pkt_size = 188;
+static constexpr int64_t pcr_wrap = (int64_t(1) << 33) * 300;
+static constexpr int64_t max_pcr_gap = 27000000; //1 second
+
+static inline int64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//single writer increment
+template<typename T> static inline void add(std::atomic<T>& x, T delta) {
+	x.store(x.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+pid_stats_t::pid_stats_t()
+	: entries(std::make_unique<std::array<entry_t, 8192>>())
+{}
+
+/*
+	Returns the entry for pid if owner may update it, claiming it if it has no owner yet
+*/
+inline pid_stats_t::entry_t* pid_stats_t::claim(int pid, const void* owner, int64_t now) {
+	auto& e = (*entries)[pid];
+	auto* current = e.owner.load(std::memory_order_relaxed);
+	if (current == owner)
+		return &e;
+	if (current || !e.owner.compare_exchange_strong(current, owner, std::memory_order_acquire))
+		return nullptr;
+	//new owner: forget the writer state of the previous one
+	e.last_cc = -1;
+	e.last_was_duplicate = false;
+	e.window_packets = 0;
+	e.last_pcr = -1;
+	e.window_start_ns.store(now, std::memory_order_relaxed);
+	return &e;
+}
+
+void pid_stats_t::end_window(entry_t& e, int64_t now) {
+	auto start = e.window_start_ns.load(std::memory_order_relaxed);
+	e.bitrate.store(e.window_packets * int64_t(pkt_size * 8) * 1000000000LL / (now - start), std::memory_order_relaxed);
+	e.window_packets = 0;
+	if (e.last_pcr >= 0) {
+		int32_t jitter = std::min(e.max_pcr_offset - e.min_pcr_offset, int64_t(INT32_MAX));
+		e.pcr_jitter_ns.store(jitter, std::memory_order_relaxed);
+		if (jitter > e.max_pcr_jitter_ns.load(std::memory_order_relaxed))
+			e.max_pcr_jitter_ns.store(jitter, std::memory_order_relaxed);
+		e.min_pcr_offset = e.max_pcr_offset = now - e.pcr_anchor_ns - e.pcr_elapsed_ns;
+	}
+	e.window_start_ns.store(now, std::memory_order_relaxed);
+}
+
+/*
+	p points to a packet with a pcr in its adaptation field
+*/
+void pid_stats_t::update_pcr(entry_t& e, const uint8_t* p, int64_t now) {
+	int64_t base = (int64_t(p[6]) << 25) | (p[7] << 17) | (p[8] << 9) | (p[9] << 1) | (p[10] >> 7);
+	int64_t pcr = base * 300 + (((p[10] & 1) << 8) | p[11]);
+	bool discontinuity_indicator = p[5] & 0x80;
+	add(e.num_pcrs, int64_t(1));
+	if (e.last_pcr >= 0) {
+		auto delta = pcr - e.last_pcr;
+		if (delta < 0)
+			delta += pcr_wrap;
+		if (delta <= max_pcr_gap) {
+			e.last_pcr = pcr;
+			e.pcr_elapsed_ns += delta * 1000 / 27;
+			auto offset = now - e.pcr_anchor_ns - e.pcr_elapsed_ns;
+			e.min_pcr_offset = std::min(e.min_pcr_offset, offset);
+			e.max_pcr_offset = std::max(e.max_pcr_offset, offset);
+			return;
+		}
+		if (!discontinuity_indicator)
+			add(e.num_pcr_discontinuities, int64_t(1));
+	}
+	//first pcr or discontinuity
+	e.last_pcr = pcr;
+	e.pcr_anchor_ns = now;
+	e.pcr_elapsed_ns = 0;
+	e.min_pcr_offset = e.max_pcr_offset = 0;
+}
+
+void pid_stats_t::update(const uint8_t* buffer, int64_t len, const void* owner) {
+	auto now = now_ns();
+	for (const auto* p = buffer; p + pkt_size <= buffer + len; p += pkt_size) {
+		if (p[0] != 0x47)
+			continue;
+		int pid = ((p[1] & 0x1f) << 8) | p[2];
+		auto* e = claim(pid, owner, now);
+		if (!e)
+			continue;
+		add(e->num_packets, int64_t(1));
+		e->window_packets++;
+		if (now - e->window_start_ns.load(std::memory_order_relaxed) >= window_ns)
+			end_window(*e, now);
+		if (p[1] & 0x80) {
+			add(e->num_transport_errors, int64_t(1));
+			continue; //rest of the header cannot be trusted
+		}
+		if (p[3] & 0xc0)
+			add(e->num_scrambled, int64_t(1));
+		if (pid == 0x1fff)
+			continue;
+		bool has_adaptation = p[3] & 0x20;
+		bool has_payload = p[3] & 0x10;
+		bool discontinuity_indicator = has_adaptation && p[4] > 0 && (p[5] & 0x80);
+		int8_t cc = p[3] & 0x0f;
+		if (e->last_cc >= 0 && !discontinuity_indicator) {
+			if (!has_payload) {
+				//continuity counter does not increment
+				if (cc != e->last_cc)
+					add(e->num_cc_errors, int64_t(1));
+			} else if (cc == e->last_cc) {
+				//one duplicate packet is allowed
+				if (e->last_was_duplicate)
+					add(e->num_cc_errors, int64_t(1));
+				e->last_was_duplicate = true;
+			} else {
+				if (cc != ((e->last_cc + 1) & 0xf))
+					add(e->num_cc_errors, int64_t(1));
+				e->last_was_duplicate = false;
+			}
+		}
+		e->last_cc = cc;
+		if (has_adaptation && p[4] >= 7 && (p[5] & 0x10))
+			update_pcr(*e, p, now);
+	}
+}
+
+void pid_stats_t::release(const void* owner) {
+	for (auto& e : *entries) {
+		auto* current = owner;
+		e.owner.compare_exchange_strong(current, nullptr, std::memory_order_release, std::memory_order_relaxed);
+	}
+}
+
+std::vector<pid_stats_snapshot_t> pid_stats_t::snapshot() const {
+	std::vector<pid_stats_snapshot_t> ret;
+	auto now = now_ns();
+	for (int pid = 0; pid < (int)entries->size(); ++pid) {
+		auto& e = (*entries)[pid];
+		auto num_packets = e.num_packets.load(std::memory_order_relaxed);
+		if (num_packets == 0)
+			continue;
+		auto& s = ret.emplace_back();
+		s.pid = pid;
+		s.num_packets = num_packets;
+		s.num_cc_errors = e.num_cc_errors.load(std::memory_order_relaxed);
+		s.num_transport_errors = e.num_transport_errors.load(std::memory_order_relaxed);
+		s.num_scrambled = e.num_scrambled.load(std::memory_order_relaxed);
+		s.num_clear = std::max(int64_t(0), num_packets - s.num_scrambled - s.num_transport_errors);
+		s.num_pcrs = e.num_pcrs.load(std::memory_order_relaxed);
+		s.num_pcr_discontinuities = e.num_pcr_discontinuities.load(std::memory_order_relaxed);
+		//windows only end when packets arrive; a pid which stopped has no bitrate
+		bool stale = now - e.window_start_ns.load(std::memory_order_relaxed) > 2 * window_ns;
+		s.bitrate = stale ? 0 : e.bitrate.load(std::memory_order_relaxed);
+		s.pcr_jitter_ns = stale ? 0 : e.pcr_jitter_ns.load(std::memory_order_relaxed);
+		s.max_pcr_jitter_ns = e.max_pcr_jitter_ns.load(std::memory_order_relaxed);
+	}
+	return ret;
+}
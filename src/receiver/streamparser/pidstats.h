@@ -0,0 +1,115 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace dtdemux {
+
+	/*!
+		Copy of the health counters of one pid, as returned by pid_stats_t::snapshot
+	*/
+	struct pid_stats_snapshot_t {
+		uint16_t pid{0};
+		int64_t num_packets{0};
+		int64_t num_cc_errors{0};
+		int64_t num_transport_errors{0}; //packets with transport_error_indicator set
+		int64_t num_scrambled{0};
+		int64_t num_clear{0};
+		int64_t num_pcrs{0};
+		int64_t num_pcr_discontinuities{0}; //pcr jumps not announced by the discontinuity_indicator
+		int32_t bitrate{0}; //bits/s, measured over the last second
+		int32_t pcr_jitter_ns{0}; //measured over the last second
+		int32_t max_pcr_jitter_ns{0};
+	};
+
+	/*!
+		Per pid health counters of a transport stream, maintained while reading data.
+
+		All counters are relaxed atomics, so that other threads (e.g., python code) can read them
+		at any time without taking locks; the values of different counters need not be consistent with each other.
+
+		Several readers (e.g., the si stream and the services of a mux, each having their own demux filter)
+		can share one pid_stats_t. Each pid is updated by only one of them: the first reader which
+		sees a packet of the pid becomes its owner until it calls release().
+		As each pid has only one writer, counters are updated with load+store instead of atomic increments.
+
+		pcr jitter is measured against the time at which the data was read, and therefore includes
+		variations in delivery delay by the demux; it is intended for detecting bad reception, not for
+		precise conformance testing.
+	*/
+	class pid_stats_t {
+		struct entry_t {
+			std::atomic<const void*> owner{nullptr};
+			std::atomic<int64_t> num_packets{0};
+			std::atomic<int64_t> num_cc_errors{0};
+			std::atomic<int64_t> num_transport_errors{0};
+			std::atomic<int64_t> num_scrambled{0};
+			std::atomic<int64_t> num_pcrs{0};
+			std::atomic<int64_t> num_pcr_discontinuities{0};
+			std::atomic<int32_t> bitrate{0};
+			std::atomic<int32_t> pcr_jitter_ns{0};
+			std::atomic<int32_t> max_pcr_jitter_ns{0};
+			std::atomic<int64_t> window_start_ns{0}; //start of the current bitrate/jitter measurement window
+
+			//only accessed by the owner
+			int8_t last_cc{-1};
+			bool last_was_duplicate{false};
+			int32_t window_packets{0};
+			int64_t last_pcr{-1}; //27Mhz ticks
+			int64_t pcr_anchor_ns{0}; //read time of the first pcr after a discontinuity
+			int64_t pcr_elapsed_ns{0}; //pcr time elapsed since then
+			int64_t min_pcr_offset{0}; //minimum and maximum of read time minus pcr time in the current window
+			int64_t max_pcr_offset{0};
+		};
+
+		static constexpr int64_t window_ns = 1000000000LL;
+		std::unique_ptr<std::array<entry_t, 8192>> entries;
+
+		entry_t* claim(int pid, const void* owner, int64_t now_ns);
+		void update_pcr(entry_t& e, const uint8_t* p, int64_t now_ns);
+		void end_window(entry_t& e, int64_t now_ns);
+
+	public:
+		pid_stats_t();
+
+		/*!
+			Account for all complete packets in buffer, which must start at a packet boundary.
+			owner identifies the caller; it should be the same for all calls made from the same reader
+		*/
+		void update(const uint8_t* buffer, int64_t len, const void* owner);
+
+		/*!
+			Give up ownership of all pids owned by owner, e.g., when a reader is closed.
+			The counters themselves are retained
+		*/
+		void release(const void* owner);
+
+		/*!
+			Counters of all pids which have received at least one packet; may be called from any thread
+		*/
+		std::vector<pid_stats_snapshot_t> snapshot() const;
+	};
+
+};
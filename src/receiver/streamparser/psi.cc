@@ -45,7 +45,7 @@ using namespace dtypes;
 #define lang_iso639(a, b, c) ((a) << 16 | (b) << 8 | (c))
 
 
-inline bool crc_is_correct(const ss::bytebuffer_& payload) {
+inline bool crc_is_correct(const section_view_t& payload) {
 	auto crc = crc32(payload.buffer(), payload.size());
 	return crc == 0;
 }
@@ -102,6 +102,8 @@ namespace dtdemux {
 
 		assert(!wait_for_unit_start);
 		bytes_read = 1;
+		section_start = current_ts_packet->range.current_pointer(0) - 1;
+		section_start_bytepos = current_ts_packet->range.start_bytepos();
 		payload.append_raw((uint8_t)native_to_net(ret.table_id)); // save what we read
 		assert(bytes_read == payload.size());
 		// table length
@@ -173,7 +175,8 @@ namespace dtdemux {
 	generic parser which saves a complete table section
 	This is equivalent to getting a section
 */
-	void section_parser_t::parse_payload_unit_(bool parse_only_section_header) {
+	bool section_parser_t::parse_payload_unit_(bool parse_only_section_header,
+																						 parser_status_t* known_sections) {
 		// auto current_frame = pes_packet_desc_t(*current_ts_packet);
 		section_complete = false;
 		section_header_t hdr{};
@@ -183,34 +186,86 @@ namespace dtdemux {
 			parse_table_header(hdr);
 		if (error) {
 			parsed_header = section_header_t{};
-			RETURN_ON_ERROR;
+			return false;
 		}
 		hdr.pid = current_ts_packet->get_pid();
 
 		int toread = hdr.len - (bytes_read - 3); // we may already read 5 bytes of data following the length field
 		if (toread <= 0 || toread >= 4096) {
 			error = true;
-			RETURN_ON_ERROR;
+			return false;
 		}
+		parent.num_sections++;
 
 		bool is_stuffing = (hdr.table_id == 0x72);
-		if (this->get_buffer((uint8_t*)payload.buffer() + payload.size(), toread) < 0) {
-			THROW_BAD_DATA;
-			RETURN_ON_ERROR;
+		if (known_sections && !is_stuffing && hdr.section_syntax_indicator && toread >= 4) {
+			/*
+				Carousels mostly repeat sections which have been seen before. If this is the case,
+				skip the section body in the ts packets and only compare its crc with the known one
+			*/
+			auto known_crc = known_sections->known_section_crc(hdr);
+			if (known_crc) {
+				if (skip(toread - 4) < 0) {
+					throw_bad_data();
+					return false;
+				}
+				hdr.crc = this->get<uint32_t>();
+				if (has_error())
+					return false;
+				num_duplicate_sections_skipped++;
+				num_duplicate_bytes_skipped += bytes_read;
+				parent.num_duplicate_sections_skipped++;
+				parent.num_duplicate_bytes_skipped += bytes_read;
+				if (hdr.crc != *known_crc) {
+					/*corrupt section, or content changed without a version change; both would have been
+						ignored anyway. Forget the crc, so that the next copy is checked in full*/
+					dtdebugf("Repeated section changed: table_id=0x{:x} section_number={:d} pid=0x{:x}",
+									 hdr.table_id, hdr.section_number, pid);
+					known_sections->forget_section_crc(hdr);
+				}
+				return false;
+			}
+		}
+
+		/*
+			A section which starts and ends in the current packet is parsed in place, after checking that
+			its header bytes (which were also copied into payload) were read from this packet.
+			Longer sections are reassembled in payload. The generic parser always copies, because
+			psi_cb expects a buffer
+		*/
+		auto& range = current_ts_packet->range;
+		bool in_place = !parse_only_section_header && toread <= range.available() &&
+			section_start_bytepos == range.start_bytepos() &&
+			section_start >= range.get_buffer_ptr() &&
+			section_start + bytes_read == range.current_pointer(0);
+		if (in_place) {
+			section_data = section_view_t(section_start, bytes_read + toread);
+			this->skip(toread);
+			num_sections_in_place++;
+		} else {
+			if (this->get_buffer((uint8_t*)payload.buffer() + payload.size(), toread) < 0) {
+				throw_bad_data();
+				return false;
+			}
+			payload.resize_no_init(toread + payload.size());
+			section_data = section_view_t(payload);
 		}
-		payload.resize_no_init(toread + payload.size());
 
 		if (!is_stuffing) {
 			if (!parse_only_section_header && hdr.section_syntax_indicator &&
-					!crc_is_correct(payload)) { // CA sections may not have a crc!
+					!crc_is_correct(section_data)) { // CA sections may not have a crc!
 				dtdebugf("Skipping bad section (CRC error) section_number={} pid=0x{:x}", hdr.section_number, pid);
-				THROW_BAD_DATA;
-				RETURN_ON_ERROR;
+				throw_bad_data();
+				return false;
+			}
+			if (hdr.section_syntax_indicator) {
+				auto* p = section_data.buffer() + section_data.size() - 4;
+				hdr.crc = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
 			}
 			if (hdr.is_eit()) {
 				assert(hdr.len > 13);
-				hdr.segment_last_section_number = payload[12];
-				hdr.last_table_id = payload[13];
+				hdr.segment_last_section_number = section_data[12];
+				hdr.last_table_id = section_data[13];
 			} else {
 				hdr.last_table_id = hdr.table_id;
 				hdr.segment_last_section_number = -1;
@@ -219,7 +274,7 @@ namespace dtdemux {
 		// current_frame.set_end(current_ts_packet->range.end_bytepos());
 		parsed_header = hdr;
 		section_complete = true;
-		return;
+		return true;
 	}
 
 /*
@@ -234,6 +289,16 @@ namespace dtdemux {
 		return;
 	}
 
+	const ss::bytebuffer_& section_parser_t::section_payload() {
+		if (section_data.buffer() != (const uint8_t*) payload.buffer()) {
+			//section was parsed in place; payload only contains its header
+			auto header_len = payload.size();
+			payload.append_raw(section_data.buffer() + header_len, section_data.size() - header_len);
+			section_data = section_view_t(payload);
+		}
+		return payload;
+	}
+
 /*!
 	update  byte position markets when a current pes packet or a current section has been completed
 */
@@ -242,13 +307,12 @@ namespace dtdemux {
 		dtdebugf("INDEX: %c: [{:d}, {:d}[", 	(char)current_unit_type, current_unit_start_bytepos,
 						 current_unit_end_bytepos);
 #endif
-		if (current_unit_type == stream_type::marker_t::pat) {
-			parent.event_handler.last_pat_start_bytepos = this->current_unit_start_bytepos;
-			parent.event_handler.last_pat_end_bytepos = this->current_unit_end_bytepos;
-		} else if (current_unit_type == stream_type::marker_t::pmt) {
-			parent.event_handler.last_pmt_start_bytepos = this->current_unit_start_bytepos;
-			parent.event_handler.last_pmt_end_bytepos = this->current_unit_end_bytepos;
-		}
+		if (current_unit_type == stream_type::marker_t::pat)
+			parent.event_handler.pat_completed(this->current_unit_start_bytepos, this->current_unit_end_bytepos,
+																				 this->unit_completed_bytepos);
+		else if (current_unit_type == stream_type::marker_t::pmt)
+			parent.event_handler.pmt_completed(this->current_unit_start_bytepos, this->current_unit_end_bytepos,
+																				 this->unit_completed_bytepos);
 #if 0
 		parent.event_handler.index_event(current_unit_type,
 																		 /* this->pid, this->stream_type, */
@@ -256,7 +320,7 @@ namespace dtdemux {
 																		 1, //illegal
 																		 1, //illegal
 																		 this->current_unit_start_bytepos,
-																		 this->current_unit_end_bytepos, this->name);
+																		 this->current_unit_end_bytepos, this->unit_completed_bytepos, this->name);
 #endif
 
 		current_unit_start_bytepos = current_ts_packet->range.start_bytepos();
@@ -329,17 +393,17 @@ namespace dtdemux {
 
 }; // namespace dtdemux
 
-void psi_parser_t::parse_payload_unit_init() {
+bool psi_parser_t::parse_payload_unit_init() {
 	auto new_play_time = parent.event_handler.pcr_play_time();
 	assert(new_play_time >= this->last_play_time);
 	this->last_play_time = new_play_time;
 	bool parse_only_section_header = false;
-	section_parser_t::parse_payload_unit_(parse_only_section_header);
+	return section_parser_t::parse_payload_unit_(parse_only_section_header, &parser_status);
 }
 
 void pmt_parser_t::parse_payload_unit() {
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 
 	auto& hdr = *header();
 
@@ -359,12 +423,13 @@ void pmt_parser_t::parse_payload_unit() {
 	bool success = false;
 
 	if (must_process || timedout)  {
-		stored_section_t section(payload, hdr.pid);
+		stored_section_t section(section_data, hdr.pid);
 		section.skip(hdr.header_len); // already parsed
 		success = timedout ? true : parse_pmt_section(section, pmt);
 		if (success) {
-			pmt.stream_packetno_end = parent.event_handler.last_pmt_end_bytepos / ts_packet_t::size;
-			auto must_reset = this->section_cb(this, pmt, !hdr.current_next, section.payload);
+			pmt.stream_packetno_end =
+				parent.event_handler.pmt_end_bytepos_before(current_ts_packet->range.start_bytepos()) / ts_packet_t::size;
+			auto must_reset = this->section_cb(this, pmt, !hdr.current_next, section_payload());
 			if (must_reset == reset_type_t::ABORT)
 				parent.return_early();
 			else if (must_reset == reset_type_t::RESET)
@@ -375,8 +440,8 @@ void pmt_parser_t::parse_payload_unit() {
 }
 
 void pat_parser_t::parse_payload_unit() {
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 
 	auto& hdr = *header();
 	if (hdr.table_id != 0x0 || !hdr.section_syntax_indicator) { // not a pat section
@@ -397,12 +462,12 @@ void pat_parser_t::parse_payload_unit() {
 	pat_services_t pat_services;
 	bool success = false;
 	if (must_process || timedout) {
-		stored_section_t section(payload, hdr.pid);
+		stored_section_t section(section_data, hdr.pid);
 		section.skip(hdr.header_len); // already parsed
 		success = parse_pat_section(section, pat_services);
 		if (success && pat_services.entries.size() == 0) {
 			dtdebugf("empty pat (2)\n");
-			stored_section_t section(payload, hdr.pid);
+			stored_section_t section(section_data, hdr.pid);
 			section.skip(hdr.header_len); // already parsed
 			pat_services_t pat_services;
 			parse_pat_section(section, pat_services);
@@ -420,8 +485,8 @@ void pat_parser_t::parse_payload_unit() {
 }
 
 void nit_parser_t::parse_payload_unit() {
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 
 	auto& hdr = *header();
 	bool is_nit = ((hdr.table_id & ~0x1) == 0x40);
@@ -443,7 +508,7 @@ void nit_parser_t::parse_payload_unit() {
 	nit_network_t network;
 	bool success{false};
 	if (must_process || timedout) {
-		stored_section_t section(payload, hdr.pid);
+		stored_section_t section(section_data, hdr.pid);
 		section.skip(hdr.header_len); // already parsed
 		success = parse_nit_section(section, network);
 	} else
@@ -463,8 +528,8 @@ void nit_parser_t::parse_payload_unit() {
 
 void sdt_bat_parser_t::parse_payload_unit() {
 	dttime_init();
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 	auto& hdr = *header();
 
 	bool is_sdt = (hdr.table_id == 0x42 || hdr.table_id == 0x46);
@@ -491,7 +556,7 @@ void sdt_bat_parser_t::parse_payload_unit() {
 		sdt_services_t services;
 		bool success{false};
 		if (must_process || timedout) {
-			stored_section_t section(payload, hdr.pid);
+			stored_section_t section(section_data, hdr.pid);
 			section.skip(hdr.header_len); // already parsed
 			success = parse_sdt_section(section, services);
 		} else
@@ -513,7 +578,7 @@ void sdt_bat_parser_t::parse_payload_unit() {
 		bool success{false};
 		if (must_process || timedout) {
 			timedout = false;
-			stored_section_t section(payload, hdr.pid);
+			stored_section_t section(section_data, hdr.pid);
 			section.skip(hdr.header_len); // already parsed
 			success = parse_bat_section(section, bouquet);
 		}
@@ -535,8 +600,8 @@ void sdt_bat_parser_t::parse_payload_unit() {
 }
 
 void eit_parser_t::parse_payload_unit() {
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 
 	auto& hdr = *header();
 	bool is_stuffing = (hdr.table_id == 0x72);
@@ -562,7 +627,7 @@ void eit_parser_t::parse_payload_unit() {
 	epg.is_freesat = (pid == dtdemux::ts_stream_t::FREESAT_EIT_PID);
 	bool success{false};
 	if (must_process || timedout) {
-		stored_section_t section(payload, hdr.pid);
+		stored_section_t section(section_data, hdr.pid);
 #ifdef PRINTTIME
 		auto xxx_start = system_clock_t::now();
 #endif
@@ -622,8 +687,8 @@ int64_t eit_parser_t::callback_delay;
 #endif
 
 void mhw2_parser_t::parse_payload_unit() {
-	parse_payload_unit_init();
-	RETURN_ON_ERROR;
+	if (!parse_payload_unit_init())
+		return;
 
 	auto& hdr = *header();
 
@@ -678,7 +743,7 @@ void mhw2_parser_t::parse_payload_unit() {
 	dtdemux::reset_type_t must_reset{dtdemux::reset_type_t::NO_RESET};
 	if (must_process || timedout) {
 		timedout = false;
-		stored_section_t section(payload, hdr.pid);
+		stored_section_t section(section_data, hdr.pid);
 		section.skip(hdr.header_len); // already parsed
 		subtable_info_t info{pid, true, hdr.table_id, hdr.version_number, hdr.last_section_number + 1, done, timedout};
 
@@ -24,6 +24,7 @@
 #include "neumodb/chdb/chdb_extra.h"
 #include "neumodb/epgdb/epgdb_extra.h"
 #include "si_state.h"
+#include "crc32.h"
 
 #include "stackstring.h"
 
@@ -285,8 +286,16 @@ namespace dtdemux {
 		*/
 		section_header_t parsed_header;
 		bool section_complete = false;
+		//position of the table_id byte of the current section in the ts packet data
+		const uint8_t* section_start{nullptr};
+		int64_t section_start_bytepos{-1};
 	protected:
 		ss::bytebuffer<4096> payload; //4096 = maximum size of any section
+		/*
+			complete current section: payload, or the ts packet data if the section was contained
+			in a single packet (psi_parser_t only)
+		*/
+		section_view_t section_data;
 		int pid = -1;
 		//int table_id = -1;
 		section_header_t* header();
@@ -306,7 +315,12 @@ namespace dtdemux {
 
 		//void write_section_header(const section_header_t& hdr, ss::bytebuffer_& out);
 	protected:
-		virtual void parse_payload_unit_(bool parse_only_section_header);
+		/*
+			if known_sections is set, sections which it reports as repeats of sections in completed subtables
+			are skipped without copying them, checking their crc or parsing them; returns false for such sections
+		*/
+		virtual bool parse_payload_unit_(bool parse_only_section_header,
+																		 parser_status_t* known_sections = nullptr);
 		virtual void parse_payload_unit() override;
 	public:
 		section_parser_t(ts_stream_t& parent, int pid, const char*name)
@@ -322,10 +336,20 @@ namespace dtdemux {
 		}
 
 		virtual void unit_completed_cb() final;
+
+		/*
+			copy of the current section, for callers which need to store it
+		*/
+		const ss::bytebuffer_& section_payload();
+
+		int64_t num_sections_in_place{0}; //sections parsed without copying them
+		int64_t num_duplicate_sections_skipped{0};
+		int64_t num_duplicate_bytes_skipped{0};
 	};
 
 	struct psi_parser_t : public section_parser_t
 	{
+		parser_status_t  parser_status;
 
 		virtual void parse_payload_unit() override;
 
@@ -338,12 +362,15 @@ namespace dtdemux {
 		virtual ~psi_parser_t() {
 		}
 
-		void parse_payload_unit_init();
+		/*
+			returns false on error and for repeated sections of completed subtables, which need no
+			further processing
+		*/
+		bool parse_payload_unit_init();
 	};
 
 	struct nit_parser_t : public psi_parser_t
 	{
-		parser_status_t  parser_status;
 		std::function<reset_type_t(nit_network_t&, const subtable_info_t&)>
 		section_cb = [](const nit_network_t& network, const subtable_info_t& subtable_info)
 			{return reset_type_t::NO_RESET;};
@@ -368,7 +395,6 @@ namespace dtdemux {
 	struct sdt_bat_parser_t : public psi_parser_t
 	{
 
-		parser_status_t  parser_status;
 		int fst_preferred_region_id{-1}; //needed to select bouquets
 
 
@@ -400,7 +426,6 @@ namespace dtdemux {
 	struct mhw2_parser_t : public psi_parser_t
 	{
 
-		parser_status_t  parser_status;
 		int fst_preferred_region_id{-1}; //needed to select bouquets
 
 		chdb::epg_type_t epg_type{chdb::epg_type_t::MOVISTAR};
@@ -441,7 +466,6 @@ namespace dtdemux {
 		static int64_t processing_delay;
 		static int64_t callback_delay;
 #endif
-		parser_status_t  parser_status;
 		chdb::epg_type_t epg_type{chdb::epg_type_t::UNKNOWN};
 		std::function<reset_type_t(epg_t&, const subtable_info_t&)>
 		section_cb = [](epg_t& epg, const subtable_info_t& subtable_info)
@@ -469,7 +493,6 @@ namespace dtdemux {
 
 	struct pat_parser_t : public psi_parser_t
 	{
-		parser_status_t  parser_status;
 		std::function<reset_type_t(const pat_services_t&, const subtable_info_t&)>
 		section_cb = [](const pat_services_t& services, const subtable_info_t& subtable_info)
 			{return reset_type_t::NO_RESET;};
@@ -491,7 +514,6 @@ namespace dtdemux {
 
 	struct pmt_parser_t : public psi_parser_t
 	{
-		parser_status_t  parser_status;
 		int current_version_number{-1};
 		int service_id {-1};
 
@@ -521,7 +543,6 @@ namespace dtdemux {
 
 
 	bool pmt_ca_changed(const pmt_info_t& a,  const pmt_info_t& b);
-	uint32_t crc32(const uint8_t* data, int size);
 
 	inline bool is_audio (const pid_info_t& pidinfo) {
 		using namespace stream_type;
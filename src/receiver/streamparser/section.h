@@ -48,6 +48,7 @@ namespace dtdemux {
 		uint8_t version_number{0};
 		uint8_t section_number{0};
 		uint8_t last_section_number{0};
+		uint32_t crc{0}; //last 4 bytes of the section, if section_syntax_indicator is set
 		bool current_next = 1;
 		bool section_syntax_indicator{0};
 		bool private_bit{0};
@@ -75,9 +76,45 @@ namespace dtdemux {
 		}
 	};
 
+	/*
+		Non-owning view of the bytes of a complete section. The bytes are either stored in a reassembly
+		buffer, or, for sections contained in a single ts packet, still in the packet data.
+		In the latter case the view is only valid until the parser reads the next packet
+	*/
+	struct section_view_t {
+		const uint8_t* data{nullptr};
+		int len{0};
+
+		section_view_t() = default;
+
+		section_view_t(const uint8_t* data, int len)
+			: data(data)
+			, len(len) {}
+
+		section_view_t(const ss::bytebuffer_& buffer)
+			: data((const uint8_t*)buffer.buffer())
+			, len(buffer.size()) {}
+
+		section_view_t(const data_range_t& range)
+			: data(range.get_buffer_ptr())
+			, len(range.len()) {}
+
+		inline const uint8_t* buffer() const {
+			return data;
+		}
+
+		inline int size() const {
+			return len;
+		}
+
+		inline uint8_t operator[](int idx) const {
+			return data[idx];
+		}
+	};
+
 	struct stored_section_t {
 		uint16_t pid{0x1fff};
-		ss::bytebuffer_& payload;
+		section_view_t payload;
 		int bytes_read{0};
 		bool error{false};
 		bool throw_on_error{false};
@@ -91,7 +128,7 @@ namespace dtdemux {
 				throw bad_data_exception();
 		}
 
-		stored_section_t(ss::bytebuffer_& payload_, uint16_t pid_)
+		stored_section_t(const section_view_t& payload_, uint16_t pid_)
 			: pid(pid_)
 			, payload(payload_) {}
 
@@ -99,7 +136,7 @@ namespace dtdemux {
 			return payload.size() - bytes_read;
 		}
 
-		uint8_t* current_pointer(int size)  {
+		const uint8_t* current_pointer(int size)  {
 			if(available() < size) {
 				throw_bad_data();
 				return nullptr;
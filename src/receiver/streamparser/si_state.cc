@@ -299,6 +299,8 @@ std::tuple<bool, bool, section_type_t> parser_status_t::check(const section_head
 	}
 	if (cstate.completed) {
 		timedout_now = false;
+		if (hdr.section_syntax_indicator)
+			fingerprints[fingerprint_key(hdr)] = {hdr.crc, hdr.version_number};
 		return {timedout_now, badversion, section_type_t::COMPLETE};
 	}
 
@@ -361,6 +363,9 @@ void parser_status_t::reset(const section_header_t& hdr) {
 	cstate.reset(hdr);
 	completed = false;
 	assert(!cstate.completed);
+	/*for eit, several table_ids map to the same subtable; resets are rare,
+		so simply forget all sections*/
+	fingerprints.clear();
 }
 
 bool parser_status_t::timedout_now(uint8_t table_id) {
@@ -21,6 +21,8 @@
 
 #pragma once
 #include <cstdlib>
+#include <optional>
+#include <unordered_map>
 #include "section.h"
 #include "mpeg.h"
 #include "substream.h"
@@ -126,6 +128,15 @@ namespace dtdemux {
 
 
 
+	/*
+		crc of a section belonging to a completed subtable. Later repeats of the section with the same
+		crc can be dropped without copying, checking or parsing them
+	*/
+	struct section_fingerprint_t {
+		uint32_t crc{0};
+		uint8_t version_number{0};
+	};
+
 	class parser_status_t {
 		steady_time_t last_new_section;
 		steady_time_t last_section;
@@ -140,8 +151,18 @@ namespace dtdemux {
 		std::map<subtable_key_t, completion_status_t> cstates;
 		std::array<std::unique_ptr<table_timeout_t>, 256> table_timeouts; //indexed by table id
 
+		//indexed by table_id, table_id_extension[1,2] and section_number
+		std::unordered_map<uint64_t, section_fingerprint_t> fingerprints;
+
 		inline completion_status_t& completion_status_for_section(const section_header_t& hdr);
 
+		static inline uint64_t fingerprint_key(const section_header_t& hdr) {
+			return (uint64_t(hdr.table_id_extension) << 48) |
+				(uint64_t(hdr.table_id_extension1) << 32) |
+				(uint64_t(hdr.table_id_extension2) << 16) |
+				(uint64_t(hdr.table_id) << 8) | hdr.section_number;
+		}
+
 
 	public:
 		//bool timed_out() const;
@@ -158,6 +179,22 @@ namespace dtdemux {
 	returns: timedout, new_subtable_version, section_type
  */
 		std::tuple<bool, bool, section_type_t> check(const section_header_t& hdr, int cc_error_counter);
+
+		/*
+			crc of an earlier copy of this section, if check() has already classified such a copy
+			as COMPLETE. Later copies would also be classified as COMPLETE, which means that callers
+			ignore them.
+		*/
+		std::optional<uint32_t> known_section_crc(const section_header_t& hdr) const {
+			auto it = fingerprints.find(fingerprint_key(hdr));
+			if (it == fingerprints.end() || it->second.version_number != hdr.version_number || !hdr.current_next)
+				return {};
+			return it->second.crc;
+		}
+
+		void forget_section_crc(const section_header_t& hdr) {
+			fingerprints.erase(fingerprint_key(hdr));
+		}
 #if 0
 		void forget_section(const section_header_t& hdr);
 #endif
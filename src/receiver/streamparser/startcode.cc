@@ -0,0 +1,120 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "startcode.h"
+#include <string.h>
+#include <immintrin.h>
+
+using namespace dtdemux;
+
+/*
+	The prefix cannot start at p[i] if p[i+2] > 1; so we can skip 3 bytes at once in that case,
+	which is the common case in compressed data
+*/
+static int64_t find_scalar(const uint8_t* p, int64_t len) {
+	int64_t i = 0;
+	while (i + 2 < len) {
+		if (p[i + 2] > 1)
+			i += 3;
+		else if (p[i + 2] == 0)
+			i += 1;
+		else if (p[i] == 0 && p[i + 1] == 0)
+			return i;
+		else
+			i += 3;
+	}
+	return -1;
+}
+
+/*
+	Compare 16 (or 32) byte blocks at offsets 0, 1 and 2 with 0, 0 and 1; a bit set in the resulting mask
+	indicates a prefix starting at the corresponding byte
+*/
+__attribute__((target("sse2")))
+static int64_t find_sse2(const uint8_t* p, int64_t len) {
+	const auto zero = _mm_setzero_si128();
+	const auto one = _mm_set1_epi8(1);
+	int64_t i = 0;
+	for (; i + 18 <= len; i += 16) {
+		auto v0 = _mm_loadu_si128((const __m128i*)(p + i));
+		auto v1 = _mm_loadu_si128((const __m128i*)(p + i + 1));
+		auto v2 = _mm_loadu_si128((const __m128i*)(p + i + 2));
+		auto m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero)),
+													 _mm_cmpeq_epi8(v2, one));
+		if (auto mask = _mm_movemask_epi8(m))
+			return i + __builtin_ctz(mask);
+	}
+	auto ret = find_scalar(p + i, len - i);
+	return ret < 0 ? ret : i + ret;
+}
+
+__attribute__((target("avx2")))
+static int64_t find_avx2(const uint8_t* p, int64_t len) {
+	const auto zero = _mm256_setzero_si256();
+	const auto one = _mm256_set1_epi8(1);
+	int64_t i = 0;
+	for (; i + 34 <= len; i += 32) {
+		auto v0 = _mm256_loadu_si256((const __m256i*)(p + i));
+		auto v1 = _mm256_loadu_si256((const __m256i*)(p + i + 1));
+		auto v2 = _mm256_loadu_si256((const __m256i*)(p + i + 2));
+		auto m = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(v0, zero), _mm256_cmpeq_epi8(v1, zero)),
+															_mm256_cmpeq_epi8(v2, one));
+		if (uint32_t mask = _mm256_movemask_epi8(m))
+			return i + __builtin_ctz(mask);
+	}
+	//not calling find_sse2 avoids mixing vex and non-vex encoded instructions
+	const auto zero128 = _mm_setzero_si128();
+	const auto one128 = _mm_set1_epi8(1);
+	for (; i + 18 <= len; i += 16) {
+		auto v0 = _mm_loadu_si128((const __m128i*)(p + i));
+		auto v1 = _mm_loadu_si128((const __m128i*)(p + i + 1));
+		auto v2 = _mm_loadu_si128((const __m128i*)(p + i + 2));
+		auto m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v0, zero128), _mm_cmpeq_epi8(v1, zero128)),
+													 _mm_cmpeq_epi8(v2, one128));
+		if (auto mask = _mm_movemask_epi8(m))
+			return i + __builtin_ctz(mask);
+	}
+	auto ret = find_scalar(p + i, len - i);
+	return ret < 0 ? ret : i + ret;
+}
+
+startcode_impl_t dtdemux::startcode_best_impl() {
+	static const startcode_impl_t best = []() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return startcode_impl_t::AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return startcode_impl_t::SSE2;
+		return startcode_impl_t::SCALAR;
+	}();
+	return best;
+}
+
+int64_t dtdemux::find_start_code_prefix(const uint8_t* p, int64_t len, startcode_impl_t impl) {
+	switch (impl == startcode_impl_t::AUTO ? startcode_best_impl() : impl) {
+	case startcode_impl_t::AVX2:
+		return find_avx2(p, len);
+	case startcode_impl_t::SSE2:
+		return find_sse2(p, len);
+	case startcode_impl_t::SCALAR:
+	default:
+		return find_scalar(p, len);
+	}
+}
@@ -0,0 +1,47 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+	Search for the start code prefix 00 00 01 which precedes pes headers, mpeg2 start codes
+	and h264/hevc nal units
+*/
+namespace dtdemux {
+
+	enum class startcode_impl_t {
+		AUTO, //best one supported by the cpu
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+
+	/*!
+		Returns the offset of the first 00 00 01 prefix which lies completely in [p, p+len),
+		or -1 if there is none
+	*/
+	int64_t find_start_code_prefix(const uint8_t* p, int64_t len, startcode_impl_t impl = startcode_impl_t::AUTO);
+
+	/*!
+		Returns the implementation selected by startcode_impl_t::AUTO
+	*/
+	startcode_impl_t startcode_best_impl();
+};
@@ -21,8 +21,11 @@
 
 #pragma once
 
+#include <array>
 #include <cstdlib>
 #include <map>
+#include <memory>
+#include <vector>
 
 /*
 	do_transfer fails for some reason when NDEBUG is defined
@@ -40,6 +43,7 @@
 #include <iostream>
 #include "util/util.h"
 #include "streamtime.h"
+#include "tsprescan.h"
 
 unconvertable_int(uint16_t, dvb_pid_t);
 
@@ -108,6 +112,16 @@ unconvertable_int(uint16_t, dvb_pid_t);
 
 	packets for which no parser is registered will be skipped. New parsers may be registered at any time.
 
+	Batch dispatch (set_batch_dispatch(true)): instead of resuming a fiber for each packet, parse() first
+	classifies all packets in the buffer provided by implementation_t::read_batch() per pid, using a flat
+	pid table. Each fiber is then resumed once per buffer and get_packet_for_this_parser() returns the packets
+	of its batch without further context switches. As a consequence, packets of different pids are no longer
+	processed in stream order within one buffer; packets of the same pid still are. After each buffer,
+	implementation_t::batch_dispatched() is called, so that results which depend on the order of pids
+	(e.g., index markers) can be put in stream order. A parser registered
+	while a buffer is being dispatched (e.g., a pmt parser registered by the pat parser) still receives all
+	packets of its pid in that buffer, also when they precede the packet which caused the registration.
+
 	}
 
 */
@@ -305,6 +319,20 @@ namespace dtdemux {
 			range.tst = range.available();
 			this->range=range;
 		}
+
+		/*!
+			Construct from the header fields of packet i decoded by prescan_ts_packets, without reading the
+			header again. The caller must have skipped packets with a transport error and null packets
+		*/
+		ts_packet_t(data_range_t& range, const ts_prescan_t& prescan, int i)
+			: header(((prescan.flags[i] & 0xe0) << 8) | prescan.pids[i])
+			, flags(((prescan.flags[i] & 0x0f) << 4) | prescan.ccs[i])
+		{
+			range.set_cursor(4);
+			parse_adaptation(range);
+			range.tst = range.available();
+			this->range=range;
+		}
 	};
 
 	struct descriptor_t {
@@ -320,8 +348,46 @@ namespace dtdemux {
 		continuation_t root;
 		continuation_t * volatile  self{&root};
 		volatile int current_pid = -1;
+
+		/*
+			batch dispatch state. Packets in batch_range are located by prescan and linked per pid via batch_next;
+			batch_pids contains (pid, first packet) in order of first appearance
+		*/
+		bool batch_dispatch{false};
+		bool batch_exhausted{false};
+		data_range_t batch_range;
+		ts_prescan_t prescan;
+		std::vector<int32_t> batch_next;
+		std::vector<std::pair<uint16_t, int32_t>> batch_pids;
+		std::array<int32_t, 8192> batch_tail;
+		int batch_pos{0}; //index in batch_pids of pid being dispatched
+		int32_t batch_cursor{-1}; //next packet to dispatch for the pid being dispatched
+		//indices in batch_pids of pids which had no parser when it was their turn
+		std::vector<int32_t> batch_skipped;
+
+		void classify_batch(const data_range_t& range);
+		ts_packet_t* next_batch_packet();
+		bool dispatch_batch();
+		void requeue_skipped_pids();
+
+		//thread cpu time spent in the fiber of each pid in ns; only allocated when enabled
+		std::unique_ptr<std::array<int64_t, 8192>> pid_cpu_time;
+
 	protected:
 		std::map<dvb_pid_t, continuation_t> fibers;
+		/*flat pid lookup table; entries point to the continuations in fibers,
+			whose addresses are stable*/
+		std::array<continuation_t*, 8192> fiber_table{};
+
+		inline continuation_t* find_fiber(int pid) const {
+			return fiber_table[pid & 0x1fff];
+		}
+
+		inline void erase_fiber(int pid) {
+			fiber_table[pid & 0x1fff] = nullptr;
+			fibers.erase(dvb_pid_t(pid));
+		}
+
 		void dump_fibers(const char * caller="", int i=0) {
 			printf("%s %d:++++++++++++++++++++++++++\n", caller,i);
 			for(auto& [pid, f] : fibers) {
@@ -342,6 +408,21 @@ namespace dtdemux {
 			throw std::runtime_error("This function should be implemented by implementation_t");
 		}
 
+		/*!
+			return a range containing all remaining complete packets and mark them as consumed.
+			Only needed for batch dispatch
+		*/
+		data_range_t read_batch() {
+			assert(0);
+			throw std::runtime_error("This function should be implemented by implementation_t");
+		}
+
+		/*!
+			called after all packets returned by read_batch() have been dispatched
+		*/
+		void batch_dispatched() {
+		}
+
 	public:
 
 		/*!abort parsing early because we intend to switch to the next file
@@ -380,8 +461,51 @@ namespace dtdemux {
 		*/
 		int exit();
 
-		stream_parser_base_t() {
+		/*!
+			switch between per packet and per buffer dispatching of packets to parsers.
+			Should only be called when all data has been parsed
+		*/
+		void set_batch_dispatch(bool on) {
+			assert(!batch_pending());
+			batch_dispatch = on;
+		}
 
+		/*!
+			enable/disable accounting of the cpu time spent in each parser, for benchmarking.
+			Only implemented for batch dispatch, because otherwise parsers transfer control
+			directly to each other
+		*/
+		void set_cpu_time_accounting(bool on) {
+			if(!on)
+				pid_cpu_time.reset();
+			else if(!pid_cpu_time) {
+				pid_cpu_time = std::make_unique<std::array<int64_t, 8192>>();
+				pid_cpu_time->fill(0);
+			}
+		}
+
+		int64_t cpu_time_ns(int pid) const {
+			return pid_cpu_time ? (*pid_cpu_time)[pid & 0x1fff] : 0;
+		}
+
+		/*!
+			true if parsing of the last batch was interrupted by return_early()
+		*/
+		inline bool batch_pending() const {
+			return batch_pos < (int) batch_pids.size();
+		}
+
+		/*!
+			Batch dispatch only: skip the packets of the pid being dispatched which carry nothing but payload
+			(no payload_unit_start, no adaptation field) and whose continuity counter follows cc, without
+			constructing a ts_packet_t for each of them. scrambled is set if any skipped packet was scrambled.
+			Returns the last skipped packet, or nullptr if none was skipped
+		*/
+		ts_packet_t* skip_payload_packets(uint8_t cc, bool& scrambled);
+		int64_t num_payload_packets_skipped{0};
+
+		stream_parser_base_t() {
+			batch_tail.fill(-1);
 		}
 #if 0
 	  ~stream_parser_base_t() {
@@ -164,6 +164,16 @@ namespace dtdemux {
 	template<typename implementation_t>
 	inline ts_packet_t* stream_parser_base_t<implementation_t>::get_packet_for_this_parser()
 	{
+		if(batch_dispatch) {
+			/*return the next packet of the current batch for this pid; if none is left,
+				return control to parse() which will resume us with the first packet of our next batch
+			*/
+			auto* p = next_batch_packet();
+			if(p)
+				return p;
+			batch_exhausted = true;
+			return call_fiber(root, p);
+		}
 		ts_packet_t* p = NULL;
 		int parser_pid = current_pid;
 		/*
@@ -198,8 +208,8 @@ namespace dtdemux {
 			Usually this means that parsing must be transfered to a different parser.
 			However, some parsers may process packets of more than one pid (e.g., parsers which skip data)
 		*/
-		auto it = fibers.find(dvb_pid_t(packet_pid));
-		auto& fn = (it!=fibers.end()) ? it->second : root;
+		auto* fiber = find_fiber(packet_pid);
+		auto& fn = fiber ? *fiber : root;
 
 		/*transfer control to the new parser. This parser will save our own stack frame
 			and will then start or continue processing. In turn the new parser can transfer
@@ -223,7 +233,7 @@ namespace dtdemux {
 
 	template <class implementation_t>
 	inline void stream_parser_base_t<implementation_t>::unregister_parser(int parser_pid) {
-		fibers.erase(dvb_pid_t(parser_pid));
+		erase_fiber(parser_pid);
 	}
 
 	template <class implementation_t>
@@ -238,13 +248,14 @@ namespace dtdemux {
 		}
 #endif
 		auto &self = fibers[dvb_pid_t(parser_pid)];
+		fiber_table[parser_pid & 0x1fff] = &self;
 		auto f = [this, &self, fn, parser_pid](continuation_t&& invoker) -> continuation_t {
 			//return to root at startup and do nothing
 			dtdemux::ts_packet_t* in = do_transfer(self, invoker, nullptr);
 			//start processing many packets; fn will only return when fuly done
 			assert(in);
 			fn(in);
-			fibers.erase(dvb_pid_t(parser_pid));
+			erase_fiber(parser_pid);
 			//printf("returning root pid={:d}\n", in[0]);
 			/*
 				If we ever end, we transfer control to the very first caller.
@@ -271,6 +282,20 @@ namespace dtdemux {
 	template<typename implementation_t>
 	void stream_parser_base_t<implementation_t>::parse()
 	{
+		if(batch_dispatch) {
+			for(;;) {
+				if(!batch_pending()) {
+					auto range = static_cast<implementation_t*>(this)->read_batch();
+					if(!range.is_valid())
+						break; //temporary end of stream
+					classify_batch(range);
+				}
+				if(!dispatch_batch())
+					break; //a parser returned early; dispatching continues in the next call
+				static_cast<implementation_t*>(this)->batch_dispatched();
+			}
+			return;
+		}
 		for(;;) {
 			auto* p= static_cast<implementation_t*>(this)->read_packet();
 			assert(!p || p->range.available() ==  p->range.tst);
@@ -279,9 +304,9 @@ namespace dtdemux {
 			assert(!p || p->range.available() == p->range.tst);
 			int packet_pid = p->get_pid();
 			assert(!p || p->range.available() == p->range.tst);
-			auto it = fibers.find(dvb_pid_t(packet_pid));
-			if (it != fibers.end()) {
-				auto& fn = it->second;
+			auto* fiber = find_fiber(packet_pid);
+			if (fiber) {
+				auto& fn = *fiber;
 				current_pid = packet_pid;
 				//dump_fibers("before", packet_pid);
 				p = call_fiber(fn, p);
@@ -299,9 +324,147 @@ namespace dtdemux {
 	int stream_parser_base_t<implementation_t>::exit()
 	{
 		fibers.clear();
+		fiber_table.fill(nullptr);
+		batch_pids.clear();
+		batch_skipped.clear();
+		batch_pos = 0;
+		batch_cursor = -1;
 		return 0;
 	}
 
+	/*
+		Sort the packets in range per pid by linking each packet to the next one with the same pid.
+		Pids without a parser are included as well, because a parser for them may be registered while
+		dispatching the batch (e.g., pmt parser registered by pat parser)
+	*/
+	template<typename implementation_t>
+	void stream_parser_base_t<implementation_t>::classify_batch(const data_range_t& range)
+	{
+		batch_range = range;
+		int32_t num_packets = prescan_ts_packets(range.get_buffer_ptr(), range.len(), prescan);
+		if(prescan.num_bytes_skipped > 0)
+			dtdebugf("Skipped {:d} bytes to resynchronise", prescan.num_bytes_skipped);
+		batch_next.resize(num_packets);
+		batch_pids.clear();
+		batch_skipped.clear();
+		for(int32_t i = 0; i < num_packets; ++i) {
+			int pid = prescan.pids[i];
+			batch_next[i] = -1;
+			if(pid == 0x1fff || prescan.has_transport_error(i))
+				continue; //null packet or packet which would be rejected by ts_packet_t
+			auto& tail = batch_tail[pid];
+			if(tail < 0)
+				batch_pids.push_back({pid, i});
+			else
+				batch_next[tail] = i;
+			tail = i;
+		}
+		for(auto& [pid, first]: batch_pids)
+			batch_tail[pid] = -1;
+		batch_pos = 0;
+		batch_cursor = batch_pids.empty() ? -1 : batch_pids[0].second;
+	}
+
+	/*
+		Return the next valid packet of the pid currently being dispatched, or NULL if none is left
+	*/
+	template<typename implementation_t>
+	inline ts_packet_t* stream_parser_base_t<implementation_t>::next_batch_packet()
+	{
+		while(batch_cursor >= 0) {
+			auto idx = batch_cursor;
+			batch_cursor = batch_next[idx];
+			auto range = batch_range.sub_range(prescan.offsets[idx], ts_packet_t::size);
+			//classify_batch has excluded null packets and packets with transport errors
+			global_ts_packet = ts_packet_t(range, prescan, idx);
+			if(global_ts_packet.range.is_valid())
+				return &global_ts_packet;
+		}
+		return nullptr;
+	}
+
+	template<typename implementation_t>
+	inline ts_packet_t* stream_parser_base_t<implementation_t>::skip_payload_packets(uint8_t cc, bool& scrambled)
+	{
+		if(!batch_dispatch)
+			return nullptr;
+		int32_t last = -1;
+		while(batch_cursor >= 0) {
+			auto idx = batch_cursor;
+			auto flags = prescan.flags[idx];
+			if((flags & (ts_prescan_t::PUSI | ts_prescan_t::ADAPTATION)) || !(flags & ts_prescan_t::PAYLOAD))
+				break;
+			cc = (cc + 1) & 0xf;
+			if(prescan.ccs[idx] != cc)
+				break; //let process_packet_header deal with duplicates and errors
+			scrambled |= (flags & ts_prescan_t::SCRAMBLED) != 0;
+			last = idx;
+			batch_cursor = batch_next[idx];
+			num_payload_packets_skipped++;
+		}
+		if(last < 0)
+			return nullptr;
+		auto range = batch_range.sub_range(prescan.offsets[last], ts_packet_t::size);
+		global_ts_packet = ts_packet_t(range, prescan, last);
+		return &global_ts_packet;
+	}
+
+	/*
+		Resume the fiber of each pid in the batch once. Returns false if some parser
+		returned early, in which case the batch is still pending
+	*/
+	template<typename implementation_t>
+	bool stream_parser_base_t<implementation_t>::dispatch_batch()
+	{
+		while(batch_pos < (int) batch_pids.size()) {
+			int pid = batch_pids[batch_pos].first;
+			auto* fiber = find_fiber(pid);
+			if(!fiber && batch_cursor == batch_pids[batch_pos].second)
+				batch_skipped.push_back(batch_pos); //a parser may still be registered by a later pid
+			auto* p = fiber ? next_batch_packet() : nullptr;
+			if(!p) {
+				//no (more) packets for this pid, or no parser
+				++batch_pos;
+				batch_cursor = batch_pending() ? batch_pids[batch_pos].second : -1;
+				continue;
+			}
+			current_pid = pid;
+			batch_exhausted = false;
+			if(pid_cpu_time) {
+				struct timespec start, end;
+				clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+				call_fiber(*fiber, p);
+				clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+				(*pid_cpu_time)[pid] += (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+			} else
+				call_fiber(*fiber, p);
+			if(!batch_skipped.empty())
+				requeue_skipped_pids();
+			if(!batch_exhausted && find_fiber(pid) == fiber)
+				return false;
+		}
+		return true;
+	}
+
+	/*
+		The batch was split per pid before all parsers were known. Pids which were skipped because they had
+		no parser, but have one now, are appended to batch_pids so that their packets in the batch are still
+		dispatched
+	*/
+	template<typename implementation_t>
+	void stream_parser_base_t<implementation_t>::requeue_skipped_pids()
+	{
+		for(int i = 0; i < (int) batch_skipped.size();) {
+			auto entry = batch_pids[batch_skipped[i]];
+			if(find_fiber(entry.first)) {
+				batch_pids.push_back(entry);
+				batch_skipped[i] = batch_skipped.back();
+				batch_skipped.pop_back();
+			} else
+				++i;
+		}
+	}
+
 
 
 
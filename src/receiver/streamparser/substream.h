@@ -111,6 +111,8 @@ namespace dtdemux {
 																							 current pes_packet or current section*/
 		uint64_t current_unit_end_bytepos = 0;  /*byte position (in the global stream) of the last byte  of the
 																							 current pes_packet or current section*/
+		uint64_t unit_completed_bytepos = 0; /*byte position of the packet which completed the current pes_packet
+																					 or section; set just before unit_completed_cb is called*/
 		ts_packet_t* current_ts_packet = NULL; //last read packet
 		int bytes_read = 0;
 	protected:
@@ -130,6 +132,7 @@ namespace dtdemux {
 
 		void skip_to_unit_start();
 		void skip_to_pointer();
+		void skip_rest_of_unit();
 		void throw_bad_data() {
 			error = true;
 			if (throw_on_error)
@@ -65,6 +65,7 @@ void ts_substream_t::parse(ts_packet_t* p) {
 					bytes_read = 0;
 					parse_payload_unit();
 					wait_for_unit_start = true;
+					skip_rest_of_unit();
 					get_next_packet();
 					skip_to_unit_start(); //will reset wait_for_unit_start but not do anything else
 				}
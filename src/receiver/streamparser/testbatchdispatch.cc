@@ -0,0 +1,134 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+/*
+	Check that batch dispatch produces the same index as per packet dispatch:
+	testbatchdispatch [synthetic_seconds]
+
+	A synthetic multiplex is indexed in the same way as active_mpm_t does, i.e., with a pat parser, the
+	pmt parsers of all services and a video parser for the indexed service. The markers and the positions of the
+	pmts are compared between per packet dispatch, batch dispatch and batch dispatch in header only indexing
+	mode, for several buffer sizes. Returns 0 if all are identical
+*/
+
+#include "muxgenerator.h"
+#include "packetstream.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace dtdemux;
+
+struct index_t {
+	std::vector<recdb::marker_t> markers;
+	std::vector<int64_t> pmt_packetnos; //stream_packetno_end of each pmt of the indexed service
+};
+
+static index_t run(std::vector<uint8_t>& data, int service_id, int chunk_size, bool batch_dispatch,
+									 bool header_only) {
+	index_t ret;
+	ts_stream_t stream;
+	stream.event_handler.collected_markers = &ret.markers;
+	stream.set_batch_dispatch(batch_dispatch);
+	stream.header_only_indexing = header_only;
+	std::vector<uint16_t> pmt_pids;
+	auto pat_parser = stream.register_pat_pid();
+	pat_parser->section_cb = [&](const pat_services_t& pat_services, const subtable_info_t& i) {
+		for (const auto& e : pat_services.entries) {
+			if (e.service_id == 0 || std::find(pmt_pids.begin(), pmt_pids.end(), e.pmt_pid) != pmt_pids.end())
+				continue;
+			pmt_pids.push_back(e.pmt_pid);
+			auto pmt_parser = stream.register_pmt_pid(e.pmt_pid, e.service_id);
+			pmt_parser->section_cb = [&](pmt_parser_t* parser, const pmt_info_t& pmt, bool isnext,
+																	 const ss::bytebuffer_& sec_data) {
+				if (isnext || pmt.service_id != service_id)
+					return reset_type_t::NO_RESET;
+				ret.pmt_packetnos.push_back(pmt.stream_packetno_end);
+				for (const auto& pidinfo : pmt.pid_descriptors) {
+					if (pmt.pcr_pid == pidinfo.stream_pid && stream_type::is_video(pidinfo.stream_type))
+						stream.register_video_pids(pmt.service_id, pidinfo.stream_pid, pmt.pcr_pid, pidinfo.stream_type);
+				}
+				return reset_type_t::NO_RESET;
+			};
+		}
+		return reset_type_t::NO_RESET;
+	};
+	int64_t chunk_bytes = chunk_size * (int64_t)ts_packet_t::size;
+	for (int64_t pos = 0; pos < (int64_t)data.size(); pos += chunk_bytes) {
+		auto len = std::min(chunk_bytes, (int64_t)data.size() - pos);
+		stream.set_buffer(data.data() + pos, len);
+		stream.parse();
+	}
+	stream.exit();
+	return ret;
+}
+
+static int compare(const char* title, const index_t& ref, const index_t& index) {
+	int num_errors{0};
+	if (ref.markers.size() != index.markers.size()) {
+		printf("%s: %ld markers instead of %ld\n", title, index.markers.size(), ref.markers.size());
+		++num_errors;
+	}
+	for (int i = 0; i < (int)std::min(ref.markers.size(), index.markers.size()); ++i) {
+		auto& a = ref.markers[i];
+		auto& b = index.markers[i];
+		if (a.k.time == b.k.time && a.packetno_start == b.packetno_start && a.packetno_end == b.packetno_end)
+			continue;
+		if (num_errors++ < 10)
+			printf("%s: marker %d: t=%ld [%ld, %ld] instead of t=%ld [%ld, %ld]\n", title, i, int64_t(b.k.time),
+						 int64_t(b.packetno_start), int64_t(b.packetno_end), int64_t(a.k.time), int64_t(a.packetno_start),
+						 int64_t(a.packetno_end));
+	}
+	if (ref.pmt_packetnos != index.pmt_packetnos) {
+		printf("%s: pmt positions differ\n", title);
+		++num_errors;
+	}
+	return num_errors;
+}
+
+int main(int argc, char** argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 20;
+	if (seconds <= 0) {
+		fprintf(stderr, "Usage: %s [synthetic_seconds]\n", argv[0]);
+		return -1;
+	}
+	std::vector<uint8_t> data;
+	mux_generator_t(data).generate(seconds);
+
+	int num_errors{0};
+	for (int service_id : {1, 2}) {
+		auto ref = run(data, service_id, 1024, false, false);
+		if (ref.markers.empty()) {
+			printf("service %d: no markers\n", service_id);
+			++num_errors;
+		}
+		for (int chunk_size : {1024, 97, 7}) {
+			for (bool header_only : {false, true}) {
+				char title[64];
+				snprintf(title, sizeof(title), "service %d chunk_size=%d%s", service_id, chunk_size,
+								 header_only ? " header only" : "");
+				num_errors += compare(title, ref, run(data, service_id, chunk_size, true, header_only));
+			}
+		}
+		printf("service %d: %ld markers, %ld pmts\n", service_id, ref.markers.size(), ref.pmt_packetnos.size());
+	}
+	printf("%s\n", num_errors ? "FAILED" : "OK");
+	return num_errors ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Equivalence test of all crc32 implementations against the original byte at a time
+	code from section.cc:
+	-all messages of 1, 2 and 3 bytes
+	-all lengths up to 8192 bytes, at all 16 alignments, with random data
+	-incremental computation split at arbitrary positions
+	-batch verification of correct and corrupted sections
+*/
+
+#include "crc32.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace dtdemux;
+
+//reference implementation: the original code, taken and adapted from libdtv, (c) Rolf Hakenes
+static uint32_t ref_table[256];
+
+static void init_ref_table() {
+	for (uint32_t b = 0; b < 256; ++b) {
+		uint32_t crc = b << 24;
+		for (int i = 0; i < 8; ++i)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+		ref_table[b] = crc;
+	}
+	//spot check against the published table
+	if (ref_table[1] != 0x04c11db7 || ref_table[2] != 0x09823b6e || ref_table[255] != 0xb1f740b4) {
+		printf("FAIL: reference table\n");
+		exit(-1);
+	}
+}
+
+static uint32_t ref_crc32(const uint8_t* data, int size) {
+	uint32_t crc = 0xFFFFFFFF;
+	if (size < 4)
+		return false;
+	for (int i = 0; i < size; i++)
+		crc = (crc << 8) ^ ref_table[((crc >> 24) ^ (uint8_t)data[i])];
+	return crc;
+}
+
+static const crc_impl_t impls[] = {crc_impl_t::TABLE, crc_impl_t::SLICE8, crc_impl_t::SLICE16, crc_impl_t::PCLMUL};
+static const char* names[] = {"table", "slice8", "slice16", "pclmul"};
+
+static int num_errors{0};
+
+static void check(const uint8_t* data, int size) {
+	auto ref = ref_crc32(data, size);
+	if (crc32(data, size) != ref) {
+		if (num_errors++ < 10)
+			printf("FAIL: crc32 size=%d\n", size);
+	}
+	if (size < 4)
+		return; //crc32_update has no special case for short data
+	for (int i = 0; i < 4; ++i) {
+		if (impls[i] == crc_impl_t::PCLMUL && crc32_best_impl() != crc_impl_t::PCLMUL)
+			continue;
+		auto crc = crc32_update(0xffffffff, data, size, impls[i]);
+		if (crc != ref && num_errors++ < 10)
+			printf("FAIL: %s size=%d crc=0x%08x expected 0x%08x\n", names[i], size, crc, ref);
+	}
+}
+
+int main(int argc, char** argv) {
+	init_ref_table();
+	srandom(1);
+	printf("Best implementation: %s\n", names[(int)crc32_best_impl() - 1]);
+
+	uint8_t small[3];
+	for (int size = 1; size <= 3; ++size) {
+		for (int v = 0; v < (1 << (8 * size)); ++v) {
+			for (int i = 0; i < size; ++i)
+				small[i] = v >> (8 * i);
+			check(small, size);
+		}
+	}
+
+	const int max_size = 8192;
+	std::vector<uint8_t> data(max_size + 16);
+	for (auto& x : data)
+		x = random();
+	for (int size = 0; size <= max_size; ++size)
+		for (int align = 0; align < 16; ++align)
+			check(&data[align], size);
+
+	//incremental
+	for (int i = 0; i < 10000; ++i) {
+		int size = 4 + random() % 5000;
+		int split = random() % (size + 1);
+		auto ref = ref_crc32(&data[0], size);
+		auto crc = crc32_update(0xffffffff, &data[0], split);
+		crc = crc32_update(crc, &data[split], size - split);
+		if (crc != ref && num_errors++ < 10)
+			printf("FAIL: incremental size=%d split=%d\n", size, split);
+	}
+
+	//batch: sections with correct crc appended; every third one corrupted
+	const int num = 1000;
+	std::vector<std::vector<uint8_t>> sections(num);
+	std::vector<const uint8_t*> ptrs(num);
+	std::vector<int> sizes(num);
+	bool ok[num];
+	int expected_ok{0};
+	for (int i = 0; i < num; ++i) {
+		auto& s = sections[i];
+		s.resize(8 + random() % 4089);
+		for (auto& x : s)
+			x = random();
+		auto crc = ref_crc32(s.data(), s.size() - 4);
+		for (int j = 0; j < 4; ++j)
+			s[s.size() - 4 + j] = crc >> (24 - 8 * j);
+		if (i % 3 == 0)
+			s[random() % s.size()] ^= 1 << (random() % 8);
+		else
+			expected_ok++;
+		ptrs[i] = s.data();
+		sizes[i] = s.size();
+	}
+	auto num_ok = crc32_verify_batch(ptrs.data(), sizes.data(), num, ok);
+	if (num_ok != expected_ok)
+		printf("FAIL: batch found %d correct sections; expected %d\n", num_ok, expected_ok);
+	for (int i = 0; i < num; ++i) {
+		if (ok[i] != (i % 3 != 0) && num_errors++ < 10)
+			printf("FAIL: batch section %d\n", i);
+	}
+	if (num_errors == 0)
+		printf("All tests passed\n");
+	return num_errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,260 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "tsprescan.h"
+#include <string.h>
+#include <immintrin.h>
+#include "util/dtassert.h"
+
+using namespace dtdemux;
+
+static constexpr int pkt_size = 188;
+static constexpr uint8_t sync_byte = 0x47;
+
+/*
+	The header of a packet, loaded as a little endian 32 bit word h, is converted as follows:
+	pid = ((byte1 & 0x1f) << 8) | byte2
+	flags = (byte1 & 0xe0) | (byte3 >> 4)
+	cc = byte3 & 0x0f
+*/
+static inline uint32_t load_header(const uint8_t* p) {
+	uint32_t h;
+	memcpy(&h, p, sizeof(h));
+	return h;
+}
+
+/*
+	Process up to n packets at p, all expected to be at a packet boundary.
+	Results are stored starting at index idx in out. Returns the number of packets
+	processed before the first packet with a bad sync byte
+*/
+static int scan_scalar(const uint8_t* p, int n, int64_t offset, ts_prescan_t& out, int idx) {
+	int i = 0;
+	for (; i < n; ++i, p += pkt_size) {
+		auto h = load_header(p);
+		if ((h & 0xff) != sync_byte)
+			break;
+		out.offsets[idx + i] = offset + i * pkt_size;
+		out.pids[idx + i] = (h & 0x1f00) | ((h >> 16) & 0xff);
+		out.flags[idx + i] = ((h >> 8) & 0xe0) | (h >> 28);
+		out.ccs[idx + i] = (h >> 24) & 0x0f;
+	}
+	return i;
+}
+
+__attribute__((target("sse4.2")))
+static int scan_sse42(const uint8_t* p, int n, int64_t offset, ts_prescan_t& out, int idx) {
+	int i = 0;
+	const auto sync = _mm_set1_epi32(sync_byte);
+	const auto mask_ff = _mm_set1_epi32(0xff);
+	const auto mask_pid_hi = _mm_set1_epi32(0x1f00);
+	const auto mask_e0 = _mm_set1_epi32(0xe0);
+	const auto mask_0f = _mm_set1_epi32(0x0f);
+	for (; i + 4 <= n; i += 4, p += 4 * pkt_size) {
+		auto h = _mm_setr_epi32(load_header(p), load_header(p + pkt_size),
+														load_header(p + 2 * pkt_size), load_header(p + 3 * pkt_size));
+		auto ok = _mm_cmpeq_epi32(_mm_and_si128(h, mask_ff), sync);
+		if (_mm_movemask_ps(_mm_castsi128_ps(ok)) != 0xf)
+			break; //let scalar code find the exact position
+		auto pid = _mm_or_si128(_mm_and_si128(h, mask_pid_hi), _mm_and_si128(_mm_srli_epi32(h, 16), mask_ff));
+		auto flags = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(h, 8), mask_e0), _mm_srli_epi32(h, 28));
+		auto cc = _mm_and_si128(_mm_srli_epi32(h, 24), mask_0f);
+		auto pid16 = _mm_packus_epi32(pid, pid);
+		auto flags8 = _mm_packus_epi16(_mm_packus_epi32(flags, flags), flags);
+		auto cc8 = _mm_packus_epi16(_mm_packus_epi32(cc, cc), cc);
+		_mm_storel_epi64((__m128i*)&out.pids[idx + i], pid16);
+		int32_t f = _mm_cvtsi128_si32(flags8);
+		int32_t c = _mm_cvtsi128_si32(cc8);
+		memcpy(&out.flags[idx + i], &f, 4);
+		memcpy(&out.ccs[idx + i], &c, 4);
+		for (int j = 0; j < 4; ++j)
+			out.offsets[idx + i + j] = offset + (i + j) * pkt_size;
+	}
+	return i + scan_scalar(p, n - i, offset + i * pkt_size, out, idx + i);
+}
+
+__attribute__((target("avx2")))
+static int scan_avx2(const uint8_t* p, int n, int64_t offset, ts_prescan_t& out, int idx) {
+	int i = 0;
+	const auto sync = _mm256_set1_epi32(sync_byte);
+	const auto mask_ff = _mm256_set1_epi32(0xff);
+	const auto mask_pid_hi = _mm256_set1_epi32(0x1f00);
+	const auto mask_e0 = _mm256_set1_epi32(0xe0);
+	const auto mask_0f = _mm256_set1_epi32(0x0f);
+	const auto vindex = _mm256_setr_epi32(0, pkt_size, 2 * pkt_size, 3 * pkt_size,
+																				4 * pkt_size, 5 * pkt_size, 6 * pkt_size, 7 * pkt_size);
+	const auto lanes_0_4 = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+	const auto step = _mm256_set1_epi32(8 * pkt_size);
+	auto offsets = _mm256_add_epi32(_mm256_set1_epi32(offset), vindex);
+	for (; i + 8 <= n; i += 8, p += 8 * pkt_size) {
+		auto h = _mm256_i32gather_epi32((const int*)p, vindex, 1);
+		auto ok = _mm256_cmpeq_epi32(_mm256_and_si256(h, mask_ff), sync);
+		if (_mm256_movemask_ps(_mm256_castsi256_ps(ok)) != 0xff)
+			break; //let scalar code find the exact position
+		auto pid = _mm256_or_si256(_mm256_and_si256(h, mask_pid_hi),
+															 _mm256_and_si256(_mm256_srli_epi32(h, 16), mask_ff));
+		auto flags = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(h, 8), mask_e0), _mm256_srli_epi32(h, 28));
+		auto cc = _mm256_and_si256(_mm256_srli_epi32(h, 24), mask_0f);
+		//packing operates per 128 bit lane; permute gathers the two lane results
+		auto pid16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(pid, pid), 0x08);
+		auto flags8 = _mm256_permutevar8x32_epi32(
+			_mm256_packus_epi16(_mm256_packus_epi32(flags, flags), flags), lanes_0_4);
+		auto cc8 = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(_mm256_packus_epi32(cc, cc), cc), lanes_0_4);
+		_mm_storeu_si128((__m128i*)&out.pids[idx + i], _mm256_castsi256_si128(pid16));
+		_mm_storel_epi64((__m128i*)&out.flags[idx + i], _mm256_castsi256_si128(flags8));
+		_mm_storel_epi64((__m128i*)&out.ccs[idx + i], _mm256_castsi256_si128(cc8));
+		_mm256_storeu_si256((__m256i*)&out.offsets[idx + i], offsets);
+		offsets = _mm256_add_epi32(offsets, step);
+	}
+	return i + scan_scalar(p, n - i, offset + i * pkt_size, out, idx + i);
+}
+
+static uint64_t match_pids_scalar(const uint8_t* p, int n, uint16_t pid1, uint16_t pid2) {
+	uint64_t ret{0};
+	for (int i = 0; i < n; ++i, p += pkt_size) {
+		uint16_t pid = ((p[1] & 0x1f) << 8) | p[2];
+		ret |= uint64_t(pid == pid1 || pid == pid2) << i;
+	}
+	return ret;
+}
+
+__attribute__((target("sse4.2")))
+static uint64_t match_pids_sse42(const uint8_t* p, int n, uint16_t pid1, uint16_t pid2) {
+	uint64_t ret{0};
+	int i = 0;
+	const auto mask_ff = _mm_set1_epi32(0xff);
+	const auto mask_pid_hi = _mm_set1_epi32(0x1f00);
+	const auto v1 = _mm_set1_epi32(pid1);
+	const auto v2 = _mm_set1_epi32(pid2);
+	for (; i + 4 <= n; i += 4, p += 4 * pkt_size) {
+		auto h = _mm_setr_epi32(load_header(p), load_header(p + pkt_size),
+														load_header(p + 2 * pkt_size), load_header(p + 3 * pkt_size));
+		auto pid = _mm_or_si128(_mm_and_si128(h, mask_pid_hi), _mm_and_si128(_mm_srli_epi32(h, 16), mask_ff));
+		auto match = _mm_or_si128(_mm_cmpeq_epi32(pid, v1), _mm_cmpeq_epi32(pid, v2));
+		ret |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(match))) << i;
+	}
+	return i < n ? ret | (match_pids_scalar(p, n - i, pid1, pid2) << i) : ret; //shifting by 64 is undefined
+}
+
+__attribute__((target("avx2")))
+static uint64_t match_pids_avx2(const uint8_t* p, int n, uint16_t pid1, uint16_t pid2) {
+	uint64_t ret{0};
+	int i = 0;
+	const auto mask_ff = _mm256_set1_epi32(0xff);
+	const auto mask_pid_hi = _mm256_set1_epi32(0x1f00);
+	const auto v1 = _mm256_set1_epi32(pid1);
+	const auto v2 = _mm256_set1_epi32(pid2);
+	const auto vindex = _mm256_setr_epi32(0, pkt_size, 2 * pkt_size, 3 * pkt_size,
+																				4 * pkt_size, 5 * pkt_size, 6 * pkt_size, 7 * pkt_size);
+	for (; i + 8 <= n; i += 8, p += 8 * pkt_size) {
+		auto h = _mm256_i32gather_epi32((const int*)p, vindex, 1);
+		auto pid = _mm256_or_si256(_mm256_and_si256(h, mask_pid_hi),
+															 _mm256_and_si256(_mm256_srli_epi32(h, 16), mask_ff));
+		auto match = _mm256_or_si256(_mm256_cmpeq_epi32(pid, v1), _mm256_cmpeq_epi32(pid, v2));
+		ret |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(match))) << i;
+	}
+	return i < n ? ret | (match_pids_scalar(p, n - i, pid1, pid2) << i) : ret;
+}
+
+/*
+	Find the first position >= pos which looks like the start of a packet: a sync byte followed by
+	two more sync bytes at packet distance, as far as they are in the buffer.
+	Returns -1 if no complete packet can be found
+*/
+static int64_t resync(const uint8_t* buffer, int64_t pos, int64_t len) {
+	while (pos + pkt_size <= len) {
+		auto* q = (const uint8_t*)memchr(buffer + pos, sync_byte, len - pkt_size + 1 - pos);
+		if (!q)
+			return -1;
+		pos = q - buffer;
+		bool ok = true;
+		for (int k = 1; k <= 2 && ok && pos + k * pkt_size < len; ++k)
+			ok = buffer[pos + k * pkt_size] == sync_byte;
+		if (ok)
+			return pos;
+		++pos;
+	}
+	return -1;
+}
+
+prescan_impl_t dtdemux::prescan_best_impl() {
+	static const prescan_impl_t best = []() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return prescan_impl_t::AVX2;
+		if (__builtin_cpu_supports("sse4.2"))
+			return prescan_impl_t::SSE42;
+		return prescan_impl_t::SCALAR;
+	}();
+	return best;
+}
+
+int dtdemux::prescan_ts_packets(const uint8_t* buffer, int64_t len, ts_prescan_t& out,
+																prescan_impl_t impl) {
+	if (impl == prescan_impl_t::AUTO)
+		impl = prescan_best_impl();
+	auto* scan = impl == prescan_impl_t::AVX2 ? scan_avx2 : impl == prescan_impl_t::SSE42 ? scan_sse42 : scan_scalar;
+	int max_packets = len / pkt_size;
+	out.offsets.resize(max_packets);
+	out.pids.resize(max_packets);
+	out.flags.resize(max_packets);
+	out.ccs.resize(max_packets);
+	out.num_bytes_skipped = 0;
+	int num_packets = 0;
+	int64_t pos = 0;
+	while (pos + pkt_size <= len) {
+		if (buffer[pos] != sync_byte) {
+			auto next = resync(buffer, pos + 1, len);
+			if (next < 0) {
+				out.num_bytes_skipped += len - pos;
+				pos = len;
+				break;
+			}
+			out.num_bytes_skipped += next - pos;
+			pos = next;
+		}
+		int n = (len - pos) / pkt_size;
+		assert(num_packets + n <= max_packets);
+		auto count = scan(buffer + pos, n, pos, out, num_packets);
+		num_packets += count;
+		pos += count * (int64_t)pkt_size;
+	}
+	out.end_offset = pos;
+	out.offsets.resize(num_packets);
+	out.pids.resize(num_packets);
+	out.flags.resize(num_packets);
+	out.ccs.resize(num_packets);
+	return num_packets;
+}
+
+uint64_t dtdemux::match_pids(const uint8_t* buffer, int num_packets, uint16_t pid1, uint16_t pid2,
+														 prescan_impl_t impl) {
+	assert(num_packets <= 64);
+	if (impl == prescan_impl_t::AUTO)
+		impl = prescan_best_impl();
+	switch (impl) {
+	case prescan_impl_t::AVX2:
+		return match_pids_avx2(buffer, num_packets, pid1, pid2);
+	case prescan_impl_t::SSE42:
+		return match_pids_sse42(buffer, num_packets, pid1, pid2);
+	default:
+		return match_pids_scalar(buffer, num_packets, pid1, pid2);
+	}
+}
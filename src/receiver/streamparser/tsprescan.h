@@ -0,0 +1,117 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace dtdemux {
+
+	/*!
+		Compact header information for all packets in a buffer of transport stream packets,
+		stored in parallel arrays (one entry per packet). Filled by prescan_ts_packets.
+
+		flags contains the transport_error_indicator, payload_unit_start_indicator and transport_priority
+		bits of byte 1 of the packet header in its high bits and scrambling_control and
+		adaptation_field_control of byte 3 in its low bits
+	*/
+	struct ts_prescan_t {
+		enum flag_t : uint8_t {
+			TEI = 0x80,
+			PUSI = 0x40,
+			PRIORITY = 0x20,
+			SCRAMBLED = 0x0c,
+			ADAPTATION = 0x02,
+			PAYLOAD = 0x01
+		};
+
+		std::vector<uint32_t> offsets; //byte offset of each packet in the buffer
+		std::vector<uint16_t> pids;
+		std::vector<uint8_t> flags;
+		std::vector<uint8_t> ccs;
+		int64_t num_bytes_skipped{0}; //bytes skipped while resynchronising
+		int64_t end_offset{0}; //offset just past the last complete packet
+
+		inline int size() const {
+			return pids.size();
+		}
+
+		inline bool has_transport_error(int i) const {
+			return flags[i] & TEI;
+		}
+
+		inline bool get_payload_unit_start(int i) const {
+			return flags[i] & PUSI;
+		}
+
+		inline uint8_t get_scrambling_control(int i) const {
+			return (flags[i] & SCRAMBLED) >> 2;
+		}
+
+		inline bool is_encrypted(int i) const {
+			return flags[i] & SCRAMBLED;
+		}
+
+		inline bool has_adaptation(int i) const {
+			return flags[i] & ADAPTATION;
+		}
+
+		inline bool has_payload(int i) const {
+			return flags[i] & PAYLOAD;
+		}
+
+		void clear() {
+			offsets.clear();
+			pids.clear();
+			flags.clear();
+			ccs.clear();
+			num_bytes_skipped = 0;
+			end_offset = 0;
+		}
+	};
+
+	enum class prescan_impl_t {
+		AUTO, //best one supported by the cpu
+		SCALAR,
+		SSE42,
+		AVX2
+	};
+
+	/*!
+		Validate the sync bytes of all packets in buffer and extract their header fields into out.
+		Input need not start at a packet boundary: when a sync byte is missing, scanning resumes at the next
+		position where three consecutive sync bytes are found (or fewer, near the end of the buffer).
+		Returns the number of packets found
+	*/
+	int prescan_ts_packets(const uint8_t* buffer, int64_t len, ts_prescan_t& out,
+												 prescan_impl_t impl = prescan_impl_t::AUTO);
+
+	/*!
+		Returns a mask with bit i set if packet i of the num_packets (at most 64) packets at buffer has
+		pid pid1 or pid2. buffer must start at a packet boundary; sync bytes are not checked
+	*/
+	uint64_t match_pids(const uint8_t* buffer, int num_packets, uint16_t pid1, uint16_t pid2,
+											prescan_impl_t impl = prescan_impl_t::AUTO);
+
+	/*!
+		Returns the implementation selected by prescan_impl_t::AUTO
+	*/
+	prescan_impl_t prescan_best_impl();
+};
@@ -157,6 +157,28 @@ void subscriber_t::update_current_lnb(const devdb::lnb_t& lnb) {
 	}
 }
 
+std::vector<dtdemux::pid_stats_snapshot_t> subscriber_t::get_pid_stats() const {
+	auto aa = receiver->find_active_adapter(this->get_subscription_id());
+	if(!aa)
+		return {};
+	return aa->pid_stats->snapshot();
+}
+
+std::optional<decrypt_stats_t> subscriber_t::get_decrypt_stats() const {
+	auto subscription_id = this->get_subscription_id();
+	auto aa = receiver->find_active_adapter(subscription_id);
+	if(!aa)
+		return {};
+	std::optional<decrypt_stats_t> ret;
+	auto& tuner_thread = aa->tuner_thread;
+	//call by reference ok because of subsequent wait
+	tuner_thread.push_task([&tuner_thread, subscription_id, &ret]() {
+		ret = cb(tuner_thread).get_decrypt_stats(subscription_id);
+		return 0;
+	}).wait();
+	return ret;
+}
+
 void subscriber_t::remove_ssptr() {
 	auto w = receiver->subscribers.writeAccess();
 	auto& m = *w;
@@ -31,6 +31,7 @@
 #include "signal_info.h"
 #include "streamparser/packetstream.h"
 #include "streamparser/psi.h"
+#include "streamparser/pidstats.h"
 #include "util/safe/safe.h"
 #include "scan.h"
 
@@ -230,6 +231,16 @@ public:
 
 	EXPORT std::unique_ptr<playback_mpm_t> subscribe_recording(const recdb::rec_t& rec);
 
+	/*
+		per pid health counters of the mux tuned by this subscription; does not block the tuner thread
+	*/
+	EXPORT std::vector<dtdemux::pid_stats_snapshot_t> get_pid_stats() const;
+
+	/*
+		descrambling batch size and lag of the service subscribed to, if any
+	*/
+	EXPORT std::optional<decrypt_stats_t> get_decrypt_stats() const;
+
 };
 
 using ssptr_t = std::shared_ptr<subscriber_t>;
@@ -344,6 +344,14 @@ void export_subscriber(py::module& m) {
 				 , py::arg("cmd")
 				 , py::arg("par")=0
 			)
+		.def("pid_stats"
+				 , &subscriber_t::get_pid_stats
+				 , "per pid health counters (packets, errors, bitrate, pcr jitter) of the tuned mux"
+			)
+		.def("decrypt_stats"
+				 , &subscriber_t::get_decrypt_stats
+				 , "descrambling batch size and lag of the subscribed service; None if no service is subscribed"
+			)
 		;
 }
 
@@ -532,3 +540,41 @@ void export_scan_report(py::module& m) {
 		.def_readwrite("scan_id", &peak_to_scan_t::scan_id)
 		;
 }
+
+void export_pid_stats(py::module& m) {
+	static bool called = false;
+	if (called)
+		return;
+	called = true;
+	using namespace dtdemux;
+	py::class_<pid_stats_snapshot_t>(m, "pid_stats_t")
+		.def(py::init())
+		.def_readonly("pid", &pid_stats_snapshot_t::pid)
+		.def_readonly("num_packets", &pid_stats_snapshot_t::num_packets)
+		.def_readonly("num_cc_errors", &pid_stats_snapshot_t::num_cc_errors)
+		.def_readonly("num_transport_errors", &pid_stats_snapshot_t::num_transport_errors)
+		.def_readonly("num_scrambled", &pid_stats_snapshot_t::num_scrambled)
+		.def_readonly("num_clear", &pid_stats_snapshot_t::num_clear)
+		.def_readonly("num_pcrs", &pid_stats_snapshot_t::num_pcrs)
+		.def_readonly("num_pcr_discontinuities", &pid_stats_snapshot_t::num_pcr_discontinuities)
+		.def_readonly("bitrate", &pid_stats_snapshot_t::bitrate, "bits per second")
+		.def_readonly("pcr_jitter_ns", &pid_stats_snapshot_t::pcr_jitter_ns)
+		.def_readonly("max_pcr_jitter_ns", &pid_stats_snapshot_t::max_pcr_jitter_ns)
+		;
+}
+
+void export_decrypt_stats(py::module& m) {
+	static bool called = false;
+	if (called)
+		return;
+	called = true;
+	py::class_<decrypt_stats_t>(m, "decrypt_stats_t")
+		.def(py::init())
+		.def_readonly("bitrate", &decrypt_stats_t::bitrate, "bits per second")
+		.def_readonly("batch_packets", &decrypt_stats_t::batch_packets, "number of packets descrambled at once")
+		.def_readonly("lag_bytes", &decrypt_stats_t::lag_bytes, "bytes received but not yet descrambled")
+		.def_readonly("lag_ms", &decrypt_stats_t::lag_ms)
+		.def_readonly("num_deadline_flushes", &decrypt_stats_t::num_deadline_flushes,
+									"incomplete batches descrambled because the latency target expired")
+		;
+}
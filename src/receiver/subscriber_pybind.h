@@ -31,3 +31,5 @@ void export_scan_report(py::module &m);
 void export_signal_info(py::module &m);
 void export_position_motion_report(py::module &m);
 void export_sdt_data(py::module &m);
+void export_pid_stats(py::module &m);
+void export_decrypt_stats(py::module &m);
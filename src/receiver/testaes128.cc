@@ -0,0 +1,213 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Tests of the AES-128 descrambler, for all implementations:
+	-known answer tests from FIPS-197 (appendix C.1) and NIST SP 800-38A (F.1.2 and F.2.2)
+	-round trip of random ts payloads of all lengths, scrambled by a straightforward reference
+	encryption, checking that the residue is left in the clear
+*/
+
+#include "aes128.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static int num_errors{0};
+
+static void parse_hex(const char* hex, uint8_t* out) {
+	for (int i = 0; hex[2 * i]; ++i) {
+		unsigned x;
+		sscanf(hex + 2 * i, "%2x", &x);
+		out[i] = x;
+	}
+}
+
+//reference encryption, written after the description in FIPS-197
+struct ref_aes_t {
+	uint8_t sbox[256];
+	uint8_t round_keys[11][16];
+
+	static uint8_t xtime(uint8_t a) {
+		return (a << 1) ^ ((a & 0x80) ? 0x1b : 0);
+	}
+
+	ref_aes_t(const uint8_t* cw) {
+		//sbox by walking the multiplicative group with generator 3
+		uint8_t p = 1, q = 1;
+		do {
+			p = p ^ xtime(p);
+			q ^= q << 1;
+			q ^= q << 2;
+			q ^= q << 4;
+			if (q & 0x80)
+				q ^= 0x09;
+			uint8_t x = q ^ (uint8_t)((q << 1) | (q >> 7)) ^ (uint8_t)((q << 2) | (q >> 6)) ^
+				(uint8_t)((q << 3) | (q >> 5)) ^ (uint8_t)((q << 4) | (q >> 4));
+			sbox[p] = x ^ 0x63;
+		} while (p != 1);
+		sbox[0] = 0x63;
+
+		memcpy(round_keys[0], cw, 16);
+		uint8_t rcon = 1;
+		for (int r = 1; r <= 10; ++r) {
+			auto* prev = round_keys[r - 1];
+			auto* k = round_keys[r];
+			k[0] = prev[0] ^ sbox[prev[13]] ^ rcon;
+			k[1] = prev[1] ^ sbox[prev[14]];
+			k[2] = prev[2] ^ sbox[prev[15]];
+			k[3] = prev[3] ^ sbox[prev[12]];
+			for (int i = 4; i < 16; ++i)
+				k[i] = prev[i] ^ k[i - 4];
+			rcon = xtime(rcon);
+		}
+	}
+
+	void encrypt(uint8_t* s) const {
+		for (int i = 0; i < 16; ++i)
+			s[i] ^= round_keys[0][i];
+		for (int r = 1; r <= 10; ++r) {
+			uint8_t t[16];
+			for (int c = 0; c < 4; ++c)
+				for (int row = 0; row < 4; ++row)
+					t[4 * c + row] = sbox[s[4 * ((c + row) % 4) + row]]; //SubBytes and ShiftRows
+			if (r < 10) {
+				for (int c = 0; c < 4; ++c) { //MixColumns
+					auto* a = &t[4 * c];
+					uint8_t all = a[0] ^ a[1] ^ a[2] ^ a[3], a0 = a[0];
+					a[0] ^= all ^ xtime(a[0] ^ a[1]);
+					a[1] ^= all ^ xtime(a[1] ^ a[2]);
+					a[2] ^= all ^ xtime(a[2] ^ a[3]);
+					a[3] ^= all ^ xtime(a[3] ^ a0);
+				}
+			}
+			for (int i = 0; i < 16; ++i)
+				s[i] = t[i] ^ round_keys[r][i];
+		}
+	}
+
+	void scramble_payload(uint8_t* data, int len, bool cbc, const uint8_t* iv) const {
+		const uint8_t* prev = iv;
+		for (int i = 0; i + 16 <= len; i += 16) {
+			if (cbc)
+				for (int j = 0; j < 16; ++j)
+					data[i + j] ^= prev[j];
+			encrypt(data + i);
+			prev = data + i;
+		}
+	}
+};
+
+static const aes_impl_t impls[] = {aes_impl_t::PORTABLE, aes_impl_t::AESNI};
+static const char* names[] = {"portable", "aesni"};
+
+static bool supported(aes_impl_t impl) {
+	return impl != aes_impl_t::AESNI || aes128_best_impl() == aes_impl_t::AESNI;
+}
+
+static void check_kat(const char* title, const char* key_hex, const char* iv_hex, const char* plain_hex,
+											const char* cipher_hex) {
+	uint8_t cw[16], iv[16], plain[64], cipher[64];
+	int len = strlen(plain_hex) / 2;
+	parse_hex(key_hex, cw);
+	if (iv_hex)
+		parse_hex(iv_hex, iv);
+	parse_hex(plain_hex, plain);
+	parse_hex(cipher_hex, cipher);
+
+	ref_aes_t ref(cw);
+	uint8_t data[64];
+	memcpy(data, plain, len);
+	ref.scramble_payload(data, len, iv_hex, iv);
+	if (memcmp(data, cipher, len) != 0 && num_errors++ < 10)
+		printf("FAIL: %s: reference encryption\n", title);
+
+	for (int i = 0; i < 2; ++i) {
+		if (!supported(impls[i]))
+			continue;
+		aes128_key_t key;
+		aes128_set_key(key, cw, iv_hex ? iv : nullptr, impls[i]);
+		memcpy(data, cipher, len);
+		if (iv_hex)
+			aes128_decrypt_cbc(key, data, len / 16);
+		else
+			aes128_decrypt_ecb(key, data, len / 16);
+		if (memcmp(data, plain, len) != 0 && num_errors++ < 10)
+			printf("FAIL: %s: %s\n", title, names[i]);
+	}
+}
+
+int main(int argc, char** argv) {
+	printf("Best implementation: %s\n", names[(int)aes128_best_impl() - 1]);
+	check_kat("FIPS-197 C.1", "000102030405060708090a0b0c0d0e0f", nullptr, "00112233445566778899aabbccddeeff",
+						"69c4e0d86a7b0430d8cdb78070b4c55a");
+	const char* sp800_key = "2b7e151628aed2a6abf7158809cf4f3c";
+	const char* sp800_plain = "6bc1bee22e409f96e93d7e117393172a"
+		"ae2d8a571e03ac9c9eb76fac45af8e51"
+		"30c81c46a35ce411e5fbc1191a0a52ef"
+		"f69f2445df4f9b17ad2b417be66c3710";
+	check_kat("SP 800-38A ECB", sp800_key, nullptr, sp800_plain,
+						"3ad77bb40d7a3660a89ecaf32466ef97"
+						"f5d3d58503b9699de785895a96fdbaaf"
+						"43b1cd7f598ece23881b00e3ed030688"
+						"7b0c785e27e8ad3f8223207104725dd4");
+	check_kat("SP 800-38A CBC", sp800_key, "000102030405060708090a0b0c0d0e0f", sp800_plain,
+						"7649abac8119b246cee98e9b12e9197d"
+						"5086cb9b507219ee95db113a917678b2"
+						"73bed6b8e3c1743b7116e69e22229516"
+						"3ff1caa1681fac09120eca307586e1a7");
+
+	//round trip of ts payloads of all lengths at several alignments, with the cissa iv
+	srandom(1);
+	std::vector<uint8_t> plain(184 + 16), data(184 + 16);
+	for (int n = 0; n < 200; ++n) {
+		uint8_t cw[16];
+		for (auto& x : cw)
+			x = random();
+		for (auto& x : plain)
+			x = random();
+		ref_aes_t ref(cw);
+		for (bool cbc : {false, true}) {
+			for (int len = 0; len <= 184; ++len) {
+				int align = n % 16;
+				memcpy(&data[align], &plain[align], len);
+				ref.scramble_payload(&data[align], len, cbc, aes128_cissa_iv);
+				auto scrambled = data;
+				for (int i = 0; i < 2; ++i) {
+					if (!supported(impls[i]))
+						continue;
+					aes128_key_t key;
+					aes128_set_key(key, cw, nullptr, impls[i]);
+					data = scrambled;
+					aes128_descramble_payload(key, cbc, &data[align], len);
+					if (memcmp(&data[align], &plain[align], len) != 0 && num_errors++ < 10)
+						printf("FAIL: %s %s round trip len=%d\n", names[i], cbc ? "cbc" : "ecb", len);
+					if (len % 16 != 0 && memcmp(&scrambled[align + len - len % 16], &plain[align + len - len % 16],
+																			len % 16) != 0 && num_errors++ < 10)
+						printf("FAIL: residue scrambled len=%d\n", len);
+				}
+			}
+		}
+	}
+	if (num_errors == 0)
+		printf("All tests passed\n");
+	return num_errors == 0 ? 0 : -1;
+}
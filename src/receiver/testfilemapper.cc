@@ -0,0 +1,242 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Tests of readonly mmap_t, which maps files in chunks shared by all readers:
+	-readers following a growing file, as playback_mpm_t does for a live buffer, while the file is
+	written through a writable mmap_t
+	-several readers seeking randomly in the same file, using more chunks than the cache keeps mapped
+	-a file which is deleted while being read is unmapped once the last reader closes it
+	All data read is compared with what was written
+*/
+
+#include "filemapper.h"
+#include "util/logger.h"
+#include "util/util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static int num_errors{0};
+
+static uint8_t expected_byte(off_t pos) {
+	return (pos * 2654435761u) >> 13;
+}
+
+static bool check(const uint8_t* data, off_t pos, int len, const char* what) {
+	for (int i = 0; i < len; ++i) {
+		if (data[i] != expected_byte(pos + i)) {
+			if (num_errors++ < 10)
+				printf("FAIL: %s: wrong byte at %ld\n", what, pos + i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int open_reader(const char* filename) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		printf("FAIL: cannot open %s: %s\n", filename, strerror(errno));
+		exit(-1);
+	}
+	return fd;
+}
+
+/*
+	A writer appends packets in chunks of random size; after each chunk, two readers read all
+	data which has been made available, each in pieces of a different size
+*/
+static void test_growing(const char* filename) {
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (ftruncate(fd, 16 * 1024 * 1024) < 0) {
+		printf("FAIL: cannot truncate %s\n", filename);
+		exit(-1);
+	}
+	mmap_t writer(16 * 1024 * 1024, false);
+	writer.init(fd, 0);
+	mmap_t readers[2]{{16 * 1024 * 1024, true}, {16 * 1024 * 1024, true}};
+	off_t read_pos[2]{0, 0};
+	for (int i = 0; i < 2; ++i)
+		readers[i].init(open_reader(filename), 0, 0);
+	off_t written = 0;
+	const off_t file_size = 5 * mmap_t::chunk_size + 1234 * 188;
+	while (written < file_size) {
+		uint8_t* buffer;
+		int remaining = writer.get_write_buffer(buffer);
+		if (remaining < 1024) {
+			writer.advance();
+			remaining = writer.get_write_buffer(buffer);
+		}
+		int n = std::min((off_t)std::min(remaining, 188 * (1 + (int)(random() % 2000))), file_size - written);
+		n -= n % 188;
+		for (int i = 0; i < n; ++i)
+			buffer[i] = expected_byte(written + i);
+		writer.advance_write_pointer(n);
+		writer.advance_decrypt_pointer(n);
+		written += n;
+		for (int r = 0; r < 2; ++r) {
+			auto& reader = readers[r];
+			reader.grow_map(written);
+			for (;;) {
+				int len = reader.get_read_buffer(buffer);
+				if (len <= 0)
+					break;
+				len = std::min(len, r == 0 ? 7 * 188 : 1000 * 188);
+				if (!check(buffer, read_pos[r], len, "growing"))
+					return;
+				reader.advance_read_pointer(len);
+				read_pos[r] += len;
+			}
+		}
+	}
+	for (int r = 0; r < 2; ++r) {
+		if (read_pos[r] != written && num_errors++ < 10)
+			printf("FAIL: growing: reader %d read %ld of %ld bytes\n", r, read_pos[r], written);
+	}
+}
+
+/*
+	readers jump to random positions and read a random amount from there.
+	The file is large enough to need more chunks than are cached
+*/
+static void test_seeking(const char* filename) {
+	const int num_packets = 40 * mmap_t::chunk_size / 188;
+	{
+		std::vector<uint8_t> data(num_packets * 188);
+		for (size_t i = 0; i < data.size(); ++i)
+			data[i] = expected_byte(i);
+		int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+			printf("FAIL: cannot write %s\n", filename);
+			exit(-1);
+		}
+		close(fd);
+	}
+	const int num_readers = 4;
+	std::vector<std::unique_ptr<mmap_t>> readers;
+	for (int r = 0; r < num_readers; ++r)
+		readers.push_back(std::make_unique<mmap_t>(16 * 1024 * 1024, true));
+	const off_t end = num_packets * (off_t)188;
+	for (int i = 0; i < 500; ++i) {
+		auto& reader = *readers[random() % num_readers];
+		off_t pos = (random() % num_packets) * (off_t)188;
+		int fd = reader.fd >= 0 ? reader.fd : open_reader(filename);
+		if (!reader.init(fd, pos, end)) {
+			printf("FAIL: init failed\n");
+			++num_errors;
+			return;
+		}
+		int64_t todo = std::min(end - pos, (off_t)(random() % mmap_t::chunk_size));
+		while (todo > 0) {
+			uint8_t* buffer;
+			int len = reader.get_read_buffer(buffer);
+			if (len <= 0) {
+				if (num_errors++ < 10)
+					printf("FAIL: seeking: no data at %ld\n", pos);
+				break;
+			}
+			len = std::min((int64_t)len, todo);
+			if (!check(buffer, pos, len, "seeking"))
+				return;
+			reader.advance_read_pointer(len);
+			pos += len;
+			todo -= len;
+		}
+	}
+}
+
+/*
+	returns true if filename is mapped in this process
+*/
+static bool is_mapped(const char* filename) {
+	FILE* fp = fopen("/proc/self/maps", "r");
+	if (!fp)
+		return false;
+	char line[1024];
+	bool ret = false;
+	while (!ret && fgets(line, sizeof(line), fp))
+		ret = strstr(line, filename) != nullptr;
+	fclose(fp);
+	return ret;
+}
+
+/*
+	Two readers read a file, which is then deleted. The chunk cache may not keep the deleted file
+	mapped after both readers have closed it
+*/
+static void test_unlinked(const char* filename) {
+	const int num_packets = 3 * mmap_t::chunk_size / 188;
+	std::vector<uint8_t> data(num_packets * 188);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = expected_byte(i);
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+		printf("FAIL: cannot write %s\n", filename);
+		exit(-1);
+	}
+	close(fd);
+	const off_t end = num_packets * (off_t)188;
+	{
+		mmap_t readers[2]{{16 * 1024 * 1024, true}, {16 * 1024 * 1024, true}};
+		for (int r = 0; r < 2; ++r) {
+			readers[r].init(open_reader(filename), r * mmap_t::chunk_size, end);
+			off_t pos = r * mmap_t::chunk_size;
+			for (off_t todo = mmap_t::chunk_size + 1000 * 188; todo > 0;) {
+				uint8_t* buffer;
+				int len = std::min((off_t)readers[r].get_read_buffer(buffer), todo);
+				if (len <= 0 || !check(buffer, pos, len, "unlinked"))
+					return;
+				readers[r].advance_read_pointer(len);
+				pos += len;
+				todo -= len;
+			}
+		}
+		unlink(filename);
+		if (!is_mapped(filename) && num_errors++ < 10)
+			printf("FAIL: unlinked: file not mapped while being read\n");
+		readers[0].unmap();
+		readers[0].close();
+		if (!is_mapped(filename) && num_errors++ < 10)
+			printf("FAIL: unlinked: file unmapped while still being read by another reader\n");
+	}
+	if (is_mapped(filename) && num_errors++ < 10)
+		printf("FAIL: unlinked: deleted file still mapped after all readers closed it\n");
+}
+
+int main(int argc, char** argv) {
+	srandom(1);
+	char filename[] = "/tmp/testfilemapper.XXXXXX";
+	int fd = mkstemp(filename);
+	if (fd < 0) {
+		printf("FAIL: cannot create temporary file\n");
+		return -1;
+	}
+	close(fd);
+	test_growing(filename);
+	test_seeking(filename);
+	test_unlinked(filename);
+	if (num_errors == 0)
+		printf("All tests passed\n");
+	return num_errors == 0 ? 0 : -1;
+}
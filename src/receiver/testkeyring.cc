@@ -0,0 +1,256 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Tests of the control word handoff between scam thread and service thread:
+	-a producer thread pushes numbered keys as fast as possible; the consumer must see all of them in order
+	-keys pushed while the consumer does not receive them, more than fit in the queue, are not lost
+	-replay of crypto periods with alternating parity, in which the key for each period is requested
+	during the previous period and arrives after a random delay, sometimes after the parity change.
+	At each parity change the consumer must switch to exactly the key of the new period (no key lost),
+	and never to a key requested after the current position in the stream (no key applied early).
+	Some keys are never returned by scam; the consumer must then skip the period instead of using
+	the key for the next period of the same parity.
+	The replay is done once with deterministic interleaving and once with a real producer thread.
+*/
+
+#include "keyring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static int num_errors{0};
+
+struct test_key_t {
+	int8_t parity = -1;
+	bool valid = false;
+	int64_t request_bytepos{-1};
+	int64_t seqno{-1}; //crypto period for which the key is meant
+};
+
+using ring_t = key_ring_t<test_key_t, 256, 32>;
+
+static void test_ordering() {
+	ring_t ring;
+	const int64_t num_keys = 1000000;
+	std::atomic<int64_t> num_received{0};
+	std::thread producer([&]() {
+		for (int64_t i = 0; i < num_keys; ++i) {
+			test_key_t key{int8_t(i & 1), true, i, i};
+			//stay far enough ahead of the consumer to overflow the queue, but do not overwrite unseen history
+			while (i - num_received.load(std::memory_order_acquire) >= ring_t::num_keys / 2)
+				std::this_thread::yield();
+			if (ring.push(key) != i % ring_t::num_keys && num_errors++ < 10)
+				printf("FAIL: ordering: wrong index for key %ld\n", i);
+		}
+	});
+	int64_t expected = 0;
+	while (expected < num_keys) {
+		int n = ring.receive();
+		if (n == 0)
+			std::this_thread::yield();
+		for (int64_t i = expected; i < expected + n; ++i) {
+			auto& key = ring[i % ring_t::num_keys];
+			if (key.seqno != i && num_errors++ < 10)
+				printf("FAIL: ordering: key %ld found instead of %ld\n", key.seqno, i);
+		}
+		expected += n;
+		num_received.store(expected, std::memory_order_release);
+		if (n > 0 && ring.last_received_key_idx() != (expected - 1) % ring_t::num_keys && num_errors++ < 10)
+			printf("FAIL: ordering: last_received_key_idx=%d after %ld keys\n", ring.last_received_key_idx(), expected);
+	}
+	producer.join();
+}
+
+/*
+	The consumer does not receive keys for a while, so that the queue overflows; keys pushed after that,
+	also while the consumer is receiving, must follow the overflowed keys
+*/
+static void test_overflow() {
+	ring_t ring;
+	int64_t seqno = 0;
+	int64_t expected = 0;
+	for (int round = 0; round < 10; ++round) {
+		int num_to_push = 1 + random() % (ring_t::num_keys - 1);
+		for (int i = 0; i < num_to_push; ++i, ++seqno) {
+			if (ring.push(test_key_t{int8_t(seqno & 1), true, seqno, seqno}) != seqno % ring_t::num_keys &&
+					num_errors++ < 10)
+				printf("FAIL: overflow: wrong index for key %ld\n", seqno);
+		}
+		int n = ring.receive();
+		if (n != num_to_push && num_errors++ < 10)
+			printf("FAIL: overflow: received %d of %d keys\n", n, num_to_push);
+		for (int64_t i = expected; i < expected + n; ++i) {
+			auto& key = ring[i % ring_t::num_keys];
+			if (key.seqno != i && num_errors++ < 10)
+				printf("FAIL: overflow: key %ld found instead of %ld\n", key.seqno, i);
+		}
+		expected += n;
+	}
+}
+
+struct crypto_period_t {
+	int64_t request_bytepos; //when the ecm was sent to scam
+	int64_t deliver_bytepos; //when scam returns the key
+	bool lost{false}; //scam never returns the key
+};
+
+struct replay_t {
+	static constexpr int64_t period_len = 500 * 188;
+	std::vector<crypto_period_t> periods;
+
+	//period 0 starts at bytepos 0
+	static int64_t period_start(int p) {
+		return p * period_len;
+	}
+
+	explicit replay_t(int num_periods) {
+		int64_t last_delivery = 0;
+		for (int p = 0; p < num_periods; ++p) {
+			crypto_period_t cp;
+			//the key for period p is requested during period p - 1 (or at the start of the stream for p = 0)
+			cp.request_bytepos = p == 0 ? 0 : period_start(p - 1) + random() % (period_len / 2);
+			//normally the key arrives well before period p starts, but 1 in 5 arrives late
+			auto delay = (random() % 5 == 0) ? period_len / 2 + random() % period_len : random() % (period_len / 4);
+			//scam answers ecms in order
+			cp.deliver_bytepos = std::max(last_delivery, cp.request_bytepos + delay);
+			last_delivery = cp.deliver_bytepos;
+			cp.lost = p >= 2 && p < num_periods - 1 && random() % 20 == 0;
+			periods.push_back(cp);
+		}
+	}
+
+	test_key_t key(int p) const {
+		return test_key_t{int8_t(p & 1), true, periods[p].request_bytepos, p};
+	}
+
+	/*
+		simulates the service thread: data is received in chunks of step bytes; it is decrypted up to the
+		next parity change, which is only passed once the key for the new period has been found.
+		deliver(received) must push all keys delivered before bytepos received; if it pushes them
+		asynchronously, exact must be false as it is then unknown when they become visible
+	*/
+	template <typename deliver_t> void run(ring_t& ring, int64_t step, bool exact, deliver_t deliver) {
+		int num_periods = periods.size();
+		int last_used_key_idxs[2] = {-1, -1};
+		int current = -1; //period being decrypted
+		int64_t decrypted = 0;
+		int64_t end = period_start(num_periods);
+		for (int64_t received = 0; current < num_periods - 1; received = std::min(received + step, end)) {
+			deliver(received);
+			ring.receive();
+			while (current < num_periods - 1) {
+				auto next = current + 1;
+				auto parity_change = period_start(next);
+				if (parity_change >= received) {
+					decrypted = received;
+					break;
+				}
+				decrypted = parity_change;
+				auto odd = next & 1;
+				auto& idx = last_used_key_idxs[odd];
+				auto ret = ring.find_key(idx + 1, odd, decrypted, idx < 0);
+				if (ret < 0) {
+					if (periods[next].lost && received > period_start(next + 1) + step) {
+						/*the next parity change has been received, so the key will not be used anymore
+							(this is what dvbcsa_t::skip_non_decryptable concludes)*/
+						current = next;
+						continue;
+					}
+					if (!exact || periods[next].lost)
+						break; // wait for the key
+					if (received >= periods[next].deliver_bytepos + step && num_errors++ < 10)
+						printf("FAIL: step=%ld: key for period %d delivered at %ld not found at %ld\n", step, next,
+									 periods[next].deliver_bytepos, received);
+					if (received == end) {
+						//cannot happen unless a key was lost
+						printf("FAIL: step=%ld: stuck at period %d\n", step, next);
+						++num_errors;
+						return;
+					}
+					break; // wait for the key
+				}
+				auto& key = ring[ret];
+				if (key.seqno != next && num_errors++ < 10)
+					printf("FAIL: step=%ld: period %d uses key for period %ld\n", step, next, key.seqno);
+				if (key.request_bytepos > decrypted && num_errors++ < 10)
+					printf("FAIL: step=%ld: period %d at %ld uses key requested at %ld\n", step, next, decrypted,
+								 key.request_bytepos);
+				idx = ret;
+				current = next;
+			}
+		}
+		if (decrypted < period_start(num_periods - 1) && num_errors++ < 10)
+			printf("FAIL: step=%ld: not all periods decrypted\n", step);
+	}
+};
+
+static void test_replay() {
+	const int num_periods = 2000;
+	for (int64_t step : {188L, 7 * 188L, 1024 * 188L}) {
+		replay_t replay(num_periods);
+		ring_t ring;
+		int delivered = 0;
+		replay.run(ring, step, true, [&](int64_t received) {
+			for (; delivered < num_periods && replay.periods[delivered].deliver_bytepos < received; ++delivered) {
+				if (!replay.periods[delivered].lost)
+					ring.push(replay.key(delivered));
+			}
+		});
+	}
+}
+
+static void test_threaded_replay() {
+	const int num_periods = 2000;
+	replay_t replay(num_periods);
+	ring_t ring;
+	std::atomic<int64_t> num_bytes_received{0};
+	std::atomic<bool> done{false};
+	std::thread producer([&]() {
+		for (int p = 0; p < num_periods; ++p) {
+			while (num_bytes_received.load(std::memory_order_relaxed) <= replay.periods[p].deliver_bytepos) {
+				if (done)
+					return;
+				std::this_thread::yield();
+			}
+			if (!replay.periods[p].lost)
+				ring.push(replay.key(p));
+		}
+	});
+	const int64_t step = 7 * 188;
+	replay.run(ring, step, false, [&](int64_t received) {
+		num_bytes_received.store(received, std::memory_order_relaxed);
+		std::this_thread::yield();
+	});
+	done = true;
+	producer.join();
+}
+
+int main(int argc, char** argv) {
+	srandom(1);
+	test_ordering();
+	test_overflow();
+	test_replay();
+	test_threaded_replay();
+	if (num_errors == 0)
+		printf("All tests passed\n");
+	return num_errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,189 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+	Tests of ts_file_reader_t, replaying a generated .ts file which has a pcr every 20ms on one pid:
+	-unpaced replay from an epoll loop returns the whole file, including a trailing partial packet
+	-read_into only returns the packets of the requested pids
+	-paced replay returns the same data, and takes as long as the pcrs indicate (scaled by speed)
+*/
+
+#include "tsfilereader.h"
+#include "util/logger.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static constexpr int packet_size = 188;
+static constexpr int num_packets = 500;
+static constexpr int pcr_interval = 10; //packets
+static constexpr int64_t pcr_step = 27000000LL / 50; //20ms
+static constexpr uint16_t pcr_pid = 0x100;
+static constexpr uint16_t data_pid = 0x101;
+static int num_errors{0};
+
+static void fail(const char* fmt, auto... args) {
+	if (num_errors++ < 10) {
+		printf("FAIL: ");
+		printf(fmt, args...);
+		printf("\n");
+	}
+}
+
+static std::vector<uint8_t> make_stream() {
+	std::vector<uint8_t> ret(num_packets * packet_size + 100); //ends with a partial packet
+	for (int i = 0; i < num_packets; ++i) {
+		auto* p = ret.data() + i * packet_size;
+		bool has_pcr = i % pcr_interval == 0;
+		uint16_t pid = has_pcr ? pcr_pid : data_pid;
+		p[0] = 0x47;
+		p[1] = pid >> 8;
+		p[2] = pid & 0xff;
+		p[3] = (has_pcr ? 0x30 : 0x10) | (i & 0xf);
+		int start = 4;
+		if (has_pcr) {
+			int64_t pcr = (i / pcr_interval) * pcr_step;
+			int64_t base = pcr / 300;
+			int64_t ext = pcr % 300;
+			p[4] = 7; //adaptation field length
+			p[5] = 0x10; //pcr flag
+			p[6] = base >> 25;
+			p[7] = base >> 17;
+			p[8] = base >> 9;
+			p[9] = base >> 1;
+			p[10] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+			p[11] = ext & 0xff;
+			start = 12;
+		}
+		for (int j = start; j < packet_size; ++j)
+			p[j] = i + j;
+	}
+	for (int j = 0; j < 100; ++j)
+		ret[num_packets * packet_size + j] = j;
+	return ret;
+}
+
+/*
+	returns all data delivered by reader, read from an epoll loop as a service thread would
+*/
+static std::vector<uint8_t> replay(ts_file_reader_t& reader) {
+	std::vector<uint8_t> ret;
+	epoll_t epoll;
+	if (reader.open(&epoll) < 0) {
+		fail("cannot open %s", reader.filename.c_str());
+		return ret;
+	}
+	struct epoll_event events[8];
+	for (int idle = 0; !reader.at_end() && idle < 10;) {
+		int n = epoll.wait(events, 8, 100);
+		idle = n == 0 ? idle + 1 : 0;
+		for (int i = 0; i < n; ++i) {
+			if (!reader.on_epoll_event(&events[i]))
+				continue;
+			for (;;) {
+				auto [p, len] = reader.read(7 * packet_size);
+				if (len <= 0)
+					break;
+				ret.insert(ret.end(), p, p + len);
+				reader.discard(len);
+			}
+		}
+	}
+	if (!reader.at_end())
+		fail("%s: replay stalled after %ld bytes", reader.paced ? "paced" : "unpaced", (int64_t)ret.size());
+	reader.close();
+	return ret;
+}
+
+static void test_unpaced(const char* filename, const std::vector<uint8_t>& data) {
+	ts_file_reader_t reader(filename, false, 1., 64 * packet_size);
+	auto out = replay(reader);
+	if (out != data)
+		fail("unpaced: read %ld bytes which differ from the %ld bytes in the file", (int64_t)out.size(),
+				 (int64_t)data.size());
+}
+
+static void test_read_into(const char* filename, const std::vector<uint8_t>& data) {
+	epoll_t epoll; //must outlive reader
+	ts_file_reader_t reader(filename, false, 1., 64 * packet_size);
+	if (reader.open(&epoll) < 0) {
+		fail("cannot open %s", filename);
+		return;
+	}
+	std::vector<uint16_t> pids{data_pid};
+	std::vector<uint8_t> out(num_packets * packet_size);
+	ssize_t num_bytes{0};
+	for (;;) {
+		auto ret = reader.read_into(out.data() + num_bytes, 13 * packet_size, &pids);
+		if (ret <= 0)
+			break;
+		num_bytes += ret;
+	}
+	int n = num_bytes / packet_size;
+	for (int i = 0, j = 0; i < num_packets; ++i) {
+		if (i % pcr_interval == 0)
+			continue; //pcr pid
+		if (j >= n || memcmp(out.data() + j * packet_size, data.data() + i * packet_size, packet_size) != 0) {
+			fail("read_into: packet %d missing or wrong", i);
+			return;
+		}
+		++j;
+	}
+	if (n != num_packets - num_packets / pcr_interval)
+		fail("read_into: returned %d packets", n);
+}
+
+static void test_paced(const char* filename, const std::vector<uint8_t>& data) {
+	const double speed = 10.;
+	ts_file_reader_t reader(filename, true, speed, 64 * packet_size);
+	auto start = steady_clock_t::now();
+	auto out = replay(reader);
+	auto elapsed = std::chrono::duration<double>(steady_clock_t::now() - start).count();
+	if (out != data)
+		fail("paced: read %ld bytes which differ from the %ld bytes in the file", (int64_t)out.size(),
+				 (int64_t)data.size());
+	double expected = (num_packets / pcr_interval - 1) * pcr_step / 27e6 / speed;
+	if (elapsed < expected * 0.9 || elapsed > expected + 1.)
+		fail("paced: replay took %.3fs; expected %.3fs", elapsed, expected);
+}
+
+int main(int argc, char** argv) {
+	char filename[] = "/tmp/testtsfilereader.XXXXXX";
+	int fd = mkstemp(filename);
+	if (fd < 0) {
+		printf("FAIL: cannot create temporary file\n");
+		return -1;
+	}
+	auto data = make_stream();
+	if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+		printf("FAIL: cannot write %s\n", filename);
+		return -1;
+	}
+	close(fd);
+	test_unpaced(filename, data);
+	test_read_into(filename, data);
+	test_paced(filename, data);
+	unlink(filename);
+	if (num_errors == 0)
+		printf("All tests passed\n");
+	return num_errors == 0 ? 0 : -1;
+}
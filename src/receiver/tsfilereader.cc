@@ -0,0 +1,220 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "tsfilereader.h"
+#include "util/logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr int packet_size = 188;
+
+int ts_file_reader_t::open(epoll_t* epoll, int epoll_flags)
+{
+	if(fd >= 0) {
+		dterrorf("Implementation error: multiple opens");
+		return fd;
+	}
+	fd = ::open(filename.c_str(), O_RDONLY|O_CLOEXEC);
+	if(fd < 0) {
+		dterrorf("Cannot open {}: {}", filename, strerror(errno));
+		return fd;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	dtdebugf("OPEN {} paced={:d} speed={:f}", filename, paced, speed);
+	this->epoll = epoll;
+	eof = false;
+	num_valid = 0;
+	num_released = 0;
+	file_offset = 0;
+	num_read = 0;
+	pcr_pid = -1;
+	first_pcr = -1;
+	last_pcr = -1;
+	if(paced) {
+		timer_fd = periodic_timer_create_and_start(std::chrono::duration<double>(pacing_period).count());
+		epoll->add_fd(timer_fd, epoll_flags);
+	} else {
+		epoll->add_fd((int)notifier, epoll_flags);
+		notifier.unblock();
+	}
+	return fd;
+}
+
+void ts_file_reader_t::close() {
+	if(fd < 0)
+		return;
+	if(paced)
+		epoll->remove_fd(timer_fd);
+	else
+		epoll->remove_fd((int)notifier);
+	if(timer_fd >= 0) {
+		timer_stop(timer_fd);
+		::close(timer_fd);
+	}
+	timer_fd = -1;
+	force_close(fd);
+	fd = -1;
+	epoll = nullptr;
+	dtdebugf("Closed {}: {:d} bytes read", filename, file_offset);
+}
+
+bool ts_file_reader_t::on_epoll_event(const epoll_event* evt) {
+	if(!epoll)
+		return false;
+	if(paced) {
+		if(!epoll->matches(evt, timer_fd))
+			return false;
+		uint64_t num_expirations;
+		if(::read(timer_fd, &num_expirations, sizeof(num_expirations)) < 0 && errno != EAGAIN)
+			dterrorf("error reading timer: {}", strerror(errno));
+		return true;
+	}
+	if(!epoll->matches(evt, (int)notifier))
+		return false;
+	notifier.reset();
+	return true;
+}
+
+/*
+	append data from the file to the buffer
+ */
+void ts_file_reader_t::fill_buffer() {
+	auto *p = bufferp.get();
+	if(!p) {
+		bufferp = std::make_unique<uint8_t[]>(buffer_size);
+		p = bufferp.get();
+	}
+	while(!eof && num_valid < buffer_size) {
+		auto ret = ::pread(fd, p + num_valid, buffer_size - num_valid, file_offset);
+		if(ret < 0) {
+			if(errno == EINTR)
+				continue;
+			dterrorf("Error reading {}: {}", filename, strerror(errno));
+			eof = true;
+			break;
+		}
+		if(ret == 0) {
+			dtdebugf("End of file {} reached after {:d} bytes", filename, file_offset);
+			eof = true;
+			break;
+		}
+		num_valid += ret;
+		file_offset += ret;
+	}
+}
+
+/*
+	Advance num_released up to, but not including, the first packet with a pcr on pcr_pid
+	which should only be played in the future. A pcr which jumps backwards or by more than 10s
+	restarts pacing from that packet.
+ */
+void ts_file_reader_t::release_paced_data() {
+	constexpr int64_t max_jump = 10 * 27000000LL;
+	auto* p = bufferp.get();
+	auto now = steady_clock_t::now();
+	while(num_released + packet_size <= num_valid) {
+		auto* pkt = p + num_released;
+		if(pkt[0] != 0x47) {
+			//not synchronised; the parser will resync
+			num_released += 1;
+			continue;
+		}
+		bool has_pcr = (pkt[3] & 0x20) && pkt[4] >= 7 && (pkt[5] & 0x10);
+		if(has_pcr) {
+			int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+			if(pcr_pid < 0)
+				pcr_pid = pid;
+			if(pid == pcr_pid) {
+				int64_t base = ((int64_t)pkt[6] << 25) | ((int64_t)pkt[7] << 17) | ((int64_t)pkt[8] << 9) |
+					((int64_t)pkt[9] << 1) | (pkt[10] >> 7);
+				int64_t ext = ((pkt[10] & 1) << 8) | pkt[11];
+				int64_t pcr = base * 300 + ext;
+				if(first_pcr < 0 || pcr < last_pcr || pcr - last_pcr > max_jump) {
+					first_pcr = pcr;
+					first_pcr_time = now;
+				}
+				auto play_time = first_pcr_time +
+					std::chrono::nanoseconds(int64_t((pcr - first_pcr) * 1000 / 27 / speed));
+				if(play_time > now)
+					return;
+				last_pcr = pcr;
+			}
+		}
+		num_released += packet_size;
+	}
+	if(eof)
+		num_released = num_valid; //trailing partial packet
+}
+
+std::tuple<uint8_t*, ssize_t> ts_file_reader_t::read(ssize_t size) {
+	fill_buffer();
+	ssize_t available = num_valid;
+	if(paced) {
+		release_paced_data();
+		available = num_released;
+	}
+	if(size > 0)
+		available = std::min(available, size);
+	if(available == 0) {
+		if(at_end())
+			return {bufferp.get(), 0};
+		errno = EAGAIN;
+		return {bufferp.get(), -1};
+	}
+	num_read += available;
+	if(!paced && !eof)
+		notifier.unblock(); //ensure that we are called again
+	return {bufferp.get(), available};
+}
+
+void ts_file_reader_t::discard(ssize_t num_bytes) {
+	assert(num_bytes <= num_valid);
+	auto delta = num_valid - num_bytes;
+	if(delta > 0)
+		memmove(bufferp.get(), bufferp.get() + num_bytes, delta);
+	num_valid = delta;
+	num_released = std::max(num_released - num_bytes, (ssize_t)0);
+}
+
+ssize_t ts_file_reader_t::read_into(uint8_t* p, ssize_t toread, const std::vector<uint16_t>* pids) {
+	ssize_t num_copied{0};
+	while (toread - num_copied >= packet_size) {
+		auto [ptr, ret] = this->read(toread - num_copied - ((toread - num_copied) % packet_size));
+		if(ret <= 0)
+			return num_copied > 0 ? num_copied : ret;
+		auto len = ret - ret % packet_size;
+		if(len == 0) {
+			discard(ret); //partial packet at end of file
+			break;
+		}
+		for(auto* q = ptr; q < ptr + len; q += packet_size) {
+			uint16_t pid = ((q[1] & 0x1f) << 8) | q[2];
+			if(!pids || std::find(pids->begin(), pids->end(), pid) != pids->end()) {
+				memcpy(p + num_copied, q, packet_size);
+				num_copied += packet_size;
+			}
+		}
+		discard(len);
+	}
+	return num_copied;
+}
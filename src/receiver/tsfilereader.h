@@ -0,0 +1,115 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <memory>
+#include <sys/epoll.h>
+#include <tuple>
+#include <vector>
+#include "stackstring.h"
+#include "util/util.h"
+
+/*
+	Replays a recorded transport stream (.ts file) like a demux device, so that si processing and
+	indexing can be measured, profiled and debugged without a tuner (see neumo-replay-ts).
+
+	Arrival of data is signalled on a file descriptor, which is added to the caller's epoll set
+	like a demux fd:
+	-unpaced: an eventfd which is signalled again after each read, until the end of the file is reached;
+	 data is delivered as fast as the caller processes it
+	-paced: a periodic timerfd; data is released according to the pcr values in the file, i.e.,
+	 read() returns data up to the first packet carrying a pcr which is still in the future
+	 (scaled by speed)
+ */
+class ts_file_reader_t {
+	constexpr static std::chrono::duration pacing_period = 10ms;
+
+	int fd{-1};
+	int timer_fd{-1}; //paced mode
+	event_handle_t notifier; //unpaced mode
+	epoll_t* epoll{nullptr};
+	bool eof{false}; //all data in the file has been read into the buffer
+
+	std::unique_ptr<uint8_t[]> bufferp{nullptr};
+	ssize_t num_valid{0}; //number of bytes in buffer
+	ssize_t num_released{0}; //number of bytes in buffer which read() may return (paced mode)
+	int64_t file_offset{0};
+
+	//pacing state
+	int pcr_pid{-1}; //the first pid on which a pcr is found
+	int64_t first_pcr{-1}; //in 27Mhz units
+	int64_t last_pcr{-1};
+	steady_time_t first_pcr_time{};
+
+	void fill_buffer();
+	void release_paced_data();
+
+public:
+	const ss::string<256> filename;
+	const ssize_t buffer_size;
+	const bool paced{false};
+	const double speed{1.};
+	int64_t num_read{0}; //bytes returned by read()
+
+	ts_file_reader_t(const char* filename, bool paced = false, double speed = 1., ssize_t buffer_size = -1)
+		: filename(filename)
+		, buffer_size(buffer_size < 0 ? 32 * 1024L * 188 : buffer_size) //multiple of packet size
+		, paced(paced)
+		, speed(speed)
+		{}
+
+	~ts_file_reader_t() {
+		close();
+	}
+
+	inline bool is_open() const {
+		return fd >= 0;
+	}
+
+	/*
+		true when the whole file has been returned by read()
+	*/
+	inline bool at_end() const {
+		return eof && num_valid == 0;
+	}
+
+	/*!
+		returns the file descriptor of the file, or -1 on error
+	*/
+	int open(epoll_t* epoll, int epoll_flags = EPOLLIN|EPOLLERR|EPOLLHUP|EPOLLET);
+	void close();
+
+	/*!
+		returns true if evt was for this reader, in which case read() should be called
+	*/
+	bool on_epoll_event(const epoll_event* evt);
+
+	/*
+		returns a buffer range with valid data; returns -1 and sets errno to EAGAIN if no
+		data is available (yet), and 0 at the end of the file
+	*/
+	std::tuple<uint8_t*, ssize_t> read(ssize_t size = -1);
+	void discard(ssize_t num_bytes);
+
+	/*
+		copy the packets of the given pids (all pids if pids is null) to p
+	*/
+	ssize_t read_into(uint8_t* p, ssize_t toread, const std::vector<uint16_t>* pids = nullptr);
+};
@@ -210,6 +210,13 @@ int tuner_thread_t::exit() {
 	return 0;
 }
 
+std::optional<decrypt_stats_t> tuner_thread_t::cb_t::get_decrypt_stats(subscription_id_t subscription_id) {
+	auto active_service_p = active_adapter.active_service_for_subscription(subscription_id);
+	if (!active_service_p)
+		return {};
+	return active_service_p->get_decrypt_stats();
+}
+
 int tuner_thread_t::cb_t::stop_recording(const recdb::rec_t& rec,
 																	 mpm_copylist_t& copy_commands)
 {
@@ -137,4 +137,5 @@ public:
 	positioner_cmd(subscription_id_t subscription_id, devdb::positioner_cmd_t cmd, int par);
 	int update_current_lnb(subscription_id_t subscription_id,  const devdb::lnb_t& lnb);
 	int stop_recording(const recdb::rec_t& rec, mpm_copylist_t& copy_commands);
+	std::optional<decrypt_stats_t> get_decrypt_stats(subscription_id_t subscription_id);
 };
@@ -0,0 +1,291 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "uringwriter.h"
+#include "util/logger.h"
+#include "util/util.h"
+#include <algorithm>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+/*
+	The ring is set up with plain system calls, to avoid a dependency on liburing for the little we need:
+	one thread submitting writes and reaping their completions
+*/
+
+uring_writer_t::uring_writer_t(int num_buffers, int buffer_size_)
+	: buffer_size(buffer_size_) {
+	io_uring_params p{};
+	ring_fd = syscall(__NR_io_uring_setup, 64, &p);
+	if (ring_fd < 0) {
+		dterrorf("io_uring_setup failed: {}", strerror(errno));
+		return;
+	}
+	num_entries = p.sq_entries;
+	sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+	sq_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+								IORING_OFF_SQ_RING);
+	cq_ptr = single_mmap ? sq_ptr
+		: mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	auto* mem = mmap(nullptr, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+									 ring_fd, IORING_OFF_SQES);
+	if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || mem == MAP_FAILED) {
+		dterrorf("Could not map io_uring: {}", strerror(errno));
+		if (mem != MAP_FAILED)
+			munmap(mem, p.sq_entries * sizeof(io_uring_sqe));
+		unmap_ring();
+		return;
+	}
+	sqes = (io_uring_sqe*)mem;
+	auto* sq = (uint8_t*)sq_ptr;
+	sq_head = (unsigned*)(sq + p.sq_off.head);
+	sq_tail = (unsigned*)(sq + p.sq_off.tail);
+	sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+	sq_array = (unsigned*)(sq + p.sq_off.array);
+	auto* cq = (uint8_t*)cq_ptr;
+	cq_head = (unsigned*)(cq + p.cq_off.head);
+	cq_tail = (unsigned*)(cq + p.cq_off.tail);
+	cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+	cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+
+	buffers.resize(num_buffers);
+	std::vector<iovec> iovecs(num_buffers);
+	for (int i = 0; i < num_buffers; ++i) {
+		void* data{nullptr};
+		if (posix_memalign(&data, sysconf(_SC_PAGESIZE), buffer_size) != 0) {
+			dterrorf("Could not allocate io_uring buffers");
+			unmap_ring();
+			return;
+		}
+		buffers[i].data = (uint8_t*)data;
+		iovecs[i].iov_base = data;
+		iovecs[i].iov_len = buffer_size;
+	}
+	/*registered buffers are pinned once, instead of for each write, but this counts against RLIMIT_MEMLOCK;
+		without them, writes still work*/
+	buffers_registered =
+		syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), num_buffers) == 0;
+	if (!buffers_registered)
+		dtdebugf("Could not register io_uring buffers: {}", strerror(errno));
+	buffer = buffers[0].data;
+}
+
+void uring_writer_t::unmap_ring() {
+	if (sqes)
+		munmap(sqes, num_entries * sizeof(io_uring_sqe));
+	if (cq_ptr && cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+		munmap(cq_ptr, cq_ring_size);
+	if (sq_ptr && sq_ptr != MAP_FAILED)
+		munmap(sq_ptr, sq_ring_size);
+	sqes = nullptr;
+	sq_ptr = cq_ptr = nullptr;
+	if (ring_fd >= 0)
+		::close(ring_fd);
+	ring_fd = -1;
+}
+
+uring_writer_t::~uring_writer_t() {
+	close();
+	unmap_ring();
+	for (auto& b : buffers)
+		free(b.data);
+}
+
+void uring_writer_t::queue_write(uint64_t seqno, const write_t& w) {
+	// never have more writes in flight than fit in the completion ring
+	while (num_writes_in_flight >= (int)num_entries) {
+		if (enter(1) < 0)
+			return;
+	}
+	auto tail = *sq_tail;
+	auto idx = tail & *sq_mask;
+	auto* sqe = &sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = buffers_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->off = w.file_offset;
+	sqe->addr = (uint64_t)(buffers[w.buffer_idx].data + w.buffer_offset);
+	sqe->len = w.len;
+	sqe->buf_index = w.buffer_idx;
+	sqe->user_data = seqno;
+	sq_array[idx] = idx;
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++num_to_submit;
+	++num_writes_in_flight;
+}
+
+/*
+	Pass queued writes to the kernel, wait for at least min_complete completions (or a signal) and
+	handle all available completions
+*/
+int uring_writer_t::enter(unsigned min_complete) {
+	for (;;) {
+		if (num_to_submit > 0 || min_complete > 0) {
+			auto ret = syscall(__NR_io_uring_enter, ring_fd, num_to_submit, min_complete,
+												 min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN && errno != EBUSY) {
+					dterrorf("io_uring_enter failed: {}", strerror(errno));
+					return -1;
+				}
+				// kernel is short on resources; completing writes will free them
+				min_complete = num_writes_in_flight > (int)num_to_submit ? 1 : 0;
+				reap();
+				continue;
+			}
+			num_to_submit -= ret;
+		}
+		reap();
+		min_complete = 0;
+		if (num_to_submit == 0)
+			return 0;
+	}
+}
+
+void uring_writer_t::reap() {
+	auto head = *cq_head;
+	for (;;) {
+		auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+		if (head == tail)
+			break;
+		auto& cqe = cqes[head & *cq_mask];
+		auto seqno = cqe.user_data;
+		auto res = cqe.res;
+		__atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+		handle_completion(seqno, res);
+	}
+}
+
+void uring_writer_t::handle_completion(uint64_t seqno, int res) {
+	assert(seqno >= first_write_seqno && seqno < first_write_seqno + writes.size());
+	auto& w = writes[seqno - first_write_seqno];
+	--num_writes_in_flight;
+	if (res == -EINTR || res == -EAGAIN) {
+		queue_write(seqno, w);
+		return;
+	}
+	if (res > 0 && res < w.len) {
+		// short write: write the remainder
+		w.file_offset += res;
+		w.buffer_offset += res;
+		w.len -= res;
+		queue_write(seqno, w);
+		return;
+	}
+	if (res <= 0)
+		dterrorf("Error while writing {:d} bytes at offset {:d}: {}", w.len, w.file_offset,
+						 res < 0 ? strerror(-res) : "nothing written");
+	w.done = true;
+	--buffers[w.buffer_idx].num_pending_writes;
+	while (!writes.empty() && writes.front().done) {
+		num_bytes_written = writes.front().file_offset + writes.front().len;
+		writes.pop_front();
+		++first_write_seqno;
+	}
+}
+
+void uring_writer_t::submit() {
+	if (fd < 0)
+		return;
+	if (decrypt_pointer > submit_pointer) {
+		writes.push_back(write_t{offset + submit_pointer, current_buffer, submit_pointer,
+				decrypt_pointer - submit_pointer});
+		++buffers[current_buffer].num_pending_writes;
+		queue_write(first_write_seqno + writes.size() - 1, writes.back());
+		submit_pointer = decrypt_pointer;
+	}
+	enter(0);
+}
+
+int uring_writer_t::advance() {
+	submit();
+	int next = (current_buffer + 1) % buffers.size();
+	while (buffers[next].num_pending_writes > 0) {
+		dtdebugf("Waiting for writes from buffer {:d}", next);
+		if (enter(1) < 0)
+			return -1;
+	}
+	auto num_bytes_to_move = write_pointer - decrypt_pointer;
+	if (num_bytes_to_move > buffer_size / 2)
+		dterrorf("Descrambling lags {:d} bytes behind", num_bytes_to_move);
+	memcpy(buffers[next].data, buffer + decrypt_pointer, num_bytes_to_move);
+	offset += decrypt_pointer;
+	write_pointer = num_bytes_to_move;
+	decrypt_pointer = 0;
+	submit_pointer = 0;
+	current_buffer = next;
+	buffer = buffers[next].data;
+	return 1;
+}
+
+void uring_writer_t::flush() {
+	if (ring_fd < 0)
+		return;
+	submit();
+	while (num_writes_in_flight > 0) {
+		if (enter(1) < 0)
+			break;
+	}
+}
+
+void uring_writer_t::transfer(int new_fd, int num_bytes_processed) {
+	assert(num_bytes_processed <= decrypt_pointer);
+	assert(decrypt_pointer <= write_pointer);
+	flush(); // also makes the current buffer free for reuse
+	if (fd >= 0) {
+		dtdebugf("TRUNCATE from ={:d} to {:d}", filesize_fd(fd), num_bytes_processed + offset);
+		if (ftruncate(fd, num_bytes_processed + offset) < 0) {
+			dterrorf("Error while truncating {}", strerror(errno));
+		}
+		close();
+	}
+	auto num_bytes_to_move = write_pointer - num_bytes_processed;
+	if (num_bytes_to_move > 0)
+		dtdebugf("Moving {:d} bytes to new file", num_bytes_to_move);
+	memmove(buffer, buffer + num_bytes_processed, num_bytes_to_move);
+	write_pointer = num_bytes_to_move;
+	decrypt_pointer -= num_bytes_processed;
+	submit_pointer = 0;
+	fd = new_fd;
+	offset = 0;
+	num_bytes_written = 0;
+}
+
+void uring_writer_t::close() {
+	flush();
+	while (fd >= 0 && ::close(fd) < 0) {
+		if (errno != EINTR) {
+			dterrorf("Error closing file: {:s}", strerror(errno));
+			break;
+		}
+	}
+	fd = -1;
+}
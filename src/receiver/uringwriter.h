@@ -0,0 +1,163 @@
+/*
+ * Neumo dvb (C) 2019-2024 deeptho@gmail.com
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+#include <deque>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+#include "util/dtassert.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*!
+	Alternative to the write side of mmap_t for live buffers: data is read into one of a small number of
+	page aligned buffers, registered with io_uring, descrambled and parsed in that buffer, and then written
+	to the file asynchronously. The file is never mapped, so the service thread does not stall on page faults
+	or on writeback of dirty mapped pages.
+
+	The pointers have the same meaning as in mmap_t, but are relative to the start of the current buffer,
+	which corresponds to byte offset in the file. Data is written up to decrypt_pointer by submit().
+	A buffer is reused only after all writes from it have completed.
+
+	Bytes before num_bytes_written in the current file are in the page cache and can be read by
+	other processes/threads (e.g., playback_mpm_t).
+*/
+struct uring_writer_t {
+	static constexpr int default_buffer_size = 4 * 4096 * 188; //multiple of 4096 and 188; approx 3 MByte
+	static constexpr int default_num_buffers = 4;
+
+private:
+	struct buffer_t {
+		uint8_t* data{nullptr};
+		int num_pending_writes{0};
+	};
+
+	struct write_t {
+		off_t file_offset;
+		int buffer_idx;
+		int buffer_offset;
+		int len;
+		bool done{false};
+	};
+
+	//ring state, shared with the kernel
+	int ring_fd{-1};
+	unsigned num_entries{0};
+	void* sq_ptr{nullptr};
+	size_t sq_ring_size{0};
+	void* cq_ptr{nullptr};
+	size_t cq_ring_size{0};
+	io_uring_sqe* sqes{nullptr};
+	unsigned* sq_head{nullptr};
+	unsigned* sq_tail{nullptr};
+	unsigned* sq_mask{nullptr};
+	unsigned* sq_array{nullptr};
+	unsigned* cq_head{nullptr};
+	unsigned* cq_tail{nullptr};
+	unsigned* cq_mask{nullptr};
+	io_uring_cqe* cqes{nullptr};
+	unsigned num_to_submit{0}; //entries queued but not yet passed to the kernel
+	bool buffers_registered{false};
+
+	std::vector<buffer_t> buffers;
+	int current_buffer{0};
+	int submit_pointer{0}; //first byte in the current buffer not yet submitted for writing
+
+	std::deque<write_t> writes; //in flight, in order of submission
+	uint64_t first_write_seqno{0}; //seqno of writes.front()
+	int num_writes_in_flight{0};
+
+	void queue_write(uint64_t seqno, const write_t& w);
+	int enter(unsigned min_complete);
+	void reap();
+	void handle_completion(uint64_t seqno, int res);
+	void unmap_ring();
+
+public:
+	const int buffer_size;
+	int fd{-1}; //file being written
+	off_t offset{0}; //file offset at which the current buffer starts
+
+	uint8_t* buffer{nullptr}; //start of the current buffer
+	int write_pointer{0}; //first byte in the current buffer we will write (read into) next
+	int decrypt_pointer{0}; //first byte in the current buffer we will decrypt next
+	off_t num_bytes_written{0}; //all bytes in the file before this offset have been written
+
+	uring_writer_t(int num_buffers = default_num_buffers, int buffer_size = default_buffer_size);
+	uring_writer_t(const uring_writer_t& other) = delete;
+	~uring_writer_t();
+
+	//false if io_uring is not available, in which case mmap_t should be used
+	bool is_valid() const {
+		return ring_fd >= 0;
+	}
+
+	int get_write_buffer(uint8_t*& buffer_ret) {
+		if (fd < 0)
+			return -1;
+		buffer_ret = buffer + write_pointer;
+		return buffer_size - write_pointer;
+	}
+
+	int bytes_to_decrypt(uint8_t*& buffer_ret) {
+		if (fd < 0)
+			return -1;
+		buffer_ret = buffer + decrypt_pointer;
+		return ((write_pointer - decrypt_pointer) / 188) * 188;
+	}
+
+	void advance_write_pointer(int extra) {
+		write_pointer += extra;
+		assert(write_pointer <= buffer_size);
+	}
+
+	void advance_decrypt_pointer(int extra) {
+		assert(decrypt_pointer + extra <= write_pointer);
+		decrypt_pointer += extra;
+	}
+
+	/*!
+		Submit writes for all data up to decrypt_pointer, and pick up completed writes
+		without waiting
+	*/
+	void submit();
+
+	/*!
+		Switch to the next buffer, waiting for its writes to complete if needed.
+		Data which has not been decrypted yet is moved to the start of the new buffer
+	*/
+	int advance();
+
+	/*!
+		Submit all pending data and wait until it has been written
+	*/
+	void flush();
+
+	/*!
+		Start writing to a new file, owned by this writer from now on.
+		The data from byte num_bytes_processed in the current buffer onwards is moved to the new file; the
+		old file is truncated just before that byte and closed
+	*/
+	void transfer(int new_fd, int num_bytes_processed);
+
+	void close();
+};
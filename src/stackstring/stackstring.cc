@@ -141,7 +141,7 @@ namespace ss {
 	output_len and *output_size can be modified
 	clean: remove characters such as \0x86 and \x0x87 (emphasis)
 */
-	int string_::append_as_utf8(char* input, int input_len, const char* enc) {
+	int string_::append_as_utf8(const char* input, int input_len, const char* enc) {
 		if (!input || !*input)
 			return 0;
 		auto size_ = size();
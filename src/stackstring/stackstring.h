@@ -883,7 +883,7 @@ namespace ss {
 			return std::string(buffer());
 		}
 
-		int append_as_utf8(char* input, int input_len, const char* enc);
+		int append_as_utf8(const char* input, int input_len, const char* enc);
 
 		int strftime(const char* fmt, const struct tm* tm);
 		void trim(int start = 0);
@@ -910,31 +910,112 @@ int MpvPlayer_::jump(int seconds) {
 	}
 
 	// retune request
-	auto op = [this, seconds]() {
-		// service is captured by copy
-		subscription.jump(seconds);
-	};
+	reopen_stream([this, seconds]() { subscription.jump(seconds); });
+	dtdebugf("JUMP SUBSCRIPTION {:p}", fmt::ptr(this));
+	return 0;
+}
+
+int MpvPlayer::jump(int seconds) {
+	auto* self = dynamic_cast<MpvPlayer_*>(this);
+	return self->jump(seconds);
+}
+
+int mpv_subscription_t::set_trick_play(int speed) {
+	if (!mpm) {
+		dtdebugf("No active playback");
+		return -1;
+	}
+	dtdebugf("TRICK PLAY speed={}", speed);
+	auto ret = mpm->set_trick_play(speed);
+	std::scoped_lock lck(m);
+	if (pending_trick_play_speed == speed)
+		pending_trick_play_speed.reset(); //unless a newer speed has been requested in the mean time
+	return ret;
+}
+
+/*
+	Returns the speed requested last, also when mpv has not yet reopened the stream to apply it
+*/
+int mpv_subscription_t::get_trick_play_speed() const {
+	{
+		std::scoped_lock lck(m);
+		if (pending_trick_play_speed)
+			return *pending_trick_play_speed;
+	}
+	return mpm ? mpm->get_trick_play_speed() : 0;
+}
+
+int mpv_subscription_t::resume_after_trick_play() {
+	if (!mpm) {
+		dtdebugf("No active playback");
+		return -1;
+	}
+	dtdebugf("RESUME PLAY after trick play");
+	return mpm->resume_after_trick_play();
+}
+
+/*
+	mpv reopens the stream, so that it discards what it has buffered; op is run when it opens the new stream.
+	Called from the gui thread, or with the gui mutex held
+*/
+void MpvPlayer_::reopen_stream(std::function<void()> op, std::optional<int> trick_play_speed) {
 	{
-		// lock must be placed after lambda
 		std::scoped_lock lck(subscription.m);
 		subscription.next_op = op;
+		subscription.pending_trick_play_speed = trick_play_speed;
 	}
 	// will be run by the first opn_fn or close_fn call
 
 	subscription.filepath.clear();
-	// int64_t start = 0;
 	const char* cmd1[] = {"loadfile", nullptr};
 	::mpv_command(mpv, cmd1);
 	subscription.filepath.format("neumo://{:p}/{:d}", fmt::ptr(this), subscription.seqno++);
 	const char* cmd[] = {"loadfile", subscription.filepath.c_str(), nullptr};
 	::mpv_command(mpv, cmd);
-	dtdebugf("JUMP SUBSCRIPTION {:p}", fmt::ptr(this));
+}
+
+/*
+	Like jump: mpv reopens the stream, so that it discards what it has buffered, and starts
+	with the new (trick play) stream
+*/
+int MpvPlayer_::set_trick_play(int speed) {
+	if (!mpv || !subscription.mpm) {
+		dterrorf("mpv not ready");
+		return -1;
+	}
+	reopen_stream([this, speed]() { subscription.set_trick_play(speed); }, speed);
+	dtdebugf("TRICK PLAY SUBSCRIPTION {:p}", fmt::ptr(this));
 	return 0;
 }
 
-int MpvPlayer::jump(int seconds) {
+/*
+	Called by the read thread when trick play has reached the start or the end of the data: mpv has received
+	trick play frames with their own timestamps, so it must reopen the stream to continue with normal play.
+	The stream is reopened from run(), because mpv cannot be commanded from the read thread
+*/
+void MpvPlayer_::on_trick_play_ended() {
+	{
+		std::lock_guard<std::mutex> lk(m);
+		must_resume_play = true;
+	}
+	cv.notify_one();
+}
+
+void MpvPlayer_::resume_play_after_trick_play() {
+	if (!mpv || !subscription.mpm)
+		return;
+	reopen_stream([this]() { subscription.resume_after_trick_play(); });
+	dtdebugf("RESUME PLAY SUBSCRIPTION {:p}", fmt::ptr(this));
+}
+
+int MpvPlayer::set_trick_play(int speed) {
 	auto* self = dynamic_cast<MpvPlayer_*>(this);
-	return self->jump(seconds);
+	return self->set_trick_play(speed);
+}
+
+int MpvPlayer::get_trick_play_speed() const {
+	auto* self = dynamic_cast<const MpvPlayer_*>(this);
+	return self->subscription.get_trick_play_speed();
 }
 
 void mpv_subscription_t::close(bool unsubscribe) {
@@ -945,6 +1026,7 @@ void mpv_subscription_t::close(bool unsubscribe) {
 	if ((int) subscription_id >= 0)
 		mpm->unregister_audio_changed_callback(subscription_id);
 	std::scoped_lock lck(m);
+	pending_trick_play_speed.reset();
 	mpm->close();
 	mpm.reset();
 	if(unsubscribe)
@@ -1041,12 +1123,21 @@ int MpvPlayer_::run() {
 	run_id = std::this_thread::get_id();
 	for (;;) {
 		bool timedout;
+		bool resume_play;
 		{
 			std::unique_lock<std::mutex> lk(m);
 			timedout = !cv.wait_for(lk, 500ms,
-									[this] { return mustexit || (frames_to_play > (inited ? 0 : 1)); });
+									[this] { return mustexit || must_resume_play || (frames_to_play > (inited ? 0 : 1)); });
 			if (mustexit)
 				break;
+			resume_play = must_resume_play;
+			must_resume_play = false;
+		}
+		if (resume_play) {
+			wxMutexGuiEnter(); //the gui thread also reopens the stream
+			resume_play_after_trick_play();
+			wxMutexGuiLeave();
+			continue;
 		}
 		if (gl_canvas->inited) { // inited is set in OnPaint
 			wxMutexGuiEnter();
@@ -1091,9 +1182,12 @@ int64_t mpv_subscription_t::read_data(char* buffer, uint64_t nbytes) {
 	auto subscription_id = subscriber->get_subscription_id();
 	if ((int) subscription_id < 0)
 		return 0;
-	if (mpm) // regular service
-		return mpm->read_data(buffer, nbytes);
-	else
+	if (mpm) { // regular service
+		auto ret = mpm->read_data(buffer, nbytes);
+		if (mpm->trick_play_has_ended())
+			mpv_player->on_trick_play_ended();
+		return ret;
+	} else
 		return wait_for_close();
 }
 
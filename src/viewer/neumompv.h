@@ -88,6 +88,8 @@ public:
 	int stop_play();
 	int stop_play_and_exit();
 	int jump(int seconds);
+	int set_trick_play(int speed);
+	int get_trick_play_speed() const;
 	int set_audio_language(int idx);
 	int set_subtitle_language(int id);
 	int change_audio_volume(int step);
@@ -26,6 +26,7 @@
 #include <condition_variable>
 #include <atomic>
 #include <functional>
+#include <optional>
 #include <mpv/client.h>
 #include <mpv/stream_cb.h>
 #include <mpv/render_gl.h>
@@ -54,6 +55,7 @@ public:
 		return (int) subscriber->get_subscription_id() >=0;
 	}
 	std::function<void()> next_op = none; //callback run on close
+	std::optional<int> pending_trick_play_speed; //set_trick_play speed of next_op, until it has been applied
 private:
 	receiver_t* receiver = nullptr;
 	MpvPlayer_* mpv_player = nullptr;
@@ -86,6 +88,9 @@ public:
 	int play_recording(const recdb::rec_t& rec, milliseconds_t start_play_time);
 	int stop_play();
 	int jump(int seconds);
+	int set_trick_play(int speed);
+	int get_trick_play_speed() const;
+	int resume_after_trick_play();
 
 	int set_audio_language(int idx);
 	void on_audio_language_change(const chdb::language_code_t& lang, int id);
@@ -114,6 +119,7 @@ public:
 	}
 
 	mpv_render_context* mpv_gl = nullptr;
+	bool must_resume_play{false}; //trick play has ended by itself; protected by m
 
 	void on_mpv_wakeup_event();
 
@@ -133,6 +139,10 @@ public:
 
 	template <typename _mux_t> int play_mux(const _mux_t& mux, bool blindscan);
 	int jump(int seconds);
+	void reopen_stream(std::function<void()> op, std::optional<int> trick_play_speed = {});
+	int set_trick_play(int speed);
+	void on_trick_play_ended();
+	void resume_play_after_trick_play();
 	int stop_play();
 	int pause();
 	int run();
@@ -66,6 +66,9 @@ PYBIND11_MODULE(pyneumompv, m) {
 		.def("play_recording", &MpvPlayer::play_recording, py::arg("recording"),
 				 py::arg("start_play_time") = milliseconds_t(0))
 		.def("jump", &MpvPlayer::jump, py::arg("seconds"))
+		.def("set_trick_play", &MpvPlayer::set_trick_play, py::arg("speed"),
+				 "Fast forward (speed=2...64), rewind (speed=-2...-64) or normal play (speed=0)")
+		.def("get_trick_play_speed", &MpvPlayer::get_trick_play_speed)
 		.def("mpv_command", &MpvPlayer::mpv_command, py::arg("command"), py::arg("arg1") = nullptr,
 				 py::arg("arg2") = nullptr)
 		.def("stop_play", &MpvPlayer::stop_play)